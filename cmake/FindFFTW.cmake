@@ -7,6 +7,8 @@
 #   FFTW_FOUND               ... true if fftw is found on the system
 #   FFTW_LIBRARIES           ... full path to fftw library
 #   FFTW_INCLUDES            ... fftw include directory
+#   FFTW_THREADS_FOUND       ... true if fftw's OpenMP libraries are found
+#   FFTW_THREADS_LIBRARIES   ... full path to fftw's OpenMP libraries
 #
 # The following variables will be checked by the function
 #   FFTW_USE_STATIC_LIBS    ... if true, only static libraries are found
@@ -59,6 +61,30 @@ message( "Searching for FFTW in " ${FFTW_ROOT})
     NO_DEFAULT_PATH
   )
 
+  find_library(
+    FFTW_OMP_LIB
+    NAMES "fftw3_omp"
+    PATHS ${FFTW_ROOT}
+    PATH_SUFFIXES "lib" "lib64"
+    NO_DEFAULT_PATH
+  )
+
+  find_library(
+    FFTWF_OMP_LIB
+    NAMES "fftw3f_omp"
+    PATHS ${FFTW_ROOT}
+    PATH_SUFFIXES "lib" "lib64"
+    NO_DEFAULT_PATH
+  )
+
+  find_library(
+    FFTWL_OMP_LIB
+    NAMES "fftw3l_omp"
+    PATHS ${FFTW_ROOT}
+    PATH_SUFFIXES "lib" "lib64"
+    NO_DEFAULT_PATH
+  )
+
   #find includes
   find_path(
     FFTW_INCLUDES
@@ -88,6 +114,24 @@ else()
     PATHS ${PKG_FFTW_LIBRARY_DIRS} ${LIB_INSTALL_DIR}
   )
 
+  find_library(
+    FFTW_OMP_LIB
+    NAMES "fftw3_omp"
+    PATHS ${PKG_FFTW_LIBRARY_DIRS} ${LIB_INSTALL_DIR}
+  )
+
+  find_library(
+    FFTWF_OMP_LIB
+    NAMES "fftw3f_omp"
+    PATHS ${PKG_FFTW_LIBRARY_DIRS} ${LIB_INSTALL_DIR}
+  )
+
+  find_library(
+    FFTWL_OMP_LIB
+    NAMES "fftw3l_omp"
+    PATHS ${PKG_FFTW_LIBRARY_DIRS} ${LIB_INSTALL_DIR}
+  )
+
   find_path(
     FFTW_INCLUDES
     NAMES "fftw3.h"
@@ -122,7 +166,29 @@ else()
     message(STATUS "${Red}Long double precision FFTW not found${ColourReset}")
 endif()
 
+# FFTW's OpenMP libraries let its native 3D transforms share the work among threads; they are only used if they
+# were found for every precision that was found.
+set(FFTW_THREADS_FOUND FALSE)
+if(FFTWF_LIB OR FFTW_LIB OR FFTWL_LIB)
+    set(FFTW_THREADS_FOUND TRUE)
+    foreach(precision FFTWF FFTW FFTWL)
+        if(${precision}_LIB)
+            if(${precision}_OMP_LIB)
+                set(FFTW_THREADS_LIBRARIES ${FFTW_THREADS_LIBRARIES} ${${precision}_OMP_LIB})
+            else()
+                set(FFTW_THREADS_FOUND FALSE)
+            endif()
+        endif()
+    endforeach()
+endif()
+if(FFTW_THREADS_FOUND)
+    message(STATUS "${Cyan}Found FFTW OpenMP libraries: ${FFTW_THREADS_LIBRARIES}${ColourReset}")
+else()
+    message(STATUS "${Red}FFTW OpenMP libraries not found${ColourReset}")
+    set(FFTW_THREADS_LIBRARIES "")
+endif()
+
 include(FindPackageHandleStandardArgs)
 find_package_handle_standard_args(FFTW DEFAULT_MSG
                                   FFTW_INCLUDES FFTW_LIBRARIES)
-mark_as_advanced(FFTW_INCLUDES FFTW_LIBRARIES FFTW_LIB FFTWF_LIB FFTWL_LIB)
+mark_as_advanced(FFTW_INCLUDES FFTW_LIBRARIES FFTW_LIB FFTWF_LIB FFTWL_LIB FFTW_OMP_LIB FFTWF_OMP_LIB FFTWL_OMP_LIB)
@@ -39,7 +39,19 @@ void declarePMEInstance(py::module& mod, std::string const& suffix) {
 
     py::class_<PME> pme(mod, ("PMEInstance" + suffix).c_str());
     pme.def(py::init<>(), "Construct PMEInstance object");
-    pme.def("setup", &PME::setup, "Set up PMEInstance object for a serial run");
+    // Registered before setup(), whose default planning rigor argument needs the type to be known.
+    py::enum_<typename PME::FFTPlanningRigor>(pme, "FFTPlanningRigor")
+        .value("Estimate", PME::FFTPlanningRigor::Estimate)
+        .value("Measure", PME::FFTPlanningRigor::Measure)
+        .value("Patient", PME::FFTPlanningRigor::Patient);
+    pme.def("setup", &PME::setup, py::arg("rPower"), py::arg("kappa"), py::arg("splineOrder"), py::arg("aDim"),
+            py::arg("bDim"), py::arg("cDim"), py::arg("scaleFactor"), py::arg("nThreads"),
+            py::arg("planningRigor") = PME::FFTPlanningRigor::Estimate, "Set up PMEInstance object for a serial run");
+#if HAVE_FFTW == 1
+    pme.def_static("import_fft_wisdom", &PME::importFFTWisdom,
+                   "Loads FFTW wisdom from a file, returning False if it could not be read.");
+    pme.def_static("export_fft_wisdom", &PME::exportFFTWisdom, "Saves the accumulated FFTW wisdom to a file.");
+#endif
     pme.def("set_lattice_vectors", &PME::setLatticeVectors,
             "Set the lattice vectors for the unit cell: A, B, C, alpha, beta, gamma, Orietation.");
     pme.def("compute_E_rec", &PME::computeERec, py::arg("parameterAngMom"),
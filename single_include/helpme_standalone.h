@@ -29,6 +29,7 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <numeric>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -38,6 +39,792 @@
 #include <unistd.h>
 #include <vector>
 
+// FFTW is available if any of its precisions has been linked in.
+#if !defined(HAVE_FFTW) && (HAVE_FFTWF == 1 || HAVE_FFTWD == 1 || HAVE_FFTWL == 1)
+#define HAVE_FFTW 1
+#endif
+
+// original file: ../src/bundled_fft.h
+
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_BUNDLED_FFT_H_
+#define _HELPME_BUNDLED_FFT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// original file: ../src/fft_backend.h
+
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_FFT_BACKEND_H_
+#define _HELPME_FFT_BACKEND_H_
+
+#include <algorithm>
+#include <complex>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/*!
+ * \file fft_backend.h
+ * \brief Contains the interface that each FFT library is wrapped in, so that the PME code can use any of them.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The sign of the exponent used by complex to complex transforms, following the FFTW convention.
+ */
+enum FFTDirection : int { FFTForward = -1, FFTBackward = 1 };
+
+/*!
+ * \brief The FFTBatchPlan class is the interface to an FFT library's plans for transforming a batch of equally
+ *        spaced, contiguous lines of data.  Complex to complex transforms work in place and real to complex and
+ *        complex to real transforms work out of place.  As with FFTW, no transform is normalized, and a complex to
+ *        real transform may overwrite its input.  The transforms must be safe to call concurrently from different
+ *        threads, provided that each works on different data.
+ */
+template <typename Real>
+class FFTBatchPlan {
+   public:
+    virtual ~FFTBatchPlan() {}
+
+    /*!
+     * \brief transform does an out of place complex to real FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(std::complex<Real> *inBuffer, Real *outBuffer) = 0;
+
+    /*!
+     * \brief transform does an out of place real to complex FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(Real *inBuffer, std::complex<Real> *outBuffer) = 0;
+
+    /*!
+     * \brief transform does an in place complex to complex FFT of every line in the batch.
+     * \param inPlaceBuffer the location of the input and output data.
+     * \param direction either FFTForward or FFTBackward.
+     */
+    virtual void transform(std::complex<Real> *inPlaceBuffer, int direction) = 0;
+};
+
+/*!
+ * \brief The FFTGridPlan class is the interface to an FFT library's plans for three dimensional real to complex and
+ *        complex to real transforms of a full grid.  The grid is stored with C as the slowest running index and A as
+ *        the fastest, and the complex grid has the same ordering with only the dimA / 2 + 1 unique values along A.
+ */
+template <typename Real>
+class FFTGridPlan {
+   public:
+    virtual ~FFTGridPlan() {}
+
+    /*!
+     * \brief transform does an out of place complex to real FFT of the grid.  The input is overwritten.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(std::complex<Real> *inBuffer, Real *outBuffer) = 0;
+
+    /*!
+     * \brief transform does an out of place real to complex FFT of the grid.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(Real *inBuffer, std::complex<Real> *outBuffer) = 0;
+};
+
+/*!
+ * \brief The FFTPlanner class is the interface to an FFT library, which makes the plans used by the PME code.
+ */
+template <typename Real>
+class FFTPlanner {
+   public:
+    virtual ~FFTPlanner() {}
+
+    /*!
+     * \brief makeBatchPlan plans the transforms of a batch of lines.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     * \return the plan.
+     */
+    virtual std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany,
+                                                              size_t realDistance, size_t complexDistance,
+                                                              bool realData) const = 0;
+
+    /*!
+     * \brief makeGridPlan plans the three dimensional transforms of a full grid.
+     * \param dimA the length of the fast running dimension.
+     * \param dimB the length of the intermediate dimension.
+     * \param dimC the length of the slow running dimension.
+     * \param nThreads the number of threads that the library should share each transform among.
+     * \return the plan, or a null pointer if the library has no native three dimensional transforms, or can't share
+     *         them among that many threads.
+     */
+    virtual std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t dimA, size_t dimB, size_t dimC,
+                                                            int nThreads) const = 0;
+};
+
+/*!
+ * \brief The ParallelExceptionCatcher class keeps the first exception thrown by any thread in a parallel region, which
+ *        exceptions can't propagate out of, so that it can be rethrown once the region has finished.
+ */
+class ParallelExceptionCatcher {
+    /// The first exception caught, if any.
+    std::exception_ptr exception_;
+
+   public:
+    /*!
+     * \brief run calls a function, catching any exception that it throws.
+     * \param function the function to call.
+     */
+    template <typename Function>
+    void run(const Function &function) {
+        try {
+            function();
+        } catch (...) {
+#pragma omp critical(helpme_parallel_exception)
+            if (!exception_) exception_ = std::current_exception();
+        }
+    }
+
+    /// \brief rethrow throws the exception caught by run(), if there was one.
+    void rethrow() const {
+        if (exception_) std::rethrow_exception(exception_);
+    }
+};
+
+/*!
+ * \brief The ThreadedFFTBatch class splits a batch of equally spaced, contiguous lines into one contiguous chunk per
+ *        thread, each with its own batch plan, and transforms the chunks concurrently.  This avoids relying on the
+ *        threading support of the FFT library.
+ */
+template <typename Real>
+class ThreadedFFTBatch {
+    /// Chunks start on a multiple of this many bytes from the start of the batch, so that every chunk has the same
+    /// SIMD alignment as the start of the batch; this is large enough for any of FFTW's SIMD instruction sets.
+    enum : size_t { AlignmentBytes = 64 };
+    /// The plans for each thread's chunk.
+    std::vector<std::unique_ptr<FFTBatchPlan<Real>>> chunkPlans_;
+    /// The first line in each chunk, with the total number of lines appended.
+    std::vector<size_t> chunkStarts_;
+    /// The distance between the starts of consecutive lines of real data.
+    size_t realDistance_;
+    /// The distance between the starts of consecutive lines of complex data.
+    size_t complexDistance_;
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+
+    static size_t gcd(size_t a, size_t b) { return b ? gcd(b, a % b) : a; }
+
+   public:
+    ThreadedFFTBatch() : realDistance_(0), complexDistance_(0), realData_(false) {}
+    /*!
+     * \brief Sets up the plans for a batch of transforms, shared among threads.
+     * \param planner the FFT library used to plan each chunk.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     * \param nThreads the number of threads to share the batch among.
+     */
+    ThreadedFFTBatch(const FFTPlanner<Real> &planner, size_t fftDimension, size_t howMany, size_t realDistance,
+                     size_t complexDistance, bool realData, int nThreads)
+        : realDistance_(realDistance), complexDistance_(complexDistance), realData_(realData) {
+        // The smallest number of lines that spans a multiple of the alignment in both the real and complex data.
+        size_t realBytes = realData ? realDistance * sizeof(Real) : AlignmentBytes;
+        size_t complexBytes = complexDistance * sizeof(std::complex<Real>);
+        size_t realGranularity = AlignmentBytes / gcd(AlignmentBytes, realBytes);
+        size_t complexGranularity = AlignmentBytes / gcd(AlignmentBytes, complexBytes);
+        size_t granularity = realGranularity / gcd(realGranularity, complexGranularity) * complexGranularity;
+
+        size_t nUnits = (howMany + granularity - 1) / granularity;
+        size_t nChunks = std::max<size_t>(1, std::min<size_t>(std::max(nThreads, 1), nUnits));
+        chunkStarts_.push_back(0);
+        for (size_t chunk = 0; chunk < nChunks; ++chunk) {
+            size_t lastLine = std::min(howMany, (nUnits * (chunk + 1) / nChunks) * granularity);
+            if (lastLine == chunkStarts_.back()) continue;
+            chunkPlans_.push_back(planner.makeBatchPlan(fftDimension, lastLine - chunkStarts_.back(), realDistance,
+                                                        complexDistance, realData));
+            chunkStarts_.push_back(lastLine);
+        }
+    }
+
+    /// \return the number of chunks that the batch is divided into.
+    size_t numChunks() const { return chunkPlans_.size(); }
+
+    /*!
+     * \brief transform does an out of place complex to real FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) {
+        // The kind of transform is checked before the parallel region, because exceptions can't propagate out of it;
+        // errors from the FFT library are caught inside the region, and rethrown after it.  A batch with no lines
+        // has no chunks, and nothing to do.
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        if (chunkPlans_.empty()) return;
+        int nChunks = chunkPlans_.size();
+        ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nChunks)
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+            errors.run([&] {
+                chunkPlans_[chunk]->transform(inBuffer + chunkStarts_[chunk] * complexDistance_,
+                                              outBuffer + chunkStarts_[chunk] * realDistance_);
+            });
+        errors.rethrow();
+    }
+
+    /*!
+     * \brief transform does an out of place real to complex FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        if (chunkPlans_.empty()) return;
+        int nChunks = chunkPlans_.size();
+        ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nChunks)
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+            errors.run([&] {
+                chunkPlans_[chunk]->transform(inBuffer + chunkStarts_[chunk] * realDistance_,
+                                              outBuffer + chunkStarts_[chunk] * complexDistance_);
+            });
+        errors.rethrow();
+    }
+
+    /*!
+     * \brief transform does an in place complex to complex FFT of every line in the batch.
+     * \param inPlaceBuffer the location of the input and output data.
+     * \param direction either FFTForward or FFTBackward.
+     */
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        if (direction != FFTForward && direction != FFTBackward)
+            throw std::runtime_error("Invalid FFT direction passed to in place transform().");
+        if (chunkPlans_.empty()) return;
+        int nChunks = chunkPlans_.size();
+        ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nChunks)
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+            errors.run([&] {
+                chunkPlans_[chunk]->transform(inPlaceBuffer + chunkStarts_[chunk] * complexDistance_, direction);
+            });
+        errors.rethrow();
+    }
+};
+
+}  // Namespace helpme
+#endif  // Header guard
+// original file: ../src/memory.h
+
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_MEMORY_H_
+#define _HELPME_MEMORY_H_
+
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace helpme {
+
+/*!
+ * \brief AlignedAllocator a class to handle aligned allocation of memory, suitable for SIMD loads and stores by the
+ *        FFT libraries and the PME kernels.  The storage comes from operator new, so that programs that replace it
+ *        also see helpme's allocations.  Code is adapted from http://www.josuttis.com/cppcode/myalloc.hpp.html.
+ */
+template <class T>
+class AlignedAllocator {
+   public:
+    /// The alignment, in bytes, of each allocation; this is a cache line, and enough for any SIMD instruction set.
+    enum : size_t { Alignment = 64 };
+
+    // type definitions
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    // rebind allocator to type U
+    template <class U>
+    struct rebind {
+        typedef AlignedAllocator<U> other;
+    };
+
+    // return address of values
+    pointer address(reference value) const { return &value; }
+    const_pointer address(const_reference value) const { return &value; }
+
+    /* constructors and destructor
+     * - nothing to do because the allocator has no state
+     */
+    AlignedAllocator() throw() {}
+    AlignedAllocator(const AlignedAllocator&) throw() {}
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U>&) throw() {}
+    ~AlignedAllocator() throw() {}
+
+    // return maximum number of elements that can be allocated
+    size_type max_size() const throw() {
+        return (std::numeric_limits<std::size_t>::max() - Alignment - sizeof(void*)) / sizeof(T);
+    }
+
+    // allocate but don't initialize num elements of type T
+    pointer allocate(size_type num, const void* = 0) {
+        if (num > max_size()) throw std::bad_alloc();
+        // The block is padded so that an aligned address can be found after room for a pointer to the block itself,
+        // which is stored just before the aligned address for deallocate() to free.
+        char* block = static_cast<char*>(::operator new(num * sizeof(T) + Alignment + sizeof(void*)));
+        std::uintptr_t first = reinterpret_cast<std::uintptr_t>(block) + sizeof(void*);
+        std::uintptr_t offset = (Alignment - first % Alignment) % Alignment;
+        char* memory = block + sizeof(void*) + offset;
+        reinterpret_cast<void**>(memory)[-1] = block;
+        return reinterpret_cast<pointer>(memory);
+    }
+
+    // initialize elements of allocated storage p with value value
+    void construct(pointer p, const T& value) {
+        // initialize memory with placement new
+        new ((void*)p) T(value);
+    }
+
+    // destroy elements of initialized storage p
+    void destroy(pointer) {}
+
+    // deallocate storage p of deleted elements
+    void deallocate(pointer p, size_type) {
+        if (p) ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+};
+
+// return that all specializations of this allocator are interchangeable
+template <class T1, class T2>
+bool operator==(const AlignedAllocator<T1>&, const AlignedAllocator<T2>&) throw() {
+    return true;
+}
+template <class T1, class T2>
+bool operator!=(const AlignedAllocator<T1>&, const AlignedAllocator<T2>&) throw() {
+    return false;
+}
+
+template <typename Real>
+using vector = std::vector<Real, AlignedAllocator<Real>>;
+
+}  // Namespace helpme
+
+#endif  // Header guard
+
+/*!
+ * \file bundled_fft.h
+ * \brief Contains a self contained mixed radix FFT, which needs no external library.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The BundledFFT class performs complex to complex transforms of a single length, using a recursive, out of
+ *        place, mixed radix Cooley-Tukey algorithm with specialized butterflies for radices 2, 3, 4 and 5 and a
+ *        generic butterfly for any other prime factors.
+ */
+template <typename Real>
+class BundledFFT {
+    using Complex = std::complex<Real>;
+
+    /// The length of the transform.
+    size_t fftDimension_;
+    /// Pairs of {radix, remaining length} for each stage of the decomposition.
+    std::vector<size_t> factors_;
+    /// The largest radix that needs the generic butterfly, or zero if there are none.
+    size_t maxGenericRadix_;
+    /// The twiddle factors exp(-2 pi i k / n) for the forward transform.
+    helpme::vector<Complex> forwardTwiddles_;
+    /// The twiddle factors exp(2 pi i k / n) for the backward transform.
+    helpme::vector<Complex> backwardTwiddles_;
+
+    /// Multiply two complex numbers, without the checks for infinities done by std::complex.
+    static Complex mul(const Complex &a, const Complex &b) {
+        return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    void butterfly2(Complex *out, size_t fstride, const Complex *twiddles, size_t m) const {
+        for (size_t k = 0; k < m; ++k) {
+            Complex t = mul(out[k + m], twiddles[k * fstride]);
+            out[k + m] = out[k] - t;
+            out[k] += t;
+        }
+    }
+
+    void butterfly3(Complex *out, size_t fstride, const Complex *twiddles, size_t m) const {
+        Real sinThird = twiddles[fstride * m].imag();
+        for (size_t k = 0; k < m; ++k) {
+            Complex s1 = mul(out[k + m], twiddles[k * fstride]);
+            Complex s2 = mul(out[k + 2 * m], twiddles[2 * k * fstride]);
+            Complex sum = s1 + s2;
+            Complex difference = (s1 - s2) * sinThird;
+            Complex base = out[k] - Real(0.5) * sum;
+            out[k] += sum;
+            out[k + m] = Complex(base.real() - difference.imag(), base.imag() + difference.real());
+            out[k + 2 * m] = Complex(base.real() + difference.imag(), base.imag() - difference.real());
+        }
+    }
+
+    void butterfly4(Complex *out, size_t fstride, const Complex *twiddles, size_t m, bool backward) const {
+        for (size_t k = 0; k < m; ++k) {
+            Complex s0 = mul(out[k + m], twiddles[k * fstride]);
+            Complex s1 = mul(out[k + 2 * m], twiddles[2 * k * fstride]);
+            Complex s2 = mul(out[k + 3 * m], twiddles[3 * k * fstride]);
+            Complex s5 = out[k] - s1;
+            Complex s4 = s0 - s2;
+            Complex s3 = s0 + s2;
+            out[k] += s1;
+            out[k + 2 * m] = out[k] - s3;
+            out[k] += s3;
+            if (backward) {
+                out[k + m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+                out[k + 3 * m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+            } else {
+                out[k + m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+                out[k + 3 * m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+            }
+        }
+    }
+
+    void butterfly5(Complex *out, size_t fstride, const Complex *twiddles, size_t m) const {
+        Complex ya = twiddles[fstride * m];
+        Complex yb = twiddles[2 * fstride * m];
+        for (size_t k = 0; k < m; ++k) {
+            Complex s0 = out[k];
+            Complex s1 = mul(out[k + m], twiddles[k * fstride]);
+            Complex s2 = mul(out[k + 2 * m], twiddles[2 * k * fstride]);
+            Complex s3 = mul(out[k + 3 * m], twiddles[3 * k * fstride]);
+            Complex s4 = mul(out[k + 4 * m], twiddles[4 * k * fstride]);
+            Complex s7 = s1 + s4, s10 = s1 - s4, s8 = s2 + s3, s9 = s2 - s3;
+            out[k] = s0 + s7 + s8;
+            Complex s5 = s0 + s7 * ya.real() + s8 * yb.real();
+            Complex s6(s10.imag() * ya.imag() + s9.imag() * yb.imag(),
+                       -s10.real() * ya.imag() - s9.real() * yb.imag());
+            out[k + m] = s5 - s6;
+            out[k + 4 * m] = s5 + s6;
+            Complex s11 = s0 + s7 * yb.real() + s8 * ya.real();
+            Complex s12(-s10.imag() * yb.imag() + s9.imag() * ya.imag(),
+                        s10.real() * yb.imag() - s9.real() * ya.imag());
+            out[k + 2 * m] = s11 + s12;
+            out[k + 3 * m] = s11 - s12;
+        }
+    }
+
+    void butterflyGeneric(Complex *out, size_t fstride, const Complex *twiddles, size_t m, size_t p,
+                          Complex *scratch) const {
+        for (size_t u = 0; u < m; ++u) {
+            for (size_t q = 0; q < p; ++q) scratch[q] = out[u + q * m];
+            for (size_t q1 = 0; q1 < p; ++q1) {
+                size_t k = u + q1 * m;
+                size_t twiddleIndex = 0;
+                Complex sum = scratch[0];
+                for (size_t q = 1; q < p; ++q) {
+                    twiddleIndex += fstride * k;
+                    if (twiddleIndex >= fftDimension_) twiddleIndex %= fftDimension_;
+                    sum += mul(scratch[q], twiddles[twiddleIndex]);
+                }
+                out[k] = sum;
+            }
+        }
+    }
+
+    void work(Complex *out, const Complex *in, size_t fstride, size_t inStride, const size_t *factors,
+              const Complex *twiddles, bool backward, Complex *scratch) const {
+        size_t p = factors[0];
+        size_t m = factors[1];
+        if (m == 1) {
+            for (size_t q = 0; q < p; ++q) out[q] = in[q * fstride * inStride];
+        } else {
+            for (size_t q = 0; q < p; ++q)
+                work(out + q * m, in + q * fstride * inStride, fstride * p, inStride, factors + 2, twiddles, backward,
+                     scratch);
+        }
+        switch (p) {
+            case 2:
+                butterfly2(out, fstride, twiddles, m);
+                break;
+            case 3:
+                butterfly3(out, fstride, twiddles, m);
+                break;
+            case 4:
+                butterfly4(out, fstride, twiddles, m, backward);
+                break;
+            case 5:
+                butterfly5(out, fstride, twiddles, m);
+                break;
+            default:
+                butterflyGeneric(out, fstride, twiddles, m, p, scratch);
+                break;
+        }
+    }
+
+   public:
+    BundledFFT() : fftDimension_(0), maxGenericRadix_(0) {}
+    /*!
+     * \brief Sets up the factorization and twiddle factors for transforms of a given length.
+     * \param fftDimension the length of the transform.
+     */
+    explicit BundledFFT(size_t fftDimension) : fftDimension_(fftDimension), maxGenericRadix_(0) {
+        if (fftDimension == 0) throw std::runtime_error("Cannot plan a zero length FFT.");
+        // Peel off radix 4 first, then 2, 3, 5 and larger odd factors in turn.
+        size_t remaining = fftDimension;
+        size_t radix = 4;
+        size_t largestPossibleFactor = static_cast<size_t>(std::sqrt(static_cast<double>(remaining)));
+        while (remaining > 1) {
+            while (remaining % radix) {
+                radix = radix == 4 ? 2 : radix == 2 ? 3 : radix + 2;
+                if (radix > largestPossibleFactor) radix = remaining;
+            }
+            remaining /= radix;
+            factors_.push_back(radix);
+            factors_.push_back(remaining);
+            if (radix > 5) maxGenericRadix_ = std::max(maxGenericRadix_, radix);
+        }
+        if (factors_.empty()) {
+            factors_.push_back(1);
+            factors_.push_back(1);
+        }
+        forwardTwiddles_.resize(fftDimension);
+        backwardTwiddles_.resize(fftDimension);
+        for (size_t k = 0; k < fftDimension; ++k) {
+            long double phase = -2 * M_PI * static_cast<long double>(k) / fftDimension;
+            forwardTwiddles_[k] = Complex(static_cast<Real>(std::cos(phase)), static_cast<Real>(std::sin(phase)));
+            backwardTwiddles_[k] = std::conj(forwardTwiddles_[k]);
+        }
+    }
+
+    /// \return the length of the transform.
+    size_t size() const { return fftDimension_; }
+
+    /// \return the number of complex values of scratch space needed by transform().
+    size_t scratchSize() const { return maxGenericRadix_; }
+
+    /*!
+     * \brief transform does an out of place complex to complex FFT.
+     * \param inBuffer the location of the input data, which must not overlap the output.
+     * \param inStride the distance between consecutive input values.
+     * \param outBuffer the location of the contiguous output data.
+     * \param direction either FFTForward or FFTBackward.
+     * \param scratch at least scratchSize() complex values of scratch space.
+     */
+    void transform(const Complex *inBuffer, size_t inStride, Complex *outBuffer, int direction,
+                   Complex *scratch) const {
+        bool backward = direction == FFTBackward;
+        if (fftDimension_ == 1) {
+            outBuffer[0] = inBuffer[0];
+            return;
+        }
+        const Complex *twiddles = backward ? backwardTwiddles_.data() : forwardTwiddles_.data();
+        work(outBuffer, inBuffer, 1, inStride, factors_.data(), twiddles, backward, scratch);
+    }
+};
+
+/*!
+ * \brief The BundledFFTBatchPlan class transforms batches of lines using BundledFFT.  Real transforms of even length
+ *        are computed as complex transforms of half the length, by packing pairs of real values into each complex
+ *        value, while those of odd length use a full length complex transform.  Each thread keeps its own scratch
+ *        space, which is allocated the first time that thread needs it.
+ */
+template <typename Real>
+class BundledFFTBatchPlan : public FFTBatchPlan<Real> {
+    using Complex = std::complex<Real>;
+
+    /// The length of each transform.
+    size_t fftDimension_;
+    /// The number of lines in the batch.
+    size_t howMany_;
+    /// The distance between the starts of consecutive lines of real data.
+    size_t realDistance_;
+    /// The distance between the starts of consecutive lines of complex data.
+    size_t complexDistance_;
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+    /// Whether real transforms are computed as complex transforms of half the length.
+    bool halfLength_;
+    /// The complex transform used for each line.
+    BundledFFT<Real> fft_;
+    /// The twiddle factors exp(-2 pi i k / n) used to split the half length transform into the real transform.
+    helpme::vector<Complex> realTwiddles_;
+
+    /// \return this thread's scratch space, resized to hold at least the requested number of complex values.
+    static Complex *threadScratch(size_t size) {
+        static thread_local helpme::vector<Complex> scratch;
+        if (scratch.size() < size) scratch.resize(size);
+        return scratch.data();
+    }
+
+    void realToComplex(const Real *in, Complex *out, Complex *scratch) const {
+        size_t complexDim = fftDimension_ / 2 + 1;
+        if (!halfLength_) {
+            for (size_t n = 0; n < fftDimension_; ++n) scratch[n] = in[n];
+            fft_.transform(scratch, 1, scratch + fftDimension_, FFTForward, scratch + 2 * fftDimension_);
+            std::copy(scratch + fftDimension_, scratch + fftDimension_ + complexDim, out);
+            return;
+        }
+        // Transform z[j] = x[2j] + i x[2j+1], then separate the transforms of the even and odd points, E and O,
+        // to form X[k] = E[k] + exp(-2 pi i k / n) O[k].
+        size_t halfDim = fftDimension_ / 2;
+        for (size_t n = 0; n < halfDim; ++n) scratch[n] = Complex(in[2 * n], in[2 * n + 1]);
+        fft_.transform(scratch, 1, scratch + halfDim, FFTForward, scratch + 2 * halfDim);
+        const Complex *z = scratch + halfDim;
+        for (size_t k = 0; k <= halfDim; ++k) {
+            Complex zk = z[k % halfDim];
+            Complex zConj = std::conj(z[(halfDim - k) % halfDim]);
+            Complex even = Real(0.5) * (zk + zConj);
+            Complex odd = Complex(Real(0.5) * (zk - zConj).imag(), Real(-0.5) * (zk - zConj).real());
+            const Complex &w = realTwiddles_[k];
+            out[k] = Complex(even.real() + w.real() * odd.real() - w.imag() * odd.imag(),
+                             even.imag() + w.real() * odd.imag() + w.imag() * odd.real());
+        }
+    }
+
+    void complexToReal(const Complex *in, Real *out, Complex *scratch) const {
+        size_t complexDim = fftDimension_ / 2 + 1;
+        if (!halfLength_) {
+            for (size_t n = 0; n < complexDim; ++n) scratch[n] = in[n];
+            for (size_t n = complexDim; n < fftDimension_; ++n) scratch[n] = std::conj(in[fftDimension_ - n]);
+            fft_.transform(scratch, 1, scratch + fftDimension_, FFTBackward, scratch + 2 * fftDimension_);
+            for (size_t n = 0; n < fftDimension_; ++n) out[n] = scratch[fftDimension_ + n].real();
+            return;
+        }
+        // Reassemble Z[k] = 2 E[k] + 2 i O[k] from the unique values of X, then transform back to get the even and
+        // odd points as the real and imaginary parts, scaled by the full length as for an unnormalized transform.
+        size_t halfDim = fftDimension_ / 2;
+        for (size_t k = 0; k < halfDim; ++k) {
+            Complex xConj = std::conj(in[halfDim - k]);
+            Complex sum = in[k] + xConj;
+            Complex difference = in[k] - xConj;
+            const Complex &w = realTwiddles_[k];
+            // difference * conj(w) gives 2 O[k], which is then multiplied by i.
+            Complex odd(difference.real() * w.real() + difference.imag() * w.imag(),
+                        difference.imag() * w.real() - difference.real() * w.imag());
+            scratch[k] = Complex(sum.real() - odd.imag(), sum.imag() + odd.real());
+        }
+        fft_.transform(scratch, 1, scratch + halfDim, FFTBackward, scratch + 2 * halfDim);
+        for (size_t n = 0; n < halfDim; ++n) {
+            out[2 * n] = scratch[halfDim + n].real();
+            out[2 * n + 1] = scratch[halfDim + n].imag();
+        }
+    }
+
+    size_t scratchSize() const { return 2 * fft_.size() + fft_.scratchSize(); }
+
+   public:
+    /*!
+     * \brief Sets up the transforms of a batch of lines.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     */
+    BundledFFTBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance, size_t complexDistance,
+                        bool realData)
+        : fftDimension_(fftDimension),
+          howMany_(howMany),
+          realDistance_(realDistance),
+          complexDistance_(complexDistance),
+          realData_(realData),
+          halfLength_(realData && fftDimension % 2 == 0),
+          fft_(halfLength_ ? fftDimension / 2 : fftDimension) {
+        if (halfLength_) {
+            realTwiddles_.resize(fftDimension / 2 + 1);
+            for (size_t k = 0; k < realTwiddles_.size(); ++k) {
+                long double phase = -2 * M_PI * static_cast<long double>(k) / fftDimension;
+                realTwiddles_[k] = Complex(static_cast<Real>(std::cos(phase)), static_cast<Real>(std::sin(phase)));
+            }
+        }
+    }
+
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        Complex *scratch = threadScratch(scratchSize());
+        for (size_t line = 0; line < howMany_; ++line)
+            complexToReal(inBuffer + line * complexDistance_, outBuffer + line * realDistance_, scratch);
+    }
+
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        Complex *scratch = threadScratch(scratchSize());
+        for (size_t line = 0; line < howMany_; ++line)
+            realToComplex(inBuffer + line * realDistance_, outBuffer + line * complexDistance_, scratch);
+    }
+
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) override {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        if (direction != FFTForward && direction != FFTBackward)
+            throw std::runtime_error("Invalid FFT direction passed to in place transform().");
+        Complex *scratch = threadScratch(scratchSize());
+        for (size_t line = 0; line < howMany_; ++line) {
+            Complex *linePtr = inPlaceBuffer + line * complexDistance_;
+            std::copy(linePtr, linePtr + fftDimension_, scratch);
+            fft_.transform(scratch, 1, linePtr, direction, scratch + fftDimension_);
+        }
+    }
+};
+
+/*!
+ * \brief The BundledFFTPlanner class makes plans that use the bundled FFT, for machines without an FFT library or to
+ *        compare against one.  There are no native three dimensional transforms, so the PME code always uses line
+ *        by line passes with this planner.
+ */
+template <typename Real>
+class BundledFFTPlanner : public FFTPlanner<Real> {
+   public:
+    std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance,
+                                                      size_t complexDistance, bool realData) const override {
+        return std::unique_ptr<FFTBatchPlan<Real>>(
+            new BundledFFTBatchPlan<Real>(fftDimension, howMany, realDistance, complexDistance, realData));
+    }
+
+    std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t, size_t, size_t, int) const override {
+        return std::unique_ptr<FFTGridPlan<Real>>();
+    }
+};
+
+}  // Namespace helpme
+#endif  // Header guard
 // original file: ../src/cartesiantransform.h
 
 // BEGINLICENSE
@@ -67,6 +854,7 @@
 #include <algorithm>
 #include <complex>
 #include <fstream>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <iomanip>
@@ -387,96 +1175,7 @@ std::string stringify(T *data, size_t size, size_t rowDim, int width = 14, int p
 }  // Namespace helpme
 
 #endif  // Header guard
-// original file: ../src/memory.h
-
-// BEGINLICENSE
-//
-// This file is part of helPME, which is distributed under the BSD 3-clause license,
-// as described in the LICENSE file in the top level directory of this project.
-//
-// Author: Andrew C. Simmonett
-//
-// ENDLICENSE
-#ifndef _HELPME_MEMORY_H_
-#define _HELPME_MEMORY_H_
-
-#include <stdexcept>
-#include <vector>
-
-#include <fftw3.h>
-
-namespace helpme {
-
-/*!
- * \brief FFTWAllocator a class to handle aligned allocation of memory using the FFTW libraries.
- *        Code is adapted from http://www.josuttis.com/cppcode/myalloc.hpp.html.
- */
-template <class T>
-class FFTWAllocator {
-   public:
-    // type definitions
-    typedef T value_type;
-    typedef T* pointer;
-    typedef const T* const_pointer;
-    typedef T& reference;
-    typedef const T& const_reference;
-    typedef std::size_t size_type;
-    typedef std::ptrdiff_t difference_type;
-
-    // rebind allocator to type U
-    template <class U>
-    struct rebind {
-        typedef FFTWAllocator<U> other;
-    };
-
-    // return address of values
-    pointer address(reference value) const { return &value; }
-    const_pointer address(const_reference value) const { return &value; }
-
-    /* constructors and destructor
-     * - nothing to do because the allocator has no state
-     */
-    FFTWAllocator() throw() {}
-    FFTWAllocator(const FFTWAllocator&) throw() {}
-    template <class U>
-    FFTWAllocator(const FFTWAllocator<U>&) throw() {}
-    ~FFTWAllocator() throw() {}
-
-    // return maximum number of elements that can be allocated
-    size_type max_size() const throw() { return std::numeric_limits<std::size_t>::max() / sizeof(T); }
-
-    // allocate but don't initialize num elements of type T
-    pointer allocate(size_type num, const void* = 0) { return static_cast<pointer>(fftw_malloc(num * sizeof(T))); }
-
-    // initialize elements of allocated storage p with value value
-    void construct(pointer p, const T& value) {
-        // initialize memory with placement new
-        new ((void*)p) T(value);
-    }
-
-    // destroy elements of initialized storage p
-    void destroy(pointer p) {}
-
-    // deallocate storage p of deleted elements
-    void deallocate(pointer p, size_type num) { fftw_free(static_cast<void*>(p)); }
-};
-
-// return that all specializations of this allocator are interchangeable
-template <class T1, class T2>
-bool operator==(const FFTWAllocator<T1>&, const FFTWAllocator<T2>&) throw() {
-    return true;
-}
-template <class T1, class T2>
-bool operator!=(const FFTWAllocator<T1>&, const FFTWAllocator<T2>&) throw() {
-    return false;
-}
-
-template <typename Real>
-using vector = std::vector<Real, FFTWAllocator<Real>>;
-
-}  // Namespace helpme
-
-#endif  // Header guard
+// #include "memory.h"
 
 namespace helpme {
 
@@ -750,9 +1449,19 @@ class Matrix {
      * \return the inverse of this matrix.
      */
     Matrix inverse() const {
-        assertSquare();
+        Matrix matrixInverse(nRows_, nCols_);
+        inverse(matrixInverse);
+        return matrixInverse;
+    }
 
-        Matrix matrixInverse(nRows_, nRows_);
+    /*!
+     * \brief inverse inverts this matrix into existing storage, leaving the original matrix untouched.
+     * \param matrixInverse the matrix to hold the inverse, which must have the same dimensions as this matrix.
+     */
+    void inverse(Matrix& matrixInverse) const {
+        assertSquare();
+        if (matrixInverse.nRows() != nRows_ || matrixInverse.nCols() != nCols_)
+            throw std::runtime_error("Inverse storage has the wrong dimensions.");
 
         if (nRows() == 3) {
             // 3x3 is a really common case, so treat it here as.
@@ -775,9 +1484,9 @@ class Matrix {
             // Generic case; just use spectral decomposition, invert the eigenvalues, and stitch back together.
             // Note that this only works for symmetric matrices.  Need to hook into Lapack for a general
             // inversion routine if this becomes a limitation.
-            return this->applyOperation([](Real& element) { element = 1 / element; });
+            Matrix spectralInverse = applyOperation([](Real& element) { element = 1 / element; });
+            std::copy(spectralInverse.cbegin(), spectralInverse.cend(), matrixInverse.begin());
         }
-        return matrixInverse;
     }
 
     /*!
@@ -1105,7 +1814,8 @@ void matrixVectorProduct(const Matrix<Real> &transformer, const Real *inputVecto
  *        components being the fast running index.
  */
 template <typename Real>
-Matrix<Real> cartesianTransform(int maxAngularMomentum, const Matrix<Real> &transformer, const Matrix<Real> &transformee) {
+Matrix<Real> cartesianTransform(int maxAngularMomentum, const Matrix<Real> &transformer,
+                                const Matrix<Real> &transformee) {
     Matrix<Real> transformed = transformee.clone();
     int offset = 1;
     int nAtoms = transformee.nRows();
@@ -1123,6 +1833,8 @@ Matrix<Real> cartesianTransform(int maxAngularMomentum, const Matrix<Real> &tran
 
 }  // Namespace helpme
 #endif  // Header guard
+// #include "fft_backend.h"
+#if HAVE_FFTW == 1
 // original file: ../src/fftw_wrapper.h
 
 // BEGINLICENSE
@@ -1136,13 +1848,18 @@ Matrix<Real> cartesianTransform(int maxAngularMomentum, const Matrix<Real> &tran
 #ifndef _HELPME_FFTW_WRAPPER_H_
 #define _HELPME_FFTW_WRAPPER_H_
 
+#include <algorithm>
 #include <complex>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include <fftw3.h>
+// #include "fft_backend.h"
 // #include "memory.h"
 
 namespace helpme {
@@ -1159,17 +1876,38 @@ struct FFTWTypes {
     using Complex = std::complex<int>;
     static Plan makePlan4(size_t, void *, void *, int) { return 0; };
     static Plan makePlan5(size_t, void *, void *, int, int) { return 0; };
+    static Plan make3DPlan6(int, int, int, void *, void *, unsigned) { return 0; };
+    static Plan makeManyPlan12(int, const int *, int, void *, const int *, int, int, void *, const int *, int, int,
+                               unsigned) {
+        return 0;
+    };
+    static Plan makeManyPlan13(int, const int *, int, void *, const int *, int, int, void *, const int *, int, int,
+                               int, unsigned) {
+        return 0;
+    };
     static void execPlan1(Plan){};
+    static int initThreads0() { return 0; };
+    static void setThreads1(int){};
+    static int wisdomFile(const char *) { return 0; };
     static void execPlan3(Plan, void *, void *){};
     static constexpr bool isImplemented = false;
     static constexpr decltype(&makePlan4) MakeRealToComplexPlan = &makePlan4;
     static constexpr decltype(&makePlan4) MakeComplexToRealPlan = &makePlan4;
     static constexpr decltype(&makePlan5) MakeComplexToComplexPlan = &makePlan5;
+    static constexpr decltype(&make3DPlan6) Make3DRealToComplexPlan = &make3DPlan6;
+    static constexpr decltype(&make3DPlan6) Make3DComplexToRealPlan = &make3DPlan6;
+    static constexpr decltype(&makeManyPlan12) MakeManyRealToComplexPlan = &makeManyPlan12;
+    static constexpr decltype(&makeManyPlan12) MakeManyComplexToRealPlan = &makeManyPlan12;
+    static constexpr decltype(&makeManyPlan13) MakeManyComplexToComplexPlan = &makeManyPlan13;
     static constexpr decltype(&execPlan3) ExecuteRealToComplexPlan = &execPlan3;
     static constexpr decltype(&execPlan3) ExecuteComplexToRealPlan = &execPlan3;
     static constexpr decltype(&execPlan3) ExecuteComplexToComplexPlan = &execPlan3;
     static constexpr decltype(&execPlan1) DestroyPlan = &execPlan1;
     static constexpr decltype(&execPlan1) CleanupFFTW = &execPlan1;
+    static constexpr decltype(&initThreads0) InitThreads = &initThreads0;
+    static constexpr decltype(&setThreads1) PlanWithNThreads = &setThreads1;
+    static constexpr decltype(&wisdomFile) ImportWisdomFromFilename = &wisdomFile;
+    static constexpr decltype(&wisdomFile) ExportWisdomToFilename = &wisdomFile;
 };
 
 #if HAVE_FFTWF == 1
@@ -1181,11 +1919,24 @@ struct FFTWTypes<float> {
     static constexpr decltype(&fftwf_plan_dft_r2c_1d) MakeRealToComplexPlan = &fftwf_plan_dft_r2c_1d;
     static constexpr decltype(&fftwf_plan_dft_c2r_1d) MakeComplexToRealPlan = &fftwf_plan_dft_c2r_1d;
     static constexpr decltype(&fftwf_plan_dft_1d) MakeComplexToComplexPlan = &fftwf_plan_dft_1d;
+    static constexpr decltype(&fftwf_plan_dft_r2c_3d) Make3DRealToComplexPlan = &fftwf_plan_dft_r2c_3d;
+    static constexpr decltype(&fftwf_plan_dft_c2r_3d) Make3DComplexToRealPlan = &fftwf_plan_dft_c2r_3d;
+    static constexpr decltype(&fftwf_plan_many_dft_r2c) MakeManyRealToComplexPlan = &fftwf_plan_many_dft_r2c;
+    static constexpr decltype(&fftwf_plan_many_dft_c2r) MakeManyComplexToRealPlan = &fftwf_plan_many_dft_c2r;
+    static constexpr decltype(&fftwf_plan_many_dft) MakeManyComplexToComplexPlan = &fftwf_plan_many_dft;
     static constexpr decltype(&fftwf_execute_dft_r2c) ExecuteRealToComplexPlan = &fftwf_execute_dft_r2c;
     static constexpr decltype(&fftwf_execute_dft_c2r) ExecuteComplexToRealPlan = &fftwf_execute_dft_c2r;
     static constexpr decltype(&fftwf_execute_dft) ExecuteComplexToComplexPlan = &fftwf_execute_dft;
     static constexpr decltype(&fftwf_destroy_plan) DestroyPlan = &fftwf_destroy_plan;
     static constexpr decltype(&fftwf_cleanup) CleanupFFTW = &fftwf_cleanup;
+#if HAVE_FFTW_THREADS == 1
+    static constexpr decltype(&fftwf_init_threads) InitThreads = &fftwf_init_threads;
+    static constexpr decltype(&fftwf_plan_with_nthreads) PlanWithNThreads = &fftwf_plan_with_nthreads;
+#endif
+    static constexpr decltype(&fftwf_import_wisdom_from_filename) ImportWisdomFromFilename =
+        &fftwf_import_wisdom_from_filename;
+    static constexpr decltype(&fftwf_export_wisdom_to_filename) ExportWisdomToFilename =
+        &fftwf_export_wisdom_to_filename;
 };
 #endif  // HAVE_FFTWF
 
@@ -1198,11 +1949,24 @@ struct FFTWTypes<double> {
     static constexpr decltype(&fftw_plan_dft_r2c_1d) MakeRealToComplexPlan = &fftw_plan_dft_r2c_1d;
     static constexpr decltype(&fftw_plan_dft_c2r_1d) MakeComplexToRealPlan = &fftw_plan_dft_c2r_1d;
     static constexpr decltype(&fftw_plan_dft_1d) MakeComplexToComplexPlan = &fftw_plan_dft_1d;
+    static constexpr decltype(&fftw_plan_dft_r2c_3d) Make3DRealToComplexPlan = &fftw_plan_dft_r2c_3d;
+    static constexpr decltype(&fftw_plan_dft_c2r_3d) Make3DComplexToRealPlan = &fftw_plan_dft_c2r_3d;
+    static constexpr decltype(&fftw_plan_many_dft_r2c) MakeManyRealToComplexPlan = &fftw_plan_many_dft_r2c;
+    static constexpr decltype(&fftw_plan_many_dft_c2r) MakeManyComplexToRealPlan = &fftw_plan_many_dft_c2r;
+    static constexpr decltype(&fftw_plan_many_dft) MakeManyComplexToComplexPlan = &fftw_plan_many_dft;
     static constexpr decltype(&fftw_execute_dft_r2c) ExecuteRealToComplexPlan = &fftw_execute_dft_r2c;
     static constexpr decltype(&fftw_execute_dft_c2r) ExecuteComplexToRealPlan = &fftw_execute_dft_c2r;
     static constexpr decltype(&fftw_execute_dft) ExecuteComplexToComplexPlan = &fftw_execute_dft;
     static constexpr decltype(&fftw_destroy_plan) DestroyPlan = &fftw_destroy_plan;
     static constexpr decltype(&fftw_cleanup) CleanupFFTW = &fftw_cleanup;
+#if HAVE_FFTW_THREADS == 1
+    static constexpr decltype(&fftw_init_threads) InitThreads = &fftw_init_threads;
+    static constexpr decltype(&fftw_plan_with_nthreads) PlanWithNThreads = &fftw_plan_with_nthreads;
+#endif
+    static constexpr decltype(&fftw_import_wisdom_from_filename) ImportWisdomFromFilename =
+        &fftw_import_wisdom_from_filename;
+    static constexpr decltype(&fftw_export_wisdom_to_filename) ExportWisdomToFilename =
+        &fftw_export_wisdom_to_filename;
 };
 #endif  // HAVE_FFTWD
 
@@ -1215,11 +1979,24 @@ struct FFTWTypes<long double> {
     static constexpr decltype(&fftwl_plan_dft_r2c_1d) MakeRealToComplexPlan = &fftwl_plan_dft_r2c_1d;
     static constexpr decltype(&fftwl_plan_dft_c2r_1d) MakeComplexToRealPlan = &fftwl_plan_dft_c2r_1d;
     static constexpr decltype(&fftwl_plan_dft_1d) MakeComplexToComplexPlan = &fftwl_plan_dft_1d;
+    static constexpr decltype(&fftwl_plan_dft_r2c_3d) Make3DRealToComplexPlan = &fftwl_plan_dft_r2c_3d;
+    static constexpr decltype(&fftwl_plan_dft_c2r_3d) Make3DComplexToRealPlan = &fftwl_plan_dft_c2r_3d;
+    static constexpr decltype(&fftwl_plan_many_dft_r2c) MakeManyRealToComplexPlan = &fftwl_plan_many_dft_r2c;
+    static constexpr decltype(&fftwl_plan_many_dft_c2r) MakeManyComplexToRealPlan = &fftwl_plan_many_dft_c2r;
+    static constexpr decltype(&fftwl_plan_many_dft) MakeManyComplexToComplexPlan = &fftwl_plan_many_dft;
     static constexpr decltype(&fftwl_execute_dft_r2c) ExecuteRealToComplexPlan = &fftwl_execute_dft_r2c;
     static constexpr decltype(&fftwl_execute_dft_c2r) ExecuteComplexToRealPlan = &fftwl_execute_dft_c2r;
     static constexpr decltype(&fftwl_execute_dft) ExecuteComplexToComplexPlan = &fftwl_execute_dft;
     static constexpr decltype(&fftwl_destroy_plan) DestroyPlan = &fftwl_destroy_plan;
     static constexpr decltype(&fftwl_cleanup) CleanupFFTW = &fftwl_cleanup;
+#if HAVE_FFTW_THREADS == 1
+    static constexpr decltype(&fftwl_init_threads) InitThreads = &fftwl_init_threads;
+    static constexpr decltype(&fftwl_plan_with_nthreads) PlanWithNThreads = &fftwl_plan_with_nthreads;
+#endif
+    static constexpr decltype(&fftwl_import_wisdom_from_filename) ImportWisdomFromFilename =
+        &fftwl_import_wisdom_from_filename;
+    static constexpr decltype(&fftwl_export_wisdom_to_filename) ExportWisdomToFilename =
+        &fftwl_export_wisdom_to_filename;
 };
 #endif  // HAVE_FFTWL
 
@@ -1235,17 +2012,17 @@ class FFTWWrapper {
 
    protected:
     /// An FFTW plan object, describing out of place complex to complex forward transforms.
-    typename typeinfo::Plan forwardPlan_;
+    typename typeinfo::Plan forwardPlan_ = Plan();
     /// An FFTW plan object, describing out of place complex to complex inverse transforms.
-    typename typeinfo::Plan inversePlan_;
+    typename typeinfo::Plan inversePlan_ = Plan();
     /// An FFTW plan object, describing in place complex to complex forward transforms.
-    typename typeinfo::Plan forwardInPlacePlan_;
+    typename typeinfo::Plan forwardInPlacePlan_ = Plan();
     /// An FFTW plan object, describing in place complex to complex inverse transforms.
-    typename typeinfo::Plan inverseInPlacePlan_;
+    typename typeinfo::Plan inverseInPlacePlan_ = Plan();
     /// An FFTW plan object, describing out of place real to complex forward transforms.
-    typename typeinfo::Plan realToComplexPlan_;
+    typename typeinfo::Plan realToComplexPlan_ = Plan();
     /// An FFTW plan object, describing out of place complex to real inverse transforms.
-    typename typeinfo::Plan complexToRealPlan_;
+    typename typeinfo::Plan complexToRealPlan_ = Plan();
     /// The size of the real data.
     size_t fftDimension_;
     /// The flags to be passed to the FFTW plan creator, to determine startup cost.
@@ -1253,7 +2030,20 @@ class FFTWWrapper {
 
    public:
     FFTWWrapper() {}
-    FFTWWrapper(size_t fftDimension) : fftDimension_(fftDimension), transformFlags_(FFTW_ESTIMATE) {
+    FFTWWrapper(const FFTWWrapper &) = delete;
+    FFTWWrapper &operator=(const FFTWWrapper &) = delete;
+    ~FFTWWrapper() {
+        for (Plan plan : {forwardPlan_, inversePlan_, forwardInPlacePlan_, inverseInPlacePlan_, realToComplexPlan_,
+                          complexToRealPlan_})
+            if (plan) typeinfo::DestroyPlan(plan);
+    }
+    /*!
+     * \brief Sets up the plans for transforms of a single line.
+     * \param fftDimension the length of the transform.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     */
+    FFTWWrapper(size_t fftDimension, unsigned transformFlags = FFTW_ESTIMATE)
+        : fftDimension_(fftDimension), transformFlags_(transformFlags) {
         if (!typeinfo::isImplemented) {
             throw std::runtime_error(
                 "Attempting to call FFTW using a precision mode that has not been linked. "
@@ -1278,6 +2068,25 @@ class FFTWWrapper {
         complexToRealPlan_ = typeinfo::MakeComplexToRealPlan(fftDimension_, complexPtr1, realPtr, transformFlags_);
     }
 
+    /*!
+     * \brief importWisdom adds the plans stored in a wisdom file to FFTW's accumulated wisdom for this precision, so
+     *        that plans needing a measured planner level can be made without repeating the measurements.
+     * \param filename the name of the wisdom file.
+     * \return whether the wisdom was imported; this fails if the file doesn't exist or isn't valid wisdom.
+     */
+    static bool importWisdom(const std::string &filename) {
+        return typeinfo::ImportWisdomFromFilename(filename.c_str()) != 0;
+    }
+
+    /*!
+     * \brief exportWisdom writes all of FFTW's accumulated wisdom for this precision to a file.
+     * \param filename the name of the wisdom file.
+     * \return whether the wisdom was written.
+     */
+    static bool exportWisdom(const std::string &filename) {
+        return typeinfo::ExportWisdomToFilename(filename.c_str()) != 0;
+    }
+
     /*!
      * \brief transform call FFTW to do an out of place complex to real FFT.
      * \param inBuffer the location of the input data.
@@ -1337,8 +2146,244 @@ class FFTWWrapper {
     }
 };
 
+/*!
+ * \brief The FFTWBatchWrapper class wraps FFTW's advanced interface, to transform a batch of equally spaced,
+ *        contiguous lines of data with a single call.  This amortizes the call overhead over the whole batch, and
+ *        lets FFTW use codelets that work on several lines at once.
+ */
+template <typename Real>
+class FFTWBatchWrapper : public FFTBatchPlan<Real> {
+    using typeinfo = FFTWTypes<Real>;
+    using Plan = typename typeinfo::Plan;
+    using Complex = typename typeinfo::Complex;
+
+   protected:
+    /// An FFTW plan object, describing in place complex to complex forward transforms of the batch.
+    typename typeinfo::Plan forwardInPlacePlan_ = Plan();
+    /// An FFTW plan object, describing in place complex to complex inverse transforms of the batch.
+    typename typeinfo::Plan inverseInPlacePlan_ = Plan();
+    /// An FFTW plan object, describing out of place real to complex forward transforms of the batch.
+    typename typeinfo::Plan realToComplexPlan_ = Plan();
+    /// An FFTW plan object, describing out of place complex to real inverse transforms of the batch.
+    typename typeinfo::Plan complexToRealPlan_ = Plan();
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+    /// The flags to be passed to the FFTW plan creator, to determine startup cost.
+    unsigned transformFlags_;
+
+   public:
+    FFTWBatchWrapper() {}
+    FFTWBatchWrapper(const FFTWBatchWrapper &) = delete;
+    FFTWBatchWrapper &operator=(const FFTWBatchWrapper &) = delete;
+    ~FFTWBatchWrapper() override {
+        for (Plan plan : {forwardInPlacePlan_, inverseInPlacePlan_, realToComplexPlan_, complexToRealPlan_})
+            if (plan) typeinfo::DestroyPlan(plan);
+    }
+    /*!
+     * \brief Sets up the plans for a batch of transforms.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     */
+    FFTWBatchWrapper(size_t fftDimension, size_t howMany, size_t realDistance, size_t complexDistance, bool realData,
+                     unsigned transformFlags = FFTW_ESTIMATE)
+        : realData_(realData), transformFlags_(transformFlags) {
+        if (!typeinfo::isImplemented) {
+            throw std::runtime_error(
+                "Attempting to call FFTW using a precision mode that has not been linked. "
+                "Make sure that -DHAVE_FFTWF=1, -DHAVE_FFTWD=1 or -DHAVE_FFTWL=1 is added to the compiler flags"
+                "for single, double and long double precision support, respectively.");
+        }
+        int n = fftDimension;
+        int nLines = howMany;
+        int realDist = realDistance;
+        int complexDist = complexDistance;
+        helpme::vector<std::complex<Real>> complexTemp(howMany * complexDistance);
+        Complex *complexPtr = reinterpret_cast<Complex *>(complexTemp.data());
+        if (realData) {
+            helpme::vector<Real> realTemp(howMany * realDistance);
+            Real *realPtr = realTemp.data();
+            realToComplexPlan_ = typeinfo::MakeManyRealToComplexPlan(1, &n, nLines, realPtr, nullptr, 1, realDist,
+                                                                     complexPtr, nullptr, 1, complexDist,
+                                                                     transformFlags_);
+            complexToRealPlan_ = typeinfo::MakeManyComplexToRealPlan(1, &n, nLines, complexPtr, nullptr, 1,
+                                                                     complexDist, realPtr, nullptr, 1, realDist,
+                                                                     transformFlags_);
+        } else {
+            forwardInPlacePlan_ = typeinfo::MakeManyComplexToComplexPlan(1, &n, nLines, complexPtr, nullptr, 1,
+                                                                         complexDist, complexPtr, nullptr, 1,
+                                                                         complexDist, FFTW_FORWARD, transformFlags_);
+            inverseInPlacePlan_ = typeinfo::MakeManyComplexToComplexPlan(1, &n, nLines, complexPtr, nullptr, 1,
+                                                                         complexDist, complexPtr, nullptr, 1,
+                                                                         complexDist, FFTW_BACKWARD, transformFlags_);
+        }
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place complex to real FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        typeinfo::ExecuteComplexToRealPlan(complexToRealPlan_, reinterpret_cast<Complex *>(inBuffer), outBuffer);
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place real to complex FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        typeinfo::ExecuteRealToComplexPlan(realToComplexPlan_, inBuffer, reinterpret_cast<Complex *>(outBuffer));
+    }
+
+    /*!
+     * \brief transform call FFTW to do an in place complex to complex FFT of every line in the batch.
+     * \param inPlaceBuffer the location of the input and output data.
+     * \param direction either FFTW_FORWARD or FFTW_BACKWARD.
+     */
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) override {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        Complex *inPlacePtr = reinterpret_cast<Complex *>(inPlaceBuffer);
+        switch (direction) {
+            case FFTW_FORWARD:
+                typeinfo::ExecuteComplexToComplexPlan(forwardInPlacePlan_, inPlacePtr, inPlacePtr);
+                break;
+            case FFTW_BACKWARD:
+                typeinfo::ExecuteComplexToComplexPlan(inverseInPlacePlan_, inPlacePtr, inPlacePtr);
+                break;
+            default:
+                throw std::runtime_error("Invalid FFTW transform passed to in place transform().");
+        }
+    }
+};
+
+/*!
+ * \brief The FFTW3DWrapper class wraps FFTW's native three dimensional real to complex and complex to real
+ *        transforms of a full grid, for runs where a single node holds all of the data.
+ */
+template <typename Real>
+class FFTW3DWrapper : public FFTGridPlan<Real> {
+    using typeinfo = FFTWTypes<Real>;
+    using Plan = typename typeinfo::Plan;
+    using Complex = typename typeinfo::Complex;
+
+   protected:
+    /// An FFTW plan object, describing out of place real to complex forward transforms of the grid.
+    typename typeinfo::Plan realToComplexPlan_ = Plan();
+    /// An FFTW plan object, describing out of place complex to real inverse transforms of the grid.
+    typename typeinfo::Plan complexToRealPlan_ = Plan();
+    /// The flags to be passed to the FFTW plan creator, to determine startup cost.
+    unsigned transformFlags_;
+
+   public:
+    FFTW3DWrapper() {}
+    FFTW3DWrapper(const FFTW3DWrapper &) = delete;
+    FFTW3DWrapper &operator=(const FFTW3DWrapper &) = delete;
+    ~FFTW3DWrapper() override {
+        for (Plan plan : {realToComplexPlan_, complexToRealPlan_})
+            if (plan) typeinfo::DestroyPlan(plan);
+    }
+    /*!
+     * \brief Sets up the plans for transforms of a grid stored with C as the slowest running index and A as the
+     *        fastest.  The complex grid has the same ordering, with only the dimA / 2 + 1 unique values along A.
+     * \param dimA the length of the fast running dimension.
+     * \param dimB the length of the intermediate dimension.
+     * \param dimC the length of the slow running dimension.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     * \param nThreads the number of threads that FFTW shares each transform among; more than one requires helpme to
+     *        be built with -DHAVE_FFTW_THREADS=1 and linked against FFTW's OpenMP libraries.
+     */
+    FFTW3DWrapper(size_t dimA, size_t dimB, size_t dimC, unsigned transformFlags = FFTW_ESTIMATE, int nThreads = 1)
+        : transformFlags_(transformFlags) {
+        if (!typeinfo::isImplemented) {
+            throw std::runtime_error(
+                "Attempting to call FFTW using a precision mode that has not been linked. "
+                "Make sure that -DHAVE_FFTWF=1, -DHAVE_FFTWD=1 or -DHAVE_FFTWL=1 is added to the compiler flags"
+                "for single, double and long double precision support, respectively.");
+        }
+        helpme::vector<Real> realTemp(dimC * dimB * dimA);
+        helpme::vector<std::complex<Real>> complexTemp(dimC * dimB * (dimA / 2 + 1));
+        Real *realPtr = realTemp.data();
+        Complex *complexPtr = reinterpret_cast<Complex *>(complexTemp.data());
+#if HAVE_FFTW_THREADS == 1
+        // FFTW's threads are initialized once per precision, and the thread count applies to every plan made until it
+        // is next set, so it's reset afterwards to keep the batch plans, which are threaded by helpme, serial.
+        static const bool threadsInitialized = typeinfo::InitThreads() != 0;
+        if (!threadsInitialized) throw std::runtime_error("FFTW's threads could not be initialized.");
+        typeinfo::PlanWithNThreads(std::max(nThreads, 1));
+#else
+        if (nThreads > 1)
+            throw std::runtime_error(
+                "Threaded FFTW grid transforms need FFTW's OpenMP libraries; make sure that -DHAVE_FFTW_THREADS=1 is "
+                "added to the compiler flags and that fftw3_omp is linked.");
+#endif
+        realToComplexPlan_ = typeinfo::Make3DRealToComplexPlan(dimC, dimB, dimA, realPtr, complexPtr, transformFlags_);
+        complexToRealPlan_ = typeinfo::Make3DComplexToRealPlan(dimC, dimB, dimA, complexPtr, realPtr, transformFlags_);
+#if HAVE_FFTW_THREADS == 1
+        typeinfo::PlanWithNThreads(1);
+#endif
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place complex to real FFT of the grid.  The input is overwritten.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        typeinfo::ExecuteComplexToRealPlan(complexToRealPlan_, reinterpret_cast<Complex *>(inBuffer), outBuffer);
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place real to complex FFT of the grid.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        typeinfo::ExecuteRealToComplexPlan(realToComplexPlan_, inBuffer, reinterpret_cast<Complex *>(outBuffer));
+    }
+};
+
+/*!
+ * \brief The FFTWPlanner class makes FFTW plans for the PME code.
+ */
+template <typename Real>
+class FFTWPlanner : public FFTPlanner<Real> {
+    /// The flags to be passed to the FFTW plan creator, to determine startup cost.
+    unsigned transformFlags_;
+
+   public:
+    /*!
+     * \brief Sets up the planner.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     */
+    explicit FFTWPlanner(unsigned transformFlags = FFTW_ESTIMATE) : transformFlags_(transformFlags) {}
+
+    std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance,
+                                                      size_t complexDistance, bool realData) const override {
+        return std::unique_ptr<FFTBatchPlan<Real>>(new FFTWBatchWrapper<Real>(
+            fftDimension, howMany, realDistance, complexDistance, realData, transformFlags_));
+    }
+
+    std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t dimA, size_t dimB, size_t dimC,
+                                                    int nThreads) const override {
+#if HAVE_FFTW_THREADS != 1
+        // Without FFTW's OpenMP libraries the grid transform would run on one thread, so the line passes are better.
+        if (nThreads > 1) return std::unique_ptr<FFTGridPlan<Real>>();
+#endif
+        return std::unique_ptr<FFTGridPlan<Real>>(
+            new FFTW3DWrapper<Real>(dimA, dimB, dimC, transformFlags_, nThreads));
+    }
+};
+
 }  // Namespace helpme
 #endif  // Header guard
+#endif
 // original file: ../src/gamma.h
 
 // BEGINLICENSE
@@ -1808,6 +2853,267 @@ int findGridSize(T inputSize, const std::initializer_list<T> &requiredDivisors)
 #endif  // Header guard
 // #include "matrix.h"
 // #include "memory.h"
+#if HAVE_MKL == 1
+// original file: ../src/mkl_wrapper.h
+
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_MKL_WRAPPER_H_
+#define _HELPME_MKL_WRAPPER_H_
+
+#include <algorithm>
+#include <complex>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <mkl_dfti.h>
+// #include "fft_backend.h"
+
+/*!
+ * \file mkl_wrapper.h
+ * \brief Contains the wrappers around the DFTI interface of Intel's Math Kernel Library.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The MKLTypes struct looks up the DFTI precision of each floating point type.
+ */
+template <typename Real>
+struct MKLTypes {
+    static constexpr bool isImplemented = false;
+    static constexpr DFTI_CONFIG_VALUE Precision = DFTI_DOUBLE;
+};
+
+template <>
+struct MKLTypes<float> {
+    static constexpr bool isImplemented = true;
+    static constexpr DFTI_CONFIG_VALUE Precision = DFTI_SINGLE;
+};
+
+template <>
+struct MKLTypes<double> {
+    static constexpr bool isImplemented = true;
+    static constexpr DFTI_CONFIG_VALUE Precision = DFTI_DOUBLE;
+};
+
+/*!
+ * \brief The MKLDescriptor class owns a DFTI descriptor, and checks the status of each call used to configure it.
+ */
+class MKLDescriptor {
+    DFTI_DESCRIPTOR_HANDLE handle_;
+
+    MKLDescriptor(const MKLDescriptor &) = delete;
+    MKLDescriptor &operator=(const MKLDescriptor &) = delete;
+
+   public:
+    MKLDescriptor() : handle_(nullptr) {}
+    ~MKLDescriptor() {
+        if (handle_) DftiFreeDescriptor(&handle_);
+    }
+
+    /*!
+     * \brief check throws if a DFTI call failed.  Transforms are checked too, as a failed transform would otherwise
+     *        leave the output untouched and silently give wrong results.
+     * \param status the value returned by the DFTI call.
+     */
+    static void check(MKL_LONG status) {
+        if (status && !DftiErrorClass(status, DFTI_NO_ERROR))
+            throw std::runtime_error(std::string("MKL DFTI error: ") + DftiErrorMessage(status));
+    }
+
+    /*!
+     * \brief create makes a new descriptor.
+     * \param precision either DFTI_SINGLE or DFTI_DOUBLE.
+     * \param domain either DFTI_REAL or DFTI_COMPLEX.
+     * \param lengths the lengths of each dimension, slowest running first.
+     * \param nThreads the number of threads that MKL may share each transform among.
+     */
+    void create(DFTI_CONFIG_VALUE precision, DFTI_CONFIG_VALUE domain, const std::vector<MKL_LONG> &lengths,
+                int nThreads = 1) {
+        MKL_LONG nDims = lengths.size();
+        if (nDims == 1)
+            check(DftiCreateDescriptor(&handle_, precision, domain, 1, lengths[0]));
+        else
+            check(DftiCreateDescriptor(&handle_, precision, domain, nDims, lengths.data()));
+        // The PME code shares batches of lines among its own threads, so those run on the calling thread; only the
+        // grid transforms, which can't be split that way, are shared among MKL's threads.
+        check(DftiSetValue(handle_, DFTI_THREAD_LIMIT, static_cast<MKL_LONG>(std::max(nThreads, 1))));
+    }
+
+    /*!
+     * \brief setRealStorage configures out of place real transforms to keep only the unique complex values, as FFTW
+     *        does.
+     */
+    void setRealStorage() {
+        check(DftiSetValue(handle_, DFTI_PLACEMENT, DFTI_NOT_INPLACE));
+        check(DftiSetValue(handle_, DFTI_CONJUGATE_EVEN_STORAGE, DFTI_COMPLEX_COMPLEX));
+        check(DftiSetValue(handle_, DFTI_PACKED_FORMAT, DFTI_CCE_FORMAT));
+    }
+
+    /*!
+     * \brief setBatch configures the number of transforms done by each call, and the spacing of their data.
+     * \param howMany the number of transforms in the batch.
+     * \param inDistance the distance between consecutive inputs of the batch.
+     * \param outDistance the distance between consecutive outputs of the batch.
+     */
+    void setBatch(size_t howMany, size_t inDistance, size_t outDistance) {
+        check(DftiSetValue(handle_, DFTI_NUMBER_OF_TRANSFORMS, static_cast<MKL_LONG>(howMany)));
+        check(DftiSetValue(handle_, DFTI_INPUT_DISTANCE, static_cast<MKL_LONG>(inDistance)));
+        check(DftiSetValue(handle_, DFTI_OUTPUT_DISTANCE, static_cast<MKL_LONG>(outDistance)));
+    }
+
+    /// \brief commit finalizes the configuration, after which the descriptor can be used for transforms.
+    void commit() { check(DftiCommitDescriptor(handle_)); }
+
+    /// \return the underlying handle, to be passed to the DFTI functions.
+    DFTI_DESCRIPTOR_HANDLE get() const { return handle_; }
+};
+
+/*!
+ * \brief The MKLBatchPlan class transforms a batch of equally spaced, contiguous lines with a single DFTI call.
+ */
+template <typename Real>
+class MKLBatchPlan : public FFTBatchPlan<Real> {
+    /// The descriptor for forward transforms, which also does in place complex to complex backward transforms.
+    MKLDescriptor forward_;
+    /// The descriptor for complex to real backward transforms, whose input and output distances are swapped.
+    MKLDescriptor backward_;
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+
+   public:
+    /*!
+     * \brief Sets up the descriptors for a batch of transforms.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     */
+    MKLBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance, size_t complexDistance, bool realData)
+        : realData_(realData) {
+        if (!MKLTypes<Real>::isImplemented)
+            throw std::runtime_error("MKL's FFTs are only available in single and double precision.");
+        std::vector<MKL_LONG> lengths(1, fftDimension);
+        if (realData) {
+            forward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths);
+            forward_.setRealStorage();
+            forward_.setBatch(howMany, realDistance, complexDistance);
+            forward_.commit();
+            backward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths);
+            backward_.setRealStorage();
+            backward_.setBatch(howMany, complexDistance, realDistance);
+            backward_.commit();
+        } else {
+            forward_.create(MKLTypes<Real>::Precision, DFTI_COMPLEX, lengths);
+            forward_.setBatch(howMany, complexDistance, complexDistance);
+            forward_.commit();
+        }
+    }
+
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        MKLDescriptor::check(DftiComputeBackward(backward_.get(), inBuffer, outBuffer));
+    }
+
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        MKLDescriptor::check(DftiComputeForward(forward_.get(), inBuffer, outBuffer));
+    }
+
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) override {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        switch (direction) {
+            case FFTForward:
+                MKLDescriptor::check(DftiComputeForward(forward_.get(), inPlaceBuffer));
+                break;
+            case FFTBackward:
+                MKLDescriptor::check(DftiComputeBackward(forward_.get(), inPlaceBuffer));
+                break;
+            default:
+                throw std::runtime_error("Invalid FFT direction passed to in place transform().");
+        }
+    }
+};
+
+/*!
+ * \brief The MKL3DPlan class does three dimensional real to complex and complex to real transforms of a full grid.
+ */
+template <typename Real>
+class MKL3DPlan : public FFTGridPlan<Real> {
+    /// The descriptor for real to complex forward transforms.
+    MKLDescriptor forward_;
+    /// The descriptor for complex to real backward transforms.
+    MKLDescriptor backward_;
+
+   public:
+    /*!
+     * \brief Sets up the descriptors for transforms of a grid stored with C as the slowest running index and A as the
+     *        fastest.  The complex grid has the same ordering, with only the dimA / 2 + 1 unique values along A.
+     * \param dimA the length of the fast running dimension.
+     * \param dimB the length of the intermediate dimension.
+     * \param dimC the length of the slow running dimension.
+     * \param nThreads the number of threads that MKL shares each transform among.
+     */
+    MKL3DPlan(size_t dimA, size_t dimB, size_t dimC, int nThreads) {
+        if (!MKLTypes<Real>::isImplemented)
+            throw std::runtime_error("MKL's FFTs are only available in single and double precision.");
+        MKL_LONG complexDimA = dimA / 2 + 1;
+        std::vector<MKL_LONG> lengths = {static_cast<MKL_LONG>(dimC), static_cast<MKL_LONG>(dimB),
+                                         static_cast<MKL_LONG>(dimA)};
+        MKL_LONG realStrides[4] = {0, static_cast<MKL_LONG>(dimB * dimA), static_cast<MKL_LONG>(dimA), 1};
+        MKL_LONG complexStrides[4] = {0, static_cast<MKL_LONG>(dimB) * complexDimA, complexDimA, 1};
+        forward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths, nThreads);
+        forward_.setRealStorage();
+        MKLDescriptor::check(DftiSetValue(forward_.get(), DFTI_INPUT_STRIDES, realStrides));
+        MKLDescriptor::check(DftiSetValue(forward_.get(), DFTI_OUTPUT_STRIDES, complexStrides));
+        forward_.commit();
+        backward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths, nThreads);
+        backward_.setRealStorage();
+        MKLDescriptor::check(DftiSetValue(backward_.get(), DFTI_INPUT_STRIDES, complexStrides));
+        MKLDescriptor::check(DftiSetValue(backward_.get(), DFTI_OUTPUT_STRIDES, realStrides));
+        backward_.commit();
+    }
+
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        MKLDescriptor::check(DftiComputeBackward(backward_.get(), inBuffer, outBuffer));
+    }
+
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        MKLDescriptor::check(DftiComputeForward(forward_.get(), inBuffer, outBuffer));
+    }
+};
+
+/*!
+ * \brief The MKLPlanner class makes plans that use the DFTI interface of Intel's Math Kernel Library.
+ */
+template <typename Real>
+class MKLPlanner : public FFTPlanner<Real> {
+   public:
+    std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance,
+                                                      size_t complexDistance, bool realData) const override {
+        return std::unique_ptr<FFTBatchPlan<Real>>(
+            new MKLBatchPlan<Real>(fftDimension, howMany, realDistance, complexDistance, realData));
+    }
+
+    std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t dimA, size_t dimB, size_t dimC,
+                                                    int nThreads) const override {
+        return std::unique_ptr<FFTGridPlan<Real>>(new MKL3DPlan<Real>(dimA, dimB, dimC, nThreads));
+    }
+};
+
+}  // Namespace helpme
+#endif  // Header guard
+#endif
 #if HAVE_MPI == 1
 // original file: ../src/mpi_wrapper.h
 
@@ -2075,14 +3381,58 @@ struct raiseNormToIntegerPower {
 #ifndef _HELPME_SPLINES_H_
 #define _HELPME_SPLINES_H_
 
-// #include "matrix.h"
+#include <array>
+
+// #include "matrix.h"
+
+/*!
+ * \file splines.h
+ * \brief Contains the C++ implementation of a cardinal B-Splines.
+ */
+
+namespace helpme {
+
+/*!
+ * \class BSplineView
+ * \brief A lightweight, non-owning view of B-splines and their derivatives stored elsewhere, e.g. in a contiguous
+ *        cache holding the splines of many atoms.  The splines are stored with rows corresponding to derivative
+ *        level and columns to spline component, as in BSpline.
+ * \tparam Real the floating point type to use for arithmetic.
+ */
+template <typename Real>
+class BSplineView {
+   protected:
+    /// The grid point at which to start interpolation.
+    short startingGridPoint_;
+    /// The order of the B-splines, which is the stride between derivative levels.
+    short order_;
+    /// The first spline value.
+    const Real *splines_;
+
+   public:
+    BSplineView() : startingGridPoint_(0), order_(0), splines_(nullptr) {}
 
-/*!
- * \file splines.h
- * \brief Contains the C++ implementation of a cardinal B-Splines.
- */
+    /*!
+     * \brief Makes a view of B-splines stored elsewhere.
+     * \param start the grid point at which to start interpolation.
+     * \param splines pointer to the splines, with rows corresponding to derivative level and columns to component.
+     * \param order the order of the B-splines.
+     */
+    BSplineView(short start, const Real *splines, short order)
+        : startingGridPoint_(start), order_(order), splines_(splines) {}
 
-namespace helpme {
+    /*!
+     * \brief Gets the grid point to start interpolating from.
+     * \return the index of the first grid point this spline supports.
+     */
+    short startingGridPoint() const { return startingGridPoint_; }
+
+    /*!
+     * \brief Returns the B-Spline, or derivative thereof.
+     * \param deriv the derivative level of the spline to be returned.
+     */
+    const Real *operator[](const int &deriv) const { return splines_ + deriv * order_; }
+};
 
 /*!
  * \class BSpline
@@ -2104,7 +3454,7 @@ class BSpline {
     short startingGridPoint_;
 
     /// Makes B-Spline array.
-    inline void makeSplineInPlace(Real *array, const Real &val, const short &n) const {
+    static inline void makeSplineInPlace(Real *array, const Real &val, const short &n) {
         Real denom = (Real)1 / (n - 1);
         array[n - 1] = denom * val * array[n - 2];
         for (short j = 1; j < n - 1; ++j)
@@ -2113,17 +3463,18 @@ class BSpline {
     }
 
     /// Takes BSpline derivative.
-    inline void differentiateSpline(const Real *array, Real *dArray, const short &n) const {
+    static inline void differentiateSpline(const Real *array, Real *dArray, const short &n) {
         dArray[0] = -array[0];
         for (short j = 1; j < n - 1; ++j) dArray[j] = array[j - 1] - array[j];
         dArray[n - 1] = array[n - 2];
     }
 
+   public:
     /*!
      * \brief assertSplineIsSufficient ensures that the spline is large enough to be differentiable.
      *        An mth order B-Spline is differentiable m-2 times.
      */
-    void assertSplineIsSufficient(int splineOrder, int derivativeLevel) const {
+    static void assertSplineIsSufficient(int splineOrder, int derivativeLevel) {
         if (splineOrder - derivativeLevel < 2) {
             std::string msg(
                 "The spline order used is not sufficient for the derivative level requested."
@@ -2134,7 +3485,6 @@ class BSpline {
         }
     }
 
-   public:
     /// The B-splines and their derivatives.  See update() for argument details.
     BSpline(short start, Real value, short order, short derivativeLevel) : splines_(derivativeLevel + 1, order) {
         update(start, value, order, derivativeLevel);
@@ -2148,7 +3498,6 @@ class BSpline {
      * \param derivativeLevel the maximum level of derivative needed for this BSpline.
      */
     void update(short start, Real value, short order, short derivativeLevel) {
-        assertSplineIsSufficient(order, derivativeLevel);
         startingGridPoint_ = start;
         order_ = order;
         derivativeLevel_ = derivativeLevel;
@@ -2158,14 +3507,28 @@ class BSpline {
             splines_ = Matrix<Real>(derivativeLevel + 1, order);
 
         splines_.setZero();
-        splines_(0, 0) = 1 - value;
-        splines_(0, 1) = value;
-        for (short m = 1; m < order_ - 1; ++m) {
-            makeSplineInPlace(splines_[0], value, m + 2);
-            if (m >= order_ - derivativeLevel_ - 2) {
-                short currentDerivative = order_ - m - 2;
+        computeInPlace(splines_[0], value, order, derivativeLevel);
+    }
+
+    /*!
+     * \brief computeInPlace computes B-splines and their derivatives into caller-provided memory, allowing many
+     *        splines to be packed into a single contiguous allocation.
+     * \param splines pointer to (derivativeLevel + 1) x order zeroed values, which are filled with the B-splines,
+     *        with rows corresponding to derivative level, and columns to spline component.
+     * \param value the distance (in fractional coordinates) from the starting grid point.
+     * \param order the order of the BSpline.
+     * \param derivativeLevel the maximum level of derivative needed for this BSpline.
+     */
+    static void computeInPlace(Real *splines, Real value, short order, short derivativeLevel) {
+        assertSplineIsSufficient(order, derivativeLevel);
+        splines[0] = 1 - value;
+        splines[1] = value;
+        for (short m = 1; m < order - 1; ++m) {
+            makeSplineInPlace(splines, value, m + 2);
+            if (m >= order - derivativeLevel - 2) {
+                short currentDerivative = order - m - 2;
                 for (short l = 0; l < currentDerivative; ++l)
-                    differentiateSpline(splines_[l], splines_[l + 1], m + 2 + currentDerivative);
+                    differentiateSpline(splines + l * order, splines + (l + 1) * order, m + 2 + currentDerivative);
             }
         }
     }
@@ -2221,11 +3584,293 @@ class BSpline {
      * \returns a const reference to the full spline data: row index is derivative, col index is spline component.
      */
     const Matrix<Real> &splineData() const { return splines_; }
+
+    /*!
+     * \brief Makes a non-owning view of this B-spline, which is only valid while this object is alive and unchanged.
+     */
+    operator BSplineView<Real>() const { return BSplineView<Real>(startingGridPoint_, splines_[0], order_); }
+};
+
+/*!
+ * \class FixedBSpline
+ * \brief A cardinal B-spline whose values are held in fixed-size storage, so that constructing or updating one
+ *        never touches the heap.  This makes it suitable for splines built on the fly, one point at a time, in
+ *        performance critical or multithreaded code.  The values are identical to those from BSpline.
+ * \tparam Real the floating point type to use for arithmetic.
+ * \tparam MaxOrder the largest spline order that can be stored.
+ * \tparam MaxDerivativeLevel the largest derivative level that can be stored.
+ */
+template <typename Real, int MaxOrder, int MaxDerivativeLevel>
+class FixedBSpline {
+   protected:
+    /// The order of this B-spline.
+    short order_;
+    /// The maximum derivative level for this B-spline.
+    short derivativeLevel_;
+    /// The grid point at which to start interpolation.
+    short startingGridPoint_;
+    /// B-Splines with rows corresponding to derivative level, and columns to spline component.
+    std::array<Real, MaxOrder * (MaxDerivativeLevel + 1)> splines_;
+
+   public:
+    FixedBSpline() : order_(0), derivativeLevel_(0), startingGridPoint_(0) {}
+
+    /// The B-splines and their derivatives.  See update() for argument details.
+    FixedBSpline(short start, Real value, short order, short derivativeLevel) {
+        update(start, value, order, derivativeLevel);
+    }
+
+    /*!
+     * \brief update computes information for FixedBSpline.
+     * \param start the grid point at which to start interpolation.
+     * \param value the distance (in fractional coordinates) from the starting grid point.
+     * \param order the order of the BSpline, which must not exceed MaxOrder.
+     * \param derivativeLevel the maximum level of derivative needed, which must not exceed MaxDerivativeLevel.
+     */
+    void update(short start, Real value, short order, short derivativeLevel) {
+        if (order > MaxOrder || derivativeLevel > MaxDerivativeLevel)
+            throw std::runtime_error("The spline order or derivative level requested exceeds the FixedBSpline size.");
+        startingGridPoint_ = start;
+        order_ = order;
+        derivativeLevel_ = derivativeLevel;
+        std::fill(splines_.begin(), splines_.begin() + (derivativeLevel + 1) * order, Real(0));
+        BSpline<Real>::computeInPlace(splines_.data(), value, order, derivativeLevel);
+    }
+
+    /*!
+     * \brief Gets the grid point to start interpolating from.
+     * \return the index of the first grid point this spline supports.
+     */
+    short startingGridPoint() const { return startingGridPoint_; }
+
+    /*!
+     * \brief Returns the B-Spline, or derivative thereof.
+     * \param deriv the derivative level of the spline to be returned.
+     */
+    const Real *operator[](const int &deriv) const { return splines_.data() + deriv * order_; }
+
+    /*!
+     * \brief Makes a non-owning view of this B-spline, which is only valid while this object is alive and unchanged.
+     */
+    operator BSplineView<Real>() const { return BSplineView<Real>(startingGridPoint_, splines_.data(), order_); }
+};
+
+/*!
+ * \class BSplineBlock
+ * \brief Cardinal B-splines, and their derivatives, for a block of points along a single direction.  The splines are
+ *        stored in structure of arrays form, with the point index running fastest, so that the recursion used to
+ *        build them runs as a vector operation across the block.  The values for each point match those from
+ *        BSpline exactly.
+ * \tparam Real the floating point type to use for arithmetic.
+ */
+template <typename Real>
+class BSplineBlock {
+   protected:
+    /// The order of the B-splines.
+    short order_;
+    /// The maximum derivative level for the B-splines.
+    short derivativeLevel_;
+    /// The number of points in the block, which is also the stride between successive spline components.
+    int nPoints_;
+    /// The splines, stored with derivative level slowest, then spline component, then point index fastest.
+    helpme::vector<Real> splines_;
+
+    /// Returns a pointer to the values of the given derivative level and spline component for all points.
+    Real *row(int deriv, int component) { return splines_.data() + (deriv * order_ + component) * nPoints_; }
+
+   public:
+    BSplineBlock() : order_(0), derivativeLevel_(0), nPoints_(0) {}
+
+    /*!
+     * \brief reserve allocates enough storage for update() to build splines for a block of points without
+     *        reallocating.
+     * \param nPoints the largest number of points in a block.
+     * \param order the order of the B-splines.
+     * \param derivativeLevel the highest level of derivative needed for the B-splines.
+     */
+    void reserve(int nPoints, short order, short derivativeLevel) {
+        size_t size = static_cast<size_t>(derivativeLevel + 1) * order * nPoints;
+        if (splines_.size() < size) splines_.resize(size);
+    }
+
+    /*!
+     * \brief update computes the B-splines for a block of points, without reallocating unless the block grows.
+     *        This is called from within parallel regions, so it doesn't throw; the caller must check the spline
+     *        order with BSpline::assertSplineIsSufficient() beforehand.
+     * \param values the distances (in fractional coordinates) of each point from its starting grid point.
+     * \param nPoints the number of points in the block.
+     * \param order the order of the B-splines.
+     * \param derivativeLevel the maximum level of derivative needed for the B-splines.
+     */
+    void update(const Real *values, int nPoints, short order, short derivativeLevel) {
+        order_ = order;
+        derivativeLevel_ = derivativeLevel;
+        nPoints_ = nPoints;
+        size_t size = static_cast<size_t>(derivativeLevel + 1) * order * nPoints;
+        if (splines_.size() < size) splines_.resize(size);
+        std::fill(splines_.begin(), splines_.begin() + size, Real(0));
+
+        Real *row00 = row(0, 0);
+        Real *row01 = row(0, 1);
+#pragma omp simd
+        for (int point = 0; point < nPoints; ++point) {
+            row00[point] = 1 - values[point];
+            row01[point] = values[point];
+        }
+        for (short m = 1; m < order_ - 1; ++m) {
+            // The same recursion as BSpline::makeSplineInPlace, applied to every point in the block at once.
+            short n = m + 2;
+            Real denom = (Real)1 / (n - 1);
+            Real *last = row(0, n - 1);
+            const Real *secondLast = row(0, n - 2);
+#pragma omp simd
+            for (int point = 0; point < nPoints; ++point) last[point] = denom * values[point] * secondLast[point];
+            for (short j = 1; j < n - 1; ++j) {
+                Real *current = row(0, n - j - 1);
+                const Real *previous = row(0, n - j - 2);
+#pragma omp simd
+                for (int point = 0; point < nPoints; ++point)
+                    current[point] = denom * ((values[point] + j) * previous[point] +
+                                              (n - j - values[point]) * current[point]);
+            }
+            Real *first = row(0, 0);
+#pragma omp simd
+            for (int point = 0; point < nPoints; ++point) first[point] *= denom * (1 - values[point]);
+
+            if (m >= order_ - derivativeLevel_ - 2) {
+                short currentDerivative = order_ - m - 2;
+                short nDerivative = m + 2 + currentDerivative;
+                for (short l = 0; l < currentDerivative; ++l) {
+                    // The same differentiation as BSpline::differentiateSpline.
+                    for (short j = 0; j < nDerivative; ++j) {
+                        Real *dRow = row(l + 1, j);
+                        const Real *plus = j < nDerivative - 1 ? row(l, j) : nullptr;
+                        const Real *minus = j > 0 ? row(l, j - 1) : nullptr;
+                        if (plus && minus) {
+#pragma omp simd
+                            for (int point = 0; point < nPoints; ++point) dRow[point] = minus[point] - plus[point];
+                        } else if (plus) {
+#pragma omp simd
+                            for (int point = 0; point < nPoints; ++point) dRow[point] = -plus[point];
+                        } else {
+#pragma omp simd
+                            for (int point = 0; point < nPoints; ++point) dRow[point] = minus[point];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Returns the values of a B-spline component, or derivative thereof, for every point in the block.
+     * \param deriv the derivative level of the spline.
+     * \param component the spline component, i.e. the offset from each point's starting grid point.
+     * \return a pointer to nPoints values, one per point in the block.
+     */
+    const Real *operator()(int deriv, int component) const {
+        return splines_.data() + (deriv * order_ + component) * nPoints_;
+    }
+
+    /*!
+     * \brief Gets the number of points in the block.
+     * \return the number of points in the block.
+     */
+    int nPoints() const { return nPoints_; }
 };
 
 }  // Namespace helpme
 #endif  // Header guard
 // #include "string_utils.h"
+// original file: ../src/transpose.h
+
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_TRANSPOSE_H_
+#define _HELPME_TRANSPOSE_H_
+
+#include <algorithm>
+#include <cstddef>
+
+/*!
+ * \file transpose.h
+ * \brief Contains cache blocked, out of place transpose kernels used to reorder the grid between FFT passes.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The number of elements along each edge of the square tiles used by the transpose kernels.  Each row of a
+ *        tile spans 256 bytes, so that the input and output tiles together fit comfortably in the L1 cache.
+ * \tparam T the type of the data being transposed.
+ */
+template <typename T>
+struct TransposeTile {
+    static constexpr size_t dim = 256 / sizeof(T) > 8 ? 256 / sizeof(T) : 8;
+};
+
+/*!
+ * \brief transposeTile transposes a single tile.  The innermost loop writes contiguous output, with the strided
+ *        reads from the input confined to a few cache lines for the duration of the tile.
+ * \param in pointer to the first input element of the tile.
+ * \param inRowStride the distance between consecutive rows of the input.
+ * \param out pointer to the first output element of the tile.
+ * \param outRowStride the distance between consecutive rows of the output.
+ * \param nRows the number of input rows in the tile.
+ * \param nCols the number of input columns in the tile.
+ */
+template <typename T>
+void transposeTile(const T *in, size_t inRowStride, T *out, size_t outRowStride, size_t nRows, size_t nCols) {
+    for (size_t col = 0; col < nCols; ++col) {
+        const T *inPtr = in + col;
+        T *outPtr = out + col * outRowStride;
+#pragma omp simd
+        for (size_t row = 0; row < nRows; ++row) outPtr[row] = inPtr[row * inRowStride];
+    }
+}
+
+/*!
+ * \brief transposeMatrices transposes each of a batch of equally spaced matrices out of place, one tile at a time,
+ *        sharing the tiles of the whole batch among the threads.  For matrix m this performs
+ *        out[m][col][row] = in[m][row][col].
+ * \param in pointer to the first input matrix.
+ * \param inMatrixStride the distance between the starts of consecutive input matrices.
+ * \param inRowStride the distance between consecutive rows of each input matrix.
+ * \param out pointer to the first output matrix, which must not overlap any of the input.
+ * \param outMatrixStride the distance between the starts of consecutive output matrices.
+ * \param outRowStride the distance between consecutive rows of each output matrix.
+ * \param nMatrices the number of matrices in the batch.
+ * \param nRows the number of rows in each input matrix.
+ * \param nCols the number of columns in each input matrix.
+ * \param nThreads the number of threads to use.
+ */
+template <typename T>
+void transposeMatrices(const T *in, size_t inMatrixStride, size_t inRowStride, T *out, size_t outMatrixStride,
+                       size_t outRowStride, size_t nMatrices, size_t nRows, size_t nCols, int nThreads) {
+    constexpr size_t tileDim = TransposeTile<T>::dim;
+    size_t nTileRows = (nRows + tileDim - 1) / tileDim;
+    size_t nTileCols = (nCols + tileDim - 1) / tileDim;
+    size_t nTilesPerMatrix = nTileRows * nTileCols;
+    size_t nTiles = nMatrices * nTilesPerMatrix;
+#pragma omp parallel for num_threads(nThreads)
+    for (size_t tile = 0; tile < nTiles; ++tile) {
+        size_t matrix = tile / nTilesPerMatrix;
+        size_t row = (tile % nTilesPerMatrix) / nTileCols * tileDim;
+        size_t col = (tile % nTileCols) * tileDim;
+        transposeTile(in + matrix * inMatrixStride + row * inRowStride + col, inRowStride,
+                      out + matrix * outMatrixStride + col * outRowStride + row, outRowStride,
+                      std::min(tileDim, nRows - row), std::min(tileDim, nCols - col));
+    }
+}
+
+}  // Namespace helpme
+#endif  // Header guard
 
 /*!
  * \file helpme.h
@@ -2258,6 +3903,7 @@ static int cartAddress(int lx, int ly, int lz) {
     case n:                                                          \
         convolveEVFxn_ = &convolveEVImpl<n>;                         \
         cacheInfluenceFunctionFxn_ = &cacheInfluenceFunctionImpl<n>; \
+        virialKernelGridsFxn_ = &virialKernelGridsImpl<n>;           \
         slfEFxn_ = &slfEImpl<n>;                                     \
         dirEFxn_ = &dirEImpl<n>;                                     \
         adjEFxn_ = &adjEImpl<n>;                                     \
@@ -2265,19 +3911,27 @@ static int cartAddress(int lx, int ly, int lz) {
         adjEFFxn_ = &adjEFImpl<n>;                                   \
         break;
 
+// This is used in common_init to point to the spreading and probing kernels specialized to a given spline order.
+#define ENABLE_KERNEL_WITH_SPLINE_ORDER_OF(n)                                                 \
+    case n:                                                                                   \
+        spreadParametersFxn_ = &PMEInstance::spreadParametersImpl<n>;                         \
+        spreadScalarParameterFxn_ = &PMEInstance::spreadScalarParameterImpl<n>;               \
+        spreadScalarParameterBrickedFxn_ = &PMEInstance::spreadScalarParameterBrickedImpl<n>; \
+        probeGridPotentialFxn_ = &PMEInstance::probeGridPotentialImpl<n>;                     \
+        probeGridForceFxn_ = &PMEInstance::probeGridForceImpl<n>;                             \
+        probeGridForceBrickedFxn_ = &PMEInstance::probeGridForceBrickedImpl<n>;               \
+        break;
+
 /*!
  * \class splineCacheEntry
- * \brief A placeholder to encapsulate information about a given atom's splines
+ * \brief A placeholder to encapsulate information about a given atom's splines, which are views into the
+ *        contiguous spline storage owned by the PMEInstance.
  */
 template <typename Real>
 struct SplineCacheEntry {
-    BSpline<Real> aSpline, bSpline, cSpline;
+    BSplineView<Real> aSpline, bSpline, cSpline;
     int absoluteAtomNumber;
-    SplineCacheEntry(int order, int derivativeLevel)
-        : aSpline(0, 0, order, derivativeLevel),
-          bSpline(0, 0, order, derivativeLevel),
-          cSpline(0, 0, order, derivativeLevel),
-          absoluteAtomNumber(-1) {}
+    SplineCacheEntry() : absoluteAtomNumber(-1) {}
 };
 
 /*!
@@ -2293,9 +3947,12 @@ template <typename Real>
 class PMEInstance {
     using GridIterator = std::vector<std::vector<std::pair<short, short>>>;
     using Complex = std::complex<Real>;
-    using Spline = BSpline<Real>;
+    using Spline = BSplineView<Real>;
     using RealMat = Matrix<Real>;
     using RealVec = helpme::vector<Real>;
+    /// The largest spline order whose splines are built in fixed-size, heap-free storage when not using the cache.
+    enum : int { MaxFixedSplineOrder = 10 };
+    using FixedSpline = FixedBSpline<Real, MaxFixedSplineOrder, MaxFixedSplineOrder - 2>;
 
    public:
     /*!
@@ -2308,6 +3965,23 @@ class PMEInstance {
      */
     enum class NodeOrder : int { ZYX = 0 };
 
+    /*!
+     * \brief The amount of effort FFTW spends choosing the fastest algorithms when the transforms are planned, which
+     *        correspond to the FFTW_ESTIMATE, FFTW_MEASURE and FFTW_PATIENT planner flags.  The measured levels make
+     *        setup slower, which can be offset by saving and reusing the plans with exportFFTWisdom() and
+     *        importFFTWisdom().  Other FFT backends ignore this setting.
+     */
+    enum class FFTPlanningRigor : int { Estimate = 0, Measure = 1, Patient = 2 };
+
+    /*!
+     * \brief The library used for the FFTs.  FFTW requires helpme to be built with HAVE_FFTW=1 (implied by any of
+     *        HAVE_FFTWF=1, HAVE_FFTWD=1 or HAVE_FFTWL=1) and is the default when available; MKL's DFTI interface
+     *        requires helpme to be built with HAVE_MKL=1, and the bundled header-only FFT needs no external library
+     *        and is the default otherwise.  The planning rigor only affects FFTW, and only FFTW and MKL provide the
+     *        native 3D transform used by single node runs.
+     */
+    enum class FFTBackend : int { FFTW = 0, MKL = 1, Bundled = 2 };
+
    protected:
     /// The FFT grid dimensions in the {A,B,C} grid dimensions.
     int dimA_, dimB_, dimC_;
@@ -2319,6 +3993,10 @@ class PMEInstance {
     int splineOrder_;
     /// The actual number of threads per MPI instance, and the number requested previously.
     int nThreads_, requestedNumberOfThreads_;
+    /// The amount of effort spent planning the FFTs.
+    FFTPlanningRigor planningRigor_;
+    /// The library used for the FFTs.
+    FFTBackend fftBackend_;
     /// The exponent of the (inverse) interatomic distance used in this kernel.
     int rPower_;
     /// The scale factor to apply to all energies and derivatives.
@@ -2338,6 +4016,9 @@ class PMEInstance {
     /// From a given starting point on the {A,B,C} edge of the grid, lists all points to be handled, correctly wrapping
     /// around the end.
     GridIterator gridIteratorA_, gridIteratorB_, gridIteratorC_;
+    /// For each starting grid point in the A dimension, the local index of the first stencil point if the whole
+    /// stencil lies contiguously on this node's grid, or -1 if it wraps around the grid or is split across nodes.
+    std::vector<int> contiguousStencilStartA_;
     /// The (inverse) bspline moduli to normalize the spreading / probing steps; these are folded into the convolution.
     RealVec splineModA_, splineModB_, splineModC_;
     /// The cached influence function involved in the convolution.
@@ -2347,6 +4028,11 @@ class PMEInstance {
     std::function<Real(int, int, int, int, int, int, int, Real, Complex *, const RealMat &, Real, Real, const Real *,
                        const Real *, const Real *, RealMat &, int)>
         convolveEVFxn_;
+    /// A function pointer to call the approprate function to apply the per-atom virial kernels to the structure
+    /// factor, templated to the rPower value.
+    std::function<void(int, int, int, int, int, int, int, Real, const Complex *, Complex *, const RealMat &, Real, Real,
+                       const Real *, const Real *, const Real *, int)>
+        virialKernelGridsFxn_;
     /// A function pointer to call the approprate function to implement cacheing of the influence function that appears
     //  in the convolution, templated to the rPower value.
     std::function<void(int, int, int, int, int, int, int, Real, RealVec &, const RealMat &, Real, Real, const Real *,
@@ -2365,6 +4051,34 @@ class PMEInstance {
     /// A function pointer to call the approprate function to compute the adjusted energy and force, templated to the
     /// rPower value.
     std::function<std::tuple<Real, Real>(Real, Real, Real)> adjEFFxn_;
+    /// A function pointer to call the approprate function to spread a single atom's parameters, templated to the
+    /// spline order.
+    std::function<void(const PMEInstance *, const int &, Real *, const int &, const Spline &, const Spline &,
+                       const Spline &, const RealMat &)>
+        spreadParametersFxn_;
+    /// A function pointer to call the approprate function to spread a single atom's scalar parameter, templated to the
+    /// spline order.
+    std::function<void(const PMEInstance *, Real *, const Spline &, const Spline &, const Spline &, const Real &)>
+        spreadScalarParameterFxn_;
+    /// A function pointer to call the approprate function to probe the potential at a single point, templated to the
+    /// spline order.
+    std::function<void(const PMEInstance *, const Real *, const int &, const Spline &, const Spline &, const Spline &,
+                       Real *)>
+        probeGridPotentialFxn_;
+    /// A function pointer to call the approprate function to probe the force on a single atom with a scalar parameter,
+    /// templated to the spline order.
+    std::function<void(const PMEInstance *, const Real *, const Spline &, const Spline &, const Spline &, const Real &,
+                       Real *, Real *)>
+        probeGridForceFxn_;
+    /// A function pointer to call the approprate function to spread a single atom's scalar parameter onto the bricked
+    /// ghost grid, templated to the spline order.
+    std::function<void(const PMEInstance *, Real *, const Spline &, const Spline &, const Spline &, const Real &)>
+        spreadScalarParameterBrickedFxn_;
+    /// A function pointer to call the approprate function to probe the force on a single atom with a scalar parameter
+    /// from the bricked potential grid, templated to the spline order.
+    std::function<void(const PMEInstance *, const Real *, const Spline &, const Spline &, const Spline &, const Real &,
+                       Real *, Real *)>
+        probeGridForceBrickedFxn_;
 #if HAVE_MPI == 1
     /// The communicator object that handles interactions with MPI.
     std::unique_ptr<MPIWrapper<Real>> mpiCommunicator_;
@@ -2405,49 +4119,474 @@ class PMEInstance {
     LatticeType latticeType_;
     /// Communication buffers for MPI parallelism.
     helpme::vector<Complex> workSpace1_, workSpace2_;
-    /// FFTW wrappers to help with transformations in the {A,B,C} dimensions.
-    FFTWWrapper<Real> fftHelperA_, fftHelperB_, fftHelperC_;
+    /// The structure factor multiplied by each of the six per-atom virial kernels, in XX XY YY XZ YZ ZZ order.  These
+    /// are sized along with the work spaces, so that per-atom virials don't allocate.
+    helpme::vector<Complex> virialKernelGrids_;
+    /// Plans to transform single lines in the {A,B} dimensions, for grids with many empty lines.
+    std::unique_ptr<FFTBatchPlan<Real>> fftLineA_, fftLineB_;
+    /// Plans that transform all of this node's lines in the {A,B,C} dimensions, split among the threads.
+    ThreadedFFTBatch<Real> fftBatchA_, fftBatchB_, fftBatchC_;
+    /// Whether the FFTs use the backend's native 3D transforms, rather than separate line passes; see planFFTs.
+    bool useNative3DFFT_;
+    /// The plan for the native 3D transform of the full grid, for single node, single threaded runs.
+    std::unique_ptr<FFTGridPlan<Real>> fft3D_;
+    /// The transformed A rows of the forward transform, before they're sorted into CAB order.
+    helpme::vector<Complex> transformedRowsA_;
     /// The list of atoms, and their fractional coordinates, that will contribute to this node.
     std::vector<std::tuple<int, Real, Real, Real>> atomList_;
+    /// The offset into atomList_ of the atoms kept by each thread's chunk of atoms in the parallel filtering pass.
+    std::vector<size_t> filterChunkOffsets_;
+    /// Whether the cached computeE() methods reuse the previous spread grid and spline cache, updating only the
+    /// atoms whose coordinates or parameters have changed.
+    bool incrementalUpdates_;
+    /// Whether the incremental state below matches the current spline cache, so that it can be updated.
+    bool incrementalStateValid_;
+    /// The number of incremental updates after which the grid is spread from scratch, to stop roundoff accumulating.
+    enum : int { IncrementalRefreshInterval = 100 };
+    /// The number of incremental updates made since the grid was last spread from scratch.
+    int incrementalUpdateCount_;
+    /// The parameter angular momentum and spline derivative level that the incremental state was built for.
+    int incrementalAngMom_, incrementalDerivativeLevel_;
+    /// The coordinates and negated parameters of every atom, as currently spread onto the incremental grid.
+    RealMat incrementalCoords_, incrementalNegatedParameters_;
+    /// The reciprocal lattice vectors that the incremental state was built with.
+    RealMat incrementalRecVecs_;
+    /// The ghost grid (always in the linear layout) holding the spread parameters of the incremental state.
+    RealVec incrementalGhostGrid_;
+    /// The position of each atom in atomList_ and splineCache_, or -1 if it does not contribute to this node.
+    std::vector<int> cacheSlotOfAtom_;
+    /// The atoms whose coordinates or parameters have changed since the last incremental update.
+    std::vector<int> movedAtoms_;
     /// The cached list of splines, which is stored as a member to make it persistent.
     std::vector<SplineCacheEntry<Real>> splineCache_;
+    /// The storage for the cached splines viewed by splineCache_: all A splines, then all B, then all C.  Each atom's
+    /// splines hold all derivative levels together, padded to a whole number of SIMD vectors.
+    RealVec splineCacheData_;
+    /// The {A,B,C} dimensions of the ghost grid, which pads this node's grid by splineOrder-1 points on either side
+    /// (or by fewer, if that would exceed the full grid dimension) so that every stencil is contiguous.
+    int ghostDimA_, ghostDimB_, ghostDimC_;
+    /// For each starting grid point in the {A,B,C} dimension, the corresponding first point on the ghost grid.
+    std::vector<int> ghostStartA_, ghostStartB_, ghostStartC_;
+    /// For each ghost grid point in the {A,B,C} dimension, the locally owned grid point it is folded onto, or -1.
+    std::vector<int> ghostFoldA_, ghostFoldB_, ghostFoldC_;
+    /// The ghost grid that parameters are spread onto, stored in CBA order, before folding onto the periodic grid.
+    RealVec ghostGrid_;
+    /// Flags for each {C,B} row of the ghost grid, in CB order, that are set if any stencil touches the row.  Rows that
+    /// are not flagged are neither cleared nor folded, which saves a lot of work for slab and interface systems.
+    std::vector<char> ghostRowOccupied_;
+    /// Scratch space flagging the {C,B} ghost grid rows where stencils start, used to build ghostRowOccupied_.
+    std::vector<char> ghostRowStarts_;
+    /// Flags for each {C,B} row of this node's grid, in CB order, and for each C plane, that are set if the row (or
+    /// any row in the plane) receives a contribution from a flagged ghost grid row; built by updateLocalRowOccupancy.
+    std::vector<char> localRowOccupied_, localPlaneOccupied_;
+    /// The ghost grids used when several sets of scalar parameters are spread at once, interleaved so that the index
+    /// of the parameter set runs fastest, and the corresponding (weighted) potential grids, interleaved the same way.
+    RealVec multiGhostGrids_, multiPotentialGrids_;
+    /// The number of rows along each of the B and C dimensions that are grouped into a brick in the bricked layout.
+    enum : int { BrickDim = 8 };
+    /// Whether scalar parameters are spread onto, and forces probed from, ghost grids stored as bricks of BrickDim x
+    /// BrickDim full A rows, rather than plane by plane, so that each stencil touches only a few compact blocks.
+    bool useBrickedGrids_;
+    /// The number of bricks needed to cover the {B,C} dimensions of the ghost grid.
+    int numBricksB_, numBricksC_;
+    /// The potential on the ghost grid in the bricked layout, with any points not owned by this node set to zero.
+    /// This is only allocated while the bricked layout is in use.
+    RealVec brickedPotentialGrid_;
+    /// The parts of each bricked ghost grid row's offset that come from its {B,C} index; see brickedRowOffset.
+    std::vector<size_t> brickedRowOffsetB_, brickedRowOffsetC_;
+    /// The number of atoms, or arbitrary probe points, whose splines are built together in a BSplineBlock.
+    enum : int { PointBlockSize = 128 };
+    /// The {A,B,C} spline blocks used by each thread to build batches of splines.
+    std::vector<BSplineBlock<Real>> threadSplineBlocks_;
+    /// Per-thread scratch for the fractional coordinate potential derivatives at an atom, used when probing the grid.
+    /// Each row holds the derivatives up to the highest level that the spline order supports, padded to a page.
+    RealMat fractionalPhis_;
+    /// The potential grid kept by computePotentialGridRec(), to be probed at arbitrary points.
+    RealVec storedPotentialGrid_;
+    /// The parameters and coordinates of the accepted state for Monte Carlo trial moves.
+    RealMat acceptedParameters_, acceptedCoordinates_;
+    /// The reciprocal lattice vectors that the accepted state was set up with.
+    RealMat acceptedRecVecs_;
+    /// The charge grid and potential grid of the accepted state; the latter is recomputed lazily after each accept.
+    RealVec acceptedChargeGrid_, acceptedPotentialGrid_;
+    /// Whether the accepted potential grid needs to be recomputed from the accepted charge grid.
+    bool acceptedPotentialIsStale_;
+    /// The sum of the accepted parameters, needed for the m=0 term of the rPower>3 kernels.
+    Real acceptedParameterSum_;
+    /// The number of moves accepted since the accepted charge grid was last spread from scratch.
+    int acceptedMoveCount_;
+    /// The potential at every grid point due to a unit parameter at the origin.
+    RealVec unitPotentialGrid_;
+    /// The atoms, new parameters and new coordinates of the pending trial move.
+    std::vector<int> trialAtoms_;
+    RealVec trialParameters_, trialCoordinates_;
+    /// The change in the sum of parameters proposed by the pending trial move.
+    Real trialParameterChange_;
+    /// The {A,B,C} grid points and weights of the change to the charge grid proposed by the pending trial move.
+    std::vector<std::tuple<short, short, short, Real>> trialStencil_;
+    /// Scratch space for the splines of a single atom in the trial moves.
+    RealVec trialSplines_;
+    /// The number of buckets that the {B,C} dimensions are divided into for multithreaded spreading.
+    int numSpreadBucketsB_, numSpreadBucketsC_;
+    /// The offset of each spreading bucket's first entry in spreadBucketAtoms_, plus a final end offset.
+    std::vector<size_t> spreadBucketOffsets_;
+    /// The splineCache_ entries, sorted by the spreading bucket that their stencil starts in.
+    std::vector<size_t> spreadBucketAtoms_;
+    /// Whether atoms are processed in order of the grid row containing their starting grid point, for cache locality.
+    bool sortAtomsSpatially_;
+    /// The order in which atoms are processed, when spatial sorting is enabled.
+    std::vector<int> spatialAtomOrder_;
+    /// Scratch space for spatial sorting; each atom's starting grid row and the cumulative number of atoms per row.
+    std::vector<int> spatialSortKeys_, spatialSortRowOffsets_;
+
+    /*!
+     * \brief A simple helper to compute factorials.
+     * \param n the number whose factorial is to be taken.
+     * \return n!
+     */
+    unsigned int factorial(unsigned int n) {
+        unsigned int ret = 1;
+        for (unsigned int i = 1; i <= n; ++i) ret *= i;
+        return ret;
+    }
+
+    /*!
+     * \brief makeGridIterator makes an iterator over the spline values that contribute to this node's grid
+     *        in a given Cartesian dimension.  The iterator is of the form (grid point, spline index) and is
+     *        sorted by increasing grid point, for cache efficiency.
+     * \param dimension the dimension of the grid in the Cartesian dimension of interest.
+     * \param first the first grid point in the Cartesian dimension to be handled by this node.
+     * \param last the element past the last grid point in the Cartesian dimension to be handled by this node.
+     * \return the vector of spline iterators for each starting grid point.
+     */
+    GridIterator makeGridIterator(int dimension, int first, int last) const {
+        GridIterator gridIterator;
+        for (int gridStart = 0; gridStart < dimension; ++gridStart) {
+            std::vector<std::pair<short, short>> splineIterator(splineOrder_);
+            splineIterator.clear();
+            for (int splineIndex = 0; splineIndex < splineOrder_; ++splineIndex) {
+                int gridPoint = (splineIndex + gridStart) % dimension;
+                if (gridPoint >= first && gridPoint < last)
+                    splineIterator.push_back(std::make_pair(gridPoint - first, splineIndex));
+            }
+            splineIterator.shrink_to_fit();
+            std::sort(splineIterator.begin(), splineIterator.end());
+            gridIterator.push_back(splineIterator);
+        }
+        gridIterator.shrink_to_fit();
+        return gridIterator;
+    }
+
+    /*!
+     * \brief makeGhostLayerMaps sets up the mapping between the periodic grid and the ghost grid in a given Cartesian
+     *        dimension.  A stencil starting at grid point s covers ghost grid points p ... p + splineOrder - 1,
+     *        where p = (s - first + splineOrder - 1) mod dimension, so it never has to wrap around the edge.  Ghost
+     *        grid point q corresponds to grid point first + q - (splineOrder - 1), modulo dimension.
+     * \param dimension the dimension of the grid in the Cartesian dimension of interest.
+     * \param first the first grid point in the Cartesian dimension to be handled by this node.
+     * \param last the element past the last grid point in the Cartesian dimension to be handled by this node.
+     * \param ghostDimension the dimension of the ghost grid, which is set by this function.
+     * \param ghostStart the first ghost grid point for each starting grid point, which is set by this function.
+     * \param ghostFold the locally owned grid point that each ghost point contributes to, or -1 if it is not owned.
+     */
+    void makeGhostLayerMaps(int dimension, int first, int last, int &ghostDimension, std::vector<int> &ghostStart,
+                            std::vector<int> &ghostFold) const {
+        int padding = splineOrder_ - 1;
+        // Only stencils that start within this many points of the ghost grid's origin touch this node.
+        int startRange = std::min(dimension, last - first + padding);
+        ghostDimension = startRange + padding;
+        ghostStart.resize(dimension);
+        for (int gridStart = 0; gridStart < dimension; ++gridStart)
+            ghostStart[gridStart] = (gridStart - first + padding + dimension) % dimension;
+        ghostFold.resize(ghostDimension);
+        for (int ghostPoint = 0; ghostPoint < ghostDimension; ++ghostPoint) {
+            int gridPoint = (first + ghostPoint - padding + 2 * dimension) % dimension;
+            ghostFold[ghostPoint] = gridPoint >= first && gridPoint < last ? gridPoint - first : -1;
+        }
+    }
+
+    /*!
+     * \brief foldGhostGrid adds the ghost grid contents onto the periodic grid owned by this node.  Only the rows
+     *        flagged in ghostRowOccupied_ are read.
+     * \param ghostGrid pointer to the first element of the ghost grid to be folded.
+     * \param gridStride the spacing between consecutive elements of the ghost grid, which is larger than one when
+     *        several ghost grids are stored interleaved.
+     * \param bricked whether the ghost grid is stored in the bricked layout, rather than in CBA order.
+     * \return realGrid the array of discretized parameters (stored in CBA order).
+     */
+    Real *foldGhostGrid(const Real *ghostGrid, int gridStride = 1, bool bricked = false) {
+        Real *realGrid = reinterpret_cast<Real *>(workSpace1_.data());
+        const int padding = splineOrder_ - 1;
+#pragma omp parallel for num_threads(nThreads_)
+        for (int c = 0; c < myDimC_; ++c) {
+            Real *cPlane = realGrid + c * myDimB_ * myDimA_;
+            std::fill(cPlane, cPlane + myDimB_ * myDimA_, 0);
+            for (int ghostC = 0; ghostC < ghostDimC_; ++ghostC) {
+                if (ghostFoldC_[ghostC] != c) continue;
+                for (int ghostB = 0; ghostB < ghostDimB_; ++ghostB) {
+                    int b = ghostFoldB_[ghostB];
+                    if (b < 0 || !ghostRowOccupied_[ghostC * ghostDimB_ + ghostB]) continue;
+                    Real *cbRow = cPlane + b * myDimA_;
+                    const Real *ghostRow = ghostGrid + ghostRowOffset(ghostC, ghostB, bricked) * gridStride;
+                    // The interior maps contiguously onto this node's row; only the ghost points need wrapping.
+                    const Real *interiorRow = ghostRow + padding * gridStride;
+                    if (gridStride == 1) {
+                        for (int a = 0; a < myDimA_; ++a) cbRow[a] += interiorRow[a];
+                    } else {
+                        for (int a = 0; a < myDimA_; ++a) cbRow[a] += interiorRow[a * gridStride];
+                    }
+                    for (int ghostA = 0; ghostA < padding; ++ghostA) {
+                        int a = ghostFoldA_[ghostA];
+                        if (a >= 0) cbRow[a] += ghostRow[ghostA * gridStride];
+                    }
+                    for (int ghostA = padding + myDimA_; ghostA < ghostDimA_; ++ghostA) {
+                        int a = ghostFoldA_[ghostA];
+                        if (a >= 0) cbRow[a] += ghostRow[ghostA * gridStride];
+                    }
+                }
+            }
+        }
+        return realGrid;
+    }
+
+    /*!
+     * \brief brickedRowOffset computes the location of a ghost grid row in the bricked layout.  Rows are grouped into
+     *        bricks of BrickDim x BrickDim {C,B} rows, stored contiguously in CB order, and the bricks themselves are
+     *        stored in CB order.  Each row holds the full A dimension, so stencil rows remain contiguous.
+     * \param ghostC the C index of the row on the ghost grid.
+     * \param ghostB the B index of the row on the ghost grid.
+     * \return the offset of the first point in the row from the start of the bricked grid.
+     */
+    size_t brickedRowOffset(int ghostC, int ghostB) const {
+        return brickedRowOffsetC_[ghostC] + brickedRowOffsetB_[ghostB];
+    }
+
+    /*!
+     * \brief makeBrickedRowOffsets tabulates the bricked row offsets, which separate into a part that depends only on
+     *        the C index of the row and a part that depends only on its B index.
+     */
+    void makeBrickedRowOffsets() {
+        brickedRowOffsetB_.resize(ghostDimB_);
+        for (int ghostB = 0; ghostB < ghostDimB_; ++ghostB)
+            brickedRowOffsetB_[ghostB] =
+                (static_cast<size_t>(ghostB / BrickDim) * BrickDim * BrickDim + ghostB % BrickDim) * ghostDimA_;
+        brickedRowOffsetC_.resize(ghostDimC_);
+        for (int ghostC = 0; ghostC < ghostDimC_; ++ghostC)
+            brickedRowOffsetC_[ghostC] = (static_cast<size_t>(ghostC / BrickDim) * numBricksB_ * BrickDim * BrickDim +
+                                          (ghostC % BrickDim) * BrickDim) *
+                                         ghostDimA_;
+    }
+
+    /*!
+     * \brief ghostRowOffset computes the location of a ghost grid row, in either layout.
+     * \param ghostC the C index of the row on the ghost grid.
+     * \param ghostB the B index of the row on the ghost grid.
+     * \param bricked whether the ghost grid is stored in the bricked layout, rather than in CBA order.
+     * \return the offset of the first point in the row from the start of the ghost grid.
+     */
+    size_t ghostRowOffset(int ghostC, int ghostB, bool bricked) const {
+        return bricked ? brickedRowOffset(ghostC, ghostB)
+                       : static_cast<size_t>(ghostC * ghostDimB_ + ghostB) * ghostDimA_;
+    }
+
+    /*!
+     * \brief brickPotentialGrid copies the potential owned by this node onto a ghost grid in the bricked layout,
+     *        replicating the periodic images needed by stencils that wrap around the grid.  Ghost points that are
+     *        owned by another node are zeroed, so that probing gives this node's share of the result, just as for
+     *        the linear layout.  Only the rows flagged in ghostRowOccupied_, which the cached atoms' stencils cover,
+     *        are copied.
+     * \param potentialGrid pointer to the array containing the potential, in ZYX order.
+     * \return pointer to the bricked potential grid.
+     */
+    const Real *brickPotentialGrid(const Real *potentialGrid) {
+        Real *brickedGrid = brickedPotentialGrid_.data();
+#pragma omp parallel for num_threads(nThreads_)
+        for (int ghostC = 0; ghostC < ghostDimC_; ++ghostC) {
+            int c = ghostFoldC_[ghostC];
+            for (int ghostB = 0; ghostB < ghostDimB_; ++ghostB) {
+                if (!ghostRowOccupied_[ghostC * ghostDimB_ + ghostB]) continue;
+                int b = ghostFoldB_[ghostB];
+                Real *ghostRow = brickedGrid + brickedRowOffset(ghostC, ghostB);
+                if (c < 0 || b < 0) {
+                    std::fill(ghostRow, ghostRow + ghostDimA_, 0);
+                    continue;
+                }
+                const Real *cbRow = potentialGrid + (static_cast<size_t>(c) * myDimB_ + b) * myDimA_;
+                for (int ghostA = 0; ghostA < ghostDimA_; ++ghostA) {
+                    int a = ghostFoldA_[ghostA];
+                    ghostRow[ghostA] = a >= 0 ? cbRow[a] : 0;
+                }
+            }
+        }
+        return brickedGrid;
+    }
+
+    /*!
+     * \brief updateGhostRowOccupancy builds ghostRowOccupied_ from the stencil starting rows flagged in
+     *        ghostRowStarts_, by extending each flag over the splineOrder x splineOrder rows that the stencil covers.
+     *        The extension is done one dimension at a time, so the cost is independent of the number of atoms.
+     */
+    void updateGhostRowOccupancy() {
+        const int order = splineOrder_;
+        // Extend along B, storing the intermediate result in ghostRowOccupied_.
+        for (int ghostC = 0; ghostC < ghostDimC_; ++ghostC) {
+            const char *startRow = ghostRowStarts_.data() + ghostC * ghostDimB_;
+            char *occupiedRow = ghostRowOccupied_.data() + ghostC * ghostDimB_;
+            for (int ghostB = 0; ghostB < ghostDimB_; ++ghostB) {
+                char occupied = 0;
+                for (int start = std::max(0, ghostB - order + 1); start <= ghostB; ++start) occupied |= startRow[start];
+                occupiedRow[ghostB] = occupied;
+            }
+        }
+        // Extend along C, working backwards so that each plane only reads planes that have not yet been updated.
+        for (int ghostC = ghostDimC_ - 1; ghostC >= 0; --ghostC) {
+            char *occupiedRow = ghostRowOccupied_.data() + ghostC * ghostDimB_;
+            for (int start = std::max(0, ghostC - order + 1); start < ghostC; ++start) {
+                const char *sourceRow = ghostRowOccupied_.data() + start * ghostDimB_;
+                for (int ghostB = 0; ghostB < ghostDimB_; ++ghostB) occupiedRow[ghostB] |= sourceRow[ghostB];
+            }
+        }
+    }
 
     /*!
-     * \brief A simple helper to compute factorials.
-     * \param n the number whose factorial is to be taken.
-     * \return n!
+     * \brief updateLocalRowOccupancy folds ghostRowOccupied_ onto this node's grid, flagging the rows that the
+     *        stencils of the cached atoms touch in localRowOccupied_ and the C planes holding them in
+     *        localPlaneOccupied_.  Rows that are not flagged are zero on a folded grid, and are never probed.
+     * \return the number of flagged rows.
      */
-    unsigned int factorial(unsigned int n) {
-        unsigned int ret = 1;
-        for (unsigned int i = 1; i <= n; ++i) ret *= i;
-        return ret;
+    size_t updateLocalRowOccupancy() {
+        std::fill(localRowOccupied_.begin(), localRowOccupied_.end(), 0);
+        std::fill(localPlaneOccupied_.begin(), localPlaneOccupied_.end(), 0);
+        for (int ghostC = 0; ghostC < ghostDimC_; ++ghostC) {
+            int c = ghostFoldC_[ghostC];
+            if (c < 0) continue;
+            for (int ghostB = 0; ghostB < ghostDimB_; ++ghostB) {
+                int b = ghostFoldB_[ghostB];
+                if (b < 0 || !ghostRowOccupied_[ghostC * ghostDimB_ + ghostB]) continue;
+                localRowOccupied_[c * myDimB_ + b] = 1;
+                localPlaneOccupied_[c] = 1;
+            }
+        }
+        return std::count(localRowOccupied_.begin(), localRowOccupied_.end(), 1);
     }
 
     /*!
-     * \brief makeGridIterator makes an iterator over the spline values that contribute to this node's grid
-     *        in a given Cartesian dimension.  The iterator is of the form (grid point, spline index) and is
-     *        sorted by increasing grid point, for cache efficiency.
-     * \param dimension the dimension of the grid in the Cartesian dimension of interest.
-     * \param first the first grid point in the Cartesian dimension to be handled by this node.
-     * \param last the element past the last grid point in the Cartesian dimension to be handled by this node.
-     * \return the vector of spline iterators for each starting grid point.
+     * \brief forEachOccupiedPlaneRun calls a function for each run of consecutive C planes of this node's grid that
+     *        are flagged in localPlaneOccupied_.
+     * \param function the function to call, with the first plane of the run and the number of planes in it.
      */
-    GridIterator makeGridIterator(int dimension, int first, int last) const {
-        GridIterator gridIterator;
-        for (int gridStart = 0; gridStart < dimension; ++gridStart) {
-            std::vector<std::pair<short, short>> splineIterator(splineOrder_);
-            splineIterator.clear();
-            for (int splineIndex = 0; splineIndex < splineOrder_; ++splineIndex) {
-                int gridPoint = (splineIndex + gridStart) % dimension;
-                if (gridPoint >= first && gridPoint < last)
-                    splineIterator.push_back(std::make_pair(gridPoint - first, splineIndex));
+    template <typename Function>
+    void forEachOccupiedPlaneRun(const Function &function) const {
+        for (int c = 0; c < myDimC_;) {
+            if (!localPlaneOccupied_[c]) {
+                ++c;
+                continue;
             }
-            splineIterator.shrink_to_fit();
-            std::sort(splineIterator.begin(), splineIterator.end());
-            gridIterator.push_back(splineIterator);
+            int firstPlane = c;
+            while (c < myDimC_ && localPlaneOccupied_[c]) ++c;
+            function(firstPlane, c - firstPlane);
         }
-        gridIterator.shrink_to_fit();
-        return gridIterator;
+    }
+
+    /*!
+     * \brief zeroOccupiedGhostRows clears the rows of a ghost grid that the stencils of the cached atoms touch; the
+     *        remaining rows are left untouched, because they are never read.
+     * \param ghostGrid pointer to the ghost grid.
+     * \param gridStride the spacing between consecutive elements of the ghost grid, which is larger than one when
+     *        several ghost grids are stored interleaved.
+     * \param bricked whether the ghost grid is stored in the bricked layout, rather than in CBA order.
+     */
+    void zeroOccupiedGhostRows(Real *ghostGrid, int gridStride = 1, bool bricked = false) {
+#pragma omp parallel for num_threads(nThreads_)
+        for (int ghostC = 0; ghostC < ghostDimC_; ++ghostC) {
+            for (int ghostB = 0; ghostB < ghostDimB_; ++ghostB) {
+                if (!ghostRowOccupied_[ghostC * ghostDimB_ + ghostB]) continue;
+                Real *ghostRow = ghostGrid + ghostRowOffset(ghostC, ghostB, bricked) * gridStride;
+                std::fill(ghostRow, ghostRow + ghostDimA_ * gridStride, 0);
+            }
+        }
+    }
+
+    /*!
+     * \brief numSpreadBuckets computes how many buckets the starting points on a ghost grid dimension are divided into
+     *        for multithreaded spreading.  Buckets are at least as wide as the spline order, so a stencil starting in
+     *        one bucket can only reach into the next one, allowing all even (or all odd) buckets to be processed
+     *        concurrently without two threads touching the same ghost grid point.
+     * \param ghostDimension the dimension of the ghost grid in the Cartesian dimension of interest.
+     * \return the number of buckets.
+     */
+    int numSpreadBuckets(int ghostDimension) const {
+        return std::max(1, (ghostDimension - splineOrder_ + 1) / splineOrder_);
+    }
+
+    /*!
+     * \brief sortAtomsIntoSpreadBuckets performs a counting sort of the entries in the spline cache, according to the
+     *        {B,C} bucket containing their starting grid point.  The original ordering is retained within each bucket.
+     */
+    void sortAtomsIntoSpreadBuckets() {
+        size_t nAtoms = atomList_.size();
+        size_t nBuckets = numSpreadBucketsB_ * numSpreadBucketsC_;
+        auto bucketOf = [&](size_t relativeAtomNumber) {
+            const auto &entry = splineCache_[relativeAtomNumber];
+            int bBucket = ghostStartB_[entry.bSpline.startingGridPoint()] * numSpreadBucketsB_ /
+                          (ghostDimB_ - splineOrder_ + 1);
+            int cBucket = ghostStartC_[entry.cSpline.startingGridPoint()] * numSpreadBucketsC_ /
+                          (ghostDimC_ - splineOrder_ + 1);
+            return cBucket * numSpreadBucketsB_ + bBucket;
+        };
+        spreadBucketOffsets_.assign(nBuckets + 1, 0);
+        spreadBucketAtoms_.resize(nAtoms);
+        for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber)
+            ++spreadBucketOffsets_[bucketOf(relativeAtomNumber) + 1];
+        for (size_t bucket = 0; bucket < nBuckets; ++bucket)
+            spreadBucketOffsets_[bucket + 1] += spreadBucketOffsets_[bucket];
+        // Use the start offsets as insertion cursors; this leaves each one pointing at the next bucket's start.
+        for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber)
+            spreadBucketAtoms_[spreadBucketOffsets_[bucketOf(relativeAtomNumber)]++] = relativeAtomNumber;
+        for (size_t bucket = nBuckets; bucket > 0; --bucket)
+            spreadBucketOffsets_[bucket] = spreadBucketOffsets_[bucket - 1];
+        spreadBucketOffsets_[0] = 0;
+    }
+
+    /*!
+     * \brief startingGridRow computes the index of the (C,B) row of the grid that contains the starting grid point
+     *        of a given atom's splines.
+     * \param atomCoords a 3-vector containing the atom's coordinates.
+     * \return the row index, C * dimB + B.
+     */
+    int startingGridRow(const Real *atomCoords) const {
+        Real fractionalCoords[3];
+        short startingGridPoints[3];
+        locatePoint(atomCoords, fractionalCoords, startingGridPoints);
+        return startingGridPoints[2] * dimB_ + startingGridPoints[1];
+    }
+
+    /*!
+     * \brief updateSpatialAtomOrder makes sure that spatialAtomOrder_ lists the atoms approximately sorted by the grid
+     *        row containing their starting grid point.  The ordering from the previous call is kept if atoms have
+     *        moved little enough since then that it is still mostly sorted; otherwise a new counting sort is performed.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     */
+    void updateSpatialAtomOrder(const RealMat &coordinates) {
+        size_t nAtoms = coordinates.nRows();
+        spatialSortKeys_.resize(nAtoms);
+        for (size_t atom = 0; atom < nAtoms; ++atom) spatialSortKeys_[atom] = startingGridRow(coordinates[atom]);
+
+        if (spatialAtomOrder_.size() == nAtoms) {
+            size_t nOutOfOrder = 0;
+            for (size_t n = 1; n < nAtoms; ++n)
+                nOutOfOrder += spatialSortKeys_[spatialAtomOrder_[n]] < spatialSortKeys_[spatialAtomOrder_[n - 1]];
+            // Tolerate one out-of-order neighbor in every sixteen before paying for a new sort.
+            if (16 * nOutOfOrder <= nAtoms) return;
+        }
+
+        size_t nRows = dimB_ * dimC_;
+        spatialSortRowOffsets_.assign(nRows + 1, 0);
+        for (size_t atom = 0; atom < nAtoms; ++atom) ++spatialSortRowOffsets_[spatialSortKeys_[atom] + 1];
+        for (size_t row = 0; row < nRows; ++row) spatialSortRowOffsets_[row + 1] += spatialSortRowOffsets_[row];
+        spatialAtomOrder_.resize(nAtoms);
+        for (size_t atom = 0; atom < nAtoms; ++atom)
+            spatialAtomOrder_[spatialSortRowOffsets_[spatialSortKeys_[atom]]++] = atom;
     }
 
     /*! Make sure that the iterator over AM components is up to date.
@@ -2486,6 +4625,72 @@ class PMEInstance {
         }
     }
 
+    /*!
+     * \brief locateAtom finds the fractional coordinates of an atom, and whether its stencil touches this node's part
+     *        of the grid.
+     * \param coords the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param atom the absolute atom number.
+     * \param aCoord the fractional coordinate in the A direction, in the range [0,1).
+     * \param bCoord the fractional coordinate in the B direction, in the range [0,1).
+     * \param cCoord the fractional coordinate in the C direction, in the range [0,1).
+     * \return whether the atom contributes to this node's part of the grid.
+     */
+    bool locateAtom(const RealMat &coords, int atom, Real &aCoord, Real &bCoord, Real &cCoord) const {
+        Real fractionalCoords[3];
+        short startingGridPoints[3];
+        locatePoint(coords[atom], fractionalCoords, startingGridPoints);
+        aCoord = fractionalCoords[0];
+        bCoord = fractionalCoords[1];
+        cCoord = fractionalCoords[2];
+        return gridIteratorA_[startingGridPoints[0]].size() && gridIteratorB_[startingGridPoints[1]].size() &&
+               gridIteratorC_[startingGridPoints[2]].size();
+    }
+
+    /*!
+     * \brief splineCacheStride computes the number of values stored for each atom's splines in each direction.
+     * \param splineDerivativeLevel the derivative level of the cached splines.
+     * \return the number of values, padded to a whole number of SIMD vectors.
+     */
+    size_t splineCacheStride(int splineDerivativeLevel) const {
+        constexpr size_t simdWidthInReals = 32 / sizeof(Real);
+        size_t splineStride = (splineDerivativeLevel + 1) * splineOrder_;
+        return (splineStride + simdWidthInReals - 1) / simdWidthInReals * simdWidthInReals;
+    }
+
+    /*!
+     * \brief cacheAtomSplines computes an atom's splines into the given slot of the spline cache.
+     * \param slot the position in atomList_ and splineCache_ to fill.
+     * \param atom the absolute atom number.
+     * \param aCoord the fractional coordinate in the A direction.
+     * \param bCoord the fractional coordinate in the B direction.
+     * \param cCoord the fractional coordinate in the C direction.
+     * \param splineDerivativeLevel the derivative level of the cached splines.
+     */
+    void cacheAtomSplines(size_t slot, int atom, Real aCoord, Real bCoord, Real cCoord, int splineDerivativeLevel) {
+        size_t splineStride = splineCacheStride(splineDerivativeLevel);
+        size_t cacheCapacity = splineCacheData_.size() / (3 * splineStride);
+        Real *aSplines = splineCacheData_.data() + slot * splineStride;
+        Real *bSplines = aSplines + cacheCapacity * splineStride;
+        Real *cSplines = bSplines + cacheCapacity * splineStride;
+        short aStartingGridPoint = dimA_ * aCoord;
+        short bStartingGridPoint = dimB_ * bCoord;
+        short cStartingGridPoint = dimC_ * cCoord;
+        for (Real *splines : {aSplines, bSplines, cSplines}) std::fill(splines, splines + splineStride, Real(0));
+        BSpline<Real>::computeInPlace(aSplines, dimA_ * aCoord - aStartingGridPoint, splineOrder_,
+                                      splineDerivativeLevel);
+        BSpline<Real>::computeInPlace(bSplines, dimB_ * bCoord - bStartingGridPoint, splineOrder_,
+                                      splineDerivativeLevel);
+        BSpline<Real>::computeInPlace(cSplines, dimC_ * cCoord - cStartingGridPoint, splineOrder_,
+                                      splineDerivativeLevel);
+        atomList_[slot] = std::make_tuple(atom, aCoord, bCoord, cCoord);
+        auto &atomSplines = splineCache_[slot];
+        atomSplines.absoluteAtomNumber = atom;
+        atomSplines.aSpline = Spline(aStartingGridPoint, aSplines, splineOrder_);
+        atomSplines.bSpline = Spline(bStartingGridPoint, bSplines, splineOrder_);
+        atomSplines.cSpline = Spline(cStartingGridPoint, cSplines, splineOrder_);
+        ghostRowStarts_[ghostStartC_[cStartingGridPoint] * ghostDimB_ + ghostStartB_[bStartingGridPoint]] = 1;
+    }
+
     /*!
      * \brief filterAtomsAndBuildSplineCache builds a list of BSplines for only the atoms to be handled by this node.
      * \param splineDerivativeLevel the derivative level (parameter angular momentum + energy derivative level) of the
@@ -2493,70 +4698,128 @@ class PMEInstance {
      */
     void filterAtomsAndBuildSplineCache(int splineDerivativeLevel, const RealMat &coords) {
         assertInitialized();
+        // The splines are built inside a parallel region, which exceptions can't propagate out of, so check now.
+        BSpline<Real>::assertSplineIsSufficient(splineOrder_, splineDerivativeLevel);
+        incrementalStateValid_ = false;
 
-        atomList_.clear();
+        std::fill(ghostRowStarts_.begin(), ghostRowStarts_.end(), 0);
         size_t nAtoms = coords.nRows();
-        for (int atom = 0; atom < nAtoms; ++atom) {
-            const Real *atomCoords = coords[atom];
-            constexpr float EPS = 1e-6;
-            Real aCoord =
-                atomCoords[0] * recVecs_(0, 0) + atomCoords[1] * recVecs_(1, 0) + atomCoords[2] * recVecs_(2, 0) - EPS;
-            Real bCoord =
-                atomCoords[0] * recVecs_(0, 1) + atomCoords[1] * recVecs_(1, 1) + atomCoords[2] * recVecs_(2, 1) - EPS;
-            Real cCoord =
-                atomCoords[0] * recVecs_(0, 2) + atomCoords[1] * recVecs_(1, 2) + atomCoords[2] * recVecs_(2, 2) - EPS;
-            // Make sure the fractional coordinates fall in the range 0 <= s < 1
-            aCoord -= floor(aCoord);
-            bCoord -= floor(bCoord);
-            cCoord -= floor(cCoord);
-            short aStartingGridPoint = dimA_ * aCoord;
-            short bStartingGridPoint = dimB_ * bCoord;
-            short cStartingGridPoint = dimC_ * cCoord;
-            const auto &aGridIterator = gridIteratorA_[aStartingGridPoint];
-            const auto &bGridIterator = gridIteratorB_[bStartingGridPoint];
-            const auto &cGridIterator = gridIteratorC_[cStartingGridPoint];
-            if (aGridIterator.size() && bGridIterator.size() && cGridIterator.size())
-                atomList_.emplace_back(atom, aCoord, bCoord, cCoord);
+        if (sortAtomsSpatially_) updateSpatialAtomOrder(coords);
+        // Each thread counts the atoms it keeps from a contiguous chunk of the list, then the counts are prefix summed
+        // to find where each thread's atoms go, so that the atom list is compacted in parallel in the original order.
+        filterChunkOffsets_.resize(nThreads_ + 1);
+#pragma omp parallel num_threads(nThreads_)
+        {
+#ifdef _OPENMP
+            int threadID = omp_get_thread_num();
+            int nTeamThreads = omp_get_num_threads();
+#else
+            int threadID = 0;
+            int nTeamThreads = 1;
+#endif
+            size_t firstAtom = nAtoms * threadID / nTeamThreads;
+            size_t lastAtom = nAtoms * (threadID + 1) / nTeamThreads;
+            Real aCoord, bCoord, cCoord;
+            size_t nKept = 0;
+            for (size_t atomNum = firstAtom; atomNum < lastAtom; ++atomNum) {
+                int atom = sortAtomsSpatially_ ? spatialAtomOrder_[atomNum] : atomNum;
+                nKept += locateAtom(coords, atom, aCoord, bCoord, cCoord);
+            }
+            filterChunkOffsets_[threadID + 1] = nKept;
+#pragma omp barrier
+#pragma omp single
+            {
+                filterChunkOffsets_[0] = 0;
+                std::partial_sum(filterChunkOffsets_.begin(), filterChunkOffsets_.begin() + nTeamThreads + 1,
+                                 filterChunkOffsets_.begin());
+                atomList_.resize(filterChunkOffsets_[nTeamThreads]);
+            }
+            size_t atomListNum = filterChunkOffsets_[threadID];
+            for (size_t atomNum = firstAtom; atomNum < lastAtom; ++atomNum) {
+                int atom = sortAtomsSpatially_ ? spatialAtomOrder_[atomNum] : atomNum;
+                if (locateAtom(coords, atom, aCoord, bCoord, cCoord)) {
+                    atomList_[atomListNum++] = std::make_tuple(atom, aCoord, bCoord, cCoord);
+                    short bStartingGridPoint = dimB_ * bCoord;
+                    short cStartingGridPoint = dimC_ * cCoord;
+                    size_t row = ghostStartC_[cStartingGridPoint] * ghostDimB_ + ghostStartB_[bStartingGridPoint];
+#pragma omp atomic write
+                    ghostRowStarts_[row] = 1;
+                }
+            }
         }
+        updateGhostRowOccupancy();
 
         // Now we know how many atoms we loop over the dense list, redefining nAtoms accordingly.
         // The first stage above is to get the number of atoms, so we can avoid calling push_back
         // and thus avoid the many memory allocations.  If the cache is too small, grow it by a
         // certain scale factor to try and minimize allocations in a not-too-wasteful manner.
         nAtoms = atomList_.size();
-        if (splineCache_.size() < nAtoms) {
-            size_t newSize = static_cast<size_t>(1.2 * nAtoms);
-            for (int atom = splineCache_.size(); atom < newSize; ++atom)
-                splineCache_.emplace_back(splineOrder_, splineDerivativeLevel);
-        }
-
-        for (int atomListNum = 0; atomListNum < nAtoms; ++atomListNum) {
-            const auto &entry = atomList_[atomListNum];
-            const int absoluteAtomNumber = std::get<0>(entry);
-            const Real aCoord = std::get<1>(entry);
-            const Real bCoord = std::get<2>(entry);
-            const Real cCoord = std::get<3>(entry);
-            short aStartingGridPoint = dimA_ * aCoord;
-            short bStartingGridPoint = dimB_ * bCoord;
-            short cStartingGridPoint = dimC_ * cCoord;
-            auto &atomSplines = splineCache_[atomListNum];
-            atomSplines.absoluteAtomNumber = absoluteAtomNumber;
-            atomSplines.aSpline.update(aStartingGridPoint, dimA_ * aCoord - aStartingGridPoint, splineOrder_,
-                                       splineDerivativeLevel);
-            atomSplines.bSpline.update(bStartingGridPoint, dimB_ * bCoord - bStartingGridPoint, splineOrder_,
-                                       splineDerivativeLevel);
-            atomSplines.cSpline.update(cStartingGridPoint, dimC_ * cCoord - cStartingGridPoint, splineOrder_,
-                                       splineDerivativeLevel);
-        }
-    }
-
-    /*!
-     * \brief Spreads parameters onto the grid for a single atom
+        size_t splineStride = splineCacheStride(splineDerivativeLevel);
+        size_t cacheCapacity = splineCacheData_.size() / (3 * splineStride);
+        if (cacheCapacity < nAtoms) {
+            cacheCapacity = static_cast<size_t>(1.2 * nAtoms);
+            splineCacheData_.resize(3 * cacheCapacity * splineStride);
+        }
+        if (splineCache_.size() < nAtoms) splineCache_.resize(static_cast<size_t>(1.2 * nAtoms));
+        Real *aSplineData = splineCacheData_.data();
+        Real *bSplineData = aSplineData + cacheCapacity * splineStride;
+        Real *cSplineData = bSplineData + cacheCapacity * splineStride;
+
+        // The splines are built for batches of atoms at a time, vectorizing the recursion across the atoms in each
+        // batch, and then scattered into each atom's slot in the cache.
+        size_t nBatches = (nAtoms + PointBlockSize - 1) / PointBlockSize;
+#pragma omp parallel for num_threads(nThreads_)
+        for (size_t batch = 0; batch < nBatches; ++batch) {
+#ifdef _OPENMP
+            int threadID = omp_get_thread_num();
+#else
+            int threadID = 1;
+#endif
+            BSplineBlock<Real> *splineBlocks = &threadSplineBlocks_[3 * (threadID % nThreads_)];
+            size_t firstAtom = batch * PointBlockSize;
+            int nBatchAtoms = static_cast<int>(std::min<size_t>(PointBlockSize, nAtoms - firstAtom));
+            Real distances[3 * PointBlockSize];
+            for (int batchAtom = 0; batchAtom < nBatchAtoms; ++batchAtom) {
+                size_t atomListNum = firstAtom + batchAtom;
+                const auto &entry = atomList_[atomListNum];
+                const Real aCoord = std::get<1>(entry);
+                const Real bCoord = std::get<2>(entry);
+                const Real cCoord = std::get<3>(entry);
+                short aStartingGridPoint = dimA_ * aCoord;
+                short bStartingGridPoint = dimB_ * bCoord;
+                short cStartingGridPoint = dimC_ * cCoord;
+                distances[batchAtom] = dimA_ * aCoord - aStartingGridPoint;
+                distances[PointBlockSize + batchAtom] = dimB_ * bCoord - bStartingGridPoint;
+                distances[2 * PointBlockSize + batchAtom] = dimC_ * cCoord - cStartingGridPoint;
+                size_t splineOffset = atomListNum * splineStride;
+                auto &atomSplines = splineCache_[atomListNum];
+                atomSplines.absoluteAtomNumber = std::get<0>(entry);
+                atomSplines.aSpline = Spline(aStartingGridPoint, aSplineData + splineOffset, splineOrder_);
+                atomSplines.bSpline = Spline(bStartingGridPoint, bSplineData + splineOffset, splineOrder_);
+                atomSplines.cSpline = Spline(cStartingGridPoint, cSplineData + splineOffset, splineOrder_);
+            }
+            Real *splineData[3] = {aSplineData, bSplineData, cSplineData};
+            for (int dim = 0; dim < 3; ++dim) {
+                auto &splineBlock = splineBlocks[dim];
+                splineBlock.update(distances + dim * PointBlockSize, nBatchAtoms, splineOrder_, splineDerivativeLevel);
+                for (int level = 0; level <= splineDerivativeLevel; ++level) {
+                    for (int component = 0; component < splineOrder_; ++component) {
+                        const Real *values = splineBlock(level, component);
+                        Real *atomSplines = splineData[dim] + firstAtom * splineStride + level * splineOrder_;
+                        for (int batchAtom = 0; batchAtom < nBatchAtoms; ++batchAtom)
+                            atomSplines[batchAtom * splineStride + component] = values[batchAtom];
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Spreads parameters onto the ghost grid for a single atom.  The ghost grid is padded so that no stencil
+     *        needs to wrap, making each row update a contiguous, vectorizable operation.
      * \param atom the absolute atom number.
-     * \param realGrid pointer to the array containing the grid in CBA order
+     * \param ghostGrid pointer to the array containing the ghost grid in CBA order
      * \param nComponents the number of angular momentum components in the parameters.
-     * \param nForceComponents the number of angular momentum components in the parameters with one extra
-     *        level of angular momentum to permit evaluation of forces.
      * \param splineA the BSpline object for the A direction.
      * \param splineB the BSpline object for the B direction.
      * \param splineC the BSpline object for the C direction.
@@ -2573,62 +4836,345 @@ class PMEInstance {
      *         for Ly in range(0, L - Lz + 1):
      *              Lx  = L - Ly - Lz
      * \endcode
+     * \tparam Order the spline order, allowing the stencil loops to be unrolled, or zero for the generic version.
      */
-    void spreadParametersImpl(const int &atom, Real *realGrid, const int &nComponents, const Spline &splineA,
-                              const Spline &splineB, const Spline &splineC, const RealMat &parameters) {
-        const auto &aGridIterator = gridIteratorA_[splineA.startingGridPoint()];
-        const auto &bGridIterator = gridIteratorB_[splineB.startingGridPoint()];
-        const auto &cGridIterator = gridIteratorC_[splineC.startingGridPoint()];
-        int numPointsA = static_cast<int>(aGridIterator.size());
-        int numPointsB = static_cast<int>(bGridIterator.size());
-        int numPointsC = static_cast<int>(cGridIterator.size());
-        const auto *iteratorDataA = aGridIterator.data();
-        const auto *iteratorDataB = bGridIterator.data();
-        const auto *iteratorDataC = cGridIterator.data();
+    template <int Order>
+    void spreadParametersImpl(const int &atom, Real *ghostGrid, const int &nComponents, const Spline &splineA,
+                              const Spline &splineB, const Spline &splineC, const RealMat &parameters) const {
+        const int order = Order ? Order : splineOrder_;
+        const size_t strideC = ghostDimB_ * ghostDimA_;
+        const size_t strideB = ghostDimA_;
+        Real *stencil = ghostGrid + ghostStartC_[splineC.startingGridPoint()] * strideC +
+                        ghostStartB_[splineB.startingGridPoint()] * strideB + ghostStartA_[splineA.startingGridPoint()];
         for (int component = 0; component < nComponents; ++component) {
             const auto &quanta = angMomIterator_[component];
             Real param = parameters(atom, component);
             const Real *splineValsA = splineA[quanta[0]];
             const Real *splineValsB = splineB[quanta[1]];
             const Real *splineValsC = splineC[quanta[2]];
+            for (int pointC = 0; pointC < order; ++pointC) {
+                Real cValP = param * splineValsC[pointC];
+                for (int pointB = 0; pointB < order; ++pointB) {
+                    Real cbValP = cValP * splineValsB[pointB];
+                    Real *cbRow = stencil + pointC * strideC + pointB * strideB;
+#pragma omp simd
+                    for (int pointA = 0; pointA < order; ++pointA) cbRow[pointA] += cbValP * splineValsA[pointA];
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Spreads the parameter onto the ghost grid for a single atom, specialized for zero parameter angular
+     *        momentum.
+     * \param ghostGrid pointer to the array containing the ghost grid in CBA order
+     * \param splineA the BSpline object for the A direction.
+     * \param splineB the BSpline object for the B direction.
+     * \param splineC the BSpline object for the C direction.
+     * \param parameter the parameter associated with the given atom.
+     * \tparam Order the spline order, allowing the stencil loops to be unrolled, or zero for the generic version.
+     */
+    template <int Order>
+    void spreadScalarParameterImpl(Real *ghostGrid, const Spline &splineA, const Spline &splineB,
+                                   const Spline &splineC, const Real &parameter) const {
+        const size_t strideC = ghostDimB_ * ghostDimA_;
+        const size_t strideB = ghostDimA_;
+        Real *stencil = ghostGrid + ghostStartC_[splineC.startingGridPoint()] * strideC +
+                        ghostStartB_[splineB.startingGridPoint()] * strideB + ghostStartA_[splineA.startingGridPoint()];
+        const Real *splineValsA = splineA[0];
+        const Real *splineValsB = splineB[0];
+        const Real *splineValsC = splineC[0];
+        if (Order) {
+            // Build the full outer product of the spline values up front, so that the grid update that follows is
+            // just a stream of contiguous row additions.
+            Real outerProduct[Order ? Order * Order * Order : 1];
+            for (int pointC = 0; pointC < Order; ++pointC) {
+                for (int pointB = 0; pointB < Order; ++pointB) {
+                    Real cbValP = parameter * splineValsC[pointC] * splineValsB[pointB];
+                    Real *cbValues = outerProduct + (pointC * Order + pointB) * Order;
+                    for (int pointA = 0; pointA < Order; ++pointA) cbValues[pointA] = cbValP * splineValsA[pointA];
+                }
+            }
+            for (int pointC = 0; pointC < Order; ++pointC) {
+                for (int pointB = 0; pointB < Order; ++pointB) {
+                    const Real *cbValues = outerProduct + (pointC * Order + pointB) * Order;
+                    Real *cbRow = stencil + pointC * strideC + pointB * strideB;
+#pragma omp simd
+                    for (int pointA = 0; pointA < Order; ++pointA) cbRow[pointA] += cbValues[pointA];
+                }
+            }
+        } else {
+            for (int pointC = 0; pointC < splineOrder_; ++pointC) {
+                Real cValP = parameter * splineValsC[pointC];
+                for (int pointB = 0; pointB < splineOrder_; ++pointB) {
+                    Real cbValP = cValP * splineValsB[pointB];
+                    Real *cbRow = stencil + pointC * strideC + pointB * strideB;
+#pragma omp simd
+                    for (int pointA = 0; pointA < splineOrder_; ++pointA)
+                        cbRow[pointA] += cbValP * splineValsA[pointA];
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Spreads a single atom's scalar parameter onto the bricked ghost grid.
+     * \param ghostGrid pointer to the bricked ghost grid.
+     * \param splineA the BSpline object for the A direction.
+     * \param splineB the BSpline object for the B direction.
+     * \param splineC the BSpline object for the C direction.
+     * \param parameter the parameter associated with the given atom.
+     * \tparam Order the spline order, allowing the stencil loops to be unrolled, or zero for the generic version.
+     */
+    template <int Order>
+    void spreadScalarParameterBrickedImpl(Real *ghostGrid, const Spline &splineA, const Spline &splineB,
+                                          const Spline &splineC, const Real &parameter) const {
+        const size_t *rowOffsetsB = brickedRowOffsetB_.data() + ghostStartB_[splineB.startingGridPoint()];
+        const size_t *rowOffsetsC = brickedRowOffsetC_.data() + ghostStartC_[splineC.startingGridPoint()];
+        Real *stencilA = ghostGrid + ghostStartA_[splineA.startingGridPoint()];
+        const Real *splineValsA = splineA[0];
+        const Real *splineValsB = splineB[0];
+        const Real *splineValsC = splineC[0];
+        if (Order) {
+            // As for the linear layout, the outer product is built first, leaving a stream of row additions.
+            Real outerProduct[Order ? Order * Order * Order : 1];
+            for (int pointC = 0; pointC < Order; ++pointC) {
+                for (int pointB = 0; pointB < Order; ++pointB) {
+                    Real cbValP = parameter * splineValsC[pointC] * splineValsB[pointB];
+                    Real *cbValues = outerProduct + (pointC * Order + pointB) * Order;
+                    for (int pointA = 0; pointA < Order; ++pointA) cbValues[pointA] = cbValP * splineValsA[pointA];
+                }
+            }
+            for (int pointC = 0; pointC < Order; ++pointC) {
+                Real *cRows = stencilA + rowOffsetsC[pointC];
+                for (int pointB = 0; pointB < Order; ++pointB) {
+                    const Real *cbValues = outerProduct + (pointC * Order + pointB) * Order;
+                    Real *cbRow = cRows + rowOffsetsB[pointB];
+#pragma omp simd
+                    for (int pointA = 0; pointA < Order; ++pointA) cbRow[pointA] += cbValues[pointA];
+                }
+            }
+        } else {
+            for (int pointC = 0; pointC < splineOrder_; ++pointC) {
+                Real cValP = parameter * splineValsC[pointC];
+                Real *cRows = stencilA + rowOffsetsC[pointC];
+                for (int pointB = 0; pointB < splineOrder_; ++pointB) {
+                    Real cbValP = cValP * splineValsB[pointB];
+                    Real *cbRow = cRows + rowOffsetsB[pointB];
+#pragma omp simd
+                    for (int pointA = 0; pointA < splineOrder_; ++pointA)
+                        cbRow[pointA] += cbValP * splineValsA[pointA];
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Probes the grid and computes the force for a single atom, specialized for zero parameter angular momentum.
+     * \param potentialGrid pointer to the array containing the potential, in ZYX order.
+     * \param splineA the BSpline object for the A direction.
+     * \param splineB the BSpline object for the B direction.
+     * \param splineC the BSpline object for the C direction.
+     * \param parameter the list of parameter associated with the given atom.
+     * \param forces a 3 vector of the forces for this atom, ordered in memory as {Fx, Fy, Fz}.
+     * \param energy if not null, half of the parameter times the potential at this atom is added to it.
+     * \tparam Order the spline order, allowing the stencil loops to be unrolled, or zero for the generic version.
+     */
+    template <int Order>
+    void probeGridForceImpl(const Real *potentialGrid, const Spline &splineA, const Spline &splineB,
+                            const Spline &splineC, const Real &parameter, Real *forces, Real *energy) const {
+        const auto &aGridIterator = gridIteratorA_[splineA.startingGridPoint()];
+        const auto &bGridIterator = gridIteratorB_[splineB.startingGridPoint()];
+        const auto &cGridIterator = gridIteratorC_[splineC.startingGridPoint()];
+        // The specialized kernels need the full stencil to be on this node; partial stencils use the generic kernel.
+        if (Order &&
+            (aGridIterator.size() != Order || bGridIterator.size() != Order || cGridIterator.size() != Order)) {
+            probeGridForceImpl<0>(potentialGrid, splineA, splineB, splineC, parameter, forces, energy);
+            return;
+        }
+        const Real *splineStartA0 = splineA[0];
+        const Real *splineStartB0 = splineB[0];
+        const Real *splineStartC0 = splineC[0];
+        const Real *splineStartA1 = splineStartA0 + splineOrder_;
+        const Real *splineStartB1 = splineStartB0 + splineOrder_;
+        const Real *splineStartC1 = splineStartC0 + splineOrder_;
+        Real phi = 0, Ex = 0, Ey = 0, Ez = 0;
+        if (Order) {
+            // Each row of the stencil is contracted with the A splines and their derivatives as a vector operation.
+            // Rows that don't wrap are read in place; those that do are first gathered into spline index order.
+            const int aStart = contiguousStencilStartA_[splineA.startingGridPoint()];
+            const auto *iteratorDataA = aGridIterator.data();
+            Real wrappedRow[Order ? Order : 1];
+            for (int pointC = 0; pointC < Order; ++pointC) {
+                const auto &cPoint = cGridIterator[pointC];
+                const Real &splineC0 = splineStartC0[cPoint.second];
+                const Real &splineC1 = splineStartC1[cPoint.second];
+                for (int pointB = 0; pointB < Order; ++pointB) {
+                    const auto &bPoint = bGridIterator[pointB];
+                    const Real &splineB0 = splineStartB0[bPoint.second];
+                    const Real &splineB1 = splineStartB1[bPoint.second];
+                    const Real *cbRow = potentialGrid + cPoint.first * myDimA_ * myDimB_ + bPoint.first * myDimA_;
+                    const Real *rowValues = cbRow + aStart;
+                    if (aStart < 0) {
+                        for (int pointA = 0; pointA < Order; ++pointA)
+                            wrappedRow[iteratorDataA[pointA].second] = cbRow[iteratorDataA[pointA].first];
+                        rowValues = wrappedRow;
+                    }
+                    Real rowA0 = 0, rowA1 = 0;
+#pragma omp simd reduction(+ : rowA0, rowA1)
+                    for (int pointA = 0; pointA < Order; ++pointA) {
+                        rowA0 += rowValues[pointA] * splineStartA0[pointA];
+                        rowA1 += rowValues[pointA] * splineStartA1[pointA];
+                    }
+                    phi += rowA0 * splineB0 * splineC0;
+                    Ex += rowA1 * splineB0 * splineC0;
+                    Ey += rowA0 * splineB1 * splineC0;
+                    Ez += rowA0 * splineB0 * splineC1;
+                }
+            }
+        } else {
+            // We unpack the vector to raw pointers, as profiling shows that using range based for loops over vectors
+            // causes a signficant penalty in the innermost loop, primarily due to checking the loop stop condition.
+            const int numPointsA = static_cast<int>(aGridIterator.size());
+            const int numPointsB = static_cast<int>(bGridIterator.size());
+            const int numPointsC = static_cast<int>(cGridIterator.size());
+            const auto *iteratorDataA = aGridIterator.data();
+            const auto *iteratorDataB = bGridIterator.data();
+            const auto *iteratorDataC = cGridIterator.data();
             for (int pointC = 0; pointC < numPointsC; ++pointC) {
                 const auto &cPoint = iteratorDataC[pointC];
-                Real cValP = param * splineValsC[cPoint.second];
+                const Real &splineC0 = splineStartC0[cPoint.second];
+                const Real &splineC1 = splineStartC1[cPoint.second];
                 for (int pointB = 0; pointB < numPointsB; ++pointB) {
                     const auto &bPoint = iteratorDataB[pointB];
-                    Real cbValP = cValP * splineValsB[bPoint.second];
-                    Real *cbRow = realGrid + cPoint.first * myDimB_ * myDimA_ + bPoint.first * myDimA_;
+                    const Real &splineB0 = splineStartB0[bPoint.second];
+                    const Real &splineB1 = splineStartB1[bPoint.second];
+                    const Real *cbRow = potentialGrid + cPoint.first * myDimA_ * myDimB_ + bPoint.first * myDimA_;
                     for (int pointA = 0; pointA < numPointsA; ++pointA) {
                         const auto &aPoint = iteratorDataA[pointA];
-                        cbRow[aPoint.first] += cbValP * splineValsA[aPoint.second];
+                        const Real &splineA0 = splineStartA0[aPoint.second];
+                        const Real &splineA1 = splineStartA1[aPoint.second];
+                        const Real &gridVal = cbRow[aPoint.first];
+                        phi += gridVal * splineA0 * splineB0 * splineC0;
+                        Ey += gridVal * splineA0 * splineB1 * splineC0;
+                        Ez += gridVal * splineA0 * splineB0 * splineC1;
+                        Ex += gridVal * splineA1 * splineB0 * splineC0;
                     }
                 }
             }
         }
+
+        forces[0] -= parameter * (scaledRecVecs_[0][0] * Ex + scaledRecVecs_[0][1] * Ey + scaledRecVecs_[0][2] * Ez);
+        forces[1] -= parameter * (scaledRecVecs_[1][0] * Ex + scaledRecVecs_[1][1] * Ey + scaledRecVecs_[1][2] * Ez);
+        forces[2] -= parameter * (scaledRecVecs_[2][0] * Ex + scaledRecVecs_[2][1] * Ey + scaledRecVecs_[2][2] * Ez);
+        if (energy) *energy += parameter * phi / 2;
     }
 
     /*!
-     * \brief Probes the grid and computes the force for a single atom, specialized for zero parameter angular momentum.
-     * \param potentialGrid pointer to the array containing the potential, in ZYX order.
+     * \brief Probes the bricked potential grid and computes the force for a single atom with a scalar parameter.
+     * \param potentialGrid pointer to the bricked potential grid, as returned by brickPotentialGrid().
      * \param splineA the BSpline object for the A direction.
      * \param splineB the BSpline object for the B direction.
      * \param splineC the BSpline object for the C direction.
-     * \param parameter the list of parameter associated with the given atom.
+     * \param parameter the parameter associated with the given atom.
+     * \param forces a 3 vector of the forces for this atom, ordered in memory as {Fx, Fy, Fz}.
+     * \param energy if not null, half of the parameter times the potential at this atom is added to it.
+     * \tparam Order the spline order, allowing the stencil loops to be unrolled, or zero for the generic version.
+     */
+    template <int Order>
+    void probeGridForceBrickedImpl(const Real *potentialGrid, const Spline &splineA, const Spline &splineB,
+                                   const Spline &splineC, const Real &parameter, Real *forces, Real *energy) const {
+        const int order = Order ? Order : splineOrder_;
+        const size_t *rowOffsetsB = brickedRowOffsetB_.data() + ghostStartB_[splineB.startingGridPoint()];
+        const size_t *rowOffsetsC = brickedRowOffsetC_.data() + ghostStartC_[splineC.startingGridPoint()];
+        const Real *stencilA = potentialGrid + ghostStartA_[splineA.startingGridPoint()];
+        const Real *splineStartA0 = splineA[0];
+        const Real *splineStartB0 = splineB[0];
+        const Real *splineStartC0 = splineC[0];
+        const Real *splineStartA1 = splineStartA0 + splineOrder_;
+        const Real *splineStartB1 = splineStartB0 + splineOrder_;
+        const Real *splineStartC1 = splineStartC0 + splineOrder_;
+        Real phi = 0, Ex = 0, Ey = 0, Ez = 0;
+        for (int pointC = 0; pointC < order; ++pointC) {
+            const Real &splineC0 = splineStartC0[pointC];
+            const Real &splineC1 = splineStartC1[pointC];
+            const Real *cRows = stencilA + rowOffsetsC[pointC];
+            for (int pointB = 0; pointB < order; ++pointB) {
+                const Real &splineB0 = splineStartB0[pointB];
+                const Real &splineB1 = splineStartB1[pointB];
+                const Real *cbRow = cRows + rowOffsetsB[pointB];
+                // The ghost rows hold the wrapped images, so every row of the stencil is contiguous.
+                Real rowA0 = 0, rowA1 = 0;
+#pragma omp simd reduction(+ : rowA0, rowA1)
+                for (int pointA = 0; pointA < order; ++pointA) {
+                    rowA0 += cbRow[pointA] * splineStartA0[pointA];
+                    rowA1 += cbRow[pointA] * splineStartA1[pointA];
+                }
+                phi += rowA0 * splineB0 * splineC0;
+                Ex += rowA1 * splineB0 * splineC0;
+                Ey += rowA0 * splineB1 * splineC0;
+                Ez += rowA0 * splineB0 * splineC1;
+            }
+        }
+
+        forces[0] -= parameter * (scaledRecVecs_[0][0] * Ex + scaledRecVecs_[0][1] * Ey + scaledRecVecs_[0][2] * Ez);
+        forces[1] -= parameter * (scaledRecVecs_[1][0] * Ex + scaledRecVecs_[1][1] * Ey + scaledRecVecs_[1][2] * Ez);
+        forces[2] -= parameter * (scaledRecVecs_[2][0] * Ex + scaledRecVecs_[2][1] * Ey + scaledRecVecs_[2][2] * Ez);
+        if (energy) *energy += parameter * phi / 2;
+    }
+
+    /*!
+     * \brief Spreads several sets of scalar parameters for a single atom onto interleaved ghost grids at once.
+     * \param ghostGrids pointer to the interleaved ghost grids, with the parameter set index running fastest.
+     * \param nGrids the number of parameter sets, and therefore of interleaved grids.
+     * \param splineA the BSpline object for the A direction.
+     * \param splineB the BSpline object for the B direction.
+     * \param splineC the BSpline object for the C direction.
+     * \param parameters the nGrids parameters associated with the given atom.
+     */
+    void spreadScalarParametersMultiGridImpl(Real *ghostGrids, const int &nGrids, const Spline &splineA,
+                                             const Spline &splineB, const Spline &splineC,
+                                             const Real *parameters) const {
+        const size_t strideB = static_cast<size_t>(ghostDimA_) * nGrids;
+        const size_t strideC = ghostDimB_ * strideB;
+        Real *stencil = ghostGrids + ghostStartC_[splineC.startingGridPoint()] * strideC +
+                        ghostStartB_[splineB.startingGridPoint()] * strideB +
+                        ghostStartA_[splineA.startingGridPoint()] * nGrids;
+        const Real *splineValsA = splineA[0];
+        const Real *splineValsB = splineB[0];
+        const Real *splineValsC = splineC[0];
+        for (int pointC = 0; pointC < splineOrder_; ++pointC) {
+            for (int pointB = 0; pointB < splineOrder_; ++pointB) {
+                Real cbVal = splineValsC[pointC] * splineValsB[pointB];
+                Real *cbRow = stencil + pointC * strideC + pointB * strideB;
+                for (int pointA = 0; pointA < splineOrder_; ++pointA) {
+                    Real cbaVal = cbVal * splineValsA[pointA];
+                    Real *gridPoint = cbRow + pointA * nGrids;
+#pragma omp simd
+                    for (int grid = 0; grid < nGrids; ++grid) gridPoint[grid] += cbaVal * parameters[grid];
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Probes interleaved potential grids and computes the force for a single atom, summed over several sets of
+     *        scalar parameters.
+     * \param potentialGrids pointer to the interleaved potential grids, in ZYX order with the parameter set index
+     *        running fastest.
+     * \param nGrids the number of parameter sets, and therefore of interleaved grids.
+     * \param splineA the BSpline object for the A direction.
+     * \param splineB the BSpline object for the B direction.
+     * \param splineC the BSpline object for the C direction.
+     * \param parameters the nGrids parameters associated with the given atom.
      * \param forces a 3 vector of the forces for this atom, ordered in memory as {Fx, Fy, Fz}.
      */
-    void probeGridImpl(const Real *potentialGrid, const Spline &splineA, const Spline &splineB, const Spline &splineC,
-                       const Real &parameter, Real *forces) const {
+    void probeGridForceMultiGridImpl(const Real *potentialGrids, const int &nGrids, const Spline &splineA,
+                                     const Spline &splineB, const Spline &splineC, const Real *parameters,
+                                     Real *forces) const {
         const auto &aGridIterator = gridIteratorA_[splineA.startingGridPoint()];
         const auto &bGridIterator = gridIteratorB_[splineB.startingGridPoint()];
         const auto &cGridIterator = gridIteratorC_[splineC.startingGridPoint()];
-        // We unpack the vector to raw pointers, as profiling shows that using range based for loops over vectors
-        // causes a signficant penalty in the innermost loop, primarily due to checking the loop stop condition.
-        int numPointsA = static_cast<int>(aGridIterator.size());
-        int numPointsB = static_cast<int>(bGridIterator.size());
-        int numPointsC = static_cast<int>(cGridIterator.size());
-        const auto *iteratorDataA = aGridIterator.data();
-        const auto *iteratorDataB = bGridIterator.data();
-        const auto *iteratorDataC = cGridIterator.data();
         const Real *splineStartA0 = splineA[0];
         const Real *splineStartB0 = splineB[0];
         const Real *splineStartC0 = splineC[0];
@@ -2636,20 +5182,23 @@ class PMEInstance {
         const Real *splineStartB1 = splineStartB0 + splineOrder_;
         const Real *splineStartC1 = splineStartC0 + splineOrder_;
         Real Ex = 0, Ey = 0, Ez = 0;
-        for (int pointC = 0; pointC < numPointsC; ++pointC) {
-            const auto &cPoint = iteratorDataC[pointC];
+        for (const auto &cPoint : cGridIterator) {
             const Real &splineC0 = splineStartC0[cPoint.second];
             const Real &splineC1 = splineStartC1[cPoint.second];
-            for (int pointB = 0; pointB < numPointsB; ++pointB) {
-                const auto &bPoint = iteratorDataB[pointB];
+            for (const auto &bPoint : bGridIterator) {
                 const Real &splineB0 = splineStartB0[bPoint.second];
                 const Real &splineB1 = splineStartB1[bPoint.second];
-                const Real *cbRow = potentialGrid + cPoint.first * myDimA_ * myDimB_ + bPoint.first * myDimA_;
-                for (int pointA = 0; pointA < numPointsA; ++pointA) {
-                    const auto &aPoint = iteratorDataA[pointA];
+                const Real *cbRow =
+                    potentialGrids + (static_cast<size_t>(cPoint.first) * myDimB_ + bPoint.first) * myDimA_ * nGrids;
+                for (const auto &aPoint : aGridIterator) {
                     const Real &splineA0 = splineStartA0[aPoint.second];
                     const Real &splineA1 = splineStartA1[aPoint.second];
-                    const Real &gridVal = cbRow[aPoint.first];
+                    // Contract the potentials of all parameter sets with this atom's parameters first, so that the
+                    // spline products below are only formed once per grid point.
+                    const Real *gridPoint = cbRow + aPoint.first * nGrids;
+                    Real gridVal = 0;
+#pragma omp simd reduction(+ : gridVal)
+                    for (int grid = 0; grid < nGrids; ++grid) gridVal += gridPoint[grid] * parameters[grid];
                     Ey += gridVal * splineA0 * splineB1 * splineC0;
                     Ez += gridVal * splineA0 * splineB0 * splineC1;
                     Ex += gridVal * splineA1 * splineB0 * splineC0;
@@ -2657,9 +5206,9 @@ class PMEInstance {
             }
         }
 
-        forces[0] -= parameter * (scaledRecVecs_[0][0] * Ex + scaledRecVecs_[0][1] * Ey + scaledRecVecs_[0][2] * Ez);
-        forces[1] -= parameter * (scaledRecVecs_[1][0] * Ex + scaledRecVecs_[1][1] * Ey + scaledRecVecs_[1][2] * Ez);
-        forces[2] -= parameter * (scaledRecVecs_[2][0] * Ex + scaledRecVecs_[2][1] * Ey + scaledRecVecs_[2][2] * Ez);
+        forces[0] -= scaledRecVecs_[0][0] * Ex + scaledRecVecs_[0][1] * Ey + scaledRecVecs_[0][2] * Ez;
+        forces[1] -= scaledRecVecs_[1][0] * Ex + scaledRecVecs_[1][1] * Ey + scaledRecVecs_[1][2] * Ez;
+        forces[2] -= scaledRecVecs_[2][0] * Ex + scaledRecVecs_[2][1] * Ey + scaledRecVecs_[2][2] * Ez;
     }
 
     /*!
@@ -2673,19 +5222,36 @@ class PMEInstance {
      * \param phiPtr a scratch array of length nPotentialComponents, to store the fractional potential.
      * N.B. Make sure that updateAngMomIterator() has been called first with the appropriate derivative
      * level for the requested potential derivatives.
+     * \tparam Order the spline order, allowing the stencil loops to be unrolled, or zero for the generic version.
      */
-    void probeGridImpl(const Real *potentialGrid, const int &nPotentialComponents, const Spline &splineA,
-                       const Spline &splineB, const Spline &splineC, Real *phiPtr) {
+    template <int Order>
+    void probeGridPotentialImpl(const Real *potentialGrid, const int &nPotentialComponents, const Spline &splineA,
+                                const Spline &splineB, const Spline &splineC, Real *phiPtr) const {
         const auto &aGridIterator = gridIteratorA_[splineA.startingGridPoint()];
         const auto &bGridIterator = gridIteratorB_[splineB.startingGridPoint()];
         const auto &cGridIterator = gridIteratorC_[splineC.startingGridPoint()];
+        // The specialized kernels need the full stencil to be on this node; partial stencils use the generic kernel.
+        if (Order &&
+            (aGridIterator.size() != Order || bGridIterator.size() != Order || cGridIterator.size() != Order)) {
+            probeGridPotentialImpl<0>(potentialGrid, nPotentialComponents, splineA, splineB, splineC, phiPtr);
+            return;
+        }
+        const int numPointsA = Order ? Order : static_cast<int>(aGridIterator.size());
+        const int numPointsB = Order ? Order : static_cast<int>(bGridIterator.size());
+        const int numPointsC = Order ? Order : static_cast<int>(cGridIterator.size());
+        const auto *iteratorDataA = aGridIterator.data();
+        const auto *iteratorDataB = bGridIterator.data();
+        const auto *iteratorDataC = cGridIterator.data();
         const Real *splineStartA = splineA[0];
         const Real *splineStartB = splineB[0];
         const Real *splineStartC = splineC[0];
-        for (const auto &cPoint : cGridIterator) {
-            for (const auto &bPoint : bGridIterator) {
+        for (int pointC = 0; pointC < numPointsC; ++pointC) {
+            const auto &cPoint = iteratorDataC[pointC];
+            for (int pointB = 0; pointB < numPointsB; ++pointB) {
+                const auto &bPoint = iteratorDataB[pointB];
                 const Real *cbRow = potentialGrid + cPoint.first * myDimA_ * myDimB_ + bPoint.first * myDimA_;
-                for (const auto &aPoint : aGridIterator) {
+                for (int pointA = 0; pointA < numPointsA; ++pointA) {
+                    const auto &aPoint = iteratorDataA[pointA];
                     Real gridVal = cbRow[aPoint.first];
                     for (int component = 0; component < nPotentialComponents; ++component) {
                         const auto &quanta = angMomIterator_[component];
@@ -2728,9 +5294,9 @@ class PMEInstance {
      */
     void probeGridImpl(const int &atom, const Real *potentialGrid, const int &nComponents, const int &nForceComponents,
                        const Spline &splineA, const Spline &splineB, const Spline &splineC, Real *phiPtr,
-                       const RealMat &parameters, Real *forces) {
+                       const RealMat &parameters, Real *forces) const {
         std::fill(phiPtr, phiPtr + nForceComponents, 0);
-        probeGridImpl(potentialGrid, nForceComponents, splineA, splineB, splineC, phiPtr);
+        probeGridPotentialFxn_(this, potentialGrid, nForceComponents, splineA, splineB, splineC, phiPtr);
 
         Real fracForce[3] = {0, 0, 0};
         for (int component = 0; component < nComponents; ++component) {
@@ -2752,43 +5318,67 @@ class PMEInstance {
     }
 
     /*!
-     * \brief assertInitialized makes sure that setup() has been called before running any calculations.
+     * \brief assertInitialized makes sure that setup() has been called before running any calculations.
+     */
+    void assertInitialized() const {
+        if (!rPower_)
+            throw std::runtime_error(
+                "Either setup(...) or setup_parallel(...) must be called before computing anything.");
+    }
+
+    /*!
+     * \brief locatePoint converts a point's Cartesian coordinates to fractional coordinates, and finds the grid point
+     *        from which interpolation starts in each direction.
+     * \param pointCoords a 3-vector containing the point's coordinates.
+     * \param fractionalCoords the {A,B,C} fractional coordinates, in the range [0,1).
+     * \param startingGridPoints the {A,B,C} grid points at which interpolation starts.
+     */
+    void locatePoint(const Real *pointCoords, Real *fractionalCoords, short *startingGridPoints) const {
+        // Subtract a tiny amount to make sure we're not exactly on the rightmost (excluded)
+        // grid point. The calculation is translationally invariant, so this is valid.
+        constexpr float EPS = 1e-6f;
+        const int dims[3] = {dimA_, dimB_, dimC_};
+        for (int dim = 0; dim < 3; ++dim) {
+            Real coord = pointCoords[0] * recVecs_(0, dim) + pointCoords[1] * recVecs_(1, dim) +
+                         pointCoords[2] * recVecs_(2, dim) - EPS;
+            // Make sure the fractional coordinates fall in the range 0 <= s < 1
+            coord -= floor(coord);
+            fractionalCoords[dim] = coord;
+            startingGridPoints[dim] = dims[dim] * coord;
+        }
+    }
+
+    /*!
+     * \brief fractionalGridPosition finds the grid point from which interpolation starts in each direction, and the
+     *        fractional distance from it, for a given point in space.
+     * \param atomCoords a 3-vector containing the point's coordinates.
+     * \param startingGridPoints the {A,B,C} grid points at which interpolation starts.
+     * \param distances the {A,B,C} distances (in fractional grid units) from the starting grid points.
      */
-    void assertInitialized() const {
-        if (!rPower_)
-            throw std::runtime_error(
-                "Either setup(...) or setup_parallel(...) must be called before computing anything.");
+    void fractionalGridPosition(const Real *atomCoords, short *startingGridPoints, Real *distances) const {
+        Real fractionalCoords[3];
+        locatePoint(atomCoords, fractionalCoords, startingGridPoints);
+        distances[0] = dimA_ * fractionalCoords[0] - startingGridPoints[0];
+        distances[1] = dimB_ * fractionalCoords[1] - startingGridPoints[1];
+        distances[2] = dimC_ * fractionalCoords[2] - startingGridPoints[2];
     }
 
     /*!
      * \brief makeBSplines construct the {x,y,z} B-Splines.
      * \param atomCoords a 3-vector containing the atom's coordinates.
      * \param derivativeLevel level of derivative needed for the splines.
+     * \tparam SplineType the B-spline class to construct; FixedSpline avoids any heap allocations, but is limited to
+     *         orders up to MaxFixedSplineOrder, while BSpline can handle any order.
      * \return a 3-tuple containing the {x,y,z} B-splines.
      */
-    std::tuple<Spline, Spline, Spline> makeBSplines(const Real *atomCoords, short derivativeLevel) const {
-        // Subtract a tiny amount to make sure we're not exactly on the rightmost (excluded)
-        // grid point. The calculation is translationally invariant, so this is valid.
-        constexpr float EPS = 1e-6f;
-        Real aCoord =
-            atomCoords[0] * recVecs_(0, 0) + atomCoords[1] * recVecs_(1, 0) + atomCoords[2] * recVecs_(2, 0) - EPS;
-        Real bCoord =
-            atomCoords[0] * recVecs_(0, 1) + atomCoords[1] * recVecs_(1, 1) + atomCoords[2] * recVecs_(2, 1) - EPS;
-        Real cCoord =
-            atomCoords[0] * recVecs_(0, 2) + atomCoords[1] * recVecs_(1, 2) + atomCoords[2] * recVecs_(2, 2) - EPS;
-        // Make sure the fractional coordinates fall in the range 0 <= s < 1
-        aCoord -= floor(aCoord);
-        bCoord -= floor(bCoord);
-        cCoord -= floor(cCoord);
-        short aStartingGridPoint = dimA_ * aCoord;
-        short bStartingGridPoint = dimB_ * bCoord;
-        short cStartingGridPoint = dimC_ * cCoord;
-        Real aDistanceFromGridPoint = dimA_ * aCoord - aStartingGridPoint;
-        Real bDistanceFromGridPoint = dimB_ * bCoord - bStartingGridPoint;
-        Real cDistanceFromGridPoint = dimC_ * cCoord - cStartingGridPoint;
-        return std::make_tuple(Spline(aStartingGridPoint, aDistanceFromGridPoint, splineOrder_, derivativeLevel),
-                               Spline(bStartingGridPoint, bDistanceFromGridPoint, splineOrder_, derivativeLevel),
-                               Spline(cStartingGridPoint, cDistanceFromGridPoint, splineOrder_, derivativeLevel));
+    template <typename SplineType = FixedSpline>
+    std::tuple<SplineType, SplineType, SplineType> makeBSplines(const Real *atomCoords, short derivativeLevel) const {
+        short startingGridPoints[3];
+        Real distances[3];
+        fractionalGridPosition(atomCoords, startingGridPoints, distances);
+        return std::make_tuple(SplineType(startingGridPoints[0], distances[0], splineOrder_, derivativeLevel),
+                               SplineType(startingGridPoints[1], distances[1], splineOrder_, derivativeLevel),
+                               SplineType(startingGridPoints[2], distances[2], splineOrder_, derivativeLevel));
     }
 
     /*!
@@ -2798,8 +5388,10 @@ class PMEInstance {
      * quadrupoles, etc.).
      * \param parameters the input parameters.
      * \param coordinates the input coordinates.
+     * \param nParameterSets the number of sets of parameters stored side by side in the parameters matrix.
      */
-    void sanityChecks(int parameterAngMom, const RealMat &parameters, const RealMat &coordinates) {
+    void sanityChecks(int parameterAngMom, const RealMat &parameters, const RealMat &coordinates,
+                      int nParameterSets = 1) {
         assertInitialized();
 
         if (parameters.nRows() == 0)
@@ -2813,11 +5405,21 @@ class PMEInstance {
         if (coordinates.nRows() != parameters.nRows())
             throw std::runtime_error(
                 "Inconsistent number of coordinates and parameters; there should be nAtoms of each.");
-        if (parameters.nCols() != nCartesian(parameterAngMom))
+        if (parameters.nCols() != static_cast<size_t>(nParameterSets * nCartesian(parameterAngMom)))
             throw std::runtime_error(
                 "Mismatch in the number of parameters provided and the parameter angular momentum");
     }
 
+    /*!
+     * \brief mValue maps a grid index to its wavevector index m, where -1/2 <= m/dim < 1/2.  This is cheap enough
+     *        to evaluate on the fly, which saves the convolution kernels from allocating lookup tables.
+     * \param k the index of the grid point, relative to the first point handled by this node.
+     * \param start the first grid point handled by this node.
+     * \param dim the grid dimension.
+     * \return the wavevector index.
+     */
+    static Real mValue(int k, int start, int dim) { return k + start >= (dim + 1) / 2 ? k + start - dim : k + start; }
+
     /*!
      * \brief convolveEVImpl performs the reciprocal space convolution, returning the energy.  We opt to not cache
      *        this the same way as the non-virial version because it's safe to assume that if the virial is requested
@@ -2861,21 +5463,12 @@ class PMEInstance {
         // Ensure the m=0 term convolution product is zeroed for the backtransform; it's been accounted for above.
         if (nodeZero) gridPtr[0] = Complex(0, 0);
 
-        std::vector<Real> xMVals(myNx), yMVals(myNy), zMVals(nz);
-        // Iterators to conveniently map {X,Y,Z} grid location to m_{X,Y,Z} value, where -1/2 << m/dim < 1/2.
-        for (int kx = 0; kx < myNx; ++kx) xMVals[kx] = startX + (kx + startX >= (nx + 1) / 2 ? kx - nx : kx);
-        for (int ky = 0; ky < myNy; ++ky) yMVals[ky] = startY + (ky + startY >= (ny + 1) / 2 ? ky - ny : ky);
-        for (int kz = 0; kz < nz; ++kz) zMVals[kz] = kz >= (nz + 1) / 2 ? kz - nz : kz;
-
         Real bPrefac = M_PI * M_PI / (kappa * kappa);
         Real volPrefac = scaleFactor * pow(M_PI, rPower - 1) / (sqrtPi * gammaComputer<Real, rPower>::value * volume);
         int halfNx = nx / 2 + 1;
         size_t nxz = myNx * nz;
         Real Vxx = 0, Vxy = 0, Vyy = 0, Vxz = 0, Vyz = 0, Vzz = 0;
         const Real *boxPtr = boxInv[0];
-        const Real *xMPtr = xMVals.data();
-        const Real *yMPtr = yMVals.data();
-        const Real *zMPtr = zMVals.data();
         size_t nyxz = myNy * nxz;
         // Exclude m=0 cell.
         int start = (nodeZero ? 1 : 0);
@@ -2889,9 +5482,9 @@ class PMEInstance {
             // We only loop over the first nx/2+1 x values; this
             // accounts for the "missing" complex conjugate values.
             Real permPrefac = kx + startX != 0 && kx + startX != halfNx - 1 ? 2 : 1;
-            const Real &mx = xMPtr[kx];
-            const Real &my = yMPtr[ky];
-            const Real &mz = zMPtr[kz];
+            Real mx = mValue(kx, startX, nx);
+            Real my = mValue(ky, startY, ny);
+            Real mz = mValue(kz, 0, nz);
             Real mVecX = boxPtr[0] * mx + boxPtr[1] * my + boxPtr[2] * mz;
             Real mVecY = boxPtr[3] * mx + boxPtr[4] * my + boxPtr[5] * mz;
             Real mVecZ = boxPtr[6] * mx + boxPtr[7] * my + boxPtr[8] * mz;
@@ -2928,6 +5521,83 @@ class PMEInstance {
 
         return energy;
     }
+    /*!
+     * \brief virialKernelGridsImpl multiplies the structure factor by each of the six kernels whose back transforms,
+     *        probed at an atom and multiplied by half of its parameter, give that atom's contribution to the virial.
+     *        For each wavevector m the kernel for component ij is G(m) delta_ij - 2 dG(m)/d(m^2) m_i m_j, where G is
+     *        the influence function, so that the per-atom contributions sum to the virial from convolveEVImpl.
+     * \tparam rPower the exponent of the (inverse) distance kernel (e.g. 1 for Coulomb, 6 for attractive dispersion).
+     * \param nx the grid dimension in the x direction.
+     * \param ny the grid dimension in the y direction.
+     * \param nz the grid dimension in the z direction.
+     * \param myNx the subset of the grid in the x direction to be handled by this node.
+     * \param myNy the subset of the grid in the y direction to be handled by this node.
+     * \param startX the starting grid point handled by this node in the X direction.
+     * \param startY the starting grid point handled by this node in the Y direction.
+     * \param scaleFactor a scale factor to be applied to all computed energies and derivatives thereof (e.g. the
+     *        1 / [4 pi epslion0] for Coulomb calculations).
+     * \param gridPtr the Fourier space grid, with ordering YXZ, before convolution.
+     * \param kernelGrids the six output grids, stored one after the other, each with the same layout as gridPtr.
+     * \param boxInv the reciprocal lattice vectors.
+     * \param volume the volume of the unit cell.
+     * \param kappa the attenuation parameter in units inverse of those used to specify coordinates.
+     * \param xMods the Fourier space norms of the x B-Splines.
+     * \param yMods the Fourier space norms of the y B-Splines.
+     * \param zMods the Fourier space norms of the z B-Splines.
+     * \param nThreads the number of OpenMP threads to use.
+     */
+    template <int rPower>
+    static void virialKernelGridsImpl(int nx, int ny, int nz, int myNx, int myNy, int startX, int startY,
+                                      Real scaleFactor, const Complex *gridPtr, Complex *kernelGrids,
+                                      const RealMat &boxInv, Real volume, Real kappa, const Real *xMods,
+                                      const Real *yMods, const Real *zMods, int nThreads) {
+        Real bPrefac = M_PI * M_PI / (kappa * kappa);
+        Real volPrefac = scaleFactor * pow(M_PI, rPower - 1) / (sqrtPi * gammaComputer<Real, rPower>::value * volume);
+        size_t nxz = myNx * nz;
+        size_t nyxz = myNy * nxz;
+        const Real *boxPtr = boxInv[0];
+
+        bool nodeZero = startX == 0 && startY == 0;
+        int start = (nodeZero ? 1 : 0);
+        if (nodeZero) {
+            // The m=0 term only contributes to the diagonal, and is only present for rPower>3 kernels.
+            Real prefac = rPower > 3 ? 2 * scaleFactor * M_PI * sqrtPi * pow(kappa, rPower - 3) /
+                                           ((rPower - 3) * gammaComputer<Real, rPower>::value * volume)
+                                     : 0;
+            for (int component = 0; component < 6; ++component) {
+                bool diagonal = component == 0 || component == 2 || component == 5;
+                kernelGrids[component * nyxz] = diagonal ? prefac * gridPtr[0] : Complex(0, 0);
+            }
+        }
+#pragma omp parallel for num_threads(nThreads)
+        for (size_t yxz = start; yxz < nyxz; ++yxz) {
+            size_t xz = yxz % nxz;
+            short ky = yxz / nxz;
+            short kx = xz / nz;
+            short kz = xz % nz;
+            Real mx = mValue(kx, startX, nx);
+            Real my = mValue(ky, startY, ny);
+            Real mz = mValue(kz, 0, nz);
+            Real mVecX = boxPtr[0] * mx + boxPtr[1] * my + boxPtr[2] * mz;
+            Real mVecY = boxPtr[3] * mx + boxPtr[4] * my + boxPtr[5] * mz;
+            Real mVecZ = boxPtr[6] * mx + boxPtr[7] * my + boxPtr[8] * mz;
+            Real mNormSq = mVecX * mVecX + mVecY * mVecY + mVecZ * mVecZ;
+            Real mTerm = raiseNormToIntegerPower<Real, rPower - 3>::compute(mNormSq);
+            Real bSquared = bPrefac * mNormSq;
+            auto gammas = incompleteGammaVirialComputer<Real, 3 - rPower>::compute(bSquared);
+            Real totalPrefac = volPrefac * mTerm * yMods[ky + startY] * xMods[kx + startX] * zMods[kz];
+            Real influenceFunction = totalPrefac * std::get<0>(gammas);
+            Real vPrefac = -2 * std::get<1>(gammas) * totalPrefac / mNormSq;
+            const Complex &gridVal = gridPtr[yxz];
+            kernelGrids[0 * nyxz + yxz] = (influenceFunction + vPrefac * mVecX * mVecX) * gridVal;
+            kernelGrids[1 * nyxz + yxz] = (vPrefac * mVecX * mVecY) * gridVal;
+            kernelGrids[2 * nyxz + yxz] = (influenceFunction + vPrefac * mVecY * mVecY) * gridVal;
+            kernelGrids[3 * nyxz + yxz] = (vPrefac * mVecX * mVecZ) * gridVal;
+            kernelGrids[4 * nyxz + yxz] = (vPrefac * mVecY * mVecZ) * gridVal;
+            kernelGrids[5 * nyxz + yxz] = (influenceFunction + vPrefac * mVecZ * mVecZ) * gridVal;
+        }
+    }
+
     /*!
      * \brief cacheInfluenceFunctionImpl computes the influence function used in convolution, for later use.
      * \tparam rPower the exponent of the (inverse) distance kernel (e.g. 1 for Coulomb, 6 for attractive dispersion).
@@ -2963,12 +5633,6 @@ class PMEInstance {
         Real *gridPtr = influenceFunction.data();
         if (nodeZero) gridPtr[0] = 0;
 
-        std::vector<Real> xMVals(myNx), yMVals(myNy), zMVals(nz);
-        // Iterators to conveniently map {X,Y,Z} grid location to m_{X,Y,Z} value, where -1/2 << m/dim < 1/2.
-        for (int kx = 0; kx < myNx; ++kx) xMVals[kx] = startX + (kx + startX >= (nx + 1) / 2 ? kx - nx : kx);
-        for (int ky = 0; ky < myNy; ++ky) yMVals[ky] = startY + (ky + startY >= (ny + 1) / 2 ? ky - ny : ky);
-        for (int kz = 0; kz < nz; ++kz) zMVals[kz] = kz >= (nz + 1) / 2 ? kz - nz : kz;
-
         Real bPrefac = M_PI * M_PI / (kappa * kappa);
         Real volPrefac = scaleFactor * pow(M_PI, rPower - 1) / (sqrtPi * gammaComputer<Real, rPower>::value * volume);
         const Real *boxPtr = boxInv[0];
@@ -2981,9 +5645,9 @@ class PMEInstance {
             short ky = yxz / nxz;
             short kx = xz / nz;
             short kz = xz % nz;
-            Real mx = (Real)xMVals[kx];
-            Real my = (Real)yMVals[ky];
-            Real mz = (Real)zMVals[kz];
+            Real mx = mValue(kx, startX, nx);
+            Real my = mValue(ky, startY, ny);
+            Real mz = mValue(kz, 0, nz);
             Real mVecX = boxPtr[0] * mx + boxPtr[1] * my + boxPtr[2] * mz;
             Real mVecY = boxPtr[3] * mx + boxPtr[4] * my + boxPtr[5] * mz;
             Real mVecZ = boxPtr[6] * mx + boxPtr[7] * my + boxPtr[8] * mz;
@@ -3110,14 +5774,15 @@ class PMEInstance {
      * \brief common_init sets up information that is common to serial and parallel runs.
      */
     void common_init(int rPower, Real kappa, int splineOrder, int dimA, int dimB, int dimC, Real scaleFactor,
-                     int nThreads) {
+                     int nThreads, FFTPlanningRigor planningRigor) {
         kappaHasChanged_ = kappa != kappa_;
         rPowerHasChanged_ = rPower_ != rPower;
         gridDimensionHasChanged_ = dimA_ != dimA || dimB_ != dimB || dimC_ != dimC;
         splineOrderHasChanged_ = splineOrder_ != splineOrder;
         scaleFactorHasChanged_ = scaleFactor_ != scaleFactor;
         if (kappaHasChanged_ || rPowerHasChanged_ || gridDimensionHasChanged_ || splineOrderHasChanged_ ||
-            scaleFactorHasChanged_ || requestedNumberOfThreads_ != nThreads) {
+            scaleFactorHasChanged_ || requestedNumberOfThreads_ != nThreads || planningRigor_ != planningRigor ||
+            numNodesHasChanged_) {
             rPower_ = rPower;
 
             dimA_ = dimA;
@@ -3127,6 +5792,7 @@ class PMEInstance {
             myComplexDimA_ = myDimA_ / 2 + 1;
             splineOrder_ = splineOrder;
             requestedNumberOfThreads_ = nThreads;
+            planningRigor_ = planningRigor;
 #ifdef _OPENMP
             nThreads_ = nThreads ? nThreads : omp_get_max_threads();
 #else
@@ -3136,18 +5802,20 @@ class PMEInstance {
             kappa_ = kappa;
             cacheLineSizeInReals_ = static_cast<Real>(sysconf(_SC_PAGESIZE) / sizeof(Real));
 
-            // Helpers to perform 1D FFTs along each dimension.
-            fftHelperA_ = FFTWWrapper<Real>(dimA_);
-            fftHelperB_ = FFTWWrapper<Real>(dimB_);
-            fftHelperC_ = FFTWWrapper<Real>(dimC_);
-
             // Grid iterators to correctly wrap the grid when using splines.
             gridIteratorA_ = makeGridIterator(dimA_, firstA_, lastA_);
             gridIteratorB_ = makeGridIterator(dimB_, firstB_, lastB_);
             gridIteratorC_ = makeGridIterator(dimC_, firstC_, lastC_);
+            contiguousStencilStartA_.resize(dimA_);
+            for (int start = 0; start < dimA_; ++start) {
+                const auto &iterator = gridIteratorA_[start];
+                bool contiguous = iterator.size() == static_cast<size_t>(splineOrder_) &&
+                                  iterator.back().first - iterator.front().first == splineOrder_ - 1;
+                contiguousStencilStartA_[start] = contiguous ? iterator.front().first : -1;
+            }
 
             // Fourier space spline norms.
-            Spline spline = Spline(0, 0, splineOrder_, 0);
+            BSpline<Real> spline(0, 0, splineOrder_, 0);
             splineModA_ = spline.invSplineModuli(dimA_);
             splineModB_ = spline.invSplineModuli(dimB_);
             splineModC_ = spline.invSplineModuli(dimC_);
@@ -3167,13 +5835,117 @@ class PMEInstance {
                     break;
             }
 
+            // Set up function pointers to the spreading and probing kernels.  The stencil loops are unrolled for the
+            // most commonly used spline orders, listed below, while all other orders use the generic kernels.
+            switch (splineOrder) {
+                ENABLE_KERNEL_WITH_SPLINE_ORDER_OF(4);
+                ENABLE_KERNEL_WITH_SPLINE_ORDER_OF(5);
+                ENABLE_KERNEL_WITH_SPLINE_ORDER_OF(6);
+                default:
+                    spreadParametersFxn_ = &PMEInstance::spreadParametersImpl<0>;
+                    spreadScalarParameterFxn_ = &PMEInstance::spreadScalarParameterImpl<0>;
+                    spreadScalarParameterBrickedFxn_ = &PMEInstance::spreadScalarParameterBrickedImpl<0>;
+                    probeGridPotentialFxn_ = &PMEInstance::probeGridPotentialImpl<0>;
+                    probeGridForceFxn_ = &PMEInstance::probeGridForceImpl<0>;
+                    probeGridForceBrickedFxn_ = &PMEInstance::probeGridForceBrickedImpl<0>;
+                    break;
+            }
+
+            // The padded grid that parameters are spread onto, before folding onto the periodic grid.
+            makeGhostLayerMaps(dimA_, firstA_, lastA_, ghostDimA_, ghostStartA_, ghostFoldA_);
+            makeGhostLayerMaps(dimB_, firstB_, lastB_, ghostDimB_, ghostStartB_, ghostFoldB_);
+            makeGhostLayerMaps(dimC_, firstC_, lastC_, ghostDimC_, ghostStartC_, ghostFoldC_);
+            // The ghost grid is shared by the linear and bricked layouts, so make it large enough for either.
+            numBricksB_ = (ghostDimB_ + BrickDim - 1) / BrickDim;
+            numBricksC_ = (ghostDimC_ + BrickDim - 1) / BrickDim;
+            ghostGrid_ = RealVec(static_cast<size_t>(numBricksB_) * numBricksC_ * BrickDim * BrickDim * ghostDimA_);
+            makeBrickedRowOffsets();
+            brickedPotentialGrid_ = useBrickedGrids_ ? RealVec(ghostGrid_.size()) : RealVec();
+            incrementalStateValid_ = false;
+            acceptedChargeGrid_.clear();
+            ghostRowOccupied_.assign(static_cast<size_t>(ghostDimC_) * ghostDimB_, 1);
+            ghostRowStarts_.assign(static_cast<size_t>(ghostDimC_) * ghostDimB_, 0);
+            localRowOccupied_.assign(static_cast<size_t>(myDimC_) * myDimB_, 1);
+            localPlaneOccupied_.assign(myDimC_, 1);
+
+            numSpreadBucketsB_ = numSpreadBuckets(ghostDimB_);
+            numSpreadBucketsC_ = numSpreadBuckets(ghostDimC_);
+
             subsetOfCAlongA_ = myDimC_ / numNodesA_;
             subsetOfCAlongB_ = myDimC_ / numNodesB_;
             subsetOfBAlongC_ = myDimB_ / numNodesC_;
 
             workSpace1_ = helpme::vector<Complex>(myDimC_ * myComplexDimA_ * myDimB_);
             workSpace2_ = helpme::vector<Complex>(myDimC_ * myComplexDimA_ * myDimB_);
+            virialKernelGrids_ = helpme::vector<Complex>(6 * static_cast<size_t>(myDimC_) * myComplexDimA_ * myDimB_);
+
+            transformedRowsA_ = helpme::vector<Complex>(static_cast<size_t>(subsetOfCAlongA_) * myDimB_ * complexDimA_);
+
+            // Scratch for building and probing splines, sized for the highest derivative level the spline order allows.
+            // Each thread's potential derivatives are padded to a multiple of the page size, so that the threads never
+            // share a page.
+            int maxDerivativeLevel = std::max(splineOrder_ - 2, 0);
+            size_t phiRowSize =
+                std::ceil(nCartesian(maxDerivativeLevel) / cacheLineSizeInReals_) * cacheLineSizeInReals_;
+            fractionalPhis_ = RealMat(nThreads_, phiRowSize);
+            threadSplineBlocks_ = std::vector<BSplineBlock<Real>>(3 * nThreads_);
+            for (auto &splineBlock : threadSplineBlocks_)
+                splineBlock.reserve(PointBlockSize, splineOrder_, maxDerivativeLevel);
+
+            planFFTs();
+        }
+    }
+
+    /*!
+     * \brief planFFTs makes the FFT plans for the current grid, node and thread layout with the selected backend.
+     */
+    void planFFTs() {
+        std::unique_ptr<FFTPlanner<Real>> planner;
+        switch (fftBackend_) {
+            case FFTBackend::FFTW: {
+#if HAVE_FFTW == 1
+                unsigned fftFlags = planningRigor_ == FFTPlanningRigor::Patient
+                                        ? FFTW_PATIENT
+                                        : planningRigor_ == FFTPlanningRigor::Measure ? FFTW_MEASURE : FFTW_ESTIMATE;
+                planner.reset(new FFTWPlanner<Real>(fftFlags));
+                break;
+#else
+                throw std::runtime_error("The FFTW FFT backend requires helpme to be built with HAVE_FFTW=1.");
+#endif
+            }
+            case FFTBackend::MKL:
+#if HAVE_MKL == 1
+                planner.reset(new MKLPlanner<Real>());
+                break;
+#else
+                throw std::runtime_error("The MKL FFT backend requires helpme to be built with HAVE_MKL=1.");
+#endif
+            case FFTBackend::Bundled:
+                planner.reset(new BundledFFTPlanner<Real>());
+                break;
+            default:
+                throw std::runtime_error("Unknown FFT backend requested.");
         }
+
+        // Plans to perform single 1D FFTs along the A and B dimensions.
+        fftLineA_ = planner->makeBatchPlan(dimA_, 1, dimA_, complexDimA_, true);
+        fftLineB_ = planner->makeBatchPlan(dimB_, 1, dimB_, dimB_, false);
+
+        // Batched plans, which transform every line of a dimension in the local block, one chunk per thread.
+        size_t nRowsA = static_cast<size_t>(subsetOfCAlongA_) * myDimB_;
+        size_t nLinesB = static_cast<size_t>(subsetOfCAlongB_) * myComplexDimA_;
+        size_t nLinesC = static_cast<size_t>(subsetOfBAlongC_) * myComplexDimA_;
+        fftBatchA_ = ThreadedFFTBatch<Real>(*planner, dimA_, nRowsA, dimA_, complexDimA_, true, nThreads_);
+        fftBatchB_ = ThreadedFFTBatch<Real>(*planner, dimB_, nLinesB, dimB_, dimB_, false, nThreads_);
+        fftBatchC_ = ThreadedFFTBatch<Real>(*planner, dimC_, nLinesC, dimC_, dimC_, false, nThreads_);
+
+        // With all of the grid on one node, a native 3D transform replaces the three line passes and the sorts
+        // between them, leaving a single sort to and from the BAC order used by the convolution.  The library shares
+        // that transform among the threads itself; the line passes are kept for backends that have no native 3D
+        // transform, or that can't thread it.
+        fft3D_.reset();
+        if (numNodesA_ * numNodesB_ * numNodesC_ == 1) fft3D_ = planner->makeGridPlan(dimA_, dimB_, dimC_, nThreads_);
+        useNative3DFFT_ = static_cast<bool>(fft3D_);
     }
 
    public:
@@ -3183,6 +5955,12 @@ class PMEInstance {
           dimC_(0),
           splineOrder_(0),
           requestedNumberOfThreads_(-1),
+          planningRigor_(FFTPlanningRigor::Estimate),
+#if HAVE_FFTW == 1
+          fftBackend_(FFTBackend::FFTW),
+#else
+          fftBackend_(FFTBackend::Bundled),
+#endif
           rPower_(0),
           scaleFactor_(0),
           kappa_(0),
@@ -3197,7 +5975,12 @@ class PMEInstance {
           cellC_(0),
           cellAlpha_(0),
           cellBeta_(0),
-          cellGamma_(0) {}
+          cellGamma_(0),
+          useNative3DFFT_(false),
+          incrementalUpdates_(false),
+          incrementalStateValid_(false),
+          useBrickedGrids_(false),
+          sortAtomsSpatially_(false) {}
 
     /*!
      * \brief cellVolume Compute the volume of the unit cell.
@@ -3249,7 +6032,6 @@ class PMEInstance {
                         }
                     }
                 }
-                recVecs_ = boxVecs_.inverse();
             } else if (latticeType == LatticeType::XAligned) {
                 boxVecs_(0, 0) = A;
                 boxVecs_(0, 1) = 0;
@@ -3263,8 +6045,8 @@ class PMEInstance {
             } else {
                 throw std::runtime_error("Unknown lattice type in setLatticeVectors");
             }
-            recVecs_ = boxVecs_.inverse();
-            scaledRecVecs_ = recVecs_.clone();
+            boxVecs_.inverse(recVecs_);
+            std::copy(recVecs_.cbegin(), recVecs_.cend(), scaledRecVecs_.begin());
             scaledRecVecs_.row(0) *= dimA_;
             scaledRecVecs_.row(1) *= dimB_;
             scaledRecVecs_.row(2) *= dimC_;
@@ -3281,13 +6063,84 @@ class PMEInstance {
         }
     }
 
+    /*!
+     * \brief Controls whether atoms are processed in order of their position on the grid, rather than the order in
+     *        which they are provided.  Spreading and probing then walk the grid in a cache friendly way, which helps
+     *        for large systems with poorly ordered coordinates.  The ordering is reused from one call to the next as
+     *        long as atoms have not moved enough to disorder it significantly.  Results agree with the unsorted
+     *        calculation to within round-off error.  Sorting is disabled by default.
+     * \param sortAtoms whether to sort the atoms spatially.
+     */
+    void setSpatialSorting(bool sortAtoms) {
+        sortAtomsSpatially_ = sortAtoms;
+        if (!sortAtoms) spatialAtomOrder_.clear();
+    }
+
+    /*!
+     * \brief setBrickedGrids controls whether scalar parameters (charges, C6 coefficients, etc.) are spread onto, and
+     *        forces are probed from, grids stored as bricks of 8x8 full-length A rows, rather than plane by plane.
+     *        Each stencil then spans a few compact blocks of memory, which can reduce cache and TLB misses on large
+     *        grids.  The conversion to the linear layout used by the FFTs happens in the pass that folds the ghost
+     *        grid onto the periodic grid.  The potential from inverseTransform() is copied back into the bricked
+     *        layout before probing; the native 3D transform writes the linear layout directly, so that copy can't be
+     *        fused into the transform, but it costs much less than it saves in the force kernel.
+     * \param useBricks whether to use the bricked layout.
+     */
+    void setBrickedGrids(bool useBricks) {
+        useBrickedGrids_ = useBricks;
+        brickedPotentialGrid_ = useBricks ? RealVec(ghostGrid_.size()) : RealVec();
+    }
+
+    /*!
+     * \brief setIncrementalUpdates controls whether the computeE(), computeEF(), computeEFV() and per-atom methods keep
+     *        the spread grid and spline cache from one call to the next, and update only the atoms whose coordinates
+     *        or parameters have changed.  This suits Monte Carlo and other simulations in which only a few atoms move
+     *        between calls; when more than a fifth of the atoms have changed, the lattice or the type of calculation
+     *        differs from the previous call, or every IncrementalRefreshInterval updates, the grid is rebuilt from
+     *        scratch.  The incrementally updated grid always uses the linear layout.  Incremental updates are
+     *        disabled by default.
+     * \param incremental whether to update the spread grid incrementally.
+     */
+    void setIncrementalUpdates(bool incremental) {
+        incrementalUpdates_ = incremental;
+        incrementalStateValid_ = false;
+        if (!incremental) {
+            incrementalGhostGrid_.clear();
+            incrementalCoords_ = RealMat();
+            incrementalNegatedParameters_ = RealMat();
+        }
+    }
+
+    /*!
+     * \brief setFFTBackend selects the library used for the FFTs; see FFTBackend.  The transforms are replanned
+     *        immediately if the instance is already set up, otherwise they are planned by the next call to setup().
+     *        Results agree between backends to within round-off error.
+     * \param backend the FFT library to use.
+     */
+    void setFFTBackend(FFTBackend backend) {
+#if HAVE_FFTW != 1
+        if (backend == FFTBackend::FFTW)
+            throw std::runtime_error("The FFTW FFT backend requires helpme to be built with HAVE_FFTW=1.");
+#endif
+#if HAVE_MKL != 1
+        if (backend == FFTBackend::MKL)
+            throw std::runtime_error("The MKL FFT backend requires helpme to be built with HAVE_MKL=1.");
+#endif
+        if (backend == fftBackend_) return;
+        fftBackend_ = backend;
+        if (dimA_) planFFTs();
+    }
+
     /*!
      * \brief Performs the forward 3D FFT of the discretized parameter grid.
      * \param realGrid the array of discretized parameters (stored in CBA order,
      *                 with A being the fast running index) to be transformed.
+     * \param occupiedRowsOnly whether realGrid was folded from the ghost grid of the cached atoms, so that only the
+     *        rows flagged by updateLocalRowOccupancy can be nonzero; the row flags then replace the scans for empty
+     *        lines.  The flags are only used if the A and B dimensions are not distributed over nodes.
      * \return Pointer to the transformed grid, which is stored in one of the buffers in BAC order.
      */
-    Complex *forwardTransform(Real *realGrid) {
+    Complex *forwardTransform(Real *realGrid, bool occupiedRowsOnly = false) {
         Real *realCBA;
         Complex *buffer1, *buffer2;
         if (realGrid == reinterpret_cast<Real *>(workSpace1_.data())) {
@@ -3300,11 +6153,25 @@ class PMEInstance {
             buffer2 = workSpace1_.data();
         }
 
+        // The line passes below skip the lines that are known to be empty, so the native transform is only used
+        // when no more than a quarter of the rows are empty.
+        bool useRowMask = occupiedRowsOnly && numNodesA_ == 1 && numNodesB_ == 1;
+        size_t nLocalRows = static_cast<size_t>(myDimC_) * myDimB_;
+        size_t nOccupiedRows = useRowMask ? updateLocalRowOccupancy() : nLocalRows;
+        if (useNative3DFFT_ && 4 * (nLocalRows - nOccupiedRows) <= nLocalRows) {
+            // The native transform leaves the data in CBA order, which is sorted to BAC order for the convolution.
+            fft3D_->transform(realGrid, buffer1);
+            size_t nLinesC = static_cast<size_t>(dimB_) * complexDimA_;
+            transposeMatrices(buffer1, 0, nLinesC, buffer2, 0, dimC_, 1, dimC_, nLinesC, nThreads_);
+            return buffer2;
+        }
+
 #if HAVE_MPI == 1
         if (numNodesA_ > 1) {
             // Communicate A along columns
             mpiCommunicatorA_->allToAll(realGrid, realCBA, subsetOfCAlongA_ * myDimA_ * myDimB_);
             // Resort the data to end up with realGrid holding a full row of A data, for B pencil and C subset.
+#pragma omp parallel for num_threads(nThreads_)
             for (int c = 0; c < subsetOfCAlongA_; ++c) {
                 Real *outC = realGrid + c * myDimB_ * dimA_;
                 for (int b = 0; b < myDimB_; ++b) {
@@ -3316,27 +6183,50 @@ class PMEInstance {
             }
         }
 #endif
-        // Each parallel node allocates buffers of length dimA/(2 numNodesA)+1 for A, leading to a total of
-        // dimA/2 + numNodesA = complexDimA+numNodesA-1 if dimA is even
-        // and
-        // numNodesA (dimA-1)/2 + numNodesA = complexDimA + numNodesA/2-1 if dimA is odd
-        // We just allocate the larger size here, remembering that the final padding values on the last node
-        // will all be allocated to zero and will not contribute to the final answer.
-        helpme::vector<Complex> buffer(complexDimA_ + numNodesA_ - 1);
-
-        // A transform, with instant sort to CAB ordering for each local block
-        auto scratch = buffer.data();
-        for (int c = 0; c < subsetOfCAlongA_; ++c) {
-            for (int b = 0; b < myDimB_; ++b) {
-                Real *gridPtr = realGrid + c * myDimB_ * dimA_ + b * dimA_;
-                fftHelperA_.transform(gridPtr, scratch);
-                for (int chunk = 0; chunk < numNodesA_; ++chunk) {
-                    for (int a = 0; a < myComplexDimA_; ++a) {
-                        buffer1[(chunk * subsetOfCAlongA_ + c) * myComplexDimA_ * myDimB_ + a * myDimB_ + b] =
-                            scratch[chunk * myComplexDimA_ + a];
-                    }
+        // A transform, followed by a sort to CAB ordering for each local block.  Rows that no stencil reaches, which
+        // are plentiful in slab and interface systems, transform to zero; if they make up more than a quarter of the
+        // rows, the others are transformed one at a time, otherwise every row is transformed by the batched helper.
+        // Both the line transforms and the sorts between them are shared among the threads.
+        size_t nRowsA = static_cast<size_t>(subsetOfCAlongA_) * myDimB_;
+        Complex *transformedRows = transformedRowsA_.data();
+        auto rowIsEmpty = [&](size_t row) -> bool {
+            if (useRowMask) return !localRowOccupied_[row];
+            const Real *rowPtr = realGrid + row * dimA_;
+            return std::none_of(rowPtr, rowPtr + dimA_, [](const Real &value) { return value != 0; });
+        };
+        size_t nEmptyRows = 0;
+#pragma omp parallel for reduction(+ : nEmptyRows) num_threads(nThreads_)
+        for (size_t row = 0; row < nRowsA; ++row) nEmptyRows += rowIsEmpty(row);
+        if (4 * nEmptyRows <= nRowsA) {
+            fftBatchA_.transform(realGrid, transformedRows);
+        } else {
+            ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nThreads_)
+            for (size_t row = 0; row < nRowsA; ++row) {
+                Complex *rowPtr = transformedRows + row * complexDimA_;
+                if (rowIsEmpty(row)) {
+                    std::fill(rowPtr, rowPtr + complexDimA_, Complex(0));
+                } else {
+                    errors.run([&] { fftLineA_->transform(realGrid + row * dimA_, rowPtr); });
                 }
             }
+            errors.rethrow();
+        }
+        // Each parallel node takes myComplexDimA_ = dimA/(2 numNodesA)+1 of the transformed values, which can run
+        // past the complexDimA_ values in the row on the last node; the values beyond the end of the row are zero.
+        // For each C slice the BA ordered rows for each node are transposed into AB order.
+        size_t blockSize = static_cast<size_t>(myComplexDimA_) * myDimB_;
+        for (int chunk = 0; chunk < numNodesA_; ++chunk) {
+            int nValidA = std::max(0, std::min(myComplexDimA_, complexDimA_ - chunk * myComplexDimA_));
+            Complex *chunkPtr = buffer1 + chunk * subsetOfCAlongA_ * blockSize;
+            transposeMatrices(transformedRows + chunk * myComplexDimA_, static_cast<size_t>(myDimB_) * complexDimA_,
+                              complexDimA_, chunkPtr, blockSize, myDimB_, subsetOfCAlongA_, myDimB_, nValidA,
+                              nThreads_);
+            if (nValidA < myComplexDimA_) {
+                for (int c = 0; c < subsetOfCAlongA_; ++c)
+                    std::fill(chunkPtr + c * blockSize + nValidA * myDimB_, chunkPtr + (c + 1) * blockSize,
+                              Complex(0));
+            }
         }
 
 #if HAVE_MPI == 1
@@ -3350,6 +6240,7 @@ class PMEInstance {
         if (numNodesB_ > 1) {
             mpiCommunicatorB_->allToAll(buffer1, buffer2, subsetOfCAlongB_ * myComplexDimA_ * myDimB_);
             // Resort the data to end up with the buffer holding a full row of B data, for A pencil and C subset.
+#pragma omp parallel for num_threads(nThreads_)
             for (int c = 0; c < subsetOfCAlongB_; ++c) {
                 Complex *cPtr = buffer1 + c * myComplexDimA_ * dimB_;
                 for (int a = 0; a < myComplexDimA_; ++a) {
@@ -3363,16 +6254,31 @@ class PMEInstance {
         }
 #endif
 
-        // B transform
-        for (int c = 0; c < subsetOfCAlongB_; ++c) {
-            Complex *cPtr = buffer1 + c * myComplexDimA_ * dimB_;
-            for (int a = 0; a < myComplexDimA_; ++a) {
-                fftHelperB_.transform(cPtr + a * dimB_, FFTW_FORWARD);
-            }
+        // B transform.  The transform of an empty line is also empty, so if more than a quarter of the lines come
+        // from vacuum regions they're left as they are, otherwise every line is transformed by the batched helper.
+        size_t nLinesB = static_cast<size_t>(subsetOfCAlongB_) * myComplexDimA_;
+        auto lineIsEmpty = [&](size_t line) -> bool {
+            if (useRowMask) return !localPlaneOccupied_[line / myComplexDimA_];
+            const Complex *linePtr = buffer1 + line * dimB_;
+            return std::none_of(linePtr, linePtr + dimB_, [](const Complex &value) { return value != Complex(0); });
+        };
+        size_t nEmptyLines = 0;
+#pragma omp parallel for reduction(+ : nEmptyLines) num_threads(nThreads_)
+        for (size_t line = 0; line < nLinesB; ++line) nEmptyLines += lineIsEmpty(line);
+        if (4 * nEmptyLines <= nLinesB) {
+            fftBatchB_.transform(buffer1, FFTForward);
+        } else {
+            ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nThreads_)
+            for (size_t line = 0; line < nLinesB; ++line)
+                if (!lineIsEmpty(line))
+                    errors.run([&] { fftLineB_->transform(buffer1 + line * dimB_, FFTForward); });
+            errors.rethrow();
         }
 
 #if HAVE_MPI == 1
         if (numNodesB_ > 1) {
+#pragma omp parallel for num_threads(nThreads_)
             for (int c = 0; c < subsetOfCAlongB_; ++c) {
                 Complex *zPtr = buffer1 + c * myComplexDimA_ * dimB_;
                 for (int a = 0; a < myComplexDimA_; ++a) {
@@ -3389,20 +6295,15 @@ class PMEInstance {
         }
 #endif
 
-        // sort local blocks from CAB to BAC order
-        for (int b = 0; b < myDimB_; ++b) {
-            for (int a = 0; a < myComplexDimA_; ++a) {
-                for (int c = 0; c < myDimC_; ++c) {
-                    buffer2[b * myComplexDimA_ * myDimC_ + a * myDimC_ + c] =
-                        buffer1[c * myComplexDimA_ * myDimB_ + a * myDimB_ + b];
-                }
-            }
-        }
+        // sort local blocks from CAB to BAC order, by transposing the CB matrix for each value of A
+        transposeMatrices(buffer1, myDimB_, static_cast<size_t>(myComplexDimA_) * myDimB_, buffer2, myDimC_,
+                          static_cast<size_t>(myComplexDimA_) * myDimC_, myComplexDimA_, myDimC_, myDimB_, nThreads_);
 
 #if HAVE_MPI == 1
         if (numNodesC_ > 1) {
             // Communicate C along columns
             mpiCommunicatorC_->allToAll(buffer2, buffer1, subsetOfBAlongC_ * myComplexDimA_ * myDimC_);
+#pragma omp parallel for num_threads(nThreads_)
             for (int b = 0; b < subsetOfBAlongC_; ++b) {
                 Complex *outPtrB = buffer2 + b * myComplexDimA_ * dimC_;
                 for (int a = 0; a < myComplexDimA_; ++a) {
@@ -3418,13 +6319,7 @@ class PMEInstance {
 #endif
 
         // C transform
-        for (int b = 0; b < subsetOfBAlongC_; ++b) {
-            Complex *outPtrB = buffer2 + b * myComplexDimA_ * dimC_;
-            for (int a = 0; a < myComplexDimA_; ++a) {
-                Complex *outPtrBA = outPtrB + a * dimC_;
-                fftHelperC_.transform(outPtrBA, FFTW_FORWARD);
-            }
-        }
+        fftBatchC_.transform(buffer2, FFTForward);
 
         return buffer2;
     }
@@ -3433,9 +6328,14 @@ class PMEInstance {
      * \brief Performs the inverse 3D FFT.
      * \param convolvedGrid the complex array of discretized parameters convolved with the influence function
      *                      (stored in BAC order, with C being the fast running index) to be transformed.
+     * \param occupiedRowsOnly whether only the rows of the potential grid that the stencils of the cached atoms touch
+     *        are needed, as is the case when the potential is only probed at the cached atoms.  If more than a
+     *        quarter of the rows are empty, the other rows are then left undefined, and the sorts and line transforms
+     *        that only feed them are skipped.  This is only done if the A and B dimensions are not distributed over
+     *        nodes.
      * \return Pointer to the potential grid, which is stored in one of the buffers in CBA order.
      */
-    Real *inverseTransform(Complex *convolvedGrid) {
+    Real *inverseTransform(Complex *convolvedGrid, bool occupiedRowsOnly = false) {
         Complex *buffer1, *buffer2;
         // Setup scratch, taking care not to overwrite the convolved grid.
         if (convolvedGrid == workSpace1_.data()) {
@@ -3446,17 +6346,28 @@ class PMEInstance {
             buffer2 = workSpace2_.data();
         }
 
-        // C transform
-        for (int y = 0; y < subsetOfBAlongC_; ++y) {
-            for (int x = 0; x < myComplexDimA_; ++x) {
-                int yx = y * myComplexDimA_ * dimC_ + x * dimC_;
-                fftHelperC_.transform(convolvedGrid + yx, FFTW_BACKWARD);
-            }
+        bool useRowMask = occupiedRowsOnly && numNodesA_ == 1 && numNodesB_ == 1;
+        size_t nLocalRows = static_cast<size_t>(myDimC_) * myDimB_;
+        size_t nOccupiedRows = useRowMask ? updateLocalRowOccupancy() : nLocalRows;
+        bool pruneRows = 4 * (nLocalRows - nOccupiedRows) > nLocalRows;
+
+        if (useNative3DFFT_ && !pruneRows) {
+            // Sort the BAC ordered grid into the CBA order of the native transform, which overwrites its input.
+            size_t nLinesC = static_cast<size_t>(dimB_) * complexDimA_;
+            transposeMatrices(convolvedGrid, 0, dimC_, buffer1, 0, nLinesC, 1, nLinesC, dimC_, nThreads_);
+            Real *realGrid = reinterpret_cast<Real *>(convolvedGrid);
+            fft3D_->transform(buffer1, realGrid);
+            return realGrid;
         }
 
+        // C transform.  Every line runs through the occupied planes, so none of them can be skipped, but only the
+        // occupied planes of the result are carried on to the sorts and transforms that follow.
+        fftBatchC_.transform(convolvedGrid, FFTBackward);
+
 #if HAVE_MPI == 1
         if (numNodesC_ > 1) {
             // Communicate C back to blocks
+#pragma omp parallel for num_threads(nThreads_)
             for (int b = 0; b < subsetOfBAlongC_; ++b) {
                 Complex *inPtrB = convolvedGrid + b * myComplexDimA_ * dimC_;
                 for (int a = 0; a < myComplexDimA_; ++a) {
@@ -3473,14 +6384,18 @@ class PMEInstance {
         }
 #endif
 
-        // sort local blocks from BAC to CAB order
-        for (int B = 0; B < myDimB_; ++B) {
-            for (int A = 0; A < myComplexDimA_; ++A) {
-                for (int C = 0; C < myDimC_; ++C) {
-                    buffer1[C * myComplexDimA_ * myDimB_ + A * myDimB_ + B] =
-                        buffer2[B * myComplexDimA_ * myDimC_ + A * myDimC_ + C];
-                }
-            }
+        // sort local blocks from BAC to CAB order, by transposing the BC matrix for each value of A
+        if (pruneRows) {
+            forEachOccupiedPlaneRun([&](int firstPlane, int nPlanes) {
+                transposeMatrices(buffer2 + firstPlane, myDimC_, static_cast<size_t>(myComplexDimA_) * myDimC_,
+                                  buffer1 + static_cast<size_t>(firstPlane) * myComplexDimA_ * myDimB_, myDimB_,
+                                  static_cast<size_t>(myComplexDimA_) * myDimB_, myComplexDimA_, myDimB_, nPlanes,
+                                  nThreads_);
+            });
+        } else {
+            transposeMatrices(buffer2, myDimC_, static_cast<size_t>(myComplexDimA_) * myDimC_, buffer1, myDimB_,
+                              static_cast<size_t>(myComplexDimA_) * myDimB_, myComplexDimA_, myDimB_, myDimC_,
+                              nThreads_);
         }
 
 #if HAVE_MPI == 1
@@ -3488,6 +6403,7 @@ class PMEInstance {
         if (numNodesB_ > 1) {
             mpiCommunicatorB_->allToAll(buffer1, buffer2, subsetOfCAlongB_ * myComplexDimA_ * myDimB_);
             // Resort the data to end up with the buffer holding a full row of B data, for A pencil and C subset.
+#pragma omp parallel for num_threads(nThreads_)
             for (int c = 0; c < subsetOfCAlongB_; ++c) {
                 Complex *cPtr = buffer1 + c * myComplexDimA_ * dimB_;
                 for (int a = 0; a < myComplexDimA_; ++a) {
@@ -3501,18 +6417,28 @@ class PMEInstance {
         }
 #endif
 
-        // B transform with instant sort of local blocks from CAB -> CBA order
-        for (int c = 0; c < subsetOfCAlongB_; ++c) {
-            for (int a = 0; a < myComplexDimA_; ++a) {
-                int cx = c * myComplexDimA_ * dimB_ + a * dimB_;
-                fftHelperB_.transform(buffer1 + cx, FFTW_BACKWARD);
-                for (int b = 0; b < myDimB_; ++b) {
-                    for (int chunk = 0; chunk < numNodesB_; ++chunk) {
-                        int cb = (chunk * subsetOfCAlongB_ + c) * myDimB_ * myComplexDimA_ + b * myComplexDimA_;
-                        buffer2[cb + a] = buffer1[cx + chunk * myDimB_ + b];
-                    }
-                }
-            }
+        // B transform, followed by a sort of local blocks from CAB -> CBA order, transposing the AB matrix of each
+        // node's part of every C slice.  When pruning, only the lines in occupied C planes are transformed and sorted.
+        size_t blockSize = static_cast<size_t>(myComplexDimA_) * myDimB_;
+        if (pruneRows) {
+            size_t nLinesB = static_cast<size_t>(subsetOfCAlongB_) * myComplexDimA_;
+            ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nThreads_)
+            for (size_t line = 0; line < nLinesB; ++line)
+                if (localPlaneOccupied_[line / myComplexDimA_])
+                    errors.run([&] { fftLineB_->transform(buffer1 + line * dimB_, FFTBackward); });
+            errors.rethrow();
+            forEachOccupiedPlaneRun([&](int firstPlane, int nPlanes) {
+                transposeMatrices(buffer1 + static_cast<size_t>(firstPlane) * myComplexDimA_ * dimB_,
+                                  static_cast<size_t>(myComplexDimA_) * dimB_, dimB_, buffer2 + firstPlane * blockSize,
+                                  blockSize, myComplexDimA_, nPlanes, myComplexDimA_, myDimB_, nThreads_);
+            });
+        } else {
+            fftBatchB_.transform(buffer1, FFTBackward);
+            for (int chunk = 0; chunk < numNodesB_; ++chunk)
+                transposeMatrices(buffer1 + chunk * myDimB_, static_cast<size_t>(myComplexDimA_) * dimB_, dimB_,
+                                  buffer2 + chunk * subsetOfCAlongB_ * blockSize, blockSize, myComplexDimA_,
+                                  subsetOfCAlongB_, myComplexDimA_, myDimB_, nThreads_);
         }
 
 #if HAVE_MPI == 1
@@ -3527,6 +6453,7 @@ class PMEInstance {
         if (numNodesA_ > 1) {
             mpiCommunicatorA_->allToAll(buffer1, buffer2, subsetOfCAlongA_ * myComplexDimA_ * myDimB_);
             // Resort the data to end up with the buffer holding a full row of A data, for B pencil and C subset.
+#pragma omp parallel for num_threads(nThreads_)
             for (int c = 0; c < subsetOfCAlongA_; ++c) {
                 Complex *cPtr = buffer1 + c * myDimB_ * complexDimA_;
                 for (int b = 0; b < myDimB_; ++b) {
@@ -3538,75 +6465,429 @@ class PMEInstance {
                 }
             }
         }
-#else
-        std::swap(buffer1, buffer2);
-#endif
+#else
+        std::swap(buffer1, buffer2);
+#endif
+
+        // A transform, of only the occupied rows when pruning
+        Real *realGrid = reinterpret_cast<Real *>(buffer2);
+        if (pruneRows) {
+            size_t nRowsA = static_cast<size_t>(subsetOfCAlongA_) * myDimB_;
+            ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nThreads_)
+            for (size_t row = 0; row < nRowsA; ++row)
+                if (localRowOccupied_[row])
+                    errors.run([&] { fftLineA_->transform(buffer1 + row * complexDimA_, realGrid + row * dimA_); });
+            errors.rethrow();
+        } else {
+            fftBatchA_.transform(buffer1, realGrid);
+        }
+
+#if HAVE_MPI == 1
+        // Communicate A back to blocks
+        if (numNodesA_ > 1) {
+            Real *realGrid2 = reinterpret_cast<Real *>(buffer1);
+#pragma omp parallel for num_threads(nThreads_)
+            for (int c = 0; c < subsetOfCAlongA_; ++c) {
+                Real *cPtr = realGrid + c * myDimB_ * dimA_;
+                for (int b = 0; b < myDimB_; ++b) {
+                    for (int chunk = 0; chunk < numNodesA_; ++chunk) {
+                        Real *outPtr = realGrid2 + (chunk * subsetOfCAlongA_ + c) * myDimB_ * myDimA_ + b * myDimA_;
+                        Real *inPtr = cPtr + b * dimA_ + chunk * myDimA_;
+                        std::copy(inPtr, inPtr + myDimA_, outPtr);
+                    }
+                }
+            }
+            mpiCommunicatorA_->allToAll(realGrid2, realGrid, subsetOfCAlongA_ * myDimB_ * myDimA_);
+        }
+#endif
+        return realGrid;
+    }
+
+    /*!
+     * \brief zeroWavevectorPrefactor computes the prefactor for the m=0 term, which is only present for the absolutely
+     *        convergent rPower>3 kernels.  The m=0 energy is half of this times the square of the sum of parameters.
+     * \return the m=0 prefactor, or zero if there is no m=0 term.
+     */
+    Real zeroWavevectorPrefactor() {
+        if (rPower_ <= 3) return 0;
+        return 2 * scaleFactor_ * M_PI * sqrtPi * pow(kappa_, rPower_ - 3) /
+               ((rPower_ - 3) * nonTemplateGammaComputer<Real>(rPower_) * cellVolume());
+    }
+
+    /*!
+     * \brief convolveE A wrapper to determine the correct convolution function to call.
+     * \param transformedGrid the pointer to the complex array holding the transformed grid in YXZ ordering.
+     * \return the reciprocal space energy.
+     */
+    Real convolveE(Complex *transformedGrid) {
+        updateInfluenceFunction();
+        size_t myNy = myDimB_ / numNodesC_;
+        size_t myNx = myComplexDimA_;
+        size_t nz = dimC_;
+        size_t nxz = myNx * nz;
+        size_t nyxz = myNy * nxz;
+        size_t halfNx = dimA_ / 2 + 1;
+        bool iAmNodeZero = (rankA_ == 0 && rankB_ == 0 && rankC_ == 0);
+        Real *influenceFunction = cachedInfluenceFunction_.data();
+        int startX = rankA_ * myComplexDimA_;
+
+        Real energy = 0;
+        if (rPower_ > 3 && iAmNodeZero) {
+            // Kernels with rPower>3 are absolutely convergent and should have the m=0 term present.
+            // To compute it we need sum_ij c(i)c(j), which can be obtained from the structure factor norm.
+            energy += zeroWavevectorPrefactor() * std::norm(transformedGrid[0]);
+        }
+
+        transformedGrid[0] = Complex(0, 0);
+#pragma omp parallel for reduction(+ : energy) num_threads(nThreads_)
+        for (size_t yxz = 0; yxz < nyxz; ++yxz) {
+            size_t xz = yxz % nxz;
+            int kx = startX + xz / nz;
+            // We only loop over the first nx/2+1 x values; this
+            // accounts for the "missing" complex conjugate values.
+            Real permPrefac = kx != 0 && kx != halfNx - 1 ? 2 : 1;
+            Real structFactorNorm = std::norm(transformedGrid[yxz]);
+            energy += permPrefac * structFactorNorm * influenceFunction[yxz];
+            transformedGrid[yxz] *= influenceFunction[yxz];
+        }
+        return energy / 2;
+    }
+
+    /*!
+     * \brief probePoints computes the potential, and optionally its derivatives, at arbitrary points.  The points
+     *        are sorted by the grid cell they fall in, and processed in blocks of PointBlockSize, which are
+     *        distributed over the threads.  The splines for each block are built together in structure of arrays
+     *        form, so no per-point spline objects are constructed.
+     * \param potentialGrid pointer to the array containing the potential, in ZYX order.
+     * \param points the cartesian coordinates of the points, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param nPoints the number of points.
+     * \param derivativeLevel the order of the potential derivatives required; 0 is the potential, 1 is (minus) the
+     *        field, etc.
+     * \param potential pointer to the nPoints x nD potential, where nD is the number of components up to and
+     *        including derivativeLevel.  This array is incremented, not assigned.
+     */
+    void probePoints(const Real *potentialGrid, const Real *points, size_t nPoints, int derivativeLevel,
+                     Real *potential) {
+        if (splineOrder_ - derivativeLevel < 2)
+            throw std::runtime_error("The spline order used is not sufficient for the derivative level requested.");
+        updateAngMomIterator(derivativeLevel);
+        int nComponents = nCartesian(derivativeLevel);
+        std::vector<RealMat> rotations;
+        for (int angularMomentum = 1; angularMomentum <= derivativeLevel; ++angularMomentum)
+            rotations.push_back(makeCartesianRotationMatrix(angularMomentum, scaledRecVecs_));
+
+        // Sort the points by their starting C and B grid points, so that neighboring points in a block share rows.
+        std::vector<int> keys(nPoints);
+#pragma omp parallel for num_threads(nThreads_)
+        for (size_t point = 0; point < nPoints; ++point) {
+            short startingGridPoints[3];
+            Real distances[3];
+            fractionalGridPosition(points + 3 * point, startingGridPoints, distances);
+            keys[point] = startingGridPoints[2] * dimB_ + startingGridPoints[1];
+        }
+        std::vector<size_t> offsets(static_cast<size_t>(dimB_) * dimC_ + 1, 0);
+        for (size_t point = 0; point < nPoints; ++point) ++offsets[keys[point] + 1];
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<size_t> sortedPoints(nPoints);
+        for (size_t point = 0; point < nPoints; ++point) sortedPoints[offsets[keys[point]]++] = point;
+
+        size_t nBlocks = (nPoints + PointBlockSize - 1) / PointBlockSize;
+#pragma omp parallel num_threads(nThreads_)
+        {
+#ifdef _OPENMP
+            int threadID = omp_get_thread_num();
+#else
+            int threadID = 1;
+#endif
+            auto &splinesA = threadSplineBlocks_[3 * (threadID % nThreads_)];
+            auto &splinesB = threadSplineBlocks_[3 * (threadID % nThreads_) + 1];
+            auto &splinesC = threadSplineBlocks_[3 * (threadID % nThreads_) + 2];
+            short startingGridPoints[3 * PointBlockSize];
+            Real distances[3 * PointBlockSize];
+            std::vector<Real> rowA(derivativeLevel + 1), phi(nComponents), transformed(nComponents);
+#pragma omp for schedule(dynamic)
+            for (size_t block = 0; block < nBlocks; ++block) {
+                size_t firstPoint = block * PointBlockSize;
+                int nBlockPoints = static_cast<int>(std::min<size_t>(PointBlockSize, nPoints - firstPoint));
+                for (int blockPoint = 0; blockPoint < nBlockPoints; ++blockPoint) {
+                    short start[3];
+                    Real distance[3];
+                    fractionalGridPosition(points + 3 * sortedPoints[firstPoint + blockPoint], start, distance);
+                    for (int dim = 0; dim < 3; ++dim) {
+                        startingGridPoints[dim * PointBlockSize + blockPoint] = start[dim];
+                        distances[dim * PointBlockSize + blockPoint] = distance[dim];
+                    }
+                }
+                splinesA.update(distances, nBlockPoints, splineOrder_, derivativeLevel);
+                splinesB.update(distances + PointBlockSize, nBlockPoints, splineOrder_, derivativeLevel);
+                splinesC.update(distances + 2 * PointBlockSize, nBlockPoints, splineOrder_, derivativeLevel);
+
+                for (int blockPoint = 0; blockPoint < nBlockPoints; ++blockPoint) {
+                    const auto &aGridIterator = gridIteratorA_[startingGridPoints[blockPoint]];
+                    const auto &bGridIterator = gridIteratorB_[startingGridPoints[PointBlockSize + blockPoint]];
+                    const auto &cGridIterator = gridIteratorC_[startingGridPoints[2 * PointBlockSize + blockPoint]];
+                    std::fill(phi.begin(), phi.end(), Real(0));
+                    for (const auto &cPoint : cGridIterator) {
+                        for (const auto &bPoint : bGridIterator) {
+                            const Real *cbRow =
+                                potentialGrid + cPoint.first * myDimA_ * myDimB_ + bPoint.first * myDimA_;
+                            // Contract the row with each A derivative first, then apply the B and C factors.
+                            std::fill(rowA.begin(), rowA.end(), Real(0));
+                            for (const auto &aPoint : aGridIterator) {
+                                const Real &gridVal = cbRow[aPoint.first];
+                                for (int deriv = 0; deriv <= derivativeLevel; ++deriv)
+                                    rowA[deriv] += gridVal * splinesA(deriv, aPoint.second)[blockPoint];
+                            }
+                            for (int component = 0; component < nComponents; ++component) {
+                                const auto &quanta = angMomIterator_[component];
+                                phi[component] += rowA[quanta[0]] *
+                                                  splinesB(quanta[1], bPoint.second)[blockPoint] *
+                                                  splinesC(quanta[2], cPoint.second)[blockPoint];
+                            }
+                        }
+                    }
+
+                    Real *pointPotential = potential + sortedPoints[firstPoint + blockPoint] * nComponents;
+                    pointPotential[0] += phi[0];
+                    int offset = 1;
+                    for (int angularMomentum = 1; angularMomentum <= derivativeLevel; ++angularMomentum) {
+                        int nAngMomComponents = (angularMomentum + 1) * (angularMomentum + 2) / 2;
+                        matrixVectorProduct(rotations[angularMomentum - 1], phi.data() + offset, transformed.data());
+                        for (int component = 0; component < nAngMomComponents; ++component)
+                            pointPotential[offset + component] += transformed[component];
+                        offset += nAngMomComponents;
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief addToTrialStencil appends the weighted grid points of a single atom's stencil to the trial stencil.
+     * \param atomCoords a 3-vector containing the atom's coordinates.
+     * \param parameter the scalar parameter that the stencil is weighted by.
+     */
+    void addToTrialStencil(const Real *atomCoords, Real parameter) {
+        short startingGridPoints[3];
+        Real distances[3];
+        fractionalGridPosition(atomCoords, startingGridPoints, distances);
+        trialSplines_.assign(3 * splineOrder_, Real(0));
+        for (int dim = 0; dim < 3; ++dim)
+            BSpline<Real>::computeInPlace(trialSplines_.data() + dim * splineOrder_, distances[dim], splineOrder_, 0);
+        const Real *splineA = trialSplines_.data();
+        const Real *splineB = splineA + splineOrder_;
+        const Real *splineC = splineB + splineOrder_;
+        for (int pointC = 0; pointC < splineOrder_; ++pointC) {
+            short c = (startingGridPoints[2] + pointC) % dimC_;
+            for (int pointB = 0; pointB < splineOrder_; ++pointB) {
+                short b = (startingGridPoints[1] + pointB) % dimB_;
+                Real weightCB = parameter * splineC[pointC] * splineB[pointB];
+                for (int pointA = 0; pointA < splineOrder_; ++pointA) {
+                    short a = (startingGridPoints[0] + pointA) % dimA_;
+                    trialStencil_.emplace_back(a, b, c, weightCB * splineA[pointA]);
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief refreshAcceptedPotential transforms and convolves the accepted charge grid to get its potential grid.
+     * \return the reciprocal space energy of the accepted state.
+     */
+    Real refreshAcceptedPotential() {
+        Real *realGrid = reinterpret_cast<Real *>(workSpace1_.data());
+        std::copy(acceptedChargeGrid_.begin(), acceptedChargeGrid_.end(), realGrid);
+        auto gridAddress = forwardTransform(realGrid);
+        Real energy = convolveE(gridAddress);
+        const Real *potentialGrid = inverseTransform(gridAddress);
+        acceptedPotentialGrid_.assign(potentialGrid, potentialGrid + acceptedChargeGrid_.size());
+        acceptedPotentialIsStale_ = false;
+        return energy;
+    }
+
+    /*!
+     * \brief spreadAcceptedState spreads the accepted parameters onto the accepted charge grid from scratch.
+     */
+    void spreadAcceptedState() {
+        filterAtomsAndBuildSplineCache(0, acceptedCoordinates_);
+        const Real *realGrid = spreadParameters(0, acceptedParameters_);
+        acceptedChargeGrid_.assign(realGrid, realGrid + static_cast<size_t>(dimA_) * dimB_ * dimC_);
+        acceptedParameterSum_ = std::accumulate(acceptedParameters_[0],
+                                                acceptedParameters_[0] + acceptedParameters_.nRows(), Real(0));
+        acceptedMoveCount_ = 0;
+        acceptedPotentialIsStale_ = true;
+    }
+
+    /*!
+     * \brief spreadCachedAtoms calls the provided spreading function for each entry in the spline cache.  When
+     *        running multithreaded, the entries are sorted into buckets that are processed in an order that prevents
+     *        two threads from ever touching the same ghost grid point concurrently.
+     * \param spreadAtom the function that spreads a single atom, given its SplineCacheEntry.
+     */
+    template <typename SpreadFunction>
+    void spreadCachedAtoms(const SpreadFunction &spreadAtom) {
+        size_t nAtoms = atomList_.size();
+        if (nThreads_ == 1) {
+            for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber)
+                spreadAtom(splineCache_[relativeAtomNumber]);
+            return;
+        }
+
+        // Buckets whose B indices and C indices both have the same parity never touch the same grid points, so the
+        // four parity classes are processed in turn, with the buckets in each class distributed over the threads.
+        sortAtomsIntoSpreadBuckets();
+#pragma omp parallel num_threads(nThreads_)
+        for (int parity = 0; parity < 4; ++parity) {
+            int firstBucketB = parity % 2;
+            int firstBucketC = parity / 2;
+            int nBucketsB = (numSpreadBucketsB_ - firstBucketB + 1) / 2;
+            int nBucketsC = (numSpreadBucketsC_ - firstBucketC + 1) / 2;
+#pragma omp for schedule(dynamic)
+            for (int task = 0; task < nBucketsB * nBucketsC; ++task) {
+                int bucket = (firstBucketC + 2 * (task / nBucketsB)) * numSpreadBucketsB_ + firstBucketB +
+                             2 * (task % nBucketsB);
+                for (size_t n = spreadBucketOffsets_[bucket]; n < spreadBucketOffsets_[bucket + 1]; ++n)
+                    spreadAtom(splineCache_[spreadBucketAtoms_[n]]);
+            }
+        }
+    }
 
-        // A transform
-        Real *realGrid = reinterpret_cast<Real *>(buffer2);
-        for (int cb = 0; cb < subsetOfCAlongA_ * myDimB_; ++cb) {
-            fftHelperA_.transform(buffer1 + cb * complexDimA_, realGrid + cb * dimA_);
+    /*!
+     * \brief computeRecMultiGrid runs a reciprocal space calculation for several sets of scalar parameters, sharing a
+     *        single spline cache and a single pass over it for both spreading and probing.
+     * \param parameters the nAtoms x nGrids matrix of parameters, with one set of scalar parameters per column.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param weights the weight applied to each parameter set's contributions, or an empty matrix for unit weights.
+     * \param forces pointer to the Nx3 matrix of forces to be incremented, or nullptr if forces are not needed.
+     * \param virial pointer to the vector of 6 virial elements to be incremented, or nullptr if not needed.
+     * \return the weighted sum of the reciprocal space energies.
+     */
+    Real computeRecMultiGrid(const RealMat &parameters, const RealMat &coordinates, const RealMat &weights,
+                             RealMat *forces, RealMat *virial) {
+        int nGrids = parameters.nCols();
+        if (nGrids == 0) throw std::runtime_error("At least one set of parameters must be provided.");
+        sanityChecks(0, parameters, coordinates, nGrids);
+        size_t nWeights = weights.nRows() * weights.nCols();
+        if (nWeights != 0 && nWeights != static_cast<size_t>(nGrids))
+            throw std::runtime_error("The number of weights must match the number of parameter sets.");
+
+        // Spline derivative level bumped by 1, for energy gradients.
+        filterAtomsAndBuildSplineCache(forces ? 1 : 0, coordinates);
+
+        multiGhostGrids_.resize(static_cast<size_t>(ghostDimA_) * ghostDimB_ * ghostDimC_ * nGrids);
+        Real *ghostGrids = multiGhostGrids_.data();
+        zeroOccupiedGhostRows(ghostGrids, nGrids);
+        const Real *paramPtr = parameters[0];
+        spreadCachedAtoms([&](const SplineCacheEntry<Real> &entry) {
+            spreadScalarParametersMultiGridImpl(ghostGrids, nGrids, entry.aSpline, entry.bSpline, entry.cSpline,
+                                                paramPtr + static_cast<size_t>(entry.absoluteAtomNumber) * nGrids);
+        });
+
+        size_t nGridPoints = static_cast<size_t>(myDimA_) * myDimB_ * myDimC_;
+        if (forces) multiPotentialGrids_.resize(nGridPoints * nGrids);
+        Real *potentialGrids = multiPotentialGrids_.data();
+        Real gridVirialData[6];
+        RealMat gridVirial(gridVirialData, 1, 6);
+        Real energy = 0;
+        for (int grid = 0; grid < nGrids; ++grid) {
+            Real weight = nWeights ? weights[0][grid] : 1;
+            auto realGrid = foldGhostGrid(ghostGrids + grid, nGrids);
+            auto gridAddress = forwardTransform(realGrid, true);
+            if (virial) {
+                gridVirial.setZero();
+                energy += weight * convolveEV(gridAddress, gridVirial);
+                for (int component = 0; component < 6; ++component)
+                    (*virial)[0][component] += weight * gridVirial[0][component];
+            } else {
+                energy += weight * convolveE(gridAddress);
+            }
+            if (forces) {
+                const Real *potentialGrid = inverseTransform(gridAddress, true);
+#pragma omp parallel for num_threads(nThreads_)
+                for (size_t point = 0; point < nGridPoints; ++point)
+                    potentialGrids[point * nGrids + grid] = weight * potentialGrid[point];
+            }
         }
 
-#if HAVE_MPI == 1
-        // Communicate A back to blocks
-        if (numNodesA_ > 1) {
-            Real *realGrid2 = reinterpret_cast<Real *>(buffer1);
-            for (int c = 0; c < subsetOfCAlongA_; ++c) {
-                Real *cPtr = realGrid + c * myDimB_ * dimA_;
-                for (int b = 0; b < myDimB_; ++b) {
-                    for (int chunk = 0; chunk < numNodesA_; ++chunk) {
-                        Real *outPtr = realGrid2 + (chunk * subsetOfCAlongA_ + c) * myDimB_ * myDimA_ + b * myDimA_;
-                        Real *inPtr = cPtr + b * dimA_ + chunk * myDimA_;
-                        std::copy(inPtr, inPtr + myDimA_, outPtr);
-                    }
-                }
+        if (forces) {
+            size_t nAtoms = atomList_.size();
+#pragma omp parallel for num_threads(nThreads_)
+            for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber) {
+                const auto &entry = splineCache_[relativeAtomNumber];
+                const int &atom = entry.absoluteAtomNumber;
+                probeGridForceMultiGridImpl(potentialGrids, nGrids, entry.aSpline, entry.bSpline, entry.cSpline,
+                                            parameters[atom], (*forces)[atom]);
             }
-            mpiCommunicatorA_->allToAll(realGrid2, realGrid, subsetOfCAlongA_ * myDimB_ * myDimA_);
         }
-#endif
-        return realGrid;
+
+        return energy;
     }
 
     /*!
-     * \brief convolveE A wrapper to determine the correct convolution function to call.
-     * \param transformedGrid the pointer to the complex array holding the transformed grid in YXZ ordering.
+     * \brief computeRecPerAtom runs a reciprocal space calculation for scalar parameters, decomposing the energy and,
+     *        optionally, the virial into per-atom contributions.  The per-atom energies are accumulated during the
+     *        same pass over the spline cache that computes the forces.  The per-atom virials need one more inverse
+     *        transform for each of the six virial components, applied to the structure factor multiplied by the
+     *        virial kernels, which is probed with the cached splines.
+     * \param parameters the nAtoms x 1 matrix of scalar parameters.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param forces the Nx3 matrix of forces to be incremented.
+     * \param virial pointer to the vector of 6 virial elements to be incremented, or nullptr if not needed.
+     * \param atomEnergies the Nx1 matrix of per-atom energies to be incremented.
+     * \param atomVirials pointer to the Nx6 matrix of per-atom virials to be incremented, or nullptr if not needed.
      * \return the reciprocal space energy.
      */
-    Real convolveE(Complex *transformedGrid) {
-        updateInfluenceFunction();
-        size_t myNy = myDimB_ / numNodesC_;
-        size_t myNx = myComplexDimA_;
-        size_t nz = dimC_;
-        size_t nxz = myNx * nz;
-        size_t nyxz = myNy * nxz;
-        size_t halfNx = dimA_ / 2 + 1;
+    Real computeRecPerAtom(const RealMat &parameters, const RealMat &coordinates, RealMat &forces, RealMat *virial,
+                           RealMat &atomEnergies, RealMat *atomVirials) {
+        sanityChecks(0, parameters, coordinates);
+        if (atomEnergies.nRows() != parameters.nRows() || atomEnergies.nCols() != 1)
+            throw std::runtime_error("The per-atom energies should be a matrix of dimension nAtoms x 1.");
+        if (atomVirials && (atomVirials->nRows() != parameters.nRows() || atomVirials->nCols() != 6))
+            throw std::runtime_error("The per-atom virials should be a matrix of dimension nAtoms x 6.");
+
+        // Spline derivative level bumped by 1, for energy gradients.
+        auto realGrid = buildCacheAndSpreadParameters(0, 1, parameters, coordinates);
+        auto gridPtr = forwardTransform(realGrid, true);
         bool iAmNodeZero = (rankA_ == 0 && rankB_ == 0 && rankC_ == 0);
-        Real *influenceFunction = cachedInfluenceFunction_.data();
-        int startX = rankA_ * myComplexDimA_;
+        // The m=0 term is removed from the grid by the convolution, so we keep the sum of parameters to restore it.
+        Real parameterSum = iAmNodeZero ? gridPtr[0].real() : 0;
+        size_t transformedGridSize = static_cast<size_t>(myDimC_) * myComplexDimA_ * myDimB_;
+        if (atomVirials) {
+            virialKernelGridsFxn_(dimA_, dimB_, dimC_, myComplexDimA_, myDimB_ / numNodesC_, rankA_ * myComplexDimA_,
+                                  rankB_ * myDimB_ + rankC_ * myDimB_ / numNodesC_, scaleFactor_, gridPtr,
+                                  virialKernelGrids_.data(), recVecs_, cellVolume(), kappa_, &splineModA_[0],
+                                  &splineModB_[0], &splineModC_[0], nThreads_);
+        }
+        Real energy = virial ? convolveEV(gridPtr, *virial) : convolveE(gridPtr);
+        const auto potentialGrid = inverseTransform(gridPtr, true);
+        probeGrid(potentialGrid, 0, parameters, forces, &atomEnergies);
 
-        Real energy = 0;
-        if (rPower_ > 3 && iAmNodeZero) {
-            // Kernels with rPower>3 are absolutely convergent and should have the m=0 term present.
-            // To compute it we need sum_ij c(i)c(j), which can be obtained from the structure factor norm.
-            Real prefac = 2 * scaleFactor_ * M_PI * sqrtPi * pow(kappa_, rPower_ - 3) /
-                          ((rPower_ - 3) * nonTemplateGammaComputer<Real>(rPower_) * cellVolume());
-            energy += prefac * std::norm(transformedGrid[0]);
+        const Real *paramPtr = parameters[0];
+        size_t nAtoms = atomList_.size();
+        if (iAmNodeZero && rPower_ > 3) {
+            Real zeroTermPotential = zeroWavevectorPrefactor() * parameterSum;
+            for (size_t atom = 0; atom < parameters.nRows(); ++atom)
+                atomEnergies[atom][0] += paramPtr[atom] * zeroTermPotential / 2;
         }
 
-        transformedGrid[0] = Complex(0, 0);
-#pragma omp parallel for reduction(+ : energy) num_threads(nThreads_)
-        for (size_t yxz = 0; yxz < nyxz; ++yxz) {
-            size_t xz = yxz % nxz;
-            int kx = startX + xz / nz;
-            // We only loop over the first nx/2+1 x values; this
-            // accounts for the "missing" complex conjugate values.
-            Real permPrefac = kx != 0 && kx != halfNx - 1 ? 2 : 1;
-            Real structFactorNorm = std::norm(transformedGrid[yxz]);
-            energy += permPrefac * structFactorNorm * influenceFunction[yxz];
-            transformedGrid[yxz] *= influenceFunction[yxz];
+        if (atomVirials) {
+            for (int component = 0; component < 6; ++component) {
+                const Complex *kernelGrid = virialKernelGrids_.data() + component * transformedGridSize;
+                std::copy(kernelGrid, kernelGrid + transformedGridSize, workSpace1_.data());
+                const Real *componentGrid = inverseTransform(workSpace1_.data(), true);
+#pragma omp parallel for num_threads(nThreads_)
+                for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber) {
+                    const auto &entry = splineCache_[relativeAtomNumber];
+                    const int &atom = entry.absoluteAtomNumber;
+                    Real phi = 0;
+                    probeGridPotentialFxn_(this, componentGrid, 1, entry.aSpline, entry.bSpline, entry.cSpline, &phi);
+                    (*atomVirials)[atom][component] += paramPtr[atom] * phi / 2;
+                }
+            }
         }
-        return energy / 2;
+
+        return energy;
     }
 
     /*!
@@ -3645,20 +6926,153 @@ class PMEInstance {
      * \return realGrid the array of discretized parameters (stored in CBA order).
      */
     Real *spreadParameters(int parameterAngMom, const RealMat &parameters) {
-        Real *realGrid = reinterpret_cast<Real *>(workSpace1_.data());
-        std::fill(workSpace1_.begin(), workSpace1_.end(), 0);
+        Real *ghostGrid = ghostGrid_.data();
+        bool bricked = useBrickedGrids_ && parameterAngMom == 0;
+        zeroOccupiedGhostRows(ghostGrid, 1, bricked);
         updateAngMomIterator(parameterAngMom);
-        size_t nAtoms = atomList_.size();
         int nComponents = nCartesian(parameterAngMom);
-        for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber) {
-            const auto &entry = splineCache_[relativeAtomNumber];
+        const Real *paramPtr = parameters[0];
+        auto spreadAtom = [&](const SplineCacheEntry<Real> &entry) {
             const int &atom = entry.absoluteAtomNumber;
             const auto &splineA = entry.aSpline;
             const auto &splineB = entry.bSpline;
             const auto &splineC = entry.cSpline;
-            spreadParametersImpl(atom, realGrid, nComponents, splineA, splineB, splineC, parameters);
+            if (parameterAngMom) {
+                spreadParametersFxn_(this, atom, ghostGrid, nComponents, splineA, splineB, splineC, parameters);
+            } else if (bricked) {
+                spreadScalarParameterBrickedFxn_(this, ghostGrid, splineA, splineB, splineC, paramPtr[atom]);
+            } else {
+                spreadScalarParameterFxn_(this, ghostGrid, splineA, splineB, splineC, paramPtr[atom]);
+            }
+        };
+        spreadCachedAtoms(spreadAtom);
+        return foldGhostGrid(ghostGrid, 1, bricked);
+    }
+
+    /*!
+     * \brief buildCacheAndSpreadParameters filters the atoms, builds the spline cache and spreads the parameters onto
+     *        the charge grid.  If incremental updates are enabled, the grid and cache from the previous call are
+     *        reused where possible, with only the atoms whose coordinates or parameters have changed being updated.
+     * \param parameterAngMom the angular momentum of the parameters (0 for charges, C6 coefficients, 2 for
+     *        quadrupoles, etc.).
+     * \param splineDerivativeLevel the derivative level of the splines to cache.
+     * \param parameters the list of parameters associated with each atom (charges, C6 coefficients, multipoles,
+     *        etc...).  See spreadParameters() for details of the ordering.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \return realGrid the array of discretized parameters (stored in CBA order).
+     */
+    Real *buildCacheAndSpreadParameters(int parameterAngMom, int splineDerivativeLevel, const RealMat &parameters,
+                                        const RealMat &coordinates) {
+        if (!incrementalUpdates_) {
+            filterAtomsAndBuildSplineCache(splineDerivativeLevel, coordinates);
+            return spreadParameters(parameterAngMom, parameters);
         }
-        return realGrid;
+
+        updateAngMomIterator(parameterAngMom);
+        int nComponents = nCartesian(parameterAngMom);
+        size_t nAtoms = coordinates.nRows();
+        bool canUpdate = incrementalStateValid_ && incrementalUpdateCount_ < IncrementalRefreshInterval &&
+                         parameterAngMom == incrementalAngMom_ &&
+                         splineDerivativeLevel == incrementalDerivativeLevel_ && nAtoms == incrementalCoords_.nRows() &&
+                         std::equal(recVecs_[0], recVecs_[0] + 9, incrementalRecVecs_[0]);
+        if (canUpdate) {
+            movedAtoms_.clear();
+            for (size_t atom = 0; atom < nAtoms; ++atom) {
+                bool changed = !std::equal(coordinates[atom], coordinates[atom] + 3, incrementalCoords_[atom]);
+                for (int component = 0; component < nComponents; ++component)
+                    changed |= parameters(atom, component) != -incrementalNegatedParameters_(atom, component);
+                if (changed) movedAtoms_.push_back(atom);
+            }
+            // Newly contributing atoms are appended to the cache, so there must be room for them all.
+            size_t cacheCapacity = splineCacheData_.size() / (3 * splineCacheStride(splineDerivativeLevel));
+            cacheCapacity = std::min(cacheCapacity, splineCache_.size());
+            canUpdate = 5 * movedAtoms_.size() <= nAtoms && atomList_.size() + movedAtoms_.size() <= cacheCapacity;
+        }
+
+        Real *ghostGrid = incrementalGhostGrid_.data();
+        auto spreadAtom = [&](const SplineCacheEntry<Real> &entry, const RealMat &atomParameters) {
+            if (parameterAngMom) {
+                spreadParametersFxn_(this, entry.absoluteAtomNumber, ghostGrid, nComponents, entry.aSpline,
+                                     entry.bSpline, entry.cSpline, atomParameters);
+            } else {
+                spreadScalarParameterFxn_(this, ghostGrid, entry.aSpline, entry.bSpline, entry.cSpline,
+                                          atomParameters(entry.absoluteAtomNumber, 0));
+            }
+        };
+        if (canUpdate) {
+            size_t splineStride = splineCacheStride(splineDerivativeLevel);
+            size_t cacheCapacity = splineCacheData_.size() / (3 * splineStride);
+            for (int atom : movedAtoms_) {
+                int slot = cacheSlotOfAtom_[atom];
+                // Remove the old contribution, by spreading the negated parameters with the cached splines.
+                if (slot >= 0) spreadAtom(splineCache_[slot], incrementalNegatedParameters_);
+                std::copy(coordinates[atom], coordinates[atom] + 3, incrementalCoords_[atom]);
+                for (int component = 0; component < nComponents; ++component)
+                    incrementalNegatedParameters_(atom, component) = -parameters(atom, component);
+
+                Real aCoord, bCoord, cCoord;
+                if (locateAtom(coordinates, atom, aCoord, bCoord, cCoord)) {
+                    if (slot < 0) {
+                        slot = atomList_.size();
+                        atomList_.emplace_back();
+                        cacheSlotOfAtom_[atom] = slot;
+                    }
+                    cacheAtomSplines(slot, atom, aCoord, bCoord, cCoord, splineDerivativeLevel);
+                    spreadAtom(splineCache_[slot], parameters);
+                } else if (slot >= 0) {
+                    // The atom no longer touches this node's grid, so the last cache entry is moved into its slot.
+                    size_t lastSlot = atomList_.size() - 1;
+                    if (static_cast<size_t>(slot) != lastSlot) {
+                        for (int dim = 0; dim < 3; ++dim) {
+                            Real *dimData = splineCacheData_.data() + dim * cacheCapacity * splineStride;
+                            std::copy(dimData + lastSlot * splineStride, dimData + (lastSlot + 1) * splineStride,
+                                      dimData + slot * splineStride);
+                        }
+                        const auto &lastEntry = atomList_[lastSlot];
+                        int lastAtom = std::get<0>(lastEntry);
+                        atomList_[slot] = lastEntry;
+                        auto &atomSplines = splineCache_[slot];
+                        atomSplines.absoluteAtomNumber = lastAtom;
+                        atomSplines.aSpline = Spline(splineCache_[lastSlot].aSpline.startingGridPoint(),
+                                                     splineCacheData_.data() + slot * splineStride, splineOrder_);
+                        atomSplines.bSpline = Spline(splineCache_[lastSlot].bSpline.startingGridPoint(),
+                                                     splineCacheData_.data() + (cacheCapacity + slot) * splineStride,
+                                                     splineOrder_);
+                        atomSplines.cSpline =
+                            Spline(splineCache_[lastSlot].cSpline.startingGridPoint(),
+                                   splineCacheData_.data() + (2 * cacheCapacity + slot) * splineStride, splineOrder_);
+                        cacheSlotOfAtom_[lastAtom] = slot;
+                    }
+                    atomList_.pop_back();
+                    cacheSlotOfAtom_[atom] = -1;
+                }
+            }
+            // Rows are never unmarked here, so those vacated by moved atoms are still folded; they hold only roundoff.
+            updateGhostRowOccupancy();
+            ++incrementalUpdateCount_;
+        } else {
+            filterAtomsAndBuildSplineCache(splineDerivativeLevel, coordinates);
+            incrementalGhostGrid_.assign(static_cast<size_t>(ghostDimA_) * ghostDimB_ * ghostDimC_, Real(0));
+            ghostGrid = incrementalGhostGrid_.data();
+            spreadCachedAtoms([&](const SplineCacheEntry<Real> &entry) { spreadAtom(entry, parameters); });
+
+            cacheSlotOfAtom_.assign(nAtoms, -1);
+            for (size_t slot = 0; slot < atomList_.size(); ++slot)
+                cacheSlotOfAtom_[std::get<0>(atomList_[slot])] = slot;
+            incrementalCoords_ = RealMat(nAtoms, 3);
+            std::copy(coordinates[0], coordinates[0] + 3 * nAtoms, incrementalCoords_[0]);
+            incrementalNegatedParameters_ = RealMat(nAtoms, nComponents);
+            for (size_t atom = 0; atom < nAtoms; ++atom)
+                for (int component = 0; component < nComponents; ++component)
+                    incrementalNegatedParameters_(atom, component) = -parameters(atom, component);
+            incrementalRecVecs_ = RealMat(3, 3);
+            std::copy(recVecs_[0], recVecs_[0] + 9, incrementalRecVecs_[0]);
+            incrementalAngMom_ = parameterAngMom;
+            incrementalDerivativeLevel_ = splineDerivativeLevel;
+            incrementalUpdateCount_ = 0;
+            incrementalStateValid_ = true;
+        }
+        return foldGhostGrid(ghostGrid);
     }
 
     /*!
@@ -3684,21 +7098,49 @@ class PMEInstance {
      * \return realGrid the array of discretized parameters (stored in CBA order).
      */
     Real *spreadParameters(int parameterAngMom, const RealMat &parameters, const RealMat &coordinates) {
-        Real *realGrid = reinterpret_cast<Real *>(workSpace1_.data());
-        std::fill(workSpace1_.begin(), workSpace1_.end(), 0);
+        Real *ghostGrid = ghostGrid_.data();
+        std::fill(ghostGrid_.begin(), ghostGrid_.end(), 0);
+        // Nothing is known about where these atoms are, so every row has to be folded.
+        std::fill(ghostRowOccupied_.begin(), ghostRowOccupied_.end(), 1);
         updateAngMomIterator(parameterAngMom);
+        if (splineOrder_ <= MaxFixedSplineOrder) {
+            spreadParametersWithoutCache<FixedSpline>(parameterAngMom, parameters, coordinates, ghostGrid);
+        } else {
+            spreadParametersWithoutCache<BSpline<Real>>(parameterAngMom, parameters, coordinates, ghostGrid);
+        }
+        return foldGhostGrid(ghostGrid);
+    }
+
+    /*!
+     * \brief spreadParametersWithoutCache spreads each atom's parameters onto the ghost grid, blindly reconstructing
+     *        its splines and assuming nothing about the validity of the cache.
+     * \param parameterAngMom the angular momentum of the parameters.
+     * \param parameters the list of parameters associated with each atom.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param ghostGrid pointer to the zeroed ghost grid.
+     * \tparam SplineType the B-spline class used to hold each atom's splines.
+     */
+    template <typename SplineType>
+    void spreadParametersWithoutCache(int parameterAngMom, const RealMat &parameters, const RealMat &coordinates,
+                                      Real *ghostGrid) {
         int nComponents = nCartesian(parameterAngMom);
         size_t nAtoms = coordinates.nRows();
         for (size_t atom = 0; atom < nAtoms; ++atom) {
-            // Blindly reconstruct splines for this atom, assuming nothing about the validity of the cache.
-            // Note that this incurs a somewhat steep cost due to repeated memory allocations.
-            auto bSplines = makeBSplines(coordinates[atom], parameterAngMom);
+            auto bSplines = makeBSplines<SplineType>(coordinates[atom], parameterAngMom);
             const auto &splineA = std::get<0>(bSplines);
             const auto &splineB = std::get<1>(bSplines);
             const auto &splineC = std::get<2>(bSplines);
-            spreadParametersImpl(atom, realGrid, nComponents, splineA, splineB, splineC, parameters);
+            // Skip atoms whose stencil doesn't touch this node's part of the grid.
+            if (gridIteratorA_[splineA.startingGridPoint()].empty() ||
+                gridIteratorB_[splineB.startingGridPoint()].empty() ||
+                gridIteratorC_[splineC.startingGridPoint()].empty())
+                continue;
+            if (parameterAngMom) {
+                spreadParametersFxn_(this, atom, ghostGrid, nComponents, splineA, splineB, splineC, parameters);
+            } else {
+                spreadScalarParameterFxn_(this, ghostGrid, splineA, splineB, splineC, parameters(atom, 0));
+            }
         }
-        return realGrid;
     }
 
     /*!
@@ -3726,17 +7168,40 @@ class PMEInstance {
     void probeGrid(const Real *potentialGrid, int parameterAngMom, const RealMat &parameters,
                    const RealMat &coordinates, RealMat &forces) {
         updateAngMomIterator(parameterAngMom + 1);
+        if (splineOrder_ <= MaxFixedSplineOrder) {
+            probeGridWithoutCache<FixedSpline>(potentialGrid, parameterAngMom, parameters, coordinates, forces);
+        } else {
+            probeGridWithoutCache<BSpline<Real>>(potentialGrid, parameterAngMom, parameters, coordinates, forces);
+        }
+    }
+
+    /*!
+     * \brief probeGridWithoutCache probes the potential grid to get the forces, reconstructing each atom's splines
+     *        on demand.  Atoms are distributed over the threads, each with its own scratch space.
+     * \param potentialGrid pointer to the array containing the potential, in ZYX order.
+     * \param parameterAngMom the angular momentum of the parameters.
+     * \param parameters the list of parameters associated with each atom.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param forces a Nx3 matrix of the forces, ordered in memory as {Fx1,Fy1,Fz1,Fx2,Fy2,Fz2,....FxN,FyN,FzN}.
+     * \tparam SplineType the B-spline class used to hold each atom's splines.
+     */
+    template <typename SplineType>
+    void probeGridWithoutCache(const Real *potentialGrid, int parameterAngMom, const RealMat &parameters,
+                               const RealMat &coordinates, RealMat &forces) {
         int nComponents = nCartesian(parameterAngMom);
         int nForceComponents = nCartesian(parameterAngMom + 1);
-        RealMat fractionalPhis(1, nForceComponents);
         size_t nAtoms = parameters.nRows();
+#pragma omp parallel for num_threads(nThreads_)
         for (size_t atom = 0; atom < nAtoms; ++atom) {
-            auto bSplines = makeBSplines(coordinates[atom], parameterAngMom + 1);
-            auto splineA = std::get<0>(bSplines);
-            auto splineB = std::get<1>(bSplines);
-            auto splineC = std::get<2>(bSplines);
-            probeGridImpl(atom, potentialGrid, nComponents, nForceComponents, splineA, splineB, splineC,
-                          fractionalPhis[0], parameters, forces[atom]);
+#ifdef _OPENMP
+            int threadID = omp_get_thread_num();
+#else
+            int threadID = 1;
+#endif
+            auto bSplines = makeBSplines<SplineType>(coordinates[atom], parameterAngMom + 1);
+            probeGridImpl(atom, potentialGrid, nComponents, nForceComponents, std::get<0>(bSplines),
+                          std::get<1>(bSplines), std::get<2>(bSplines), fractionalPhis_[threadID % nThreads_],
+                          parameters, forces[atom]);
         }
     }
 
@@ -3762,17 +7227,29 @@ class PMEInstance {
      *              Lx  = L - Ly - Lz
      * \endcode
      * \param forces a Nx3 matrix of the forces, ordered in memory as {Fx1,Fy1,Fz1,Fx2,Fy2,Fz2,....FxN,FyN,FzN}.
+     * \param atomEnergies if not null, a Nx1 matrix to which half of each atom's parameter times the potential at
+     *        that atom is added, in the same pass as the forces.  Only available for scalar parameters.
      */
-    void probeGrid(const Real *potentialGrid, int parameterAngMom, const RealMat &parameters, RealMat &forces) {
+    void probeGrid(const Real *potentialGrid, int parameterAngMom, const RealMat &parameters, RealMat &forces,
+                   RealMat *atomEnergies = nullptr) {
+        if (atomEnergies && parameterAngMom)
+            throw std::runtime_error("Per-atom energies are only available for scalar parameters.");
         updateAngMomIterator(parameterAngMom + 1);
         int nComponents = nCartesian(parameterAngMom);
         int nForceComponents = nCartesian(parameterAngMom + 1);
         const Real *paramPtr = parameters[0];
-        // Find how many multiples of the cache line size are needed
-        // to ensure that each thread hits a unique page.
-        size_t rowSize = std::ceil(nForceComponents / cacheLineSizeInReals_) * cacheLineSizeInReals_;
-        RealMat fractionalPhis(nThreads_, rowSize);
         size_t nAtoms = atomList_.size();
+        if (!parameterAngMom && useBrickedGrids_) {
+            const Real *brickedGrid = brickPotentialGrid(potentialGrid);
+#pragma omp parallel for num_threads(nThreads_)
+            for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber) {
+                const auto &entry = splineCache_[relativeAtomNumber];
+                const int &atom = entry.absoluteAtomNumber;
+                probeGridForceBrickedFxn_(this, brickedGrid, entry.aSpline, entry.bSpline, entry.cSpline,
+                                          paramPtr[atom], forces[atom], atomEnergies ? (*atomEnergies)[atom] : nullptr);
+            }
+            return;
+        }
 #pragma omp parallel for num_threads(nThreads_)
         for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber) {
             const auto &entry = splineCache_[relativeAtomNumber];
@@ -3786,11 +7263,12 @@ class PMEInstance {
 #else
                 int threadID = 1;
 #endif
-                Real *myScratch = fractionalPhis[threadID % nThreads_];
+                Real *myScratch = fractionalPhis_[threadID % nThreads_];
                 probeGridImpl(atom, potentialGrid, nComponents, nForceComponents, splineA, splineB, splineC, myScratch,
                               parameters, forces[atom]);
             } else {
-                probeGridImpl(potentialGrid, splineA, splineB, splineC, paramPtr[atom], forces[atom]);
+                probeGridForceFxn_(this, potentialGrid, splineA, splineB, splineC, paramPtr[atom], forces[atom],
+                                   atomEnergies ? (*atomEnergies)[atom] : nullptr);
             }
         }
     }
@@ -3818,6 +7296,19 @@ class PMEInstance {
         return slfEFxn_(parameterAngMom, parameters, kappa_, scaleFactor_);
     }
 
+    /*!
+     * \brief pairSeparation computes the vector from atom i to atom j, without allocating a temporary matrix.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param i the first atom of the pair.
+     * \param j the second atom of the pair.
+     * \param deltaR the array of three values to hold the separation vector.
+     * \return the squared distance between the atoms.
+     */
+    static Real pairSeparation(const RealMat &coordinates, int i, int j, Real *deltaR) {
+        for (int xyz = 0; xyz < 3; ++xyz) deltaR[xyz] = coordinates(j, xyz) - coordinates(i, xyz);
+        return deltaR[0] * deltaR[0] + deltaR[1] * deltaR[1] + deltaR[2] * deltaR[2];
+    }
+
     /*!
      * \brief computeEDir computes the direct space energy.  This is provided mostly for debugging and testing
      * purposes; generally the host program should provide the pairwise interactions. \param pairList dense list of
@@ -3850,9 +7341,9 @@ class PMEInstance {
         for (int pair = 0; pair < nPair; ++pair) {
             short i = pairList(pair, 0);
             short j = pairList(pair, 1);
-            auto deltaR = coordinates.row(j) - coordinates.row(i);
+            Real deltaR[3];
             // TODO: apply minimum image convention.
-            Real rSquared = deltaR.dot(deltaR);
+            Real rSquared = pairSeparation(coordinates, i, j, deltaR);
             energy += parameters(i, 0) * parameters(j, 0) * dirEFxn_(rSquared, kappaSquared);
         }
         return scaleFactor_ * energy;
@@ -3892,19 +7383,19 @@ class PMEInstance {
         for (int pair = 0; pair < nPair; ++pair) {
             short i = pairList(pair, 0);
             short j = pairList(pair, 1);
-            auto deltaR = coordinates.row(j) - coordinates.row(i);
+            Real deltaR[3];
             // TODO: apply minimum image convention.
-            Real rSquared = deltaR.dot(deltaR);
+            Real rSquared = pairSeparation(coordinates, i, j, deltaR);
             auto kernels = dirEFFxn_(rSquared, kappa_, kappaSquared);
             Real eKernel = std::get<0>(kernels);
             Real fKernel = std::get<1>(kernels);
             Real prefactor = scaleFactor_ * parameters(i, 0) * parameters(j, 0);
             energy += prefactor * eKernel;
             Real f = -prefactor * fKernel;
-            auto force = deltaR.row(0);
-            force *= f;
-            forces.row(i) -= force;
-            forces.row(j) += force;
+            for (int xyz = 0; xyz < 3; ++xyz) {
+                forces(i, xyz) -= f * deltaR[xyz];
+                forces(j, xyz) += f * deltaR[xyz];
+            }
         }
         return energy;
     }
@@ -3945,26 +7436,26 @@ class PMEInstance {
         for (int pair = 0; pair < nPair; ++pair) {
             short i = pairList(pair, 0);
             short j = pairList(pair, 1);
-            auto deltaR = coordinates.row(j) - coordinates.row(i);
+            Real deltaR[3];
             // TODO: apply minimum image convention.
-            Real rSquared = deltaR.dot(deltaR);
+            Real rSquared = pairSeparation(coordinates, i, j, deltaR);
             auto kernels = dirEFFxn_(rSquared, kappa_, kappaSquared);
             Real eKernel = std::get<0>(kernels);
             Real fKernel = std::get<1>(kernels);
             Real prefactor = scaleFactor_ * parameters(i, 0) * parameters(j, 0);
             energy += prefactor * eKernel;
             Real f = -prefactor * fKernel;
-            RealMat dRCopy = deltaR.clone();
-            auto force = dRCopy.row(0);
-            force *= f;
-            forces.row(i) -= force;
-            forces.row(j) += force;
-            virial[0][0] += force[0] * deltaR[0][0];
-            virial[0][1] += 0.5f * (force[0] * deltaR[0][1] + force[1] * deltaR[0][0]);
-            virial[0][2] += force[1] * deltaR[0][1];
-            virial[0][3] += 0.5f * (force[0] * deltaR[0][2] + force[2] * deltaR[0][0]);
-            virial[0][4] += 0.5f * (force[1] * deltaR[0][2] + force[2] * deltaR[0][1]);
-            virial[0][5] += force[2] * deltaR[0][2];
+            Real force[3] = {f * deltaR[0], f * deltaR[1], f * deltaR[2]};
+            for (int xyz = 0; xyz < 3; ++xyz) {
+                forces(i, xyz) -= force[xyz];
+                forces(j, xyz) += force[xyz];
+            }
+            virial[0][0] += force[0] * deltaR[0];
+            virial[0][1] += 0.5f * (force[0] * deltaR[1] + force[1] * deltaR[0]);
+            virial[0][2] += force[1] * deltaR[1];
+            virial[0][3] += 0.5f * (force[0] * deltaR[2] + force[2] * deltaR[0]);
+            virial[0][4] += 0.5f * (force[1] * deltaR[2] + force[2] * deltaR[1]);
+            virial[0][5] += force[2] * deltaR[2];
         }
         return energy;
     }
@@ -4002,9 +7493,9 @@ class PMEInstance {
         for (int pair = 0; pair < nPair; ++pair) {
             short i = pairList(pair, 0);
             short j = pairList(pair, 1);
-            auto deltaR = coordinates.row(j) - coordinates.row(i);
+            Real deltaR[3];
             // TODO: apply minimum image convention.
-            Real rSquared = deltaR.dot(deltaR);
+            Real rSquared = pairSeparation(coordinates, i, j, deltaR);
             energy += parameters(i, 0) * parameters(j, 0) * adjEFxn_(rSquared, kappaSquared);
         }
         return scaleFactor_ * energy;
@@ -4044,19 +7535,19 @@ class PMEInstance {
         for (int pair = 0; pair < nPair; ++pair) {
             short i = pairList(pair, 0);
             short j = pairList(pair, 1);
-            auto deltaR = coordinates.row(j) - coordinates.row(i);
+            Real deltaR[3];
             // TODO: apply minimum image convention.
-            Real rSquared = deltaR.dot(deltaR);
+            Real rSquared = pairSeparation(coordinates, i, j, deltaR);
             auto kernels = adjEFFxn_(rSquared, kappa_, kappaSquared);
             Real eKernel = std::get<0>(kernels);
             Real fKernel = std::get<1>(kernels);
             Real prefactor = scaleFactor_ * parameters(i, 0) * parameters(j, 0);
             energy += prefactor * eKernel;
             Real f = -prefactor * fKernel;
-            auto force = deltaR.row(0);
-            force *= f;
-            forces.row(i) -= force;
-            forces.row(j) += force;
+            for (int xyz = 0; xyz < 3; ++xyz) {
+                forces(i, xyz) -= f * deltaR[xyz];
+                forces(j, xyz) += f * deltaR[xyz];
+            }
         }
         return energy;
     }
@@ -4097,26 +7588,26 @@ class PMEInstance {
         for (int pair = 0; pair < nPair; ++pair) {
             short i = pairList(pair, 0);
             short j = pairList(pair, 1);
-            auto deltaR = coordinates.row(j) - coordinates.row(i);
+            Real deltaR[3];
             // TODO: apply minimum image convention.
-            Real rSquared = deltaR.dot(deltaR);
+            Real rSquared = pairSeparation(coordinates, i, j, deltaR);
             auto kernels = adjEFFxn_(rSquared, kappa_, kappaSquared);
             Real eKernel = std::get<0>(kernels);
             Real fKernel = std::get<1>(kernels);
             Real prefactor = scaleFactor_ * parameters(i, 0) * parameters(j, 0);
             energy += prefactor * eKernel;
             Real f = -prefactor * fKernel;
-            RealMat dRCopy = deltaR.clone();
-            auto force = dRCopy.row(0);
-            force *= f;
-            forces.row(i) -= force;
-            forces.row(j) += force;
-            virial[0][0] += force[0] * deltaR[0][0];
-            virial[0][1] += 0.5f * (force[0] * deltaR[0][1] + force[1] * deltaR[0][0]);
-            virial[0][2] += force[1] * deltaR[0][1];
-            virial[0][3] += 0.5f * (force[0] * deltaR[0][2] + force[2] * deltaR[0][0]);
-            virial[0][4] += 0.5f * (force[1] * deltaR[0][2] + force[2] * deltaR[0][1]);
-            virial[0][5] += force[2] * deltaR[0][2];
+            Real force[3] = {f * deltaR[0], f * deltaR[1], f * deltaR[2]};
+            for (int xyz = 0; xyz < 3; ++xyz) {
+                forces(i, xyz) -= force[xyz];
+                forces(j, xyz) += force[xyz];
+            }
+            virial[0][0] += force[0] * deltaR[0];
+            virial[0][1] += 0.5f * (force[0] * deltaR[1] + force[1] * deltaR[0]);
+            virial[0][2] += force[1] * deltaR[1];
+            virial[0][3] += 0.5f * (force[0] * deltaR[2] + force[2] * deltaR[0]);
+            virial[0][4] += 0.5f * (force[1] * deltaR[2] + force[2] * deltaR[1]);
+            virial[0][5] += force[2] * deltaR[2];
         }
         return energy;
     }
@@ -4151,28 +7642,218 @@ class PMEInstance {
         sanityChecks(parameterAngMom, parameters, coordinates);
         updateAngMomIterator(std::max(parameterAngMom, derivativeLevel));
 
-        // Note: we're calling the version of spread parameters that computes its own splines here.
-        // This is quite inefficient, but allow the potential to be computed at arbitrary locations by
-        // simply regenerating splines on demand in the probing stage.  If this becomes too slow, it's
-        // easy to write some logic to check whether gridPoints and coordinates are the same, and
-        // handle that special case using spline cacheing machinery for efficiency.
-        auto realGrid = spreadParameters(parameterAngMom, parameters, coordinates);
-        auto gridAddress = forwardTransform(realGrid);
+        // When the potential is needed at the atoms themselves, the spline cache can be used for both spreading and
+        // probing.  Otherwise, we call the version of spread parameters that computes its own splines, and probe the
+        // arbitrary locations in blocks whose splines are built on the fly.
+        bool probeAtAtoms = gridPoints.nRows() == coordinates.nRows() && gridPoints.nCols() == coordinates.nCols() &&
+                            std::equal(gridPoints[0], gridPoints[0] + gridPoints.nRows() * gridPoints.nCols(),
+                                       coordinates[0]);
+        Real *realGrid;
+        if (probeAtAtoms) {
+            filterAtomsAndBuildSplineCache(std::max(parameterAngMom, derivativeLevel), coordinates);
+            realGrid = spreadParameters(parameterAngMom, parameters);
+        } else {
+            realGrid = spreadParameters(parameterAngMom, parameters, coordinates);
+        }
+        auto gridAddress = forwardTransform(realGrid, probeAtAtoms);
         convolveE(gridAddress);
-        const auto potentialGrid = inverseTransform(gridAddress);
-        auto fracPotential = potential.clone();
+        const auto potentialGrid = inverseTransform(gridAddress, probeAtAtoms);
+        if (!probeAtAtoms) {
+            probePoints(potentialGrid, gridPoints[0], gridPoints.nRows(), derivativeLevel, potential[0]);
+            return;
+        }
+
+        RealMat fracPotential(potential.nRows(), potential.nCols());
         int nPotentialComponents = nCartesian(derivativeLevel);
-        size_t nPoints = gridPoints.nRows();
-        for (size_t point = 0; point < nPoints; ++point) {
-            auto bSplines = makeBSplines(gridPoints[point], derivativeLevel);
-            auto splineA = std::get<0>(bSplines);
-            auto splineB = std::get<1>(bSplines);
-            auto splineC = std::get<2>(bSplines);
-            probeGridImpl(potentialGrid, nPotentialComponents, splineA, splineB, splineC, fracPotential[point]);
+        size_t nAtoms = atomList_.size();
+#pragma omp parallel for num_threads(nThreads_)
+        for (size_t relativeAtomNumber = 0; relativeAtomNumber < nAtoms; ++relativeAtomNumber) {
+            const auto &entry = splineCache_[relativeAtomNumber];
+            probeGridPotentialFxn_(this, potentialGrid, nPotentialComponents, entry.aSpline, entry.bSpline,
+                                   entry.cSpline, fracPotential[entry.absoluteAtomNumber]);
         }
         potential += cartesianTransform(derivativeLevel, scaledRecVecs_, fracPotential);
     }
 
+    /*!
+     * \brief Runs the reciprocal space convolution and keeps the resulting potential grid, so that the potential
+     *        can then be evaluated at any number of arbitrary points by probePotentialGridRec().  This suits
+     *        jobs that probe many more points than there are atoms, such as electrostatic potential fitting or
+     *        exporting the potential on a grid.  The stored grid is only valid until the parameters, coordinates or
+     *        lattice change, at which point this must be called again.
+     * \param parameterAngMom the angular momentum of the parameters (0 for charges, C6 coefficients, 2 for
+     *        quadrupoles, etc.).
+     * \param parameters the list of parameters associated with each atom (charges, C6 coefficients, multipoles,
+     *        etc...).  See computePRec() for details of the ordering.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     */
+    void computePotentialGridRec(int parameterAngMom, const RealMat &parameters, const RealMat &coordinates) {
+        sanityChecks(parameterAngMom, parameters, coordinates);
+        filterAtomsAndBuildSplineCache(parameterAngMom, coordinates);
+
+        auto realGrid = spreadParameters(parameterAngMom, parameters);
+        auto gridAddress = forwardTransform(realGrid, true);
+        convolveE(gridAddress);
+        const auto potentialGrid = inverseTransform(gridAddress);
+        storedPotentialGrid_.assign(potentialGrid, potentialGrid + static_cast<size_t>(myDimA_) * myDimB_ * myDimC_);
+    }
+
+    /*!
+     * \brief Evaluates the potential, and optionally its derivatives, at arbitrary points, using the grid kept by
+     *        the most recent call to computePotentialGridRec().  The points may be streamed through in chunks of any
+     *        size by repeated calls; the results are written straight into the caller's memory.
+     * \param points the cartesian coordinates of the points, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param nPoints the number of points.
+     * \param derivativeLevel the order of the potential derivatives required; 0 is the potential, 1 is (minus) the
+     *        field, etc.
+     * \param potential pointer to the nPoints x nD potential, where nD is the number of components up to and
+     *        including derivativeLevel, ordered as described for the parameters in computePRec().  This array is
+     *        incremented, not assigned.
+     */
+    void probePotentialGridRec(const Real *points, size_t nPoints, int derivativeLevel, Real *potential) {
+        if (storedPotentialGrid_.empty())
+            throw std::runtime_error("computePotentialGridRec must be called before probePotentialGridRec.");
+        probePoints(storedPotentialGrid_.data(), points, nPoints, derivativeLevel, potential);
+    }
+
+    /*!
+     * \brief Sets up Monte Carlo trial moves of scalar parameters (charges, C6 coefficients, etc.), computing the
+     *        reciprocal space energy of the initial state, which becomes the accepted state.  The potential grid of
+     *        the accepted state is kept, so that the energy change of moving a few atoms can then be computed by
+     *        computeTrialMoveDeltaERec() from their old and new stencils alone, without spreading or transforming.
+     *        This must be called again after the lattice changes, and is only supported on a single node.
+     * \param parameters the nAtoms x 1 matrix of scalar parameters.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \return the reciprocal space energy of the initial state.
+     */
+    Real initializeTrialMovesRec(const RealMat &parameters, const RealMat &coordinates) {
+        sanityChecks(0, parameters, coordinates);
+        if (numNodesA_ * numNodesB_ * numNodesC_ != 1)
+            throw std::runtime_error("Monte Carlo trial moves are only supported on a single node.");
+
+        // The potential due to a unit parameter at the origin gives the interaction between any two grid points.
+        size_t gridSize = static_cast<size_t>(dimA_) * dimB_ * dimC_;
+        Real *unitGrid = reinterpret_cast<Real *>(workSpace1_.data());
+        std::fill(unitGrid, unitGrid + gridSize, Real(0));
+        unitGrid[0] = 1;
+        auto gridAddress = forwardTransform(unitGrid);
+        convolveE(gridAddress);
+        const Real *unitPotential = inverseTransform(gridAddress);
+        unitPotentialGrid_.assign(unitPotential, unitPotential + gridSize);
+
+        acceptedParameters_ = RealMat(parameters.nRows(), 1);
+        std::copy(parameters[0], parameters[0] + parameters.nRows(), acceptedParameters_[0]);
+        acceptedCoordinates_ = RealMat(coordinates.nRows(), 3);
+        std::copy(coordinates[0], coordinates[0] + 3 * coordinates.nRows(), acceptedCoordinates_[0]);
+        acceptedRecVecs_ = RealMat(3, 3);
+        std::copy(recVecs_[0], recVecs_[0] + 9, acceptedRecVecs_[0]);
+        trialAtoms_.clear();
+        spreadAcceptedState();
+        return refreshAcceptedPotential();
+    }
+
+    /*!
+     * \brief Computes the change in reciprocal space energy for a Monte Carlo trial move of a few atoms, relative to
+     *        the accepted state set up by initializeTrialMovesRec().  The change to the charge grid, d, comprises
+     *        the moved atoms' old stencils weighted by minus their old parameters and their new stencils weighted by
+     *        their new parameters.  The energy change is d.phi + d.K.d / 2, where phi is the accepted potential grid
+     *        and K the interaction between grid points; the second term corrects for the moved atoms interacting
+     *        with themselves through the accepted potential.  The move is kept pending until acceptTrialMove() is
+     *        called; calling this again replaces it, which is how a move is rejected.
+     * \param nMovedAtoms the number of atoms being moved.
+     * \param movedAtoms the list of nMovedAtoms distinct atom numbers being moved.
+     * \param newParameters the nMovedAtoms x 1 matrix of the moved atoms' new parameters.
+     * \param newCoordinates the nMovedAtoms x 3 matrix of the moved atoms' new cartesian coordinates.
+     * \return the change in reciprocal space energy that accepting the move would cause.
+     */
+    Real computeTrialMoveDeltaERec(int nMovedAtoms, const int *movedAtoms, const RealMat &newParameters,
+                                   const RealMat &newCoordinates) {
+        if (acceptedChargeGrid_.empty())
+            throw std::runtime_error("initializeTrialMovesRec must be called before computeTrialMoveDeltaERec.");
+        if (!std::equal(recVecs_[0], recVecs_[0] + 9, acceptedRecVecs_[0]))
+            throw std::runtime_error("The lattice has changed since initializeTrialMovesRec was called.");
+        if (newParameters.nRows() != static_cast<size_t>(nMovedAtoms) || newParameters.nCols() != 1)
+            throw std::runtime_error("The new parameters should be a matrix of dimension nMovedAtoms x 1.");
+        if (newCoordinates.nRows() != static_cast<size_t>(nMovedAtoms) || newCoordinates.nCols() != 3)
+            throw std::runtime_error("The new coordinates should be a matrix of dimension nMovedAtoms x 3.");
+        int nAtoms = acceptedCoordinates_.nRows();
+        for (int move = 0; move < nMovedAtoms; ++move) {
+            if (movedAtoms[move] < 0 || movedAtoms[move] >= nAtoms)
+                throw std::runtime_error("The moved atom numbers must be in the range [0, nAtoms).");
+            if (std::find(movedAtoms, movedAtoms + move, movedAtoms[move]) != movedAtoms + move)
+                throw std::runtime_error("Each atom may only appear once in a trial move.");
+        }
+        if (acceptedPotentialIsStale_) refreshAcceptedPotential();
+
+        trialAtoms_.assign(movedAtoms, movedAtoms + nMovedAtoms);
+        trialParameters_.assign(newParameters[0], newParameters[0] + nMovedAtoms);
+        trialCoordinates_.assign(newCoordinates[0], newCoordinates[0] + 3 * nMovedAtoms);
+        trialStencil_.clear();
+        trialParameterChange_ = 0;
+        for (int move = 0; move < nMovedAtoms; ++move) {
+            int atom = movedAtoms[move];
+            addToTrialStencil(acceptedCoordinates_[atom], -acceptedParameters_(atom, 0));
+            addToTrialStencil(newCoordinates[move], newParameters(move, 0));
+            trialParameterChange_ += newParameters(move, 0) - acceptedParameters_(atom, 0);
+        }
+
+        const Real *potentialGrid = acceptedPotentialGrid_.data();
+        const Real *unitPotential = unitPotentialGrid_.data();
+        int nPoints = trialStencil_.size();
+        Real fieldTerm = 0, selfTerm = 0;
+#pragma omp parallel for reduction(+ : fieldTerm, selfTerm) num_threads(nThreads_)
+        for (int point = 0; point < nPoints; ++point) {
+            const auto &entry = trialStencil_[point];
+            short a = std::get<0>(entry);
+            short b = std::get<1>(entry);
+            short c = std::get<2>(entry);
+            Real weight = std::get<3>(entry);
+            fieldTerm += weight * potentialGrid[(c * dimB_ + b) * dimA_ + a];
+            Real pairSum = 0;
+            for (const auto &other : trialStencil_) {
+                int deltaA = a - std::get<0>(other);
+                int deltaB = b - std::get<1>(other);
+                int deltaC = c - std::get<2>(other);
+                deltaA += deltaA < 0 ? dimA_ : 0;
+                deltaB += deltaB < 0 ? dimB_ : 0;
+                deltaC += deltaC < 0 ? dimC_ : 0;
+                pairSum += std::get<3>(other) * unitPotential[(deltaC * dimB_ + deltaB) * dimA_ + deltaA];
+            }
+            selfTerm += weight * pairSum;
+        }
+        // The m=0 term of the rPower>3 kernels is half of its prefactor times the squared sum of parameters.
+        Real parameterSum = acceptedParameterSum_;
+        Real zeroTermChange = zeroWavevectorPrefactor() * trialParameterChange_ *
+                              (parameterSum + trialParameterChange_ / 2);
+        return fieldTerm + selfTerm / 2 + zeroTermChange;
+    }
+
+    /*!
+     * \brief Accepts the trial move most recently passed to computeTrialMoveDeltaERec(), making it part of the
+     *        accepted state.  Only the moved atoms' stencils are updated on the accepted charge grid; the potential
+     *        grid is recomputed from it by the next call to computeTrialMoveDeltaERec(), so consecutive accepts only
+     *        cost one transform.  To stop roundoff accumulating, the charge grid is spread from scratch after every
+     *        IncrementalRefreshInterval accepted moves.  If no move is pending, e.g. because the last one was already
+     *        accepted or it moved no atoms, this does nothing.
+     */
+    void acceptTrialMove() {
+        if (trialAtoms_.empty()) return;
+        for (const auto &entry : trialStencil_) {
+            size_t point = (static_cast<size_t>(std::get<2>(entry)) * dimB_ + std::get<1>(entry)) * dimA_ +
+                           std::get<0>(entry);
+            acceptedChargeGrid_[point] += std::get<3>(entry);
+        }
+        for (size_t move = 0; move < trialAtoms_.size(); ++move) {
+            int atom = trialAtoms_[move];
+            acceptedParameters_(atom, 0) = trialParameters_[move];
+            std::copy(&trialCoordinates_[3 * move], &trialCoordinates_[3 * move] + 3, acceptedCoordinates_[atom]);
+        }
+        acceptedParameterSum_ += trialParameterChange_;
+        acceptedPotentialIsStale_ = true;
+        trialAtoms_.clear();
+        if (++acceptedMoveCount_ >= IncrementalRefreshInterval) spreadAcceptedState();
+    }
+
     /*!
      * \brief Runs a PME reciprocal space calculation, computing energies.
      * \param parameterAngMom the angular momentum of the parameters (0 for charges, C6 coefficients, 2 for
@@ -4195,10 +7876,9 @@ class PMEInstance {
      */
     Real computeERec(int parameterAngMom, const RealMat &parameters, const RealMat &coordinates) {
         sanityChecks(parameterAngMom, parameters, coordinates);
-        filterAtomsAndBuildSplineCache(parameterAngMom, coordinates);
 
-        auto realGrid = spreadParameters(parameterAngMom, parameters);
-        auto gridAddress = forwardTransform(realGrid);
+        auto realGrid = buildCacheAndSpreadParameters(parameterAngMom, parameterAngMom, parameters, coordinates);
+        auto gridAddress = forwardTransform(realGrid, true);
         return convolveE(gridAddress);
     }
 
@@ -4227,12 +7907,10 @@ class PMEInstance {
     Real computeEFRec(int parameterAngMom, const RealMat &parameters, const RealMat &coordinates, RealMat &forces) {
         sanityChecks(parameterAngMom, parameters, coordinates);
         // Spline derivative level bumped by 1, for energy gradients.
-        filterAtomsAndBuildSplineCache(parameterAngMom + 1, coordinates);
-
-        auto realGrid = spreadParameters(parameterAngMom, parameters);
-        auto gridAddress = forwardTransform(realGrid);
+        auto realGrid = buildCacheAndSpreadParameters(parameterAngMom, parameterAngMom + 1, parameters, coordinates);
+        auto gridAddress = forwardTransform(realGrid, true);
         Real energy = convolveE(gridAddress);
-        const auto potentialGrid = inverseTransform(gridAddress);
+        const auto potentialGrid = inverseTransform(gridAddress, true);
         probeGrid(potentialGrid, parameterAngMom, parameters, forces);
 
         return energy;
@@ -4267,17 +7945,111 @@ class PMEInstance {
         sanityChecks(parameterAngMom, parameters, coordinates);
 
         // Spline derivative level bumped by 1, for energy gradients.
-        filterAtomsAndBuildSplineCache(parameterAngMom + 1, coordinates);
-
-        auto realGrid = spreadParameters(parameterAngMom, parameters);
-        auto gridPtr = forwardTransform(realGrid);
+        auto realGrid = buildCacheAndSpreadParameters(parameterAngMom, parameterAngMom + 1, parameters, coordinates);
+        auto gridPtr = forwardTransform(realGrid, true);
         Real energy = convolveEV(gridPtr, virial);
-        const auto potentialGrid = inverseTransform(gridPtr);
+        const auto potentialGrid = inverseTransform(gridPtr, true);
         probeGrid(potentialGrid, parameterAngMom, parameters, forces);
 
         return energy;
     }
 
+    /*!
+     * \brief Runs a PME reciprocal space calculation for scalar parameters, computing energies, forces and the
+     *        reciprocal space energy of each atom, defined as half of its parameter times the potential at its site.
+     *        The per-atom energies are accumulated in the same pass as the forces and need no extra transforms.
+     * \param parameters the list of scalar (angular momentum zero) parameters associated with each atom, such as
+     *        charges or C6 coefficients, as a matrix of dimension nAtoms x 1.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param forces a Nx3 matrix of the forces, ordered in memory as {Fx1,Fy1,Fz1,Fx2,Fy2,Fz2,....FxN,FyN,FzN}.
+     *        This matrix is incremented, not assigned.
+     * \param atomEnergies a Nx1 matrix of the per-atom energies, which sum to the reciprocal space energy.
+     *        This matrix is incremented, not assigned.
+     * \return the reciprocal space energy.
+     */
+    Real computeEFRecPerAtom(const RealMat &parameters, const RealMat &coordinates, RealMat &forces,
+                             RealMat &atomEnergies) {
+        return computeRecPerAtom(parameters, coordinates, forces, nullptr, atomEnergies, nullptr);
+    }
+
+    /*!
+     * \brief Runs a PME reciprocal space calculation for scalar parameters, computing energies, forces, the virial
+     *        and their per-atom decompositions.  The per-atom virials require six extra inverse transforms.
+     * \param parameters the list of scalar (angular momentum zero) parameters associated with each atom, such as
+     *        charges or C6 coefficients, as a matrix of dimension nAtoms x 1.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param forces a Nx3 matrix of the forces, ordered in memory as {Fx1,Fy1,Fz1,Fx2,Fy2,Fz2,....FxN,FyN,FzN}.
+     *        This matrix is incremented, not assigned.
+     * \param virial a vector of length 6 containing the unique virial elements, in the order XX XY YY XZ YZ ZZ.
+     *        This vector is incremented, not assigned.
+     * \param atomEnergies a Nx1 matrix of the per-atom energies, which sum to the reciprocal space energy.
+     *        This matrix is incremented, not assigned.
+     * \param atomVirials a Nx6 matrix of the per-atom virials, in the order XX XY YY XZ YZ ZZ, which sum to the
+     *        virial.  This matrix is incremented, not assigned.
+     * \return the reciprocal space energy.
+     */
+    Real computeEFVRecPerAtom(const RealMat &parameters, const RealMat &coordinates, RealMat &forces, RealMat &virial,
+                              RealMat &atomEnergies, RealMat &atomVirials) {
+        return computeRecPerAtom(parameters, coordinates, forces, &virial, atomEnergies, &atomVirials);
+    }
+
+    /*!
+     * \brief Runs a PME reciprocal space calculation for several sets of scalar parameters at once, computing the
+     *        energy.
+     * \param parameters a matrix of dimension nAtoms x nGrids, where each column holds a separate set of scalar
+     *        (angular momentum zero) parameters, such as charges or C6 coefficients.  All sets share this instance's
+     *        kernel, grid and splines; the splines are built once and each atom is spread onto all grids in one pass.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param weights a vector of nGrids weights applied to the contributions from each parameter set, or an empty
+     *        matrix to use unit weights.  Signed weights allow cross terms between two parameter sets a and b to be
+     *        formed from the sets (a+b) and (a-b), as needed for Lorentz-Berthelot combination rules in LJ-PME.
+     * \return the weighted sum of the reciprocal space energies from each parameter set.
+     */
+    Real computeERecMultiGrid(const RealMat &parameters, const RealMat &coordinates,
+                              const RealMat &weights = RealMat()) {
+        return computeRecMultiGrid(parameters, coordinates, weights, nullptr, nullptr);
+    }
+
+    /*!
+     * \brief Runs a PME reciprocal space calculation for several sets of scalar parameters at once, computing the
+     *        energy and forces.
+     * \param parameters a matrix of dimension nAtoms x nGrids, where each column holds a separate set of scalar
+     *        (angular momentum zero) parameters, such as charges or C6 coefficients.  All sets share this instance's
+     *        kernel, grid and splines; the splines are built once and each atom is spread onto all grids in one pass.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param forces a Nx3 matrix of the forces, summed over all parameter sets, ordered in memory as
+     *        {Fx1,Fy1,Fz1,Fx2,Fy2,Fz2,....FxN,FyN,FzN}.  This matrix is incremented, not assigned.
+     * \param weights a vector of nGrids weights applied to the contributions from each parameter set, or an empty
+     *        matrix to use unit weights.  Signed weights allow cross terms between two parameter sets a and b to be
+     *        formed from the sets (a+b) and (a-b), as needed for Lorentz-Berthelot combination rules in LJ-PME.
+     * \return the weighted sum of the reciprocal space energies from each parameter set.
+     */
+    Real computeEFRecMultiGrid(const RealMat &parameters, const RealMat &coordinates, RealMat &forces,
+                               const RealMat &weights = RealMat()) {
+        return computeRecMultiGrid(parameters, coordinates, weights, &forces, nullptr);
+    }
+
+    /*!
+     * \brief Runs a PME reciprocal space calculation for several sets of scalar parameters at once, computing the
+     *        energy, forces and the virial.
+     * \param parameters a matrix of dimension nAtoms x nGrids, where each column holds a separate set of scalar
+     *        (angular momentum zero) parameters, such as charges or C6 coefficients.  All sets share this instance's
+     *        kernel, grid and splines; the splines are built once and each atom is spread onto all grids in one pass.
+     * \param coordinates the cartesian coordinates, ordered in memory as {x1,y1,z1,x2,y2,z2,....xN,yN,zN}.
+     * \param forces a Nx3 matrix of the forces, summed over all parameter sets, ordered in memory as
+     *        {Fx1,Fy1,Fz1,Fx2,Fy2,Fz2,....FxN,FyN,FzN}.  This matrix is incremented, not assigned.
+     * \param virial a vector of length 6 containing the unique virial elements, summed over all parameter sets, in
+     *        the order XX XY YY XZ YZ ZZ.  This vector is incremented, not assigned.
+     * \param weights a vector of nGrids weights applied to the contributions from each parameter set, or an empty
+     *        matrix to use unit weights.  Signed weights allow cross terms between two parameter sets a and b to be
+     *        formed from the sets (a+b) and (a-b), as needed for Lorentz-Berthelot combination rules in LJ-PME.
+     * \return the weighted sum of the reciprocal space energies from each parameter set.
+     */
+    Real computeEFVRecMultiGrid(const RealMat &parameters, const RealMat &coordinates, RealMat &forces,
+                                RealMat &virial, const RealMat &weights = RealMat()) {
+        return computeRecMultiGrid(parameters, coordinates, weights, &forces, &virial);
+    }
+
     /*!
      * \brief Runs a full (direct and reciprocal space) PME calculation, computing the energy.  The direct space
      *        implementation here is not totally optimal, so this routine should primarily be used for testing and
@@ -4391,6 +8163,27 @@ class PMEInstance {
         return energy;
     }
 
+#if HAVE_FFTW == 1
+    /*!
+     * \brief importFFTWisdom loads FFT plans saved by exportFFTWisdom(), so that setting up with a measured planning
+     *        rigor can reuse them instead of timing the candidate algorithms again.  The wisdom is shared by all
+     *        instances of the same precision, and should be imported before setup() to take effect.
+     * \param filename the name of the wisdom file.
+     * \return whether the wisdom was imported; this is false if the file does not exist yet, e.g. on the first run.
+     */
+    static bool importFFTWisdom(const std::string &filename) { return FFTWWrapper<Real>::importWisdom(filename); }
+
+    /*!
+     * \brief exportFFTWisdom saves the FFT plans made so far by all instances of the same precision, for use by later
+     *        runs on the same type of node via importFFTWisdom().
+     * \param filename the name of the wisdom file.
+     */
+    static void exportFFTWisdom(const std::string &filename) {
+        if (!FFTWWrapper<Real>::exportWisdom(filename))
+            throw std::runtime_error("Unable to write the FFTW wisdom file " + filename + ".");
+    }
+#endif  // HAVE_FFTW
+
     /*!
      * \brief setup initializes this object for a PME calculation using only threading.
      *        This may be called repeatedly without compromising performance.
@@ -4404,8 +8197,10 @@ class PMEInstance {
      *        1 / [4 pi epslion0] for Coulomb calculations).
      * \param nThreads the maximum number of threads to use for each MPI instance; if set to 0 all available threads
      * are used.
+     * \param planningRigor the amount of effort spent planning the FFTs.
      */
-    void setup(int rPower, Real kappa, int splineOrder, int dimA, int dimB, int dimC, Real scaleFactor, int nThreads) {
+    void setup(int rPower, Real kappa, int splineOrder, int dimA, int dimB, int dimC, Real scaleFactor, int nThreads,
+               FFTPlanningRigor planningRigor = FFTPlanningRigor::Estimate) {
         numNodesHasChanged_ = numNodesA_ != 1 || numNodesB_ != 1 || numNodesC_ != 1;
         numNodesA_ = numNodesB_ = numNodesC_ = 1;
         rankA_ = rankB_ = rankC_ = 0;
@@ -4419,7 +8214,7 @@ class PMEInstance {
         myDimA_ = dimA;
         myDimB_ = dimB;
         myDimC_ = dimC;
-        common_init(rPower, kappa, splineOrder, dimA, dimB, dimC, scaleFactor, nThreads);
+        common_init(rPower, kappa, splineOrder, dimA, dimB, dimC, scaleFactor, nThreads, planningRigor);
     }
 
     /*!
@@ -4439,10 +8234,11 @@ class PMEInstance {
      * \param numNodesA the number of nodes to be used for the A dimension.
      * \param numNodesB the number of nodes to be used for the B dimension.
      * \param numNodesC the number of nodes to be used for the C dimension.
+     * \param planningRigor the amount of effort spent planning the FFTs.
      */
     void setupParallel(int rPower, Real kappa, int splineOrder, int dimA, int dimB, int dimC, Real scaleFactor,
                        int nThreads, const MPI_Comm &communicator, NodeOrder nodeOrder, int numNodesA, int numNodesB,
-                       int numNodesC) {
+                       int numNodesC, FFTPlanningRigor planningRigor = FFTPlanningRigor::Estimate) {
         numNodesHasChanged_ = numNodesA_ != numNodesA || numNodesB_ != numNodesB || numNodesC_ != numNodesC;
 #if HAVE_MPI == 1
         mpiCommunicator_ =
@@ -4475,7 +8271,7 @@ class PMEInstance {
         lastB_ = rankB_ == numNodesB ? dimB : (rankB_ + 1) * myDimB_;
         lastC_ = rankC_ == numNodesC ? dimC : (rankC_ + 1) * myDimC_;
 
-        common_init(rPower, kappa, splineOrder, dimA, dimB, dimC, scaleFactor, nThreads);
+        common_init(rPower, kappa, splineOrder, dimA, dimB, dimC, scaleFactor, nThreads, planningRigor);
 
 #else   // Have MPI
         throw std::runtime_error(
@@ -4500,6 +8296,7 @@ using PMEInstanceF = helpme::PMEInstance<float>;
 
 typedef enum { XAligned = 0, ShapeMatrix = 1 } LatticeType;
 typedef enum { ZYX = 0 } NodeOrder;
+typedef enum { FFTEstimate = 0, FFTMeasure = 1, FFTPatient = 2 } FFTPlanningRigor;
 
 typedef struct PMEInstance PMEInstance;
 extern struct PMEInstance *helpme_createD();
@@ -4510,6 +8307,14 @@ extern void helpme_setupD(struct PMEInstance *pme, int rPower, double kappa, int
                           int cDim, double scaleFactor, int nThreads);
 extern void helpme_setupF(struct PMEInstance *pme, int rPower, float kappa, int splineOrder, int aDim, int bDim,
                           int cDim, float scaleFactor, int nThreads);
+extern void helpme_setup_plannedD(struct PMEInstance *pme, int rPower, double kappa, int splineOrder, int aDim,
+                                  int bDim, int cDim, double scaleFactor, int nThreads, FFTPlanningRigor planningRigor);
+extern void helpme_setup_plannedF(struct PMEInstance *pme, int rPower, float kappa, int splineOrder, int aDim,
+                                  int bDim, int cDim, float scaleFactor, int nThreads, FFTPlanningRigor planningRigor);
+extern int helpme_import_fft_wisdomD(const char *filename);
+extern int helpme_import_fft_wisdomF(const char *filename);
+extern void helpme_export_fft_wisdomD(const char *filename);
+extern void helpme_export_fft_wisdomF(const char *filename);
 #if HAVE_MPI == 1
 extern void helpme_setup_parallelD(PMEInstance *pme, int rPower, double kappa, int splineOrder, int dimA, int dimB,
                                    int dimC, double scaleFactor, int nThreads, MPI_Comm communicator,
@@ -4517,6 +8322,14 @@ extern void helpme_setup_parallelD(PMEInstance *pme, int rPower, double kappa, i
 extern void helpme_setup_parallelF(PMEInstance *pme, int rPower, float kappa, int splineOrder, int dimA, int dimB,
                                    int dimC, float scaleFactor, int nThreads, MPI_Comm communicator,
                                    NodeOrder nodeOrder, int numNodesA, int numNodesB, int numNodesC);
+extern void helpme_setup_parallel_plannedD(PMEInstance *pme, int rPower, double kappa, int splineOrder, int dimA,
+                                           int dimB, int dimC, double scaleFactor, int nThreads,
+                                           MPI_Comm communicator, NodeOrder nodeOrder, int numNodesA, int numNodesB,
+                                           int numNodesC, FFTPlanningRigor planningRigor);
+extern void helpme_setup_parallel_plannedF(PMEInstance *pme, int rPower, float kappa, int splineOrder, int dimA,
+                                           int dimB, int dimC, float scaleFactor, int nThreads, MPI_Comm communicator,
+                                           NodeOrder nodeOrder, int numNodesA, int numNodesB, int numNodesC,
+                                           FFTPlanningRigor planningRigor);
 #endif  // HAVE_MPI
 extern void helpme_set_lattice_vectorsD(struct PMEInstance *pme, double A, double B, double C, double kappa,
                                         double beta, double gamma, LatticeType latticeType);
@@ -0,0 +1,394 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_BUNDLED_FFT_H_
+#define _HELPME_BUNDLED_FFT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "fft_backend.h"
+#include "memory.h"
+
+/*!
+ * \file bundled_fft.h
+ * \brief Contains a self contained mixed radix FFT, which needs no external library.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The BundledFFT class performs complex to complex transforms of a single length, using a recursive, out of
+ *        place, mixed radix Cooley-Tukey algorithm with specialized butterflies for radices 2, 3, 4 and 5 and a
+ *        generic butterfly for any other prime factors.
+ */
+template <typename Real>
+class BundledFFT {
+    using Complex = std::complex<Real>;
+
+    /// The length of the transform.
+    size_t fftDimension_;
+    /// Pairs of {radix, remaining length} for each stage of the decomposition.
+    std::vector<size_t> factors_;
+    /// The largest radix that needs the generic butterfly, or zero if there are none.
+    size_t maxGenericRadix_;
+    /// The twiddle factors exp(-2 pi i k / n) for the forward transform.
+    helpme::vector<Complex> forwardTwiddles_;
+    /// The twiddle factors exp(2 pi i k / n) for the backward transform.
+    helpme::vector<Complex> backwardTwiddles_;
+
+    /// Multiply two complex numbers, without the checks for infinities done by std::complex.
+    static Complex mul(const Complex &a, const Complex &b) {
+        return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    void butterfly2(Complex *out, size_t fstride, const Complex *twiddles, size_t m) const {
+        for (size_t k = 0; k < m; ++k) {
+            Complex t = mul(out[k + m], twiddles[k * fstride]);
+            out[k + m] = out[k] - t;
+            out[k] += t;
+        }
+    }
+
+    void butterfly3(Complex *out, size_t fstride, const Complex *twiddles, size_t m) const {
+        Real sinThird = twiddles[fstride * m].imag();
+        for (size_t k = 0; k < m; ++k) {
+            Complex s1 = mul(out[k + m], twiddles[k * fstride]);
+            Complex s2 = mul(out[k + 2 * m], twiddles[2 * k * fstride]);
+            Complex sum = s1 + s2;
+            Complex difference = (s1 - s2) * sinThird;
+            Complex base = out[k] - Real(0.5) * sum;
+            out[k] += sum;
+            out[k + m] = Complex(base.real() - difference.imag(), base.imag() + difference.real());
+            out[k + 2 * m] = Complex(base.real() + difference.imag(), base.imag() - difference.real());
+        }
+    }
+
+    void butterfly4(Complex *out, size_t fstride, const Complex *twiddles, size_t m, bool backward) const {
+        for (size_t k = 0; k < m; ++k) {
+            Complex s0 = mul(out[k + m], twiddles[k * fstride]);
+            Complex s1 = mul(out[k + 2 * m], twiddles[2 * k * fstride]);
+            Complex s2 = mul(out[k + 3 * m], twiddles[3 * k * fstride]);
+            Complex s5 = out[k] - s1;
+            Complex s4 = s0 - s2;
+            Complex s3 = s0 + s2;
+            out[k] += s1;
+            out[k + 2 * m] = out[k] - s3;
+            out[k] += s3;
+            if (backward) {
+                out[k + m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+                out[k + 3 * m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+            } else {
+                out[k + m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+                out[k + 3 * m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+            }
+        }
+    }
+
+    void butterfly5(Complex *out, size_t fstride, const Complex *twiddles, size_t m) const {
+        Complex ya = twiddles[fstride * m];
+        Complex yb = twiddles[2 * fstride * m];
+        for (size_t k = 0; k < m; ++k) {
+            Complex s0 = out[k];
+            Complex s1 = mul(out[k + m], twiddles[k * fstride]);
+            Complex s2 = mul(out[k + 2 * m], twiddles[2 * k * fstride]);
+            Complex s3 = mul(out[k + 3 * m], twiddles[3 * k * fstride]);
+            Complex s4 = mul(out[k + 4 * m], twiddles[4 * k * fstride]);
+            Complex s7 = s1 + s4, s10 = s1 - s4, s8 = s2 + s3, s9 = s2 - s3;
+            out[k] = s0 + s7 + s8;
+            Complex s5 = s0 + s7 * ya.real() + s8 * yb.real();
+            Complex s6(s10.imag() * ya.imag() + s9.imag() * yb.imag(),
+                       -s10.real() * ya.imag() - s9.real() * yb.imag());
+            out[k + m] = s5 - s6;
+            out[k + 4 * m] = s5 + s6;
+            Complex s11 = s0 + s7 * yb.real() + s8 * ya.real();
+            Complex s12(-s10.imag() * yb.imag() + s9.imag() * ya.imag(),
+                        s10.real() * yb.imag() - s9.real() * ya.imag());
+            out[k + 2 * m] = s11 + s12;
+            out[k + 3 * m] = s11 - s12;
+        }
+    }
+
+    void butterflyGeneric(Complex *out, size_t fstride, const Complex *twiddles, size_t m, size_t p,
+                          Complex *scratch) const {
+        for (size_t u = 0; u < m; ++u) {
+            for (size_t q = 0; q < p; ++q) scratch[q] = out[u + q * m];
+            for (size_t q1 = 0; q1 < p; ++q1) {
+                size_t k = u + q1 * m;
+                size_t twiddleIndex = 0;
+                Complex sum = scratch[0];
+                for (size_t q = 1; q < p; ++q) {
+                    twiddleIndex += fstride * k;
+                    if (twiddleIndex >= fftDimension_) twiddleIndex %= fftDimension_;
+                    sum += mul(scratch[q], twiddles[twiddleIndex]);
+                }
+                out[k] = sum;
+            }
+        }
+    }
+
+    void work(Complex *out, const Complex *in, size_t fstride, size_t inStride, const size_t *factors,
+              const Complex *twiddles, bool backward, Complex *scratch) const {
+        size_t p = factors[0];
+        size_t m = factors[1];
+        if (m == 1) {
+            for (size_t q = 0; q < p; ++q) out[q] = in[q * fstride * inStride];
+        } else {
+            for (size_t q = 0; q < p; ++q)
+                work(out + q * m, in + q * fstride * inStride, fstride * p, inStride, factors + 2, twiddles, backward,
+                     scratch);
+        }
+        switch (p) {
+            case 2:
+                butterfly2(out, fstride, twiddles, m);
+                break;
+            case 3:
+                butterfly3(out, fstride, twiddles, m);
+                break;
+            case 4:
+                butterfly4(out, fstride, twiddles, m, backward);
+                break;
+            case 5:
+                butterfly5(out, fstride, twiddles, m);
+                break;
+            default:
+                butterflyGeneric(out, fstride, twiddles, m, p, scratch);
+                break;
+        }
+    }
+
+   public:
+    BundledFFT() : fftDimension_(0), maxGenericRadix_(0) {}
+    /*!
+     * \brief Sets up the factorization and twiddle factors for transforms of a given length.
+     * \param fftDimension the length of the transform.
+     */
+    explicit BundledFFT(size_t fftDimension) : fftDimension_(fftDimension), maxGenericRadix_(0) {
+        if (fftDimension == 0) throw std::runtime_error("Cannot plan a zero length FFT.");
+        // Peel off radix 4 first, then 2, 3, 5 and larger odd factors in turn.
+        size_t remaining = fftDimension;
+        size_t radix = 4;
+        size_t largestPossibleFactor = static_cast<size_t>(std::sqrt(static_cast<double>(remaining)));
+        while (remaining > 1) {
+            while (remaining % radix) {
+                radix = radix == 4 ? 2 : radix == 2 ? 3 : radix + 2;
+                if (radix > largestPossibleFactor) radix = remaining;
+            }
+            remaining /= radix;
+            factors_.push_back(radix);
+            factors_.push_back(remaining);
+            if (radix > 5) maxGenericRadix_ = std::max(maxGenericRadix_, radix);
+        }
+        if (factors_.empty()) {
+            factors_.push_back(1);
+            factors_.push_back(1);
+        }
+        forwardTwiddles_.resize(fftDimension);
+        backwardTwiddles_.resize(fftDimension);
+        for (size_t k = 0; k < fftDimension; ++k) {
+            long double phase = -2 * M_PI * static_cast<long double>(k) / fftDimension;
+            forwardTwiddles_[k] = Complex(static_cast<Real>(std::cos(phase)), static_cast<Real>(std::sin(phase)));
+            backwardTwiddles_[k] = std::conj(forwardTwiddles_[k]);
+        }
+    }
+
+    /// \return the length of the transform.
+    size_t size() const { return fftDimension_; }
+
+    /// \return the number of complex values of scratch space needed by transform().
+    size_t scratchSize() const { return maxGenericRadix_; }
+
+    /*!
+     * \brief transform does an out of place complex to complex FFT.
+     * \param inBuffer the location of the input data, which must not overlap the output.
+     * \param inStride the distance between consecutive input values.
+     * \param outBuffer the location of the contiguous output data.
+     * \param direction either FFTForward or FFTBackward.
+     * \param scratch at least scratchSize() complex values of scratch space.
+     */
+    void transform(const Complex *inBuffer, size_t inStride, Complex *outBuffer, int direction,
+                   Complex *scratch) const {
+        bool backward = direction == FFTBackward;
+        if (fftDimension_ == 1) {
+            outBuffer[0] = inBuffer[0];
+            return;
+        }
+        const Complex *twiddles = backward ? backwardTwiddles_.data() : forwardTwiddles_.data();
+        work(outBuffer, inBuffer, 1, inStride, factors_.data(), twiddles, backward, scratch);
+    }
+};
+
+/*!
+ * \brief The BundledFFTBatchPlan class transforms batches of lines using BundledFFT.  Real transforms of even length
+ *        are computed as complex transforms of half the length, by packing pairs of real values into each complex
+ *        value, while those of odd length use a full length complex transform.  Each thread keeps its own scratch
+ *        space, which is allocated the first time that thread needs it.
+ */
+template <typename Real>
+class BundledFFTBatchPlan : public FFTBatchPlan<Real> {
+    using Complex = std::complex<Real>;
+
+    /// The length of each transform.
+    size_t fftDimension_;
+    /// The number of lines in the batch.
+    size_t howMany_;
+    /// The distance between the starts of consecutive lines of real data.
+    size_t realDistance_;
+    /// The distance between the starts of consecutive lines of complex data.
+    size_t complexDistance_;
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+    /// Whether real transforms are computed as complex transforms of half the length.
+    bool halfLength_;
+    /// The complex transform used for each line.
+    BundledFFT<Real> fft_;
+    /// The twiddle factors exp(-2 pi i k / n) used to split the half length transform into the real transform.
+    helpme::vector<Complex> realTwiddles_;
+
+    /// \return this thread's scratch space, resized to hold at least the requested number of complex values.
+    static Complex *threadScratch(size_t size) {
+        static thread_local helpme::vector<Complex> scratch;
+        if (scratch.size() < size) scratch.resize(size);
+        return scratch.data();
+    }
+
+    void realToComplex(const Real *in, Complex *out, Complex *scratch) const {
+        size_t complexDim = fftDimension_ / 2 + 1;
+        if (!halfLength_) {
+            for (size_t n = 0; n < fftDimension_; ++n) scratch[n] = in[n];
+            fft_.transform(scratch, 1, scratch + fftDimension_, FFTForward, scratch + 2 * fftDimension_);
+            std::copy(scratch + fftDimension_, scratch + fftDimension_ + complexDim, out);
+            return;
+        }
+        // Transform z[j] = x[2j] + i x[2j+1], then separate the transforms of the even and odd points, E and O,
+        // to form X[k] = E[k] + exp(-2 pi i k / n) O[k].
+        size_t halfDim = fftDimension_ / 2;
+        for (size_t n = 0; n < halfDim; ++n) scratch[n] = Complex(in[2 * n], in[2 * n + 1]);
+        fft_.transform(scratch, 1, scratch + halfDim, FFTForward, scratch + 2 * halfDim);
+        const Complex *z = scratch + halfDim;
+        for (size_t k = 0; k <= halfDim; ++k) {
+            Complex zk = z[k % halfDim];
+            Complex zConj = std::conj(z[(halfDim - k) % halfDim]);
+            Complex even = Real(0.5) * (zk + zConj);
+            Complex odd = Complex(Real(0.5) * (zk - zConj).imag(), Real(-0.5) * (zk - zConj).real());
+            const Complex &w = realTwiddles_[k];
+            out[k] = Complex(even.real() + w.real() * odd.real() - w.imag() * odd.imag(),
+                             even.imag() + w.real() * odd.imag() + w.imag() * odd.real());
+        }
+    }
+
+    void complexToReal(const Complex *in, Real *out, Complex *scratch) const {
+        size_t complexDim = fftDimension_ / 2 + 1;
+        if (!halfLength_) {
+            for (size_t n = 0; n < complexDim; ++n) scratch[n] = in[n];
+            for (size_t n = complexDim; n < fftDimension_; ++n) scratch[n] = std::conj(in[fftDimension_ - n]);
+            fft_.transform(scratch, 1, scratch + fftDimension_, FFTBackward, scratch + 2 * fftDimension_);
+            for (size_t n = 0; n < fftDimension_; ++n) out[n] = scratch[fftDimension_ + n].real();
+            return;
+        }
+        // Reassemble Z[k] = 2 E[k] + 2 i O[k] from the unique values of X, then transform back to get the even and
+        // odd points as the real and imaginary parts, scaled by the full length as for an unnormalized transform.
+        size_t halfDim = fftDimension_ / 2;
+        for (size_t k = 0; k < halfDim; ++k) {
+            Complex xConj = std::conj(in[halfDim - k]);
+            Complex sum = in[k] + xConj;
+            Complex difference = in[k] - xConj;
+            const Complex &w = realTwiddles_[k];
+            // difference * conj(w) gives 2 O[k], which is then multiplied by i.
+            Complex odd(difference.real() * w.real() + difference.imag() * w.imag(),
+                        difference.imag() * w.real() - difference.real() * w.imag());
+            scratch[k] = Complex(sum.real() - odd.imag(), sum.imag() + odd.real());
+        }
+        fft_.transform(scratch, 1, scratch + halfDim, FFTBackward, scratch + 2 * halfDim);
+        for (size_t n = 0; n < halfDim; ++n) {
+            out[2 * n] = scratch[halfDim + n].real();
+            out[2 * n + 1] = scratch[halfDim + n].imag();
+        }
+    }
+
+    size_t scratchSize() const { return 2 * fft_.size() + fft_.scratchSize(); }
+
+   public:
+    /*!
+     * \brief Sets up the transforms of a batch of lines.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     */
+    BundledFFTBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance, size_t complexDistance,
+                        bool realData)
+        : fftDimension_(fftDimension),
+          howMany_(howMany),
+          realDistance_(realDistance),
+          complexDistance_(complexDistance),
+          realData_(realData),
+          halfLength_(realData && fftDimension % 2 == 0),
+          fft_(halfLength_ ? fftDimension / 2 : fftDimension) {
+        if (halfLength_) {
+            realTwiddles_.resize(fftDimension / 2 + 1);
+            for (size_t k = 0; k < realTwiddles_.size(); ++k) {
+                long double phase = -2 * M_PI * static_cast<long double>(k) / fftDimension;
+                realTwiddles_[k] = Complex(static_cast<Real>(std::cos(phase)), static_cast<Real>(std::sin(phase)));
+            }
+        }
+    }
+
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        Complex *scratch = threadScratch(scratchSize());
+        for (size_t line = 0; line < howMany_; ++line)
+            complexToReal(inBuffer + line * complexDistance_, outBuffer + line * realDistance_, scratch);
+    }
+
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        Complex *scratch = threadScratch(scratchSize());
+        for (size_t line = 0; line < howMany_; ++line)
+            realToComplex(inBuffer + line * realDistance_, outBuffer + line * complexDistance_, scratch);
+    }
+
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) override {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        if (direction != FFTForward && direction != FFTBackward)
+            throw std::runtime_error("Invalid FFT direction passed to in place transform().");
+        Complex *scratch = threadScratch(scratchSize());
+        for (size_t line = 0; line < howMany_; ++line) {
+            Complex *linePtr = inPlaceBuffer + line * complexDistance_;
+            std::copy(linePtr, linePtr + fftDimension_, scratch);
+            fft_.transform(scratch, 1, linePtr, direction, scratch + fftDimension_);
+        }
+    }
+};
+
+/*!
+ * \brief The BundledFFTPlanner class makes plans that use the bundled FFT, for machines without an FFT library or to
+ *        compare against one.  There are no native three dimensional transforms, so the PME code always uses line
+ *        by line passes with this planner.
+ */
+template <typename Real>
+class BundledFFTPlanner : public FFTPlanner<Real> {
+   public:
+    std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance,
+                                                      size_t complexDistance, bool realData) const override {
+        return std::unique_ptr<FFTBatchPlan<Real>>(
+            new BundledFFTBatchPlan<Real>(fftDimension, howMany, realDistance, complexDistance, realData));
+    }
+
+    std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t, size_t, size_t, int) const override {
+        return std::unique_ptr<FFTGridPlan<Real>>();
+    }
+};
+
+}  // Namespace helpme
+#endif  // Header guard
@@ -0,0 +1,276 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_FFT_BACKEND_H_
+#define _HELPME_FFT_BACKEND_H_
+
+#include <algorithm>
+#include <complex>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/*!
+ * \file fft_backend.h
+ * \brief Contains the interface that each FFT library is wrapped in, so that the PME code can use any of them.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The sign of the exponent used by complex to complex transforms, following the FFTW convention.
+ */
+enum FFTDirection : int { FFTForward = -1, FFTBackward = 1 };
+
+/*!
+ * \brief The FFTBatchPlan class is the interface to an FFT library's plans for transforming a batch of equally
+ *        spaced, contiguous lines of data.  Complex to complex transforms work in place and real to complex and
+ *        complex to real transforms work out of place.  As with FFTW, no transform is normalized, and a complex to
+ *        real transform may overwrite its input.  The transforms must be safe to call concurrently from different
+ *        threads, provided that each works on different data.
+ */
+template <typename Real>
+class FFTBatchPlan {
+   public:
+    virtual ~FFTBatchPlan() {}
+
+    /*!
+     * \brief transform does an out of place complex to real FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(std::complex<Real> *inBuffer, Real *outBuffer) = 0;
+
+    /*!
+     * \brief transform does an out of place real to complex FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(Real *inBuffer, std::complex<Real> *outBuffer) = 0;
+
+    /*!
+     * \brief transform does an in place complex to complex FFT of every line in the batch.
+     * \param inPlaceBuffer the location of the input and output data.
+     * \param direction either FFTForward or FFTBackward.
+     */
+    virtual void transform(std::complex<Real> *inPlaceBuffer, int direction) = 0;
+};
+
+/*!
+ * \brief The FFTGridPlan class is the interface to an FFT library's plans for three dimensional real to complex and
+ *        complex to real transforms of a full grid.  The grid is stored with C as the slowest running index and A as
+ *        the fastest, and the complex grid has the same ordering with only the dimA / 2 + 1 unique values along A.
+ */
+template <typename Real>
+class FFTGridPlan {
+   public:
+    virtual ~FFTGridPlan() {}
+
+    /*!
+     * \brief transform does an out of place complex to real FFT of the grid.  The input is overwritten.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(std::complex<Real> *inBuffer, Real *outBuffer) = 0;
+
+    /*!
+     * \brief transform does an out of place real to complex FFT of the grid.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    virtual void transform(Real *inBuffer, std::complex<Real> *outBuffer) = 0;
+};
+
+/*!
+ * \brief The FFTPlanner class is the interface to an FFT library, which makes the plans used by the PME code.
+ */
+template <typename Real>
+class FFTPlanner {
+   public:
+    virtual ~FFTPlanner() {}
+
+    /*!
+     * \brief makeBatchPlan plans the transforms of a batch of lines.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     * \return the plan.
+     */
+    virtual std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany,
+                                                              size_t realDistance, size_t complexDistance,
+                                                              bool realData) const = 0;
+
+    /*!
+     * \brief makeGridPlan plans the three dimensional transforms of a full grid.
+     * \param dimA the length of the fast running dimension.
+     * \param dimB the length of the intermediate dimension.
+     * \param dimC the length of the slow running dimension.
+     * \param nThreads the number of threads that the library should share each transform among.
+     * \return the plan, or a null pointer if the library has no native three dimensional transforms, or can't share
+     *         them among that many threads.
+     */
+    virtual std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t dimA, size_t dimB, size_t dimC,
+                                                            int nThreads) const = 0;
+};
+
+/*!
+ * \brief The ParallelExceptionCatcher class keeps the first exception thrown by any thread in a parallel region, which
+ *        exceptions can't propagate out of, so that it can be rethrown once the region has finished.
+ */
+class ParallelExceptionCatcher {
+    /// The first exception caught, if any.
+    std::exception_ptr exception_;
+
+   public:
+    /*!
+     * \brief run calls a function, catching any exception that it throws.
+     * \param function the function to call.
+     */
+    template <typename Function>
+    void run(const Function &function) {
+        try {
+            function();
+        } catch (...) {
+#pragma omp critical(helpme_parallel_exception)
+            if (!exception_) exception_ = std::current_exception();
+        }
+    }
+
+    /// \brief rethrow throws the exception caught by run(), if there was one.
+    void rethrow() const {
+        if (exception_) std::rethrow_exception(exception_);
+    }
+};
+
+/*!
+ * \brief The ThreadedFFTBatch class splits a batch of equally spaced, contiguous lines into one contiguous chunk per
+ *        thread, each with its own batch plan, and transforms the chunks concurrently.  This avoids relying on the
+ *        threading support of the FFT library.
+ */
+template <typename Real>
+class ThreadedFFTBatch {
+    /// Chunks start on a multiple of this many bytes from the start of the batch, so that every chunk has the same
+    /// SIMD alignment as the start of the batch; this is large enough for any of FFTW's SIMD instruction sets.
+    enum : size_t { AlignmentBytes = 64 };
+    /// The plans for each thread's chunk.
+    std::vector<std::unique_ptr<FFTBatchPlan<Real>>> chunkPlans_;
+    /// The first line in each chunk, with the total number of lines appended.
+    std::vector<size_t> chunkStarts_;
+    /// The distance between the starts of consecutive lines of real data.
+    size_t realDistance_;
+    /// The distance between the starts of consecutive lines of complex data.
+    size_t complexDistance_;
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+
+    static size_t gcd(size_t a, size_t b) { return b ? gcd(b, a % b) : a; }
+
+   public:
+    ThreadedFFTBatch() : realDistance_(0), complexDistance_(0), realData_(false) {}
+    /*!
+     * \brief Sets up the plans for a batch of transforms, shared among threads.
+     * \param planner the FFT library used to plan each chunk.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     * \param nThreads the number of threads to share the batch among.
+     */
+    ThreadedFFTBatch(const FFTPlanner<Real> &planner, size_t fftDimension, size_t howMany, size_t realDistance,
+                     size_t complexDistance, bool realData, int nThreads)
+        : realDistance_(realDistance), complexDistance_(complexDistance), realData_(realData) {
+        // The smallest number of lines that spans a multiple of the alignment in both the real and complex data.
+        size_t realBytes = realData ? realDistance * sizeof(Real) : AlignmentBytes;
+        size_t complexBytes = complexDistance * sizeof(std::complex<Real>);
+        size_t realGranularity = AlignmentBytes / gcd(AlignmentBytes, realBytes);
+        size_t complexGranularity = AlignmentBytes / gcd(AlignmentBytes, complexBytes);
+        size_t granularity = realGranularity / gcd(realGranularity, complexGranularity) * complexGranularity;
+
+        size_t nUnits = (howMany + granularity - 1) / granularity;
+        size_t nChunks = std::max<size_t>(1, std::min<size_t>(std::max(nThreads, 1), nUnits));
+        chunkStarts_.push_back(0);
+        for (size_t chunk = 0; chunk < nChunks; ++chunk) {
+            size_t lastLine = std::min(howMany, (nUnits * (chunk + 1) / nChunks) * granularity);
+            if (lastLine == chunkStarts_.back()) continue;
+            chunkPlans_.push_back(planner.makeBatchPlan(fftDimension, lastLine - chunkStarts_.back(), realDistance,
+                                                        complexDistance, realData));
+            chunkStarts_.push_back(lastLine);
+        }
+    }
+
+    /// \return the number of chunks that the batch is divided into.
+    size_t numChunks() const { return chunkPlans_.size(); }
+
+    /*!
+     * \brief transform does an out of place complex to real FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) {
+        // The kind of transform is checked before the parallel region, because exceptions can't propagate out of it;
+        // errors from the FFT library are caught inside the region, and rethrown after it.  A batch with no lines
+        // has no chunks, and nothing to do.
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        if (chunkPlans_.empty()) return;
+        int nChunks = chunkPlans_.size();
+        ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nChunks)
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+            errors.run([&] {
+                chunkPlans_[chunk]->transform(inBuffer + chunkStarts_[chunk] * complexDistance_,
+                                              outBuffer + chunkStarts_[chunk] * realDistance_);
+            });
+        errors.rethrow();
+    }
+
+    /*!
+     * \brief transform does an out of place real to complex FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        if (chunkPlans_.empty()) return;
+        int nChunks = chunkPlans_.size();
+        ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nChunks)
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+            errors.run([&] {
+                chunkPlans_[chunk]->transform(inBuffer + chunkStarts_[chunk] * realDistance_,
+                                              outBuffer + chunkStarts_[chunk] * complexDistance_);
+            });
+        errors.rethrow();
+    }
+
+    /*!
+     * \brief transform does an in place complex to complex FFT of every line in the batch.
+     * \param inPlaceBuffer the location of the input and output data.
+     * \param direction either FFTForward or FFTBackward.
+     */
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        if (direction != FFTForward && direction != FFTBackward)
+            throw std::runtime_error("Invalid FFT direction passed to in place transform().");
+        if (chunkPlans_.empty()) return;
+        int nChunks = chunkPlans_.size();
+        ParallelExceptionCatcher errors;
+#pragma omp parallel for num_threads(nChunks)
+        for (int chunk = 0; chunk < nChunks; ++chunk)
+            errors.run([&] {
+                chunkPlans_[chunk]->transform(inPlaceBuffer + chunkStarts_[chunk] * complexDistance_, direction);
+            });
+        errors.rethrow();
+    }
+};
+
+}  // Namespace helpme
+#endif  // Header guard
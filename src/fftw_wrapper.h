@@ -9,13 +9,18 @@
 #ifndef _HELPME_FFTW_WRAPPER_H_
 #define _HELPME_FFTW_WRAPPER_H_
 
+#include <algorithm>
 #include <complex>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include <fftw3.h>
+#include "fft_backend.h"
 #include "memory.h"
 
 namespace helpme {
@@ -32,17 +37,38 @@ struct FFTWTypes {
     using Complex = std::complex<int>;
     static Plan makePlan4(size_t, void *, void *, int) { return 0; };
     static Plan makePlan5(size_t, void *, void *, int, int) { return 0; };
+    static Plan make3DPlan6(int, int, int, void *, void *, unsigned) { return 0; };
+    static Plan makeManyPlan12(int, const int *, int, void *, const int *, int, int, void *, const int *, int, int,
+                               unsigned) {
+        return 0;
+    };
+    static Plan makeManyPlan13(int, const int *, int, void *, const int *, int, int, void *, const int *, int, int,
+                               int, unsigned) {
+        return 0;
+    };
     static void execPlan1(Plan){};
+    static int initThreads0() { return 0; };
+    static void setThreads1(int){};
+    static int wisdomFile(const char *) { return 0; };
     static void execPlan3(Plan, void *, void *){};
     static constexpr bool isImplemented = false;
     static constexpr decltype(&makePlan4) MakeRealToComplexPlan = &makePlan4;
     static constexpr decltype(&makePlan4) MakeComplexToRealPlan = &makePlan4;
     static constexpr decltype(&makePlan5) MakeComplexToComplexPlan = &makePlan5;
+    static constexpr decltype(&make3DPlan6) Make3DRealToComplexPlan = &make3DPlan6;
+    static constexpr decltype(&make3DPlan6) Make3DComplexToRealPlan = &make3DPlan6;
+    static constexpr decltype(&makeManyPlan12) MakeManyRealToComplexPlan = &makeManyPlan12;
+    static constexpr decltype(&makeManyPlan12) MakeManyComplexToRealPlan = &makeManyPlan12;
+    static constexpr decltype(&makeManyPlan13) MakeManyComplexToComplexPlan = &makeManyPlan13;
     static constexpr decltype(&execPlan3) ExecuteRealToComplexPlan = &execPlan3;
     static constexpr decltype(&execPlan3) ExecuteComplexToRealPlan = &execPlan3;
     static constexpr decltype(&execPlan3) ExecuteComplexToComplexPlan = &execPlan3;
     static constexpr decltype(&execPlan1) DestroyPlan = &execPlan1;
     static constexpr decltype(&execPlan1) CleanupFFTW = &execPlan1;
+    static constexpr decltype(&initThreads0) InitThreads = &initThreads0;
+    static constexpr decltype(&setThreads1) PlanWithNThreads = &setThreads1;
+    static constexpr decltype(&wisdomFile) ImportWisdomFromFilename = &wisdomFile;
+    static constexpr decltype(&wisdomFile) ExportWisdomToFilename = &wisdomFile;
 };
 
 #if HAVE_FFTWF == 1
@@ -54,11 +80,24 @@ struct FFTWTypes<float> {
     static constexpr decltype(&fftwf_plan_dft_r2c_1d) MakeRealToComplexPlan = &fftwf_plan_dft_r2c_1d;
     static constexpr decltype(&fftwf_plan_dft_c2r_1d) MakeComplexToRealPlan = &fftwf_plan_dft_c2r_1d;
     static constexpr decltype(&fftwf_plan_dft_1d) MakeComplexToComplexPlan = &fftwf_plan_dft_1d;
+    static constexpr decltype(&fftwf_plan_dft_r2c_3d) Make3DRealToComplexPlan = &fftwf_plan_dft_r2c_3d;
+    static constexpr decltype(&fftwf_plan_dft_c2r_3d) Make3DComplexToRealPlan = &fftwf_plan_dft_c2r_3d;
+    static constexpr decltype(&fftwf_plan_many_dft_r2c) MakeManyRealToComplexPlan = &fftwf_plan_many_dft_r2c;
+    static constexpr decltype(&fftwf_plan_many_dft_c2r) MakeManyComplexToRealPlan = &fftwf_plan_many_dft_c2r;
+    static constexpr decltype(&fftwf_plan_many_dft) MakeManyComplexToComplexPlan = &fftwf_plan_many_dft;
     static constexpr decltype(&fftwf_execute_dft_r2c) ExecuteRealToComplexPlan = &fftwf_execute_dft_r2c;
     static constexpr decltype(&fftwf_execute_dft_c2r) ExecuteComplexToRealPlan = &fftwf_execute_dft_c2r;
     static constexpr decltype(&fftwf_execute_dft) ExecuteComplexToComplexPlan = &fftwf_execute_dft;
     static constexpr decltype(&fftwf_destroy_plan) DestroyPlan = &fftwf_destroy_plan;
     static constexpr decltype(&fftwf_cleanup) CleanupFFTW = &fftwf_cleanup;
+#if HAVE_FFTW_THREADS == 1
+    static constexpr decltype(&fftwf_init_threads) InitThreads = &fftwf_init_threads;
+    static constexpr decltype(&fftwf_plan_with_nthreads) PlanWithNThreads = &fftwf_plan_with_nthreads;
+#endif
+    static constexpr decltype(&fftwf_import_wisdom_from_filename) ImportWisdomFromFilename =
+        &fftwf_import_wisdom_from_filename;
+    static constexpr decltype(&fftwf_export_wisdom_to_filename) ExportWisdomToFilename =
+        &fftwf_export_wisdom_to_filename;
 };
 #endif  // HAVE_FFTWF
 
@@ -71,11 +110,24 @@ struct FFTWTypes<double> {
     static constexpr decltype(&fftw_plan_dft_r2c_1d) MakeRealToComplexPlan = &fftw_plan_dft_r2c_1d;
     static constexpr decltype(&fftw_plan_dft_c2r_1d) MakeComplexToRealPlan = &fftw_plan_dft_c2r_1d;
     static constexpr decltype(&fftw_plan_dft_1d) MakeComplexToComplexPlan = &fftw_plan_dft_1d;
+    static constexpr decltype(&fftw_plan_dft_r2c_3d) Make3DRealToComplexPlan = &fftw_plan_dft_r2c_3d;
+    static constexpr decltype(&fftw_plan_dft_c2r_3d) Make3DComplexToRealPlan = &fftw_plan_dft_c2r_3d;
+    static constexpr decltype(&fftw_plan_many_dft_r2c) MakeManyRealToComplexPlan = &fftw_plan_many_dft_r2c;
+    static constexpr decltype(&fftw_plan_many_dft_c2r) MakeManyComplexToRealPlan = &fftw_plan_many_dft_c2r;
+    static constexpr decltype(&fftw_plan_many_dft) MakeManyComplexToComplexPlan = &fftw_plan_many_dft;
     static constexpr decltype(&fftw_execute_dft_r2c) ExecuteRealToComplexPlan = &fftw_execute_dft_r2c;
     static constexpr decltype(&fftw_execute_dft_c2r) ExecuteComplexToRealPlan = &fftw_execute_dft_c2r;
     static constexpr decltype(&fftw_execute_dft) ExecuteComplexToComplexPlan = &fftw_execute_dft;
     static constexpr decltype(&fftw_destroy_plan) DestroyPlan = &fftw_destroy_plan;
     static constexpr decltype(&fftw_cleanup) CleanupFFTW = &fftw_cleanup;
+#if HAVE_FFTW_THREADS == 1
+    static constexpr decltype(&fftw_init_threads) InitThreads = &fftw_init_threads;
+    static constexpr decltype(&fftw_plan_with_nthreads) PlanWithNThreads = &fftw_plan_with_nthreads;
+#endif
+    static constexpr decltype(&fftw_import_wisdom_from_filename) ImportWisdomFromFilename =
+        &fftw_import_wisdom_from_filename;
+    static constexpr decltype(&fftw_export_wisdom_to_filename) ExportWisdomToFilename =
+        &fftw_export_wisdom_to_filename;
 };
 #endif  // HAVE_FFTWD
 
@@ -88,11 +140,24 @@ struct FFTWTypes<long double> {
     static constexpr decltype(&fftwl_plan_dft_r2c_1d) MakeRealToComplexPlan = &fftwl_plan_dft_r2c_1d;
     static constexpr decltype(&fftwl_plan_dft_c2r_1d) MakeComplexToRealPlan = &fftwl_plan_dft_c2r_1d;
     static constexpr decltype(&fftwl_plan_dft_1d) MakeComplexToComplexPlan = &fftwl_plan_dft_1d;
+    static constexpr decltype(&fftwl_plan_dft_r2c_3d) Make3DRealToComplexPlan = &fftwl_plan_dft_r2c_3d;
+    static constexpr decltype(&fftwl_plan_dft_c2r_3d) Make3DComplexToRealPlan = &fftwl_plan_dft_c2r_3d;
+    static constexpr decltype(&fftwl_plan_many_dft_r2c) MakeManyRealToComplexPlan = &fftwl_plan_many_dft_r2c;
+    static constexpr decltype(&fftwl_plan_many_dft_c2r) MakeManyComplexToRealPlan = &fftwl_plan_many_dft_c2r;
+    static constexpr decltype(&fftwl_plan_many_dft) MakeManyComplexToComplexPlan = &fftwl_plan_many_dft;
     static constexpr decltype(&fftwl_execute_dft_r2c) ExecuteRealToComplexPlan = &fftwl_execute_dft_r2c;
     static constexpr decltype(&fftwl_execute_dft_c2r) ExecuteComplexToRealPlan = &fftwl_execute_dft_c2r;
     static constexpr decltype(&fftwl_execute_dft) ExecuteComplexToComplexPlan = &fftwl_execute_dft;
     static constexpr decltype(&fftwl_destroy_plan) DestroyPlan = &fftwl_destroy_plan;
     static constexpr decltype(&fftwl_cleanup) CleanupFFTW = &fftwl_cleanup;
+#if HAVE_FFTW_THREADS == 1
+    static constexpr decltype(&fftwl_init_threads) InitThreads = &fftwl_init_threads;
+    static constexpr decltype(&fftwl_plan_with_nthreads) PlanWithNThreads = &fftwl_plan_with_nthreads;
+#endif
+    static constexpr decltype(&fftwl_import_wisdom_from_filename) ImportWisdomFromFilename =
+        &fftwl_import_wisdom_from_filename;
+    static constexpr decltype(&fftwl_export_wisdom_to_filename) ExportWisdomToFilename =
+        &fftwl_export_wisdom_to_filename;
 };
 #endif  // HAVE_FFTWL
 
@@ -108,17 +173,17 @@ class FFTWWrapper {
 
    protected:
     /// An FFTW plan object, describing out of place complex to complex forward transforms.
-    typename typeinfo::Plan forwardPlan_;
+    typename typeinfo::Plan forwardPlan_ = Plan();
     /// An FFTW plan object, describing out of place complex to complex inverse transforms.
-    typename typeinfo::Plan inversePlan_;
+    typename typeinfo::Plan inversePlan_ = Plan();
     /// An FFTW plan object, describing in place complex to complex forward transforms.
-    typename typeinfo::Plan forwardInPlacePlan_;
+    typename typeinfo::Plan forwardInPlacePlan_ = Plan();
     /// An FFTW plan object, describing in place complex to complex inverse transforms.
-    typename typeinfo::Plan inverseInPlacePlan_;
+    typename typeinfo::Plan inverseInPlacePlan_ = Plan();
     /// An FFTW plan object, describing out of place real to complex forward transforms.
-    typename typeinfo::Plan realToComplexPlan_;
+    typename typeinfo::Plan realToComplexPlan_ = Plan();
     /// An FFTW plan object, describing out of place complex to real inverse transforms.
-    typename typeinfo::Plan complexToRealPlan_;
+    typename typeinfo::Plan complexToRealPlan_ = Plan();
     /// The size of the real data.
     size_t fftDimension_;
     /// The flags to be passed to the FFTW plan creator, to determine startup cost.
@@ -126,7 +191,20 @@ class FFTWWrapper {
 
    public:
     FFTWWrapper() {}
-    FFTWWrapper(size_t fftDimension) : fftDimension_(fftDimension), transformFlags_(FFTW_ESTIMATE) {
+    FFTWWrapper(const FFTWWrapper &) = delete;
+    FFTWWrapper &operator=(const FFTWWrapper &) = delete;
+    ~FFTWWrapper() {
+        for (Plan plan : {forwardPlan_, inversePlan_, forwardInPlacePlan_, inverseInPlacePlan_, realToComplexPlan_,
+                          complexToRealPlan_})
+            if (plan) typeinfo::DestroyPlan(plan);
+    }
+    /*!
+     * \brief Sets up the plans for transforms of a single line.
+     * \param fftDimension the length of the transform.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     */
+    FFTWWrapper(size_t fftDimension, unsigned transformFlags = FFTW_ESTIMATE)
+        : fftDimension_(fftDimension), transformFlags_(transformFlags) {
         if (!typeinfo::isImplemented) {
             throw std::runtime_error(
                 "Attempting to call FFTW using a precision mode that has not been linked. "
@@ -151,6 +229,25 @@ class FFTWWrapper {
         complexToRealPlan_ = typeinfo::MakeComplexToRealPlan(fftDimension_, complexPtr1, realPtr, transformFlags_);
     }
 
+    /*!
+     * \brief importWisdom adds the plans stored in a wisdom file to FFTW's accumulated wisdom for this precision, so
+     *        that plans needing a measured planner level can be made without repeating the measurements.
+     * \param filename the name of the wisdom file.
+     * \return whether the wisdom was imported; this fails if the file doesn't exist or isn't valid wisdom.
+     */
+    static bool importWisdom(const std::string &filename) {
+        return typeinfo::ImportWisdomFromFilename(filename.c_str()) != 0;
+    }
+
+    /*!
+     * \brief exportWisdom writes all of FFTW's accumulated wisdom for this precision to a file.
+     * \param filename the name of the wisdom file.
+     * \return whether the wisdom was written.
+     */
+    static bool exportWisdom(const std::string &filename) {
+        return typeinfo::ExportWisdomToFilename(filename.c_str()) != 0;
+    }
+
     /*!
      * \brief transform call FFTW to do an out of place complex to real FFT.
      * \param inBuffer the location of the input data.
@@ -210,5 +307,240 @@ class FFTWWrapper {
     }
 };
 
+/*!
+ * \brief The FFTWBatchWrapper class wraps FFTW's advanced interface, to transform a batch of equally spaced,
+ *        contiguous lines of data with a single call.  This amortizes the call overhead over the whole batch, and
+ *        lets FFTW use codelets that work on several lines at once.
+ */
+template <typename Real>
+class FFTWBatchWrapper : public FFTBatchPlan<Real> {
+    using typeinfo = FFTWTypes<Real>;
+    using Plan = typename typeinfo::Plan;
+    using Complex = typename typeinfo::Complex;
+
+   protected:
+    /// An FFTW plan object, describing in place complex to complex forward transforms of the batch.
+    typename typeinfo::Plan forwardInPlacePlan_ = Plan();
+    /// An FFTW plan object, describing in place complex to complex inverse transforms of the batch.
+    typename typeinfo::Plan inverseInPlacePlan_ = Plan();
+    /// An FFTW plan object, describing out of place real to complex forward transforms of the batch.
+    typename typeinfo::Plan realToComplexPlan_ = Plan();
+    /// An FFTW plan object, describing out of place complex to real inverse transforms of the batch.
+    typename typeinfo::Plan complexToRealPlan_ = Plan();
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+    /// The flags to be passed to the FFTW plan creator, to determine startup cost.
+    unsigned transformFlags_;
+
+   public:
+    FFTWBatchWrapper() {}
+    FFTWBatchWrapper(const FFTWBatchWrapper &) = delete;
+    FFTWBatchWrapper &operator=(const FFTWBatchWrapper &) = delete;
+    ~FFTWBatchWrapper() override {
+        for (Plan plan : {forwardInPlacePlan_, inverseInPlacePlan_, realToComplexPlan_, complexToRealPlan_})
+            if (plan) typeinfo::DestroyPlan(plan);
+    }
+    /*!
+     * \brief Sets up the plans for a batch of transforms.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     */
+    FFTWBatchWrapper(size_t fftDimension, size_t howMany, size_t realDistance, size_t complexDistance, bool realData,
+                     unsigned transformFlags = FFTW_ESTIMATE)
+        : realData_(realData), transformFlags_(transformFlags) {
+        if (!typeinfo::isImplemented) {
+            throw std::runtime_error(
+                "Attempting to call FFTW using a precision mode that has not been linked. "
+                "Make sure that -DHAVE_FFTWF=1, -DHAVE_FFTWD=1 or -DHAVE_FFTWL=1 is added to the compiler flags"
+                "for single, double and long double precision support, respectively.");
+        }
+        int n = fftDimension;
+        int nLines = howMany;
+        int realDist = realDistance;
+        int complexDist = complexDistance;
+        helpme::vector<std::complex<Real>> complexTemp(howMany * complexDistance);
+        Complex *complexPtr = reinterpret_cast<Complex *>(complexTemp.data());
+        if (realData) {
+            helpme::vector<Real> realTemp(howMany * realDistance);
+            Real *realPtr = realTemp.data();
+            realToComplexPlan_ = typeinfo::MakeManyRealToComplexPlan(1, &n, nLines, realPtr, nullptr, 1, realDist,
+                                                                     complexPtr, nullptr, 1, complexDist,
+                                                                     transformFlags_);
+            complexToRealPlan_ = typeinfo::MakeManyComplexToRealPlan(1, &n, nLines, complexPtr, nullptr, 1,
+                                                                     complexDist, realPtr, nullptr, 1, realDist,
+                                                                     transformFlags_);
+        } else {
+            forwardInPlacePlan_ = typeinfo::MakeManyComplexToComplexPlan(1, &n, nLines, complexPtr, nullptr, 1,
+                                                                         complexDist, complexPtr, nullptr, 1,
+                                                                         complexDist, FFTW_FORWARD, transformFlags_);
+            inverseInPlacePlan_ = typeinfo::MakeManyComplexToComplexPlan(1, &n, nLines, complexPtr, nullptr, 1,
+                                                                         complexDist, complexPtr, nullptr, 1,
+                                                                         complexDist, FFTW_BACKWARD, transformFlags_);
+        }
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place complex to real FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        typeinfo::ExecuteComplexToRealPlan(complexToRealPlan_, reinterpret_cast<Complex *>(inBuffer), outBuffer);
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place real to complex FFT of every line in the batch.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        typeinfo::ExecuteRealToComplexPlan(realToComplexPlan_, inBuffer, reinterpret_cast<Complex *>(outBuffer));
+    }
+
+    /*!
+     * \brief transform call FFTW to do an in place complex to complex FFT of every line in the batch.
+     * \param inPlaceBuffer the location of the input and output data.
+     * \param direction either FFTW_FORWARD or FFTW_BACKWARD.
+     */
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) override {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        Complex *inPlacePtr = reinterpret_cast<Complex *>(inPlaceBuffer);
+        switch (direction) {
+            case FFTW_FORWARD:
+                typeinfo::ExecuteComplexToComplexPlan(forwardInPlacePlan_, inPlacePtr, inPlacePtr);
+                break;
+            case FFTW_BACKWARD:
+                typeinfo::ExecuteComplexToComplexPlan(inverseInPlacePlan_, inPlacePtr, inPlacePtr);
+                break;
+            default:
+                throw std::runtime_error("Invalid FFTW transform passed to in place transform().");
+        }
+    }
+};
+
+/*!
+ * \brief The FFTW3DWrapper class wraps FFTW's native three dimensional real to complex and complex to real
+ *        transforms of a full grid, for runs where a single node holds all of the data.
+ */
+template <typename Real>
+class FFTW3DWrapper : public FFTGridPlan<Real> {
+    using typeinfo = FFTWTypes<Real>;
+    using Plan = typename typeinfo::Plan;
+    using Complex = typename typeinfo::Complex;
+
+   protected:
+    /// An FFTW plan object, describing out of place real to complex forward transforms of the grid.
+    typename typeinfo::Plan realToComplexPlan_ = Plan();
+    /// An FFTW plan object, describing out of place complex to real inverse transforms of the grid.
+    typename typeinfo::Plan complexToRealPlan_ = Plan();
+    /// The flags to be passed to the FFTW plan creator, to determine startup cost.
+    unsigned transformFlags_;
+
+   public:
+    FFTW3DWrapper() {}
+    FFTW3DWrapper(const FFTW3DWrapper &) = delete;
+    FFTW3DWrapper &operator=(const FFTW3DWrapper &) = delete;
+    ~FFTW3DWrapper() override {
+        for (Plan plan : {realToComplexPlan_, complexToRealPlan_})
+            if (plan) typeinfo::DestroyPlan(plan);
+    }
+    /*!
+     * \brief Sets up the plans for transforms of a grid stored with C as the slowest running index and A as the
+     *        fastest.  The complex grid has the same ordering, with only the dimA / 2 + 1 unique values along A.
+     * \param dimA the length of the fast running dimension.
+     * \param dimB the length of the intermediate dimension.
+     * \param dimC the length of the slow running dimension.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     * \param nThreads the number of threads that FFTW shares each transform among; more than one requires helpme to
+     *        be built with -DHAVE_FFTW_THREADS=1 and linked against FFTW's OpenMP libraries.
+     */
+    FFTW3DWrapper(size_t dimA, size_t dimB, size_t dimC, unsigned transformFlags = FFTW_ESTIMATE, int nThreads = 1)
+        : transformFlags_(transformFlags) {
+        if (!typeinfo::isImplemented) {
+            throw std::runtime_error(
+                "Attempting to call FFTW using a precision mode that has not been linked. "
+                "Make sure that -DHAVE_FFTWF=1, -DHAVE_FFTWD=1 or -DHAVE_FFTWL=1 is added to the compiler flags"
+                "for single, double and long double precision support, respectively.");
+        }
+        helpme::vector<Real> realTemp(dimC * dimB * dimA);
+        helpme::vector<std::complex<Real>> complexTemp(dimC * dimB * (dimA / 2 + 1));
+        Real *realPtr = realTemp.data();
+        Complex *complexPtr = reinterpret_cast<Complex *>(complexTemp.data());
+#if HAVE_FFTW_THREADS == 1
+        // FFTW's threads are initialized once per precision, and the thread count applies to every plan made until it
+        // is next set, so it's reset afterwards to keep the batch plans, which are threaded by helpme, serial.
+        static const bool threadsInitialized = typeinfo::InitThreads() != 0;
+        if (!threadsInitialized) throw std::runtime_error("FFTW's threads could not be initialized.");
+        typeinfo::PlanWithNThreads(std::max(nThreads, 1));
+#else
+        if (nThreads > 1)
+            throw std::runtime_error(
+                "Threaded FFTW grid transforms need FFTW's OpenMP libraries; make sure that -DHAVE_FFTW_THREADS=1 is "
+                "added to the compiler flags and that fftw3_omp is linked.");
+#endif
+        realToComplexPlan_ = typeinfo::Make3DRealToComplexPlan(dimC, dimB, dimA, realPtr, complexPtr, transformFlags_);
+        complexToRealPlan_ = typeinfo::Make3DComplexToRealPlan(dimC, dimB, dimA, complexPtr, realPtr, transformFlags_);
+#if HAVE_FFTW_THREADS == 1
+        typeinfo::PlanWithNThreads(1);
+#endif
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place complex to real FFT of the grid.  The input is overwritten.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        typeinfo::ExecuteComplexToRealPlan(complexToRealPlan_, reinterpret_cast<Complex *>(inBuffer), outBuffer);
+    }
+
+    /*!
+     * \brief transform call FFTW to do an out of place real to complex FFT of the grid.
+     * \param inBuffer the location of the input data.
+     * \param outBuffer the location of the output data.
+     */
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        typeinfo::ExecuteRealToComplexPlan(realToComplexPlan_, inBuffer, reinterpret_cast<Complex *>(outBuffer));
+    }
+};
+
+/*!
+ * \brief The FFTWPlanner class makes FFTW plans for the PME code.
+ */
+template <typename Real>
+class FFTWPlanner : public FFTPlanner<Real> {
+    /// The flags to be passed to the FFTW plan creator, to determine startup cost.
+    unsigned transformFlags_;
+
+   public:
+    /*!
+     * \brief Sets up the planner.
+     * \param transformFlags the FFTW planner flags, e.g. FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+     */
+    explicit FFTWPlanner(unsigned transformFlags = FFTW_ESTIMATE) : transformFlags_(transformFlags) {}
+
+    std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance,
+                                                      size_t complexDistance, bool realData) const override {
+        return std::unique_ptr<FFTBatchPlan<Real>>(new FFTWBatchWrapper<Real>(
+            fftDimension, howMany, realDistance, complexDistance, realData, transformFlags_));
+    }
+
+    std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t dimA, size_t dimB, size_t dimC,
+                                                    int nThreads) const override {
+#if HAVE_FFTW_THREADS != 1
+        // Without FFTW's OpenMP libraries the grid transform would run on one thread, so the line passes are better.
+        if (nThreads > 1) return std::unique_ptr<FFTGridPlan<Real>>();
+#endif
+        return std::unique_ptr<FFTGridPlan<Real>>(
+            new FFTW3DWrapper<Real>(dimA, dimB, dimC, transformFlags_, nThreads));
+    }
+};
+
 }  // Namespace helpme
 #endif  // Header guard
@@ -16,6 +16,7 @@ extern "C" {
 
 typedef enum { XAligned = 0, ShapeMatrix = 1 } LatticeType;
 typedef enum { ZYX = 0 } NodeOrder;
+typedef enum { FFTEstimate = 0, FFTMeasure = 1, FFTPatient = 2 } FFTPlanningRigor;
 
 PMEInstanceD* helpme_createD() {
     try {
@@ -91,6 +92,104 @@ void helpme_setupF(PMEInstanceF* pme, short rPower, float kappa, int splineOrder
     }
 }
 
+void helpme_setup_plannedD(PMEInstanceD* pme, int rPower, double kappa, int splineOrder, int aDim, int bDim,
+                           int cDim, double scaleFactor, int nThreads, FFTPlanningRigor planningRigor) {
+    try {
+        pme->setup(rPower, kappa, splineOrder, aDim, bDim, cDim, scaleFactor, nThreads,
+                   PMEInstanceD::FFTPlanningRigor(planningRigor));
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_setup_plannedD" << std::endl;
+        exit(1);
+    }
+}
+
+void helpme_setup_plannedF(PMEInstanceF* pme, int rPower, float kappa, int splineOrder, int aDim, int bDim,
+                           int cDim, float scaleFactor, int nThreads, FFTPlanningRigor planningRigor) {
+    try {
+        pme->setup(rPower, kappa, splineOrder, aDim, bDim, cDim, scaleFactor, nThreads,
+                   PMEInstanceF::FFTPlanningRigor(planningRigor));
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_setup_plannedF" << std::endl;
+        exit(1);
+    }
+}
+
+int helpme_import_fft_wisdomD(const char* filename) {
+#if HAVE_FFTW == 1
+    try {
+        return PMEInstanceD::importFFTWisdom(filename);
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_import_fft_wisdomD" << std::endl;
+        exit(1);
+    }
+#else
+    // Without FFTW there is no wisdom to load.
+    (void)filename;
+    return 0;
+#endif
+}
+
+int helpme_import_fft_wisdomF(const char* filename) {
+#if HAVE_FFTW == 1
+    try {
+        return PMEInstanceF::importFFTWisdom(filename);
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_import_fft_wisdomF" << std::endl;
+        exit(1);
+    }
+#else
+    // Without FFTW there is no wisdom to load.
+    (void)filename;
+    return 0;
+#endif
+}
+
+void helpme_export_fft_wisdomD(const char* filename) {
+#if HAVE_FFTW == 1
+    try {
+        PMEInstanceD::exportFFTWisdom(filename);
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_export_fft_wisdomD" << std::endl;
+        exit(1);
+    }
+#else
+    // Without FFTW there is no wisdom to save.
+    (void)filename;
+#endif
+}
+
+void helpme_export_fft_wisdomF(const char* filename) {
+#if HAVE_FFTW == 1
+    try {
+        PMEInstanceF::exportFFTWisdom(filename);
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_export_fft_wisdomF" << std::endl;
+        exit(1);
+    }
+#else
+    // Without FFTW there is no wisdom to save.
+    (void)filename;
+#endif
+}
+
 #if HAVE_MPI == 1
 void helpme_setup_parallelD(PMEInstanceD* pme, int rPower, double kappa, int splineOrder, int dimA, int dimB, int dimC,
                             double scaleFactor, int nThreads, MPI_Comm communicator, NodeOrder nodeOrder, int numNodesA,
@@ -122,6 +221,40 @@ void helpme_setup_parallelF(PMEInstanceF* pme, int rPower, float kappa, int spli
     }
 }
 
+void helpme_setup_parallel_plannedD(PMEInstanceD* pme, int rPower, double kappa, int splineOrder, int dimA, int dimB,
+                                    int dimC, double scaleFactor, int nThreads, MPI_Comm communicator,
+                                    NodeOrder nodeOrder, int numNodesA, int numNodesB, int numNodesC,
+                                    FFTPlanningRigor planningRigor) {
+    try {
+        pme->setupParallel(rPower, kappa, splineOrder, dimA, dimB, dimC, scaleFactor, nThreads, communicator,
+                           PMEInstanceD::NodeOrder(nodeOrder), numNodesA, numNodesB, numNodesC,
+                           PMEInstanceD::FFTPlanningRigor(planningRigor));
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_setup_parallel_plannedD" << std::endl;
+        exit(1);
+    }
+}
+
+void helpme_setup_parallel_plannedF(PMEInstanceF* pme, int rPower, float kappa, int splineOrder, int dimA, int dimB,
+                                    int dimC, float scaleFactor, int nThreads, MPI_Comm communicator,
+                                    NodeOrder nodeOrder, int numNodesA, int numNodesB, int numNodesC,
+                                    FFTPlanningRigor planningRigor) {
+    try {
+        pme->setupParallel(rPower, kappa, splineOrder, dimA, dimB, dimC, scaleFactor, nThreads, communicator,
+                           PMEInstanceF::NodeOrder(nodeOrder), numNodesA, numNodesB, numNodesC,
+                           PMEInstanceF::FFTPlanningRigor(planningRigor));
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        exit(1);
+    } catch (...) {
+        std::cerr << "An unknown error occured in helpme_setup_parallel_plannedF" << std::endl;
+        exit(1);
+    }
+}
+
 // Provide a wrapper to MPI_Comm_f2c; the C implementation may be a macro and is thus not callable from Fortran.
 MPI_Comm f_MPI_Comm_f2c(int Fcomm) { return MPI_Comm_f2c(Fcomm); }
 
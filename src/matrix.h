@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <complex>
 #include <fstream>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <iomanip>
@@ -295,9 +296,19 @@ class Matrix {
      * \return the inverse of this matrix.
      */
     Matrix inverse() const {
-        assertSquare();
+        Matrix matrixInverse(nRows_, nCols_);
+        inverse(matrixInverse);
+        return matrixInverse;
+    }
 
-        Matrix matrixInverse(nRows_, nRows_);
+    /*!
+     * \brief inverse inverts this matrix into existing storage, leaving the original matrix untouched.
+     * \param matrixInverse the matrix to hold the inverse, which must have the same dimensions as this matrix.
+     */
+    void inverse(Matrix& matrixInverse) const {
+        assertSquare();
+        if (matrixInverse.nRows() != nRows_ || matrixInverse.nCols() != nCols_)
+            throw std::runtime_error("Inverse storage has the wrong dimensions.");
 
         if (nRows() == 3) {
             // 3x3 is a really common case, so treat it here as.
@@ -320,9 +331,9 @@ class Matrix {
             // Generic case; just use spectral decomposition, invert the eigenvalues, and stitch back together.
             // Note that this only works for symmetric matrices.  Need to hook into Lapack for a general
             // inversion routine if this becomes a limitation.
-            return this->applyOperation([](Real& element) { element = 1 / element; });
+            Matrix spectralInverse = applyOperation([](Real& element) { element = 1 / element; });
+            std::copy(spectralInverse.cbegin(), spectralInverse.cend(), matrixInverse.begin());
         }
-        return matrixInverse;
     }
 
     /*!
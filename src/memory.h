@@ -9,20 +9,25 @@
 #ifndef _HELPME_MEMORY_H_
 #define _HELPME_MEMORY_H_
 
+#include <cstdint>
+#include <limits>
+#include <new>
 #include <stdexcept>
 #include <vector>
 
-#include <fftw3.h>
-
 namespace helpme {
 
 /*!
- * \brief FFTWAllocator a class to handle aligned allocation of memory using the FFTW libraries.
- *        Code is adapted from http://www.josuttis.com/cppcode/myalloc.hpp.html.
+ * \brief AlignedAllocator a class to handle aligned allocation of memory, suitable for SIMD loads and stores by the
+ *        FFT libraries and the PME kernels.  The storage comes from operator new, so that programs that replace it
+ *        also see helpme's allocations.  Code is adapted from http://www.josuttis.com/cppcode/myalloc.hpp.html.
  */
 template <class T>
-class FFTWAllocator {
+class AlignedAllocator {
    public:
+    /// The alignment, in bytes, of each allocation; this is a cache line, and enough for any SIMD instruction set.
+    enum : size_t { Alignment = 64 };
+
     // type definitions
     typedef T value_type;
     typedef T* pointer;
@@ -35,7 +40,7 @@ class FFTWAllocator {
     // rebind allocator to type U
     template <class U>
     struct rebind {
-        typedef FFTWAllocator<U> other;
+        typedef AlignedAllocator<U> other;
     };
 
     // return address of values
@@ -45,17 +50,29 @@ class FFTWAllocator {
     /* constructors and destructor
      * - nothing to do because the allocator has no state
      */
-    FFTWAllocator() throw() {}
-    FFTWAllocator(const FFTWAllocator&) throw() {}
+    AlignedAllocator() throw() {}
+    AlignedAllocator(const AlignedAllocator&) throw() {}
     template <class U>
-    FFTWAllocator(const FFTWAllocator<U>&) throw() {}
-    ~FFTWAllocator() throw() {}
+    AlignedAllocator(const AlignedAllocator<U>&) throw() {}
+    ~AlignedAllocator() throw() {}
 
     // return maximum number of elements that can be allocated
-    size_type max_size() const throw() { return std::numeric_limits<std::size_t>::max() / sizeof(T); }
+    size_type max_size() const throw() {
+        return (std::numeric_limits<std::size_t>::max() - Alignment - sizeof(void*)) / sizeof(T);
+    }
 
     // allocate but don't initialize num elements of type T
-    pointer allocate(size_type num, const void* = 0) { return static_cast<pointer>(fftw_malloc(num * sizeof(T))); }
+    pointer allocate(size_type num, const void* = 0) {
+        if (num > max_size()) throw std::bad_alloc();
+        // The block is padded so that an aligned address can be found after room for a pointer to the block itself,
+        // which is stored just before the aligned address for deallocate() to free.
+        char* block = static_cast<char*>(::operator new(num * sizeof(T) + Alignment + sizeof(void*)));
+        std::uintptr_t first = reinterpret_cast<std::uintptr_t>(block) + sizeof(void*);
+        std::uintptr_t offset = (Alignment - first % Alignment) % Alignment;
+        char* memory = block + sizeof(void*) + offset;
+        reinterpret_cast<void**>(memory)[-1] = block;
+        return reinterpret_cast<pointer>(memory);
+    }
 
     // initialize elements of allocated storage p with value value
     void construct(pointer p, const T& value) {
@@ -64,24 +81,26 @@ class FFTWAllocator {
     }
 
     // destroy elements of initialized storage p
-    void destroy(pointer p) {}
+    void destroy(pointer) {}
 
     // deallocate storage p of deleted elements
-    void deallocate(pointer p, size_type num) { fftw_free(static_cast<void*>(p)); }
+    void deallocate(pointer p, size_type) {
+        if (p) ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
 };
 
 // return that all specializations of this allocator are interchangeable
 template <class T1, class T2>
-bool operator==(const FFTWAllocator<T1>&, const FFTWAllocator<T2>&) throw() {
+bool operator==(const AlignedAllocator<T1>&, const AlignedAllocator<T2>&) throw() {
     return true;
 }
 template <class T1, class T2>
-bool operator!=(const FFTWAllocator<T1>&, const FFTWAllocator<T2>&) throw() {
+bool operator!=(const AlignedAllocator<T1>&, const AlignedAllocator<T2>&) throw() {
     return false;
 }
 
 template <typename Real>
-using vector = std::vector<Real, FFTWAllocator<Real>>;
+using vector = std::vector<Real, AlignedAllocator<Real>>;
 
 }  // Namespace helpme
 
@@ -0,0 +1,257 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_MKL_WRAPPER_H_
+#define _HELPME_MKL_WRAPPER_H_
+
+#include <algorithm>
+#include <complex>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <mkl_dfti.h>
+#include "fft_backend.h"
+
+/*!
+ * \file mkl_wrapper.h
+ * \brief Contains the wrappers around the DFTI interface of Intel's Math Kernel Library.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The MKLTypes struct looks up the DFTI precision of each floating point type.
+ */
+template <typename Real>
+struct MKLTypes {
+    static constexpr bool isImplemented = false;
+    static constexpr DFTI_CONFIG_VALUE Precision = DFTI_DOUBLE;
+};
+
+template <>
+struct MKLTypes<float> {
+    static constexpr bool isImplemented = true;
+    static constexpr DFTI_CONFIG_VALUE Precision = DFTI_SINGLE;
+};
+
+template <>
+struct MKLTypes<double> {
+    static constexpr bool isImplemented = true;
+    static constexpr DFTI_CONFIG_VALUE Precision = DFTI_DOUBLE;
+};
+
+/*!
+ * \brief The MKLDescriptor class owns a DFTI descriptor, and checks the status of each call used to configure it.
+ */
+class MKLDescriptor {
+    DFTI_DESCRIPTOR_HANDLE handle_;
+
+    MKLDescriptor(const MKLDescriptor &) = delete;
+    MKLDescriptor &operator=(const MKLDescriptor &) = delete;
+
+   public:
+    MKLDescriptor() : handle_(nullptr) {}
+    ~MKLDescriptor() {
+        if (handle_) DftiFreeDescriptor(&handle_);
+    }
+
+    /*!
+     * \brief check throws if a DFTI call failed.  Transforms are checked too, as a failed transform would otherwise
+     *        leave the output untouched and silently give wrong results.
+     * \param status the value returned by the DFTI call.
+     */
+    static void check(MKL_LONG status) {
+        if (status && !DftiErrorClass(status, DFTI_NO_ERROR))
+            throw std::runtime_error(std::string("MKL DFTI error: ") + DftiErrorMessage(status));
+    }
+
+    /*!
+     * \brief create makes a new descriptor.
+     * \param precision either DFTI_SINGLE or DFTI_DOUBLE.
+     * \param domain either DFTI_REAL or DFTI_COMPLEX.
+     * \param lengths the lengths of each dimension, slowest running first.
+     * \param nThreads the number of threads that MKL may share each transform among.
+     */
+    void create(DFTI_CONFIG_VALUE precision, DFTI_CONFIG_VALUE domain, const std::vector<MKL_LONG> &lengths,
+                int nThreads = 1) {
+        MKL_LONG nDims = lengths.size();
+        if (nDims == 1)
+            check(DftiCreateDescriptor(&handle_, precision, domain, 1, lengths[0]));
+        else
+            check(DftiCreateDescriptor(&handle_, precision, domain, nDims, lengths.data()));
+        // The PME code shares batches of lines among its own threads, so those run on the calling thread; only the
+        // grid transforms, which can't be split that way, are shared among MKL's threads.
+        check(DftiSetValue(handle_, DFTI_THREAD_LIMIT, static_cast<MKL_LONG>(std::max(nThreads, 1))));
+    }
+
+    /*!
+     * \brief setRealStorage configures out of place real transforms to keep only the unique complex values, as FFTW
+     *        does.
+     */
+    void setRealStorage() {
+        check(DftiSetValue(handle_, DFTI_PLACEMENT, DFTI_NOT_INPLACE));
+        check(DftiSetValue(handle_, DFTI_CONJUGATE_EVEN_STORAGE, DFTI_COMPLEX_COMPLEX));
+        check(DftiSetValue(handle_, DFTI_PACKED_FORMAT, DFTI_CCE_FORMAT));
+    }
+
+    /*!
+     * \brief setBatch configures the number of transforms done by each call, and the spacing of their data.
+     * \param howMany the number of transforms in the batch.
+     * \param inDistance the distance between consecutive inputs of the batch.
+     * \param outDistance the distance between consecutive outputs of the batch.
+     */
+    void setBatch(size_t howMany, size_t inDistance, size_t outDistance) {
+        check(DftiSetValue(handle_, DFTI_NUMBER_OF_TRANSFORMS, static_cast<MKL_LONG>(howMany)));
+        check(DftiSetValue(handle_, DFTI_INPUT_DISTANCE, static_cast<MKL_LONG>(inDistance)));
+        check(DftiSetValue(handle_, DFTI_OUTPUT_DISTANCE, static_cast<MKL_LONG>(outDistance)));
+    }
+
+    /// \brief commit finalizes the configuration, after which the descriptor can be used for transforms.
+    void commit() { check(DftiCommitDescriptor(handle_)); }
+
+    /// \return the underlying handle, to be passed to the DFTI functions.
+    DFTI_DESCRIPTOR_HANDLE get() const { return handle_; }
+};
+
+/*!
+ * \brief The MKLBatchPlan class transforms a batch of equally spaced, contiguous lines with a single DFTI call.
+ */
+template <typename Real>
+class MKLBatchPlan : public FFTBatchPlan<Real> {
+    /// The descriptor for forward transforms, which also does in place complex to complex backward transforms.
+    MKLDescriptor forward_;
+    /// The descriptor for complex to real backward transforms, whose input and output distances are swapped.
+    MKLDescriptor backward_;
+    /// Whether the batch holds real data, with real to complex and complex to real plans, or complex data.
+    bool realData_;
+
+   public:
+    /*!
+     * \brief Sets up the descriptors for a batch of transforms.
+     * \param fftDimension the length of each transform.
+     * \param howMany the number of lines in the batch.
+     * \param realDistance the distance between the starts of consecutive lines of real data.
+     * \param complexDistance the distance between the starts of consecutive lines of complex data.
+     * \param realData whether to plan real to complex and complex to real transforms, rather than complex to complex.
+     */
+    MKLBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance, size_t complexDistance, bool realData)
+        : realData_(realData) {
+        if (!MKLTypes<Real>::isImplemented)
+            throw std::runtime_error("MKL's FFTs are only available in single and double precision.");
+        std::vector<MKL_LONG> lengths(1, fftDimension);
+        if (realData) {
+            forward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths);
+            forward_.setRealStorage();
+            forward_.setBatch(howMany, realDistance, complexDistance);
+            forward_.commit();
+            backward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths);
+            backward_.setRealStorage();
+            backward_.setBatch(howMany, complexDistance, realDistance);
+            backward_.commit();
+        } else {
+            forward_.create(MKLTypes<Real>::Precision, DFTI_COMPLEX, lengths);
+            forward_.setBatch(howMany, complexDistance, complexDistance);
+            forward_.commit();
+        }
+    }
+
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for complex to real transforms.");
+        MKLDescriptor::check(DftiComputeBackward(backward_.get(), inBuffer, outBuffer));
+    }
+
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        if (!realData_) throw std::runtime_error("This batch was not planned for real to complex transforms.");
+        MKLDescriptor::check(DftiComputeForward(forward_.get(), inBuffer, outBuffer));
+    }
+
+    void transform(std::complex<Real> *inPlaceBuffer, int direction) override {
+        if (realData_) throw std::runtime_error("This batch was not planned for complex to complex transforms.");
+        switch (direction) {
+            case FFTForward:
+                MKLDescriptor::check(DftiComputeForward(forward_.get(), inPlaceBuffer));
+                break;
+            case FFTBackward:
+                MKLDescriptor::check(DftiComputeBackward(forward_.get(), inPlaceBuffer));
+                break;
+            default:
+                throw std::runtime_error("Invalid FFT direction passed to in place transform().");
+        }
+    }
+};
+
+/*!
+ * \brief The MKL3DPlan class does three dimensional real to complex and complex to real transforms of a full grid.
+ */
+template <typename Real>
+class MKL3DPlan : public FFTGridPlan<Real> {
+    /// The descriptor for real to complex forward transforms.
+    MKLDescriptor forward_;
+    /// The descriptor for complex to real backward transforms.
+    MKLDescriptor backward_;
+
+   public:
+    /*!
+     * \brief Sets up the descriptors for transforms of a grid stored with C as the slowest running index and A as the
+     *        fastest.  The complex grid has the same ordering, with only the dimA / 2 + 1 unique values along A.
+     * \param dimA the length of the fast running dimension.
+     * \param dimB the length of the intermediate dimension.
+     * \param dimC the length of the slow running dimension.
+     * \param nThreads the number of threads that MKL shares each transform among.
+     */
+    MKL3DPlan(size_t dimA, size_t dimB, size_t dimC, int nThreads) {
+        if (!MKLTypes<Real>::isImplemented)
+            throw std::runtime_error("MKL's FFTs are only available in single and double precision.");
+        MKL_LONG complexDimA = dimA / 2 + 1;
+        std::vector<MKL_LONG> lengths = {static_cast<MKL_LONG>(dimC), static_cast<MKL_LONG>(dimB),
+                                         static_cast<MKL_LONG>(dimA)};
+        MKL_LONG realStrides[4] = {0, static_cast<MKL_LONG>(dimB * dimA), static_cast<MKL_LONG>(dimA), 1};
+        MKL_LONG complexStrides[4] = {0, static_cast<MKL_LONG>(dimB) * complexDimA, complexDimA, 1};
+        forward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths, nThreads);
+        forward_.setRealStorage();
+        MKLDescriptor::check(DftiSetValue(forward_.get(), DFTI_INPUT_STRIDES, realStrides));
+        MKLDescriptor::check(DftiSetValue(forward_.get(), DFTI_OUTPUT_STRIDES, complexStrides));
+        forward_.commit();
+        backward_.create(MKLTypes<Real>::Precision, DFTI_REAL, lengths, nThreads);
+        backward_.setRealStorage();
+        MKLDescriptor::check(DftiSetValue(backward_.get(), DFTI_INPUT_STRIDES, complexStrides));
+        MKLDescriptor::check(DftiSetValue(backward_.get(), DFTI_OUTPUT_STRIDES, realStrides));
+        backward_.commit();
+    }
+
+    void transform(std::complex<Real> *inBuffer, Real *outBuffer) override {
+        MKLDescriptor::check(DftiComputeBackward(backward_.get(), inBuffer, outBuffer));
+    }
+
+    void transform(Real *inBuffer, std::complex<Real> *outBuffer) override {
+        MKLDescriptor::check(DftiComputeForward(forward_.get(), inBuffer, outBuffer));
+    }
+};
+
+/*!
+ * \brief The MKLPlanner class makes plans that use the DFTI interface of Intel's Math Kernel Library.
+ */
+template <typename Real>
+class MKLPlanner : public FFTPlanner<Real> {
+   public:
+    std::unique_ptr<FFTBatchPlan<Real>> makeBatchPlan(size_t fftDimension, size_t howMany, size_t realDistance,
+                                                      size_t complexDistance, bool realData) const override {
+        return std::unique_ptr<FFTBatchPlan<Real>>(
+            new MKLBatchPlan<Real>(fftDimension, howMany, realDistance, complexDistance, realData));
+    }
+
+    std::unique_ptr<FFTGridPlan<Real>> makeGridPlan(size_t dimA, size_t dimB, size_t dimC,
+                                                    int nThreads) const override {
+        return std::unique_ptr<FFTGridPlan<Real>>(new MKL3DPlan<Real>(dimA, dimB, dimC, nThreads));
+    }
+};
+
+}  // Namespace helpme
+#endif  // Header guard
@@ -9,6 +9,8 @@
 #ifndef _HELPME_SPLINES_H_
 #define _HELPME_SPLINES_H_
 
+#include <array>
+
 #include "matrix.h"
 
 /*!
@@ -18,6 +20,48 @@
 
 namespace helpme {
 
+/*!
+ * \class BSplineView
+ * \brief A lightweight, non-owning view of B-splines and their derivatives stored elsewhere, e.g. in a contiguous
+ *        cache holding the splines of many atoms.  The splines are stored with rows corresponding to derivative
+ *        level and columns to spline component, as in BSpline.
+ * \tparam Real the floating point type to use for arithmetic.
+ */
+template <typename Real>
+class BSplineView {
+   protected:
+    /// The grid point at which to start interpolation.
+    short startingGridPoint_;
+    /// The order of the B-splines, which is the stride between derivative levels.
+    short order_;
+    /// The first spline value.
+    const Real *splines_;
+
+   public:
+    BSplineView() : startingGridPoint_(0), order_(0), splines_(nullptr) {}
+
+    /*!
+     * \brief Makes a view of B-splines stored elsewhere.
+     * \param start the grid point at which to start interpolation.
+     * \param splines pointer to the splines, with rows corresponding to derivative level and columns to component.
+     * \param order the order of the B-splines.
+     */
+    BSplineView(short start, const Real *splines, short order)
+        : startingGridPoint_(start), order_(order), splines_(splines) {}
+
+    /*!
+     * \brief Gets the grid point to start interpolating from.
+     * \return the index of the first grid point this spline supports.
+     */
+    short startingGridPoint() const { return startingGridPoint_; }
+
+    /*!
+     * \brief Returns the B-Spline, or derivative thereof.
+     * \param deriv the derivative level of the spline to be returned.
+     */
+    const Real *operator[](const int &deriv) const { return splines_ + deriv * order_; }
+};
+
 /*!
  * \class BSpline
  * \brief A class to compute cardinal B-splines. This code can compute arbitrary-order B-splines of
@@ -38,7 +82,7 @@ class BSpline {
     short startingGridPoint_;
 
     /// Makes B-Spline array.
-    inline void makeSplineInPlace(Real *array, const Real &val, const short &n) const {
+    static inline void makeSplineInPlace(Real *array, const Real &val, const short &n) {
         Real denom = (Real)1 / (n - 1);
         array[n - 1] = denom * val * array[n - 2];
         for (short j = 1; j < n - 1; ++j)
@@ -47,17 +91,18 @@ class BSpline {
     }
 
     /// Takes BSpline derivative.
-    inline void differentiateSpline(const Real *array, Real *dArray, const short &n) const {
+    static inline void differentiateSpline(const Real *array, Real *dArray, const short &n) {
         dArray[0] = -array[0];
         for (short j = 1; j < n - 1; ++j) dArray[j] = array[j - 1] - array[j];
         dArray[n - 1] = array[n - 2];
     }
 
+   public:
     /*!
      * \brief assertSplineIsSufficient ensures that the spline is large enough to be differentiable.
      *        An mth order B-Spline is differentiable m-2 times.
      */
-    void assertSplineIsSufficient(int splineOrder, int derivativeLevel) const {
+    static void assertSplineIsSufficient(int splineOrder, int derivativeLevel) {
         if (splineOrder - derivativeLevel < 2) {
             std::string msg(
                 "The spline order used is not sufficient for the derivative level requested."
@@ -68,7 +113,6 @@ class BSpline {
         }
     }
 
-   public:
     /// The B-splines and their derivatives.  See update() for argument details.
     BSpline(short start, Real value, short order, short derivativeLevel) : splines_(derivativeLevel + 1, order) {
         update(start, value, order, derivativeLevel);
@@ -82,7 +126,6 @@ class BSpline {
      * \param derivativeLevel the maximum level of derivative needed for this BSpline.
      */
     void update(short start, Real value, short order, short derivativeLevel) {
-        assertSplineIsSufficient(order, derivativeLevel);
         startingGridPoint_ = start;
         order_ = order;
         derivativeLevel_ = derivativeLevel;
@@ -92,14 +135,28 @@ class BSpline {
             splines_ = Matrix<Real>(derivativeLevel + 1, order);
 
         splines_.setZero();
-        splines_(0, 0) = 1 - value;
-        splines_(0, 1) = value;
-        for (short m = 1; m < order_ - 1; ++m) {
-            makeSplineInPlace(splines_[0], value, m + 2);
-            if (m >= order_ - derivativeLevel_ - 2) {
-                short currentDerivative = order_ - m - 2;
+        computeInPlace(splines_[0], value, order, derivativeLevel);
+    }
+
+    /*!
+     * \brief computeInPlace computes B-splines and their derivatives into caller-provided memory, allowing many
+     *        splines to be packed into a single contiguous allocation.
+     * \param splines pointer to (derivativeLevel + 1) x order zeroed values, which are filled with the B-splines,
+     *        with rows corresponding to derivative level, and columns to spline component.
+     * \param value the distance (in fractional coordinates) from the starting grid point.
+     * \param order the order of the BSpline.
+     * \param derivativeLevel the maximum level of derivative needed for this BSpline.
+     */
+    static void computeInPlace(Real *splines, Real value, short order, short derivativeLevel) {
+        assertSplineIsSufficient(order, derivativeLevel);
+        splines[0] = 1 - value;
+        splines[1] = value;
+        for (short m = 1; m < order - 1; ++m) {
+            makeSplineInPlace(splines, value, m + 2);
+            if (m >= order - derivativeLevel - 2) {
+                short currentDerivative = order - m - 2;
                 for (short l = 0; l < currentDerivative; ++l)
-                    differentiateSpline(splines_[l], splines_[l + 1], m + 2 + currentDerivative);
+                    differentiateSpline(splines + l * order, splines + (l + 1) * order, m + 2 + currentDerivative);
             }
         }
     }
@@ -155,6 +212,199 @@ class BSpline {
      * \returns a const reference to the full spline data: row index is derivative, col index is spline component.
      */
     const Matrix<Real> &splineData() const { return splines_; }
+
+    /*!
+     * \brief Makes a non-owning view of this B-spline, which is only valid while this object is alive and unchanged.
+     */
+    operator BSplineView<Real>() const { return BSplineView<Real>(startingGridPoint_, splines_[0], order_); }
+};
+
+/*!
+ * \class FixedBSpline
+ * \brief A cardinal B-spline whose values are held in fixed-size storage, so that constructing or updating one
+ *        never touches the heap.  This makes it suitable for splines built on the fly, one point at a time, in
+ *        performance critical or multithreaded code.  The values are identical to those from BSpline.
+ * \tparam Real the floating point type to use for arithmetic.
+ * \tparam MaxOrder the largest spline order that can be stored.
+ * \tparam MaxDerivativeLevel the largest derivative level that can be stored.
+ */
+template <typename Real, int MaxOrder, int MaxDerivativeLevel>
+class FixedBSpline {
+   protected:
+    /// The order of this B-spline.
+    short order_;
+    /// The maximum derivative level for this B-spline.
+    short derivativeLevel_;
+    /// The grid point at which to start interpolation.
+    short startingGridPoint_;
+    /// B-Splines with rows corresponding to derivative level, and columns to spline component.
+    std::array<Real, MaxOrder * (MaxDerivativeLevel + 1)> splines_;
+
+   public:
+    FixedBSpline() : order_(0), derivativeLevel_(0), startingGridPoint_(0) {}
+
+    /// The B-splines and their derivatives.  See update() for argument details.
+    FixedBSpline(short start, Real value, short order, short derivativeLevel) {
+        update(start, value, order, derivativeLevel);
+    }
+
+    /*!
+     * \brief update computes information for FixedBSpline.
+     * \param start the grid point at which to start interpolation.
+     * \param value the distance (in fractional coordinates) from the starting grid point.
+     * \param order the order of the BSpline, which must not exceed MaxOrder.
+     * \param derivativeLevel the maximum level of derivative needed, which must not exceed MaxDerivativeLevel.
+     */
+    void update(short start, Real value, short order, short derivativeLevel) {
+        if (order > MaxOrder || derivativeLevel > MaxDerivativeLevel)
+            throw std::runtime_error("The spline order or derivative level requested exceeds the FixedBSpline size.");
+        startingGridPoint_ = start;
+        order_ = order;
+        derivativeLevel_ = derivativeLevel;
+        std::fill(splines_.begin(), splines_.begin() + (derivativeLevel + 1) * order, Real(0));
+        BSpline<Real>::computeInPlace(splines_.data(), value, order, derivativeLevel);
+    }
+
+    /*!
+     * \brief Gets the grid point to start interpolating from.
+     * \return the index of the first grid point this spline supports.
+     */
+    short startingGridPoint() const { return startingGridPoint_; }
+
+    /*!
+     * \brief Returns the B-Spline, or derivative thereof.
+     * \param deriv the derivative level of the spline to be returned.
+     */
+    const Real *operator[](const int &deriv) const { return splines_.data() + deriv * order_; }
+
+    /*!
+     * \brief Makes a non-owning view of this B-spline, which is only valid while this object is alive and unchanged.
+     */
+    operator BSplineView<Real>() const { return BSplineView<Real>(startingGridPoint_, splines_.data(), order_); }
+};
+
+/*!
+ * \class BSplineBlock
+ * \brief Cardinal B-splines, and their derivatives, for a block of points along a single direction.  The splines are
+ *        stored in structure of arrays form, with the point index running fastest, so that the recursion used to
+ *        build them runs as a vector operation across the block.  The values for each point match those from
+ *        BSpline exactly.
+ * \tparam Real the floating point type to use for arithmetic.
+ */
+template <typename Real>
+class BSplineBlock {
+   protected:
+    /// The order of the B-splines.
+    short order_;
+    /// The maximum derivative level for the B-splines.
+    short derivativeLevel_;
+    /// The number of points in the block, which is also the stride between successive spline components.
+    int nPoints_;
+    /// The splines, stored with derivative level slowest, then spline component, then point index fastest.
+    helpme::vector<Real> splines_;
+
+    /// Returns a pointer to the values of the given derivative level and spline component for all points.
+    Real *row(int deriv, int component) { return splines_.data() + (deriv * order_ + component) * nPoints_; }
+
+   public:
+    BSplineBlock() : order_(0), derivativeLevel_(0), nPoints_(0) {}
+
+    /*!
+     * \brief reserve allocates enough storage for update() to build splines for a block of points without
+     *        reallocating.
+     * \param nPoints the largest number of points in a block.
+     * \param order the order of the B-splines.
+     * \param derivativeLevel the highest level of derivative needed for the B-splines.
+     */
+    void reserve(int nPoints, short order, short derivativeLevel) {
+        size_t size = static_cast<size_t>(derivativeLevel + 1) * order * nPoints;
+        if (splines_.size() < size) splines_.resize(size);
+    }
+
+    /*!
+     * \brief update computes the B-splines for a block of points, without reallocating unless the block grows.
+     *        This is called from within parallel regions, so it doesn't throw; the caller must check the spline
+     *        order with BSpline::assertSplineIsSufficient() beforehand.
+     * \param values the distances (in fractional coordinates) of each point from its starting grid point.
+     * \param nPoints the number of points in the block.
+     * \param order the order of the B-splines.
+     * \param derivativeLevel the maximum level of derivative needed for the B-splines.
+     */
+    void update(const Real *values, int nPoints, short order, short derivativeLevel) {
+        order_ = order;
+        derivativeLevel_ = derivativeLevel;
+        nPoints_ = nPoints;
+        size_t size = static_cast<size_t>(derivativeLevel + 1) * order * nPoints;
+        if (splines_.size() < size) splines_.resize(size);
+        std::fill(splines_.begin(), splines_.begin() + size, Real(0));
+
+        Real *row00 = row(0, 0);
+        Real *row01 = row(0, 1);
+#pragma omp simd
+        for (int point = 0; point < nPoints; ++point) {
+            row00[point] = 1 - values[point];
+            row01[point] = values[point];
+        }
+        for (short m = 1; m < order_ - 1; ++m) {
+            // The same recursion as BSpline::makeSplineInPlace, applied to every point in the block at once.
+            short n = m + 2;
+            Real denom = (Real)1 / (n - 1);
+            Real *last = row(0, n - 1);
+            const Real *secondLast = row(0, n - 2);
+#pragma omp simd
+            for (int point = 0; point < nPoints; ++point) last[point] = denom * values[point] * secondLast[point];
+            for (short j = 1; j < n - 1; ++j) {
+                Real *current = row(0, n - j - 1);
+                const Real *previous = row(0, n - j - 2);
+#pragma omp simd
+                for (int point = 0; point < nPoints; ++point)
+                    current[point] = denom * ((values[point] + j) * previous[point] +
+                                              (n - j - values[point]) * current[point]);
+            }
+            Real *first = row(0, 0);
+#pragma omp simd
+            for (int point = 0; point < nPoints; ++point) first[point] *= denom * (1 - values[point]);
+
+            if (m >= order_ - derivativeLevel_ - 2) {
+                short currentDerivative = order_ - m - 2;
+                short nDerivative = m + 2 + currentDerivative;
+                for (short l = 0; l < currentDerivative; ++l) {
+                    // The same differentiation as BSpline::differentiateSpline.
+                    for (short j = 0; j < nDerivative; ++j) {
+                        Real *dRow = row(l + 1, j);
+                        const Real *plus = j < nDerivative - 1 ? row(l, j) : nullptr;
+                        const Real *minus = j > 0 ? row(l, j - 1) : nullptr;
+                        if (plus && minus) {
+#pragma omp simd
+                            for (int point = 0; point < nPoints; ++point) dRow[point] = minus[point] - plus[point];
+                        } else if (plus) {
+#pragma omp simd
+                            for (int point = 0; point < nPoints; ++point) dRow[point] = -plus[point];
+                        } else {
+#pragma omp simd
+                            for (int point = 0; point < nPoints; ++point) dRow[point] = minus[point];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Returns the values of a B-spline component, or derivative thereof, for every point in the block.
+     * \param deriv the derivative level of the spline.
+     * \param component the spline component, i.e. the offset from each point's starting grid point.
+     * \return a pointer to nPoints values, one per point in the block.
+     */
+    const Real *operator()(int deriv, int component) const {
+        return splines_.data() + (deriv * order_ + component) * nPoints_;
+    }
+
+    /*!
+     * \brief Gets the number of points in the block.
+     * \return the number of points in the block.
+     */
+    int nPoints() const { return nPoints_; }
 };
 
 }  // Namespace helpme
@@ -0,0 +1,87 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+#ifndef _HELPME_TRANSPOSE_H_
+#define _HELPME_TRANSPOSE_H_
+
+#include <algorithm>
+#include <cstddef>
+
+/*!
+ * \file transpose.h
+ * \brief Contains cache blocked, out of place transpose kernels used to reorder the grid between FFT passes.
+ */
+
+namespace helpme {
+
+/*!
+ * \brief The number of elements along each edge of the square tiles used by the transpose kernels.  Each row of a
+ *        tile spans 256 bytes, so that the input and output tiles together fit comfortably in the L1 cache.
+ * \tparam T the type of the data being transposed.
+ */
+template <typename T>
+struct TransposeTile {
+    static constexpr size_t dim = 256 / sizeof(T) > 8 ? 256 / sizeof(T) : 8;
+};
+
+/*!
+ * \brief transposeTile transposes a single tile.  The innermost loop writes contiguous output, with the strided
+ *        reads from the input confined to a few cache lines for the duration of the tile.
+ * \param in pointer to the first input element of the tile.
+ * \param inRowStride the distance between consecutive rows of the input.
+ * \param out pointer to the first output element of the tile.
+ * \param outRowStride the distance between consecutive rows of the output.
+ * \param nRows the number of input rows in the tile.
+ * \param nCols the number of input columns in the tile.
+ */
+template <typename T>
+void transposeTile(const T *in, size_t inRowStride, T *out, size_t outRowStride, size_t nRows, size_t nCols) {
+    for (size_t col = 0; col < nCols; ++col) {
+        const T *inPtr = in + col;
+        T *outPtr = out + col * outRowStride;
+#pragma omp simd
+        for (size_t row = 0; row < nRows; ++row) outPtr[row] = inPtr[row * inRowStride];
+    }
+}
+
+/*!
+ * \brief transposeMatrices transposes each of a batch of equally spaced matrices out of place, one tile at a time,
+ *        sharing the tiles of the whole batch among the threads.  For matrix m this performs
+ *        out[m][col][row] = in[m][row][col].
+ * \param in pointer to the first input matrix.
+ * \param inMatrixStride the distance between the starts of consecutive input matrices.
+ * \param inRowStride the distance between consecutive rows of each input matrix.
+ * \param out pointer to the first output matrix, which must not overlap any of the input.
+ * \param outMatrixStride the distance between the starts of consecutive output matrices.
+ * \param outRowStride the distance between consecutive rows of each output matrix.
+ * \param nMatrices the number of matrices in the batch.
+ * \param nRows the number of rows in each input matrix.
+ * \param nCols the number of columns in each input matrix.
+ * \param nThreads the number of threads to use.
+ */
+template <typename T>
+void transposeMatrices(const T *in, size_t inMatrixStride, size_t inRowStride, T *out, size_t outMatrixStride,
+                       size_t outRowStride, size_t nMatrices, size_t nRows, size_t nCols, int nThreads) {
+    constexpr size_t tileDim = TransposeTile<T>::dim;
+    size_t nTileRows = (nRows + tileDim - 1) / tileDim;
+    size_t nTileCols = (nCols + tileDim - 1) / tileDim;
+    size_t nTilesPerMatrix = nTileRows * nTileCols;
+    size_t nTiles = nMatrices * nTilesPerMatrix;
+#pragma omp parallel for num_threads(nThreads)
+    for (size_t tile = 0; tile < nTiles; ++tile) {
+        size_t matrix = tile / nTilesPerMatrix;
+        size_t row = (tile % nTilesPerMatrix) / nTileCols * tileDim;
+        size_t col = (tile % nTileCols) * tileDim;
+        transposeTile(in + matrix * inMatrixStride + row * inRowStride + col, inRowStride,
+                      out + matrix * outMatrixStride + col * outRowStride + row, outRowStride,
+                      std::min(tileDim, nRows - row), std::min(tileDim, nCols - col));
+    }
+}
+
+}  // Namespace helpme
+#endif  // Header guard
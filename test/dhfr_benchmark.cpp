@@ -25,25 +25,31 @@ int main(int argc, char *argv[]) {
     int gridZ = 64;
     int splineOrder = 4;
 
-    auto startTime = std::chrono::system_clock::now();
-    if (useFloat) {
-        auto pme = std::unique_ptr<PMEInstanceF>(new PMEInstanceF());
-        pme->setup(rPower, kappa, splineOrder, gridX, gridY, gridZ, scaleFactor, 0);
-        pme->setLatticeVectors(62.23f, 62.23f, 62.23f, 90.0f, 90.0f, 90.0f, PMEInstanceF::LatticeType::XAligned);
-        helpme::Matrix<float> coordsF = coordsD.cast<float>();
-        helpme::Matrix<float> paramsF = paramsD.cast<float>();
-        helpme::Matrix<float> forces(coordsD.nRows(), coordsD.nCols());
-        helpme::Matrix<float> virial(6, 1);
-        for (int n = 0; n < nCalcs; ++n) pme->computeEFVRec(0, paramsF, coordsF, forces, virial);
-    } else {
-        auto pme = std::unique_ptr<PMEInstanceD>(new PMEInstanceD());
-        pme->setup(rPower, kappa, splineOrder, gridX, gridY, gridZ, scaleFactor, 0);
-        pme->setLatticeVectors(62.23, 62.23, 62.23, 90, 90, 90, PMEInstanceD::LatticeType::XAligned);
-        helpme::Matrix<double> forces(coordsD.nRows(), coordsD.nCols());
-        helpme::Matrix<double> virial(6, 1);
-        for (int n = 0; n < nCalcs; ++n) pme->computeEFVRec(0, paramsD, coordsD, forces, virial);
+    // Time the calculation with atoms in their input order, and then sorted by their position on the grid.
+    for (bool sortAtoms : {false, true}) {
+        auto startTime = std::chrono::system_clock::now();
+        if (useFloat) {
+            auto pme = std::unique_ptr<PMEInstanceF>(new PMEInstanceF());
+            pme->setup(rPower, kappa, splineOrder, gridX, gridY, gridZ, scaleFactor, 0);
+            pme->setLatticeVectors(62.23f, 62.23f, 62.23f, 90.0f, 90.0f, 90.0f, PMEInstanceF::LatticeType::XAligned);
+            pme->setSpatialSorting(sortAtoms);
+            helpme::Matrix<float> coordsF = coordsD.cast<float>();
+            helpme::Matrix<float> paramsF = paramsD.cast<float>();
+            helpme::Matrix<float> forces(coordsD.nRows(), coordsD.nCols());
+            helpme::Matrix<float> virial(6, 1);
+            for (int n = 0; n < nCalcs; ++n) pme->computeEFVRec(0, paramsF, coordsF, forces, virial);
+        } else {
+            auto pme = std::unique_ptr<PMEInstanceD>(new PMEInstanceD());
+            pme->setup(rPower, kappa, splineOrder, gridX, gridY, gridZ, scaleFactor, 0);
+            pme->setLatticeVectors(62.23, 62.23, 62.23, 90, 90, 90, PMEInstanceD::LatticeType::XAligned);
+            pme->setSpatialSorting(sortAtoms);
+            helpme::Matrix<double> forces(coordsD.nRows(), coordsD.nCols());
+            helpme::Matrix<double> virial(6, 1);
+            for (int n = 0; n < nCalcs; ++n) pme->computeEFVRec(0, paramsD, coordsD, forces, virial);
+        }
+        auto endTime = std::chrono::system_clock::now();
+        std::chrono::duration<double> runTime = endTime - startTime;
+        std::cout << "Total run time (" << (sortAtoms ? "spatially sorted" : "input order") << "): " << runTime.count()
+                  << std::endl;
     }
-    auto endTime = std::chrono::system_clock::now();
-    std::chrono::duration<double> runTime = endTime - startTime;
-    std::cout << "Total run time: " << runTime.count() << std::endl;
 }
@@ -0,0 +1,76 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+// Times the forward and inverse 3D FFTs used by the reciprocal space calculation with each of the available FFT
+// backends, on grids of 64^3, 96^3 and 128^3 points (or the sizes given on the command line), to help pick the fastest
+// backend for a given machine.  The transforms are timed on their own, so that the results are not diluted by the
+// spreading and probing.  The number of threads can be set with OMP_NUM_THREADS; with a single thread, the FFTW and
+// MKL backends use their native 3D transforms.
+
+#include "helpme.h"
+#include <chrono>
+#include <string>
+
+namespace {
+const char *backendName(PMEInstanceD::FFTBackend backend) {
+    switch (backend) {
+        case PMEInstanceD::FFTBackend::FFTW:
+            return "FFTW";
+        case PMEInstanceD::FFTBackend::MKL:
+            return "MKL";
+        default:
+            return "bundled";
+    }
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::vector<int> gridDims;
+    for (int arg = 1; arg < argc; ++arg) gridDims.push_back(std::stoi(argv[arg]));
+    if (gridDims.empty()) gridDims = {64, 96, 128};
+
+    std::vector<PMEInstanceD::FFTBackend> backends;
+#if HAVE_FFTW == 1
+    backends.push_back(PMEInstanceD::FFTBackend::FFTW);
+#endif
+#if HAVE_MKL == 1
+    backends.push_back(PMEInstanceD::FFTBackend::MKL);
+#endif
+    backends.push_back(PMEInstanceD::FFTBackend::Bundled);
+
+    int nCalcs = 20;
+#ifdef _OPENMP
+    int nThreads = omp_get_max_threads();
+#else
+    int nThreads = 1;
+#endif
+    for (int gridDim : gridDims) {
+        helpme::vector<double> grid(static_cast<size_t>(gridDim) * gridDim * gridDim);
+        for (auto backend : backends) {
+            PMEInstanceD pme;
+            pme.setFFTBackend(backend);
+            pme.setup(1, 0.3, 6, gridDim, gridDim, gridDim, 332.0716, nThreads,
+                      PMEInstanceD::FFTPlanningRigor::Measure);
+            std::chrono::duration<double> forwardTime(0), inverseTime(0);
+            for (int n = 0; n < nCalcs; ++n) {
+                for (size_t point = 0; point < grid.size(); ++point) grid[point] = static_cast<double>(point % 97) - 48;
+                auto startTime = std::chrono::system_clock::now();
+                auto transformedGrid = pme.forwardTransform(grid.data());
+                auto midTime = std::chrono::system_clock::now();
+                pme.inverseTransform(transformedGrid);
+                auto endTime = std::chrono::system_clock::now();
+                forwardTime += midTime - startTime;
+                inverseTime += endTime - midTime;
+            }
+            std::cout << gridDim << "^3 grid, " << backendName(backend) << " with " << nThreads
+                      << " thread(s): forward " << forwardTime.count() / nCalcs << " s, inverse "
+                      << inverseTime.count() / nCalcs << " s" << std::endl;
+        }
+    }
+}
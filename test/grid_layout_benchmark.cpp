@@ -0,0 +1,167 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+// Times spreading of charges, and probing of the resulting forces, with the linear and bricked grid layouts, on grids
+// of 128^3 and 256^3 points (or the sizes given on the command line) filled with atoms at roughly the density of liquid
+// water.  The FFTs are left out, so that the timings reflect the grid traffic alone.  On Linux, the cache and data TLB
+// misses of each phase are counted with the hardware counters too, where the kernel and CPU provide them.  Only the
+// main thread's misses are counted, so the counts are best compared on one thread, one layout at a time, e.g.
+//
+//     OMP_NUM_THREADS=1 ./GridLayoutBenchmark 256 bricked
+
+#include "helpme.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Exposes the spline cache construction, so that spreading and probing can be timed on their own.
+class BenchmarkPMEInstance : public PMEInstanceD {
+   public:
+    using PMEInstanceD::filterAtomsAndBuildSplineCache;
+};
+
+// Counts the last level cache misses and data TLB load misses of the calling thread between start() and stop(), if
+// the hardware counters are available.  Other threads aren't counted, so run with OMP_NUM_THREADS=1 to compare layouts.
+class MissCounter {
+    int cacheFD_ = -1, tlbFD_ = -1;
+
+#if defined(__linux__)
+    static int open(unsigned type, unsigned long long config) {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = type;
+        attributes.config = config;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        return static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+    }
+    static long long read(int fd) {
+        long long count = 0;
+        return ::read(fd, &count, sizeof(count)) == sizeof(count) ? count : -1;
+    }
+#endif
+
+   public:
+    MissCounter() {
+#if defined(__linux__)
+        cacheFD_ = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        tlbFD_ = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+    }
+    ~MissCounter() {
+#if defined(__linux__)
+        for (int fd : {cacheFD_, tlbFD_})
+            if (fd >= 0) close(fd);
+#endif
+    }
+    MissCounter(const MissCounter &) = delete;
+    MissCounter &operator=(const MissCounter &) = delete;
+
+    bool available() const { return cacheFD_ >= 0 && tlbFD_ >= 0; }
+
+    void start() {
+#if defined(__linux__)
+        if (!available()) return;
+        for (int fd : {cacheFD_, tlbFD_}) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Stops counting, adding the misses since start() to the running totals.
+    void stop(long long &cacheMisses, long long &tlbMisses) {
+#if defined(__linux__)
+        if (!available()) return;
+        for (int fd : {cacheFD_, tlbFD_}) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        cacheMisses += read(cacheFD_);
+        tlbMisses += read(tlbFD_);
+#endif
+    }
+};
+
+int main(int argc, char *argv[]) {
+    std::vector<int> gridDims;
+    std::vector<bool> layouts;
+    for (int arg = 1; arg < argc; ++arg) {
+        std::string option(argv[arg]);
+        if (option == "linear" || option == "bricked") {
+            layouts.push_back(option == "bricked");
+        } else {
+            gridDims.push_back(std::stoi(option));
+        }
+    }
+    if (gridDims.empty()) gridDims = {128, 256};
+    if (layouts.empty()) layouts = {false, true};
+
+    int nCalcs = 10;
+    int splineOrder = 6;
+    double atomsPerGridPoint = 0.1;
+    for (int gridDim : gridDims) {
+        double boxLength = gridDim;
+        int nAtoms = static_cast<int>(atomsPerGridPoint * gridDim * gridDim * gridDim);
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<double> position(0, boxLength);
+        std::uniform_real_distribution<double> charge(-1, 1);
+        helpme::Matrix<double> coords(nAtoms, 3);
+        helpme::Matrix<double> charges(nAtoms, 1);
+        for (int atom = 0; atom < nAtoms; ++atom) {
+            for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+            charges(atom, 0) = charge(generator);
+        }
+
+        for (bool bricked : layouts) {
+            BenchmarkPMEInstance pme;
+            pme.setup(1, 0.3, splineOrder, gridDim, gridDim, gridDim, 332.0716, 0);
+            pme.setLatticeVectors(boxLength, boxLength, boxLength, 90, 90, 90, PMEInstanceD::LatticeType::XAligned);
+            pme.setSpatialSorting(true);
+            pme.setBrickedGrids(bricked);
+            pme.filterAtomsAndBuildSplineCache(1, coords);
+            helpme::Matrix<double> forces(nAtoms, 3);
+
+            MissCounter counter;
+            std::chrono::duration<double> spreadTime(0), probeTime(0);
+            long long spreadCacheMisses = 0, spreadTLBMisses = 0, probeCacheMisses = 0, probeTLBMisses = 0;
+            for (int n = 0; n < nCalcs; ++n) {
+                counter.start();
+                auto startTime = std::chrono::system_clock::now();
+                double *realGrid = pme.spreadParameters(0, charges);
+                auto midTime = std::chrono::system_clock::now();
+                counter.stop(spreadCacheMisses, spreadTLBMisses);
+                // The spread grid is as good as any other for timing purposes, so it stands in for the potential.
+                counter.start();
+                pme.probeGrid(realGrid, 0, charges, forces);
+                auto endTime = std::chrono::system_clock::now();
+                counter.stop(probeCacheMisses, probeTLBMisses);
+                spreadTime += midTime - startTime;
+                probeTime += endTime - midTime;
+            }
+            std::cout << gridDim << "^3 grid, " << nAtoms << " atoms, " << (bricked ? "bricked" : "linear")
+                      << " layout: spread " << spreadTime.count() / nCalcs << " s, probe "
+                      << probeTime.count() / nCalcs << " s per step" << std::endl;
+            if (counter.available()) {
+                std::cout << "    cache misses per step: spread " << spreadCacheMisses / nCalcs << ", probe "
+                          << probeCacheMisses / nCalcs << "; dTLB load misses per step: spread "
+                          << spreadTLBMisses / nCalcs << ", probe " << probeTLBMisses / nCalcs << std::endl;
+            } else {
+                std::cout << "    hardware cache and TLB miss counters are not available" << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+// Times the CAB to BAC sort that follows the B pass of the forward FFT, for complex and real grids of 64^3, 128^3 and
+// 256^3 points (or the sizes given on the command line).  The original element by element loop, which writes with a
+// large stride, is compared with the tiled transpose kernel used by helpme.  The number of threads used by the tiled
+// kernel can be set with OMP_NUM_THREADS.
+
+#include "helpme.h"
+#include <chrono>
+#include <complex>
+#include <string>
+
+namespace {
+// The sort, as it was written before the tiled kernels were introduced.
+template <typename T>
+void naiveSort(const T *in, T *out, int dimA, int dimB, int dimC) {
+    for (int b = 0; b < dimB; ++b)
+        for (int a = 0; a < dimA; ++a)
+            for (int c = 0; c < dimC; ++c) out[b * dimA * dimC + a * dimC + c] = in[c * dimA * dimB + a * dimB + b];
+}
+
+template <typename T>
+void tiledSort(const T *in, T *out, int dimA, int dimB, int dimC, int nThreads) {
+    helpme::transposeMatrices(in, dimB, static_cast<size_t>(dimA) * dimB, out, dimC, static_cast<size_t>(dimA) * dimC,
+                              dimA, dimC, dimB, nThreads);
+}
+
+template <typename T>
+void timeSorts(const std::string &label, int gridDim, int nThreads, int nCalcs) {
+    // The A dimension holds the dimA / 2 + 1 complex values left after the real to complex transform.
+    int dimA = gridDim / 2 + 1, dimB = gridDim, dimC = gridDim;
+    helpme::vector<T> in(static_cast<size_t>(dimA) * dimB * dimC), out(in.size());
+    for (size_t n = 0; n < in.size(); ++n) in[n] = T(n % 101);
+
+    std::chrono::duration<double> naiveTime(0), tiledTime(0);
+    for (int n = 0; n < nCalcs; ++n) {
+        auto startTime = std::chrono::system_clock::now();
+        naiveSort(in.data(), out.data(), dimA, dimB, dimC);
+        auto midTime = std::chrono::system_clock::now();
+        tiledSort(in.data(), out.data(), dimA, dimB, dimC, nThreads);
+        auto endTime = std::chrono::system_clock::now();
+        naiveTime += midTime - startTime;
+        tiledTime += endTime - midTime;
+    }
+    double gigabytes = 2e-9 * sizeof(T) * in.size();
+    std::cout << gridDim << "^3 " << label << " grid: naive " << naiveTime.count() / nCalcs << " s ("
+              << gigabytes * nCalcs / naiveTime.count() << " GB/s), tiled with " << nThreads << " thread(s) "
+              << tiledTime.count() / nCalcs << " s (" << gigabytes * nCalcs / tiledTime.count() << " GB/s)"
+              << std::endl;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::vector<int> gridDims;
+    for (int arg = 1; arg < argc; ++arg) gridDims.push_back(std::stoi(argv[arg]));
+    if (gridDims.empty()) gridDims = {64, 128, 256};
+
+    int nCalcs = 10;
+#ifdef _OPENMP
+    int nThreads = omp_get_max_threads();
+#else
+    int nThreads = 1;
+#endif
+    for (int gridDim : gridDims) {
+        timeSorts<std::complex<double>>("complex double", gridDim, 1, nCalcs);
+        if (nThreads > 1) timeSorts<std::complex<double>>("complex double", gridDim, nThreads, nCalcs);
+        timeSorts<double>("real double", gridDim, 1, nCalcs);
+        if (nThreads > 1) timeSorts<double>("real double", gridDim, nThreads, nCalcs);
+    }
+}
@@ -0,0 +1,125 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+
+#include "helpme.h"
+
+namespace {
+std::atomic<bool> countingAllocations(false);
+std::atomic<size_t> allocationCount(0);
+
+// Run a few steps to let the workspaces settle, then count the heap allocations made by one more step.  Matrix and
+// workspace storage comes from operator new too, via helpme's aligned allocator, so every allocation is counted.
+size_t allocationsPerStep(const std::function<void(int)> &step) {
+    for (int warmup = 0; warmup < 2; ++warmup) step(warmup);
+    allocationCount = 0;
+    countingAllocations = true;
+    step(2);
+    countingAllocations = false;
+    return allocationCount;
+}
+
+void *countedAllocate(size_t size) {
+    if (countingAllocations) ++allocationCount;
+    void *ptr = std::malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void countedFree(void *ptr) noexcept { std::free(ptr); }
+}  // namespace
+
+void *operator new(size_t size) { return countedAllocate(size); }
+void *operator new[](size_t size) { return countedAllocate(size); }
+void operator delete(void *ptr) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { countedFree(ptr); }
+
+TEST_CASE("check that repeated energy, force and virial evaluations do not allocate memory.") {
+    using PME = helpme::PMEInstance<double>;
+    int nAtoms = 200;
+    std::mt19937 generator(2468);
+    std::uniform_real_distribution<double> position(0, 20);
+    std::uniform_real_distribution<double> parameter(-1, 1);
+    helpme::Matrix<double> coords(nAtoms, 3), quadrupoles(nAtoms, 10), charges(nAtoms, 1), c6s(nAtoms, 3);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        for (int component = 0; component < 10; ++component) quadrupoles(atom, component) = parameter(generator);
+        for (int grid = 0; grid < 3; ++grid) c6s(atom, grid) = parameter(generator);
+        charges(atom, 0) = quadrupoles(atom, 0);
+    }
+    helpme::Matrix<short> pairList(nAtoms - 1, 2);
+    for (int pair = 0; pair < nAtoms - 1; ++pair) {
+        pairList(pair, 0) = pair;
+        pairList(pair, 1) = pair + 1;
+    }
+    helpme::Matrix<double> forces(nAtoms, 3), virial(1, 6), atomEnergies(nAtoms, 1), atomVirials(nAtoms, 6);
+    auto move = [&](int step) {
+        for (int atom = 0; atom < nAtoms; ++atom) coords(atom, 0) += 0.01 * (step + 1);
+    };
+
+    for (int rPower : {1, 6}) {
+        for (int nThreads : {1, 2}) {
+            PME pme;
+            pme.setup(rPower, 0.3, 6, 20, 21, 22, 332.0716, nThreads);
+            pme.setLatticeVectors(20, 21, 22, 90, 90, 90, PME::LatticeType::XAligned);
+
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.computeERec(0, charges, coords);
+                    }) == 0);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.computeEFRec(0, charges, coords, forces);
+                    }) == 0);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.computeEFVRec(2, quadrupoles, coords, forces, virial);
+                    }) == 0);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.setLatticeVectors(20 + 0.01 * step, 21, 22, 90, 90, 90, PME::LatticeType::XAligned);
+                        pme.computeEFVRec(0, charges, coords, forces, virial);
+                    }) == 0);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.computeEFVRecPerAtom(charges, coords, forces, virial, atomEnergies, atomVirials);
+                    }) == 0);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.computeEFVRecMultiGrid(c6s, coords, forces, virial);
+                    }) == 0);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.computeEFVAll(pairList, pairList, 0, charges, coords, forces, virial);
+                        pme.computeEFDir(pairList, 0, charges, coords, forces);
+                        pme.computeEFAdj(pairList, 0, charges, coords, forces);
+                    }) == 0);
+
+            pme.setSpatialSorting(true);
+            pme.setBrickedGrids(true);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        move(step);
+                        pme.computeEFVRec(0, charges, coords, forces, virial);
+                    }) == 0);
+            pme.setIncrementalUpdates(true);
+            REQUIRE(allocationsPerStep([&](int step) {
+                        coords(step, 1) += 0.1;
+                        pme.computeEFVRec(0, charges, coords, forces, virial);
+                    }) == 0);
+        }
+    }
+}
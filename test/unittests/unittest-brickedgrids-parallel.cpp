@@ -0,0 +1,83 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include "mpihelper.h"
+#include "mpi_wrapper.h"
+#include "helpme.h"
+
+template <typename Real>
+std::tuple<Real, helpme::Matrix<Real>, helpme::Matrix<Real>> runBrickedTest(int nx, int ny, int nz, bool bricked) {
+    float kappa = 0.3;
+    int gridX = 32;
+    int gridY = 32;
+    int gridZ = 32;
+    int splineOrder = 6;
+
+    helpme::Matrix<Real> coords(
+        {{2.0, 2.0, 2.0}, {2.5, 2.0, 3.0}, {1.5, 2.0, 3.0}, {0.0, 0.0, 0.0}, {0.5, 0.0, 1.0}, {-0.5, 0.0, 1.0}});
+    helpme::Matrix<Real> charges({-0.834, 0.417, 0.417, -0.834, 0.417, 0.417});
+    double scaleFactor = 332.0716;
+    using PMEInstanceR = helpme::PMEInstance<Real>;
+    auto pme = std::unique_ptr<PMEInstanceR>(new PMEInstanceR());
+    Real parallelEnergy;
+    helpme::Matrix<Real> nodeForces(6, 3);
+    helpme::Matrix<Real> nodeVirial(6, 1);
+    helpme::Matrix<Real> parallelForces(6, 3);
+    helpme::Matrix<Real> parallelVirial(6, 1);
+
+    bool serialRun = nx == 1 && ny == 1 && nz == 1;
+    if (serialRun) {
+        pme->setup(1, kappa, splineOrder, gridX, gridY, gridZ, scaleFactor, 1);
+    } else {
+        pme->setupParallel(1, kappa, splineOrder, gridX, gridY, gridZ, scaleFactor, 1, MPI_COMM_WORLD,
+                           PMEInstanceR::NodeOrder::ZYX, nx, ny, nz);
+    }
+    pme->setLatticeVectors(20, 20, 20, 90, 90, 90, PMEInstanceR::LatticeType::XAligned);
+    pme->setBrickedGrids(bricked);
+    Real nodeEnergy = pme->computeEFVRec(0, charges, coords, nodeForces, nodeVirial);
+
+    pme.reset();  // This is needed to avoid problems destroying the contained MPI communicators after MPI_Finalize.
+
+    if (serialRun) {
+        return std::make_tuple(nodeEnergy, std::move(nodeForces), std::move(nodeVirial));
+    } else {
+        // Only node 0 holds the results.
+        helpme::MPITypes<Real> mpitype;
+        MPI_Reduce(&nodeEnergy, &parallelEnergy, 1, mpitype.realType_, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(nodeForces[0], parallelForces[0], 6 * 3, mpitype.realType_, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(nodeVirial[0], parallelVirial[0], 6, mpitype.realType_, MPI_SUM, 0, MPI_COMM_WORLD);
+        return std::make_tuple(parallelEnergy, std::move(parallelForces), std::move(parallelVirial));
+    }
+}
+
+TEST_CASE("check that the bricked grid layout reproduces the serial linear layout results in parallel.") {
+    MPIHelper mpi;
+
+    SECTION("Double precision tests") {
+        double TOL = 1e-8;
+        // The serial run with the linear layout is the reference.
+        auto serialEFV = runBrickedTest<double>(1, 1, 1, false);
+        double serialEnergy = std::get<0>(serialEFV);
+        helpme::Matrix<double> serialForces = std::get<1>(serialEFV);
+        helpme::Matrix<double> serialVirial = std::get<2>(serialEFV);
+        for (auto partition : {std::make_tuple(2, 1, 1), std::make_tuple(1, 2, 1), std::make_tuple(1, 1, 2)}) {
+            auto brickedEFV =
+                runBrickedTest<double>(std::get<0>(partition), std::get<1>(partition), std::get<2>(partition), true);
+            if (mpi.myRank_ == 0) {
+                REQUIRE(std::get<0>(brickedEFV) == Approx(serialEnergy).margin(TOL));
+                REQUIRE(std::get<1>(brickedEFV).almostEquals(serialForces, TOL));
+                REQUIRE(std::get<2>(brickedEFV).almostEquals(serialVirial, TOL));
+            }
+        }
+    }
+
+    SECTION("Finalize MPI") { mpi.finalize(); }
+}
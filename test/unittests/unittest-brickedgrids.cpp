@@ -0,0 +1,101 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+TEST_CASE("check that the bricked grid layout reproduces the linear layout results.") {
+    constexpr double TOL = 1e-8;
+    int nAtoms = 300;
+    std::mt19937 generator(1357);
+    std::uniform_real_distribution<double> position(-5, 25);
+    std::uniform_real_distribution<double> parameter(-1, 1);
+    helpme::Matrix<double> coords(nAtoms, 3);
+    helpme::Matrix<double> charges(nAtoms, 1);
+    helpme::Matrix<double> dipoles(nAtoms, 4);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        charges(atom, 0) = parameter(generator);
+        for (int component = 0; component < 4; ++component) dipoles(atom, component) = parameter(generator);
+    }
+
+    // Include a generic spline order, an order longer than a brick, and a grid that is smaller than one brick.
+    for (int splineOrder : {4, 5, 6, 7, 10}) {
+        for (int gridDim : {7, 29}) {
+            if (splineOrder > gridDim) continue;
+            for (int nThreads : {1, 3}) {
+                for (int rPower : {1, 6}) {
+                    helpme::PMEInstance<double> linearPME, brickedPME;
+                    for (auto pme : {&linearPME, &brickedPME}) {
+                        pme->setup(rPower, 0.3, splineOrder, gridDim, gridDim + 1, gridDim + 3, 332.0716, nThreads);
+                        pme->setLatticeVectors(20, 21, 22, 85, 90, 95,
+                                               helpme::PMEInstance<double>::LatticeType::XAligned);
+                    }
+                    brickedPME.setBrickedGrids(true);
+
+                    helpme::Matrix<double> linearForces(nAtoms, 3), brickedForces(nAtoms, 3);
+                    helpme::Matrix<double> linearVirial(1, 6), brickedVirial(1, 6);
+                    double linearEnergy = linearPME.computeEFVRec(0, charges, coords, linearForces, linearVirial);
+                    double brickedEnergy =
+                        brickedPME.computeEFVRec(0, charges, coords, brickedForces, brickedVirial);
+                    REQUIRE(linearEnergy == Approx(brickedEnergy).margin(TOL));
+                    REQUIRE(linearForces.almostEquals(brickedForces, TOL));
+                    REQUIRE(linearVirial.almostEquals(brickedVirial, TOL));
+                }
+            }
+        }
+    }
+
+    SECTION("incremental updates and per-atom energies probe the bricked potential") {
+        helpme::PMEInstance<double> linearPME, brickedPME;
+        for (auto pme : {&linearPME, &brickedPME}) {
+            pme->setup(1, 0.3, 6, 24, 25, 26, 332.0716, 2);
+            pme->setLatticeVectors(20, 21, 22, 85, 90, 95, helpme::PMEInstance<double>::LatticeType::XAligned);
+            pme->setIncrementalUpdates(true);
+        }
+        brickedPME.setBrickedGrids(true);
+        helpme::Matrix<double> movedCoords = coords.clone();
+        for (int step = 0; step < 3; ++step) {
+            movedCoords(step, 1) += 0.3;
+            helpme::Matrix<double> linearForces(nAtoms, 3), brickedForces(nAtoms, 3);
+            helpme::Matrix<double> linearVirial(1, 6), brickedVirial(1, 6);
+            double linearEnergy = linearPME.computeEFVRec(0, charges, movedCoords, linearForces, linearVirial);
+            double brickedEnergy = brickedPME.computeEFVRec(0, charges, movedCoords, brickedForces, brickedVirial);
+            REQUIRE(linearEnergy == Approx(brickedEnergy).margin(TOL));
+            REQUIRE(linearForces.almostEquals(brickedForces, TOL));
+        }
+        helpme::Matrix<double> linearForces(nAtoms, 3), brickedForces(nAtoms, 3);
+        helpme::Matrix<double> linearVirial(1, 6), brickedVirial(1, 6);
+        helpme::Matrix<double> linearEnergies(nAtoms, 1), brickedEnergies(nAtoms, 1);
+        helpme::Matrix<double> linearVirials(nAtoms, 6), brickedVirials(nAtoms, 6);
+        linearPME.computeEFVRecPerAtom(charges, movedCoords, linearForces, linearVirial, linearEnergies,
+                                       linearVirials);
+        brickedPME.computeEFVRecPerAtom(charges, movedCoords, brickedForces, brickedVirial, brickedEnergies,
+                                        brickedVirials);
+        REQUIRE(linearForces.almostEquals(brickedForces, TOL));
+        REQUIRE(linearEnergies.almostEquals(brickedEnergies, TOL));
+    }
+
+    SECTION("multipoles fall back to the linear layout") {
+        helpme::PMEInstance<double> linearPME, brickedPME;
+        for (auto pme : {&linearPME, &brickedPME}) {
+            pme->setup(1, 0.3, 6, 24, 25, 26, 332.0716, 2);
+            pme->setLatticeVectors(20, 21, 22, 85, 90, 95, helpme::PMEInstance<double>::LatticeType::XAligned);
+        }
+        brickedPME.setBrickedGrids(true);
+        helpme::Matrix<double> linearForces(nAtoms, 3), brickedForces(nAtoms, 3);
+        double linearEnergy = linearPME.computeEFRec(1, dipoles, coords, linearForces);
+        double brickedEnergy = brickedPME.computeEFRec(1, dipoles, coords, brickedForces);
+        REQUIRE(linearEnergy == Approx(brickedEnergy).margin(TOL));
+        REQUIRE(linearForces.almostEquals(brickedForces, TOL));
+    }
+}
@@ -12,6 +12,7 @@
 #include "memory.h"
 
 #include <algorithm>
+#include <cmath>
 #include <complex>
 #include <iostream>
 #include <iomanip>
@@ -128,3 +129,155 @@ TEST_CASE("test the fftw wrapper class.") {
         REQUIRE_THROWS_WITH(helpme::FFTWWrapper<int>(4), Catch::Contains("precision mode"));
     }
 }
+
+TEST_CASE("test that the batched fftw wrapper matches line by line transforms.") {
+#if HAVE_FFTWD == 1
+    const double TOL = 1e-10;
+    // Three lines of length 6, with the real lines padded to a distance of 7 and the complex lines to 5.
+    const size_t dim = 6, nLines = 3, realDistance = 7, complexDistance = 5, complexDim = dim / 2 + 1;
+    helpme::vector<double> realData(nLines * realDistance, 0);
+    helpme::vector<std::complex<double>> complexData(nLines * complexDistance);
+    for (size_t line = 0; line < nLines; ++line)
+        for (size_t point = 0; point < dim; ++point)
+            realData[line * realDistance + point] = std::sin(line + 2.0 * point);
+
+    helpme::FFTWWrapper<double> lineHelper(dim);
+    helpme::FFTWBatchWrapper<double> realBatch(dim, nLines, realDistance, complexDistance, true);
+    helpme::vector<std::complex<double>> expectedLine(complexDim), foundLine(complexDim);
+    realBatch.transform(realData.data(), complexData.data());
+    for (size_t line = 0; line < nLines; ++line) {
+        lineHelper.transform(realData.data() + line * realDistance, expectedLine.data());
+        std::copy(complexData.begin() + line * complexDistance,
+                  complexData.begin() + line * complexDistance + complexDim, foundLine.begin());
+        REQUIRE(isClose<double>(expectedLine, foundLine, TOL));
+    }
+
+    // The round trip scales the data by the transform length.
+    helpme::vector<double> roundTrip(nLines * realDistance, 0);
+    realBatch.transform(complexData.data(), roundTrip.data());
+    for (size_t line = 0; line < nLines; ++line)
+        for (size_t point = 0; point < dim; ++point)
+            REQUIRE(roundTrip[line * realDistance + point] ==
+                    Approx(dim * realData[line * realDistance + point]).margin(TOL));
+
+    helpme::FFTWBatchWrapper<double> complexBatch(dim, nLines, dim, dim, false);
+    helpme::vector<std::complex<double>> lines(nLines * dim), expected(dim), found(dim);
+    for (size_t n = 0; n < lines.size(); ++n) lines[n] = std::complex<double>(std::cos(n), std::sin(3.0 * n));
+    helpme::vector<std::complex<double>> original = lines;
+    complexBatch.transform(lines.data(), FFTW_FORWARD);
+    for (size_t line = 0; line < nLines; ++line) {
+        std::copy(original.begin() + line * dim, original.begin() + (line + 1) * dim, expected.begin());
+        lineHelper.transform(expected.data(), FFTW_FORWARD);
+        std::copy(lines.begin() + line * dim, lines.begin() + (line + 1) * dim, found.begin());
+        REQUIRE(isClose<double>(expected, found, TOL));
+    }
+    REQUIRE_THROWS_WITH(complexBatch.transform(realData.data(), complexData.data()), Catch::Contains("not planned"));
+#endif
+}
+
+TEST_CASE("test that the threaded batch wrapper matches a single batch.") {
+#if HAVE_FFTWD == 1
+    const double TOL = 1e-10;
+    // An odd real line distance forces the chunk boundaries onto multiples of several lines, to preserve alignment.
+    const size_t dim = 10, nLines = 37, realDistance = 11, complexDistance = 6;
+    helpme::vector<double> realData(nLines * realDistance, 0);
+    for (size_t line = 0; line < nLines; ++line)
+        for (size_t point = 0; point < dim; ++point)
+            realData[line * realDistance + point] = std::cos(0.3 * line + point);
+    helpme::vector<std::complex<double>> lines(nLines * dim);
+    for (size_t n = 0; n < lines.size(); ++n) lines[n] = std::complex<double>(std::sin(n), std::cos(2.0 * n));
+
+    helpme::FFTWBatchWrapper<double> realBatch(dim, nLines, realDistance, complexDistance, true);
+    helpme::FFTWBatchWrapper<double> complexBatch(dim, nLines, dim, dim, false);
+    helpme::vector<std::complex<double>> expectedComplex(nLines * complexDistance);
+    helpme::vector<double> expectedReal(nLines * realDistance, 0);
+    helpme::vector<std::complex<double>> expectedLines = lines;
+    realBatch.transform(realData.data(), expectedComplex.data());
+    realBatch.transform(expectedComplex.data(), expectedReal.data());
+    complexBatch.transform(expectedLines.data(), FFTW_BACKWARD);
+
+    for (int nThreads : {1, 2, 3, 8, 64}) {
+        helpme::FFTWPlanner<double> planner;
+        helpme::ThreadedFFTBatch<double> threadedRealBatch(planner, dim, nLines, realDistance, complexDistance, true,
+                                                           nThreads);
+        helpme::ThreadedFFTBatch<double> threadedComplexBatch(planner, dim, nLines, dim, dim, false, nThreads);
+        for (auto numChunks : {threadedRealBatch.numChunks(), threadedComplexBatch.numChunks()}) {
+            REQUIRE(numChunks >= 1);
+            REQUIRE(numChunks <= static_cast<size_t>(nThreads));
+        }
+        helpme::vector<std::complex<double>> foundComplex(nLines * complexDistance);
+        helpme::vector<double> foundReal(nLines * realDistance, 0);
+        helpme::vector<std::complex<double>> foundLines = lines;
+        threadedRealBatch.transform(realData.data(), foundComplex.data());
+        threadedRealBatch.transform(foundComplex.data(), foundReal.data());
+        threadedComplexBatch.transform(foundLines.data(), FFTW_BACKWARD);
+        REQUIRE(isClose<double>(expectedComplex, foundComplex, TOL));
+        REQUIRE(isClose<double>(expectedReal, foundReal, TOL));
+        REQUIRE(isClose<double>(expectedLines, foundLines, TOL));
+    }
+
+    // A batch with no lines has no chunks, and transforming it does nothing.
+    helpme::FFTWPlanner<double> planner;
+    helpme::ThreadedFFTBatch<double> emptyRealBatch(planner, dim, 0, realDistance, complexDistance, true, 4);
+    helpme::ThreadedFFTBatch<double> emptyComplexBatch(planner, dim, 0, dim, dim, false, 4);
+    REQUIRE(emptyRealBatch.numChunks() == 0);
+    REQUIRE(emptyComplexBatch.numChunks() == 0);
+    REQUIRE_NOTHROW(emptyRealBatch.transform(realData.data(), expectedComplex.data()));
+    REQUIRE_NOTHROW(emptyRealBatch.transform(expectedComplex.data(), realData.data()));
+    REQUIRE_NOTHROW(emptyComplexBatch.transform(lines.data(), FFTW_FORWARD));
+#endif
+}
+
+TEST_CASE("test that the native 3D fftw wrapper matches transforms of each dimension in turn.") {
+#if HAVE_FFTWD == 1
+    const double TOL = 1e-10;
+    const size_t dimA = 6, dimB = 5, dimC = 4, complexDimA = dimA / 2 + 1;
+    helpme::vector<double> grid(dimC * dimB * dimA);
+    for (size_t n = 0; n < grid.size(); ++n) grid[n] = std::sin(0.7 * n) + std::cos(0.2 * n * n);
+
+    // Transform A, then B, then C, one line at a time.
+    helpme::FFTWWrapper<double> helperA(dimA), helperB(dimB), helperC(dimC);
+    helpme::vector<std::complex<double>> expected(dimC * dimB * complexDimA);
+    for (size_t row = 0; row < dimC * dimB; ++row)
+        helperA.transform(grid.data() + row * dimA, expected.data() + row * complexDimA);
+    helpme::vector<std::complex<double>> lineB(dimB), lineC(dimC);
+    for (size_t c = 0; c < dimC; ++c) {
+        for (size_t a = 0; a < complexDimA; ++a) {
+            for (size_t b = 0; b < dimB; ++b) lineB[b] = expected[(c * dimB + b) * complexDimA + a];
+            helperB.transform(lineB.data(), FFTW_FORWARD);
+            for (size_t b = 0; b < dimB; ++b) expected[(c * dimB + b) * complexDimA + a] = lineB[b];
+        }
+    }
+    for (size_t b = 0; b < dimB; ++b) {
+        for (size_t a = 0; a < complexDimA; ++a) {
+            for (size_t c = 0; c < dimC; ++c) lineC[c] = expected[(c * dimB + b) * complexDimA + a];
+            helperC.transform(lineC.data(), FFTW_FORWARD);
+            for (size_t c = 0; c < dimC; ++c) expected[(c * dimB + b) * complexDimA + a] = lineC[c];
+        }
+    }
+
+    helpme::FFTW3DWrapper<double> helper3D(dimA, dimB, dimC);
+    helpme::vector<std::complex<double>> found(dimC * dimB * complexDimA);
+    helper3D.transform(grid.data(), found.data());
+    REQUIRE(isClose<double>(expected, found, TOL));
+
+    // The round trip scales the data by the number of grid points.
+    helpme::vector<double> roundTrip(grid.size());
+    helper3D.transform(found.data(), roundTrip.data());
+    for (size_t n = 0; n < grid.size(); ++n) REQUIRE(roundTrip[n] == Approx(grid.size() * grid[n]).margin(TOL));
+
+    // Threaded runs only get a grid plan if FFTW can share it among the threads.
+    helpme::FFTWPlanner<double> planner;
+#if HAVE_FFTW_THREADS == 1
+    auto threadedPlan = planner.makeGridPlan(dimA, dimB, dimC, 2);
+    REQUIRE(threadedPlan);
+    helpme::vector<std::complex<double>> threadedFound(dimC * dimB * complexDimA);
+    threadedPlan->transform(grid.data(), threadedFound.data());
+    REQUIRE(isClose<double>(expected, threadedFound, TOL));
+    threadedPlan->transform(threadedFound.data(), roundTrip.data());
+    for (size_t n = 0; n < grid.size(); ++n) REQUIRE(roundTrip[n] == Approx(grid.size() * grid[n]).margin(TOL));
+#else
+    REQUIRE_FALSE(planner.makeGridPlan(dimA, dimB, dimC, 2));
+#endif
+#endif
+}
@@ -0,0 +1,123 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <cmath>
+#include <complex>
+#include <random>
+
+#include "helpme.h"
+
+#if HAVE_FFTW == 1
+TEST_CASE("check that the bundled FFT batch plans match FFTW's.") {
+    const double TOL = 1e-10;
+    helpme::FFTWPlanner<double> fftw;
+    helpme::BundledFFTPlanner<double> bundled;
+    // Lengths that exercise each of the specialized radices, a generic radix and odd real transforms.
+    for (size_t dim : {1, 2, 6, 7, 16, 20, 21, 45, 49, 98}) {
+        const size_t nLines = 5, complexDim = dim / 2 + 1, realDistance = dim + 1;
+        helpme::vector<double> realData(nLines * realDistance, 0);
+        for (size_t n = 0; n < realData.size(); ++n) realData[n] = std::sin(0.3 * n) + std::cos(0.1 * n * n);
+        helpme::vector<std::complex<double>> lines(nLines * dim);
+        for (size_t n = 0; n < lines.size(); ++n) lines[n] = std::complex<double>(std::sin(n), std::cos(2.0 * n));
+
+        auto expectedRealPlan = fftw.makeBatchPlan(dim, nLines, realDistance, complexDim, true);
+        auto foundRealPlan = bundled.makeBatchPlan(dim, nLines, realDistance, complexDim, true);
+        helpme::vector<std::complex<double>> expectedComplex(nLines * complexDim), foundComplex(nLines * complexDim);
+        expectedRealPlan->transform(realData.data(), expectedComplex.data());
+        foundRealPlan->transform(realData.data(), foundComplex.data());
+        for (size_t n = 0; n < expectedComplex.size(); ++n)
+            REQUIRE(std::abs(expectedComplex[n] - foundComplex[n]) < TOL);
+
+        helpme::vector<double> expectedReal(nLines * realDistance, 0), foundReal(nLines * realDistance, 0);
+        expectedRealPlan->transform(expectedComplex.data(), expectedReal.data());
+        foundRealPlan->transform(foundComplex.data(), foundReal.data());
+        for (size_t line = 0; line < nLines; ++line)
+            for (size_t point = 0; point < dim; ++point)
+                REQUIRE(foundReal[line * realDistance + point] ==
+                        Approx(expectedReal[line * realDistance + point]).margin(TOL));
+
+        auto expectedComplexPlan = fftw.makeBatchPlan(dim, nLines, dim, dim, false);
+        auto foundComplexPlan = bundled.makeBatchPlan(dim, nLines, dim, dim, false);
+        for (int direction : {helpme::FFTForward, helpme::FFTBackward}) {
+            helpme::vector<std::complex<double>> expectedLines = lines, foundLines = lines;
+            expectedComplexPlan->transform(expectedLines.data(), direction);
+            foundComplexPlan->transform(foundLines.data(), direction);
+            for (size_t n = 0; n < lines.size(); ++n) REQUIRE(std::abs(expectedLines[n] - foundLines[n]) < TOL);
+        }
+        REQUIRE_THROWS_WITH(foundComplexPlan->transform(realData.data(), foundComplex.data()),
+                            Catch::Contains("not planned"));
+    }
+    REQUIRE_FALSE(bundled.makeGridPlan(4, 5, 6, 1));
+}
+#endif
+
+TEST_CASE("check that each FFT backend gives the same energies, forces and virials.") {
+    using PME = helpme::PMEInstance<double>;
+    constexpr double TOL = 1e-8;
+    int nAtoms = 100;
+    std::mt19937 generator(1357);
+    std::uniform_real_distribution<double> position(0, 20);
+    std::uniform_real_distribution<double> charge(-1, 1);
+    helpme::Matrix<double> coords(nAtoms, 3);
+    helpme::Matrix<double> charges(nAtoms, 1);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        charges(atom, 0) = charge(generator);
+    }
+
+    // The results from each backend are compared with those from FFTW, or the bundled FFT if FFTW isn't available.
+    PME unbuilt;
+#if HAVE_FFTW == 1
+    PME::FFTBackend reference = PME::FFTBackend::FFTW;
+    std::vector<PME::FFTBackend> backends = {PME::FFTBackend::Bundled};
+#else
+    PME::FFTBackend reference = PME::FFTBackend::Bundled;
+    std::vector<PME::FFTBackend> backends;
+    REQUIRE_THROWS_WITH(unbuilt.setFFTBackend(PME::FFTBackend::FFTW), Catch::Contains("HAVE_FFTW"));
+#endif
+#if HAVE_MKL == 1
+    backends.push_back(PME::FFTBackend::MKL);
+#else
+    REQUIRE_THROWS_WITH(unbuilt.setFFTBackend(PME::FFTBackend::MKL), Catch::Contains("HAVE_MKL"));
+#endif
+
+    // Odd grid dimensions exercise the bundled library's generic radix and its odd length real transforms.
+    for (int nThreads : {1, 2}) {
+        auto runEFV = [&](PME::FFTBackend backend, helpme::Matrix<double> &forces, helpme::Matrix<double> &virial) {
+            PME pme;
+            pme.setFFTBackend(backend);
+            pme.setup(1, 0.3, 5, 21, 18, 14, 332.0716, nThreads);
+            pme.setLatticeVectors(20, 21, 22, 90, 90, 90, PME::LatticeType::XAligned);
+            return pme.computeEFVRec(0, charges, coords, forces, virial);
+        };
+        helpme::Matrix<double> referenceForces(nAtoms, 3), referenceVirial(1, 6);
+        double referenceEnergy = runEFV(reference, referenceForces, referenceVirial);
+        for (auto backend : backends) {
+            helpme::Matrix<double> forces(nAtoms, 3), virial(1, 6);
+            double energy = runEFV(backend, forces, virial);
+            REQUIRE(energy == Approx(referenceEnergy).margin(TOL));
+            REQUIRE(forces.almostEquals(referenceForces, TOL));
+            REQUIRE(virial.almostEquals(referenceVirial, TOL));
+        }
+
+        // Switching backends after setup replans the transforms for the existing grid.
+        PME pme;
+        pme.setup(1, 0.3, 5, 21, 18, 14, 332.0716, nThreads);
+        pme.setLatticeVectors(20, 21, 22, 90, 90, 90, PME::LatticeType::XAligned);
+        for (auto backend : backends) {
+            pme.setFFTBackend(backend);
+            helpme::Matrix<double> forces(nAtoms, 3), virial(1, 6);
+            double energy = pme.computeEFVRec(0, charges, coords, forces, virial);
+            REQUIRE(energy == Approx(referenceEnergy).margin(TOL));
+            REQUIRE(forces.almostEquals(referenceForces, TOL));
+        }
+    }
+}
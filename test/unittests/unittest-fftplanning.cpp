@@ -0,0 +1,58 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <random>
+
+#include "helpme.h"
+
+TEST_CASE("check that the FFT planning rigor does not change the results, and that wisdom can be saved and loaded.") {
+    using PME = helpme::PMEInstance<double>;
+    constexpr double TOL = 1e-8;
+    int nAtoms = 100;
+    std::mt19937 generator(2468);
+    std::uniform_real_distribution<double> position(0, 20);
+    std::uniform_real_distribution<double> charge(-1, 1);
+    helpme::Matrix<double> coords(nAtoms, 3);
+    helpme::Matrix<double> charges(nAtoms, 1);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        charges(atom, 0) = charge(generator);
+    }
+
+    auto runEF = [&](PME::FFTPlanningRigor rigor, helpme::Matrix<double> &forces) {
+        PME pme;
+        pme.setup(1, 0.3, 5, 16, 18, 20, 332.0716, 1, rigor);
+        pme.setLatticeVectors(20, 21, 22, 90, 90, 90, PME::LatticeType::XAligned);
+        return pme.computeEFRec(0, charges, coords, forces);
+    };
+
+    SECTION("planning rigor") {
+        helpme::Matrix<double> estimateForces(nAtoms, 3);
+        double estimateEnergy = runEF(PME::FFTPlanningRigor::Estimate, estimateForces);
+        for (auto rigor : {PME::FFTPlanningRigor::Measure, PME::FFTPlanningRigor::Patient}) {
+            helpme::Matrix<double> forces(nAtoms, 3);
+            double energy = runEF(rigor, forces);
+            REQUIRE(energy == Approx(estimateEnergy).margin(TOL));
+            REQUIRE(forces.almostEquals(estimateForces, TOL));
+        }
+    }
+    SECTION("wisdom files") {
+        helpme::Matrix<double> forces(nAtoms, 3);
+        runEF(PME::FFTPlanningRigor::Measure, forces);
+        const std::string wisdomFile = "helpme_unittest_wisdom.dat";
+        PME::exportFFTWisdom(wisdomFile);
+        REQUIRE(PME::importFFTWisdom(wisdomFile));
+        std::remove(wisdomFile.c_str());
+        REQUIRE_FALSE(PME::importFFTWisdom("helpme_unittest_missing_wisdom.dat"));
+        REQUIRE_THROWS(PME::exportFFTWisdom("/nonexistent_directory/helpme_wisdom.dat"));
+    }
+}
@@ -0,0 +1,69 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+TEST_CASE("check that incremental updates of the spread grid reproduce full recomputations.") {
+    constexpr double TOL = 1e-8;
+    int nAtoms = 300;
+    std::mt19937 generator(2468);
+    std::uniform_real_distribution<double> position(0, 22);
+    std::uniform_real_distribution<double> parameter(-1, 1);
+    std::uniform_int_distribution<int> atomChoice(0, nAtoms - 1);
+    std::uniform_real_distribution<double> displacement(-0.5, 0.5);
+
+    for (int parameterAngMom : {0, 1}) {
+        for (int nThreads : {1, 2}) {
+            helpme::Matrix<double> coords(nAtoms, 3);
+            helpme::Matrix<double> parameters(nAtoms, helpme::nCartesian(parameterAngMom));
+            for (int atom = 0; atom < nAtoms; ++atom) {
+                for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+                for (size_t component = 0; component < parameters.nCols(); ++component)
+                    parameters(atom, component) = parameter(generator);
+            }
+
+            helpme::PMEInstance<double> incrementalPME;
+            incrementalPME.setup(1, 0.3, 5, 24, 25, 26, 332.0716, nThreads);
+            incrementalPME.setLatticeVectors(22, 22, 22, 90, 90, 90,
+                                             helpme::PMEInstance<double>::LatticeType::XAligned);
+            incrementalPME.setIncrementalUpdates(true);
+
+            // Each step moves a few atoms, one of them far enough to land in a different part of the grid, and
+            // changes one atom's parameters, mimicking a sequence of Monte Carlo moves.
+            for (int step = 0; step < 6; ++step) {
+                helpme::PMEInstance<double> referencePME;
+                referencePME.setup(1, 0.3, 5, 24, 25, 26, 332.0716, nThreads);
+                referencePME.setLatticeVectors(22, 22, 22, 90, 90, 90,
+                                               helpme::PMEInstance<double>::LatticeType::XAligned);
+
+                helpme::Matrix<double> referenceForces(nAtoms, 3), incrementalForces(nAtoms, 3);
+                helpme::Matrix<double> referenceVirial(1, 6), incrementalVirial(1, 6);
+                double referenceE = referencePME.computeEFVRec(parameterAngMom, parameters, coords,
+                                                               referenceForces, referenceVirial);
+                double incrementalE = incrementalPME.computeEFVRec(parameterAngMom, parameters, coords,
+                                                                   incrementalForces, incrementalVirial);
+                REQUIRE(referenceE == Approx(incrementalE).margin(TOL));
+                REQUIRE(referenceForces.almostEquals(incrementalForces, TOL));
+                REQUIRE(referenceVirial.almostEquals(incrementalVirial, TOL));
+
+                for (int move = 0; move < 3; ++move) {
+                    int atom = atomChoice(generator);
+                    for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) += displacement(generator);
+                }
+                int jumper = atomChoice(generator);
+                for (int xyz = 0; xyz < 3; ++xyz) coords(jumper, xyz) = position(generator);
+                parameters(atomChoice(generator), 0) = parameter(generator);
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+TEST_CASE("check that Monte Carlo trial move energies match full recomputations.") {
+    constexpr double TOL = 1e-7;
+    int nAtoms = 200;
+
+    for (int rPower : {1, 6}) {
+        std::mt19937 generator(1357);
+        std::uniform_real_distribution<double> position(0, 20);
+        std::uniform_real_distribution<double> displacement(-0.8, 0.8);
+        std::uniform_real_distribution<double> parameter(-1, 1);
+        std::uniform_int_distribution<int> atomChoice(0, nAtoms - 1);
+        helpme::Matrix<double> coords(nAtoms, 3);
+        helpme::Matrix<double> parameters(nAtoms, 1);
+        for (int atom = 0; atom < nAtoms; ++atom) {
+            for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+            parameters(atom, 0) = parameter(generator);
+        }
+
+        helpme::PMEInstance<double> mcPME, referencePME;
+        for (auto pme : {&mcPME, &referencePME}) {
+            pme->setup(rPower, 0.3, 5, 20, 21, 22, 332.0716, 1);
+            pme->setLatticeVectors(20, 21, 22, 90, 90, 90, helpme::PMEInstance<double>::LatticeType::XAligned);
+        }
+        double acceptedEnergy = mcPME.initializeTrialMovesRec(parameters, coords);
+        REQUIRE(acceptedEnergy == Approx(referencePME.computeERec(0, parameters, coords)).margin(TOL));
+
+        // Alternate accepted and rejected moves of one or two atoms, some of which also change their parameters.
+        for (int step = 0; step < 8; ++step) {
+            int nMoved = 1 + step % 2;
+            int movedAtoms[2] = {atomChoice(generator), atomChoice(generator)};
+            if (movedAtoms[1] == movedAtoms[0]) movedAtoms[1] = (movedAtoms[0] + 1) % nAtoms;
+            helpme::Matrix<double> newParameters(nMoved, 1), newCoords(nMoved, 3);
+            helpme::Matrix<double> trialParameters = parameters.clone(), trialCoords = coords.clone();
+            for (int move = 0; move < nMoved; ++move) {
+                int atom = movedAtoms[move];
+                newParameters(move, 0) = step % 3 ? parameters(atom, 0) : parameter(generator);
+                for (int xyz = 0; xyz < 3; ++xyz) newCoords(move, xyz) = coords(atom, xyz) + displacement(generator);
+                trialParameters(atom, 0) = newParameters(move, 0);
+                for (int xyz = 0; xyz < 3; ++xyz) trialCoords(atom, xyz) = newCoords(move, xyz);
+            }
+            double deltaE = mcPME.computeTrialMoveDeltaERec(nMoved, movedAtoms, newParameters, newCoords);
+            double trialEnergy = referencePME.computeERec(0, trialParameters, trialCoords);
+            REQUIRE(acceptedEnergy + deltaE == Approx(trialEnergy).margin(TOL));
+            if (step % 4 != 3) {
+                mcPME.acceptTrialMove();
+                // The move is no longer pending, so accepting again changes nothing.
+                mcPME.acceptTrialMove();
+                acceptedEnergy = trialEnergy;
+                parameters = trialParameters.clone();
+                coords = trialCoords.clone();
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+TEST_CASE("check that spreading several parameter sets at once reproduces separate calculations.") {
+    constexpr double TOL = 1e-8;
+    int nAtoms = 300;
+    int nGrids = 3;
+    std::mt19937 generator(2468);
+    std::uniform_real_distribution<double> position(0, 20);
+    std::uniform_real_distribution<double> parameter(-1, 1);
+    helpme::Matrix<double> coords(nAtoms, 3);
+    helpme::Matrix<double> parameters(nAtoms, nGrids);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        for (int grid = 0; grid < nGrids; ++grid) parameters(atom, grid) = parameter(generator);
+    }
+    helpme::Matrix<double> weights({1.0, -0.5, 2.0});
+
+    for (int rPower : {1, 6}) {
+        for (int nThreads : {1, 3}) {
+            helpme::PMEInstance<double> pme;
+            pme.setup(rPower, 0.3, 5, 24, 25, 26, 332.0716, nThreads);
+            pme.setLatticeVectors(20, 21, 22, 85, 90, 95, helpme::PMEInstance<double>::LatticeType::XAligned);
+
+            double refEnergy = 0;
+            helpme::Matrix<double> refForces(nAtoms, 3), refVirial(1, 6);
+            for (int grid = 0; grid < nGrids; ++grid) {
+                helpme::Matrix<double> gridParameters(nAtoms, 1);
+                for (int atom = 0; atom < nAtoms; ++atom) gridParameters(atom, 0) = parameters(atom, grid);
+                helpme::Matrix<double> forces(nAtoms, 3), virial(1, 6);
+                double weight = weights(grid, 0);
+                refEnergy += weight * pme.computeEFVRec(0, gridParameters, coords, forces, virial);
+                for (int atom = 0; atom < nAtoms; ++atom)
+                    for (int xyz = 0; xyz < 3; ++xyz) refForces(atom, xyz) += weight * forces(atom, xyz);
+                for (int component = 0; component < 6; ++component)
+                    refVirial(0, component) += weight * virial(0, component);
+            }
+
+            helpme::Matrix<double> forces(nAtoms, 3), virial(1, 6);
+            double energy = pme.computeEFVRecMultiGrid(parameters, coords, forces, virial, weights);
+            REQUIRE(refEnergy == Approx(energy).margin(TOL));
+            REQUIRE(refForces.almostEquals(forces, TOL));
+            REQUIRE(refVirial.almostEquals(virial, TOL));
+
+            helpme::Matrix<double> efForces(nAtoms, 3);
+            REQUIRE(refEnergy == Approx(pme.computeEFRecMultiGrid(parameters, coords, efForces, weights)).margin(TOL));
+            REQUIRE(refForces.almostEquals(efForces, TOL));
+            REQUIRE(refEnergy == Approx(pme.computeERecMultiGrid(parameters, coords, weights)).margin(TOL));
+        }
+    }
+}
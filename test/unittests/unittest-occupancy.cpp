@@ -0,0 +1,96 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+TEST_CASE("check that grid regions left empty by slab systems are handled correctly.") {
+    constexpr double TOL = 1e-8;
+    int nSlabAtoms = 200;
+    int nFillerAtoms = 400;
+    int nAtoms = nSlabAtoms + nFillerAtoms;
+    std::mt19937 generator(97531);
+    std::uniform_real_distribution<double> inPlane(0, 24);
+    std::uniform_real_distribution<double> acrossSlab(3, 9);
+    std::uniform_real_distribution<double> anywhere(0, 40);
+    std::uniform_real_distribution<double> parameter(-1, 1);
+
+    // A slab occupying a narrow band along z, followed by a set of filler atoms that are spread throughout the box.
+    helpme::Matrix<double> coords(nAtoms, 3);
+    helpme::Matrix<double> slabCharges(nAtoms, 1), fullCharges(nAtoms, 1);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        bool inSlab = atom < nSlabAtoms;
+        coords(atom, 0) = inPlane(generator);
+        coords(atom, 1) = inPlane(generator);
+        coords(atom, 2) = inSlab ? acrossSlab(generator) : anywhere(generator);
+        fullCharges(atom, 0) = parameter(generator);
+        slabCharges(atom, 0) = inSlab ? fullCharges(atom, 0) : 0;
+    }
+    // The same slab, without the filler atoms.
+    helpme::Matrix<double> slabOnlyCoords(nSlabAtoms, 3), slabOnlyCharges(nSlabAtoms, 1);
+    for (int atom = 0; atom < nSlabAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) slabOnlyCoords(atom, xyz) = coords(atom, xyz);
+        slabOnlyCharges(atom, 0) = slabCharges(atom, 0);
+    }
+
+    for (bool bricked : {false, true}) {
+        for (int nThreads : {1, 2}) {
+            // The reference has zero-charge filler atoms occupying the vacuum, so the whole grid is processed.
+            helpme::PMEInstance<double> referencePME, slabPME;
+            for (auto pme : {&referencePME, &slabPME}) {
+                pme->setup(1, 0.3, 5, 24, 24, 40, 332.0716, nThreads);
+                pme->setLatticeVectors(24, 24, 40, 90, 90, 90, helpme::PMEInstance<double>::LatticeType::XAligned);
+                pme->setBrickedGrids(bricked);
+            }
+            helpme::Matrix<double> refForces(nAtoms, 3), refVirial(1, 6);
+            double refEnergy = referencePME.computeEFVRec(0, slabCharges, coords, refForces, refVirial);
+
+            // Run the full system first, so that the slab calculation has to cope with stale data in the vacuum.
+            helpme::Matrix<double> fullForces(nAtoms, 3), fullVirial(1, 6);
+            slabPME.computeEFVRec(0, fullCharges, coords, fullForces, fullVirial);
+            helpme::Matrix<double> slabForces(nSlabAtoms, 3), slabVirial(1, 6);
+            double slabEnergy = slabPME.computeEFVRec(0, slabOnlyCharges, slabOnlyCoords, slabForces, slabVirial);
+
+            REQUIRE(refEnergy == Approx(slabEnergy).margin(TOL));
+            REQUIRE(refVirial.almostEquals(slabVirial, TOL));
+            for (int atom = 0; atom < nSlabAtoms; ++atom)
+                for (int xyz = 0; xyz < 3; ++xyz)
+                    REQUIRE(refForces(atom, xyz) == Approx(slabForces(atom, xyz)).margin(TOL));
+
+            // The multi-grid path shares the same occupancy information.
+            helpme::Matrix<double> multiForces(nSlabAtoms, 3);
+            double multiEnergy = slabPME.computeEFRecMultiGrid(slabOnlyCharges, slabOnlyCoords, multiForces);
+            REQUIRE(refEnergy == Approx(multiEnergy).margin(TOL));
+            REQUIRE(slabForces.almostEquals(multiForces, TOL));
+
+            // The per-atom terms and the potentials at the atoms only transform back the rows that are probed.
+            helpme::Matrix<double> refAtomForces(nAtoms, 3), refAtomVirial(1, 6);
+            helpme::Matrix<double> refAtomEnergies(nAtoms, 1), refAtomVirials(nAtoms, 6);
+            referencePME.computeEFVRecPerAtom(slabCharges, coords, refAtomForces, refAtomVirial, refAtomEnergies,
+                                              refAtomVirials);
+            helpme::Matrix<double> atomForces(nSlabAtoms, 3), atomVirial(1, 6);
+            helpme::Matrix<double> atomEnergies(nSlabAtoms, 1), atomVirials(nSlabAtoms, 6);
+            slabPME.computeEFVRecPerAtom(slabOnlyCharges, slabOnlyCoords, atomForces, atomVirial, atomEnergies,
+                                         atomVirials);
+            helpme::Matrix<double> refPotential(nAtoms, 4), slabPotential(nSlabAtoms, 4);
+            referencePME.computePRec(0, slabCharges, coords, coords, 1, refPotential);
+            slabPME.computePRec(0, slabOnlyCharges, slabOnlyCoords, slabOnlyCoords, 1, slabPotential);
+            for (int atom = 0; atom < nSlabAtoms; ++atom) {
+                REQUIRE(refAtomEnergies(atom, 0) == Approx(atomEnergies(atom, 0)).margin(TOL));
+                for (int component = 0; component < 6; ++component)
+                    REQUIRE(refAtomVirials(atom, component) == Approx(atomVirials(atom, component)).margin(TOL));
+                for (int component = 0; component < 4; ++component)
+                    REQUIRE(refPotential(atom, component) == Approx(slabPotential(atom, component)).margin(TOL));
+            }
+        }
+    }
+}
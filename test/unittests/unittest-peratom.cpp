@@ -0,0 +1,75 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+namespace {
+template <typename Real>
+void checkPerAtomDecomposition(int rPower, int nThreads, bool bricked) {
+    constexpr double TOL = 1e-8;
+    int nAtoms = 300;
+    std::mt19937 generator(2468);
+    std::uniform_real_distribution<Real> position(0, 22);
+    std::uniform_real_distribution<Real> parameter(-1, 1);
+    helpme::Matrix<Real> coords(nAtoms, 3);
+    helpme::Matrix<Real> parameters(nAtoms, 1);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        parameters(atom, 0) = parameter(generator);
+    }
+
+    helpme::PMEInstance<Real> pme;
+    pme.setup(rPower, 0.3, 5, 24, 25, 26, 332.0716, nThreads);
+    pme.setLatticeVectors(21, 22, 23, 85, 90, 95, helpme::PMEInstance<Real>::LatticeType::XAligned);
+    pme.setBrickedGrids(bricked);
+
+    helpme::Matrix<Real> refForces(nAtoms, 3), refVirial(1, 6);
+    Real refEnergy = pme.computeEFVRec(0, parameters, coords, refForces, refVirial);
+
+    helpme::Matrix<Real> forces(nAtoms, 3), atomEnergies(nAtoms, 1);
+    Real energy = pme.computeEFRecPerAtom(parameters, coords, forces, atomEnergies);
+    REQUIRE(energy == Approx(refEnergy).margin(TOL));
+    REQUIRE(forces.almostEquals(refForces, TOL));
+    Real energySum = 0;
+    for (int atom = 0; atom < nAtoms; ++atom) energySum += atomEnergies(atom, 0);
+    REQUIRE(energySum == Approx(refEnergy).margin(TOL));
+
+    helpme::Matrix<Real> virial(1, 6), atomVirials(nAtoms, 6);
+    forces.setZero();
+    atomEnergies.setZero();
+    energy = pme.computeEFVRecPerAtom(parameters, coords, forces, virial, atomEnergies, atomVirials);
+    REQUIRE(energy == Approx(refEnergy).margin(TOL));
+    REQUIRE(forces.almostEquals(refForces, TOL));
+    REQUIRE(virial.almostEquals(refVirial, TOL));
+    energySum = 0;
+    helpme::Matrix<Real> virialSum(1, 6);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        energySum += atomEnergies(atom, 0);
+        for (int component = 0; component < 6; ++component) virialSum(0, component) += atomVirials(atom, component);
+    }
+    REQUIRE(energySum == Approx(refEnergy).margin(TOL));
+    REQUIRE(virialSum.almostEquals(refVirial, TOL));
+}
+}  // namespace
+
+TEST_CASE("check that per-atom energies and virials sum to the reciprocal space totals.") {
+    SECTION("Coulomb charges") {
+        checkPerAtomDecomposition<double>(1, 1, false);
+        checkPerAtomDecomposition<double>(1, 2, false);
+        checkPerAtomDecomposition<double>(1, 1, true);
+    }
+    SECTION("Dispersion coefficients, which have an m=0 term") {
+        checkPerAtomDecomposition<double>(6, 1, false);
+        checkPerAtomDecomposition<double>(6, 2, true);
+    }
+}
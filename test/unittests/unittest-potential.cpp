@@ -34,4 +34,61 @@ TEST_CASE("check potential (and derivatives thereof) code.") {
         pme.computePRec(0, charges, coords, coords, 3, potential);
         std::cout << potential << std::endl;
     }
+
+    SECTION("cached probes at the atoms match arbitrary probe points") {
+        constexpr double TOL = 1e-8;
+        // Shifting by the first (X aligned) lattice vector gives equivalent points that take the uncached path.
+        helpme::Matrix<double> shiftedCoords = coords.clone();
+        for (int atom = 0; atom < nAtoms; ++atom) shiftedCoords(atom, 0) += 20;
+        helpme::Matrix<double> arbitraryPotential(nAtoms, 10);
+        pme.computePRec(0, charges, coords, shiftedCoords, 2, arbitraryPotential);
+        for (int nThreads : {1, 2}) {
+            helpme::PMEInstance<double> threadedPME;
+            threadedPME.setup(1, kappa, 6, gridPts, gridPts, gridPts, scaleFactor, nThreads);
+            threadedPME.setLatticeVectors(20, 22, 25, 70, 85, 100,
+                                          helpme::PMEInstance<double>::LatticeType::XAligned);
+            helpme::Matrix<double> atomPotential(nAtoms, 10);
+            threadedPME.computePRec(0, charges, coords, coords, 2, atomPotential);
+            REQUIRE(atomPotential.almostEquals(arbitraryPotential, TOL));
+        }
+    }
+
+    SECTION("streamed probes at many arbitrary points match the potential at the atoms") {
+        constexpr double TOL = 1e-8;
+        // Replicate the atoms over many periodic images, in a scrambled order, to give more points than fit in a block.
+        int nImages = 101;
+        helpme::Matrix<double> points(nAtoms * nImages, 3);
+        for (int image = 0; image < nImages; ++image) {
+            for (int atom = 0; atom < nAtoms; ++atom) {
+                int point = (image * nAtoms + atom) * 7 % (nAtoms * nImages);
+                points(point, 0) = coords(atom, 0) + 20 * (image % 5 - 2);
+                points(point, 1) = coords(atom, 1);
+                points(point, 2) = coords(atom, 2);
+            }
+        }
+        helpme::Matrix<double> atomPotential(nAtoms, 10);
+        pme.computePRec(0, charges, coords, coords, 2, atomPotential);
+        for (int nThreads : {1, 3}) {
+            helpme::PMEInstance<double> streamingPME;
+            streamingPME.setup(1, kappa, 6, gridPts, gridPts, gridPts, scaleFactor, nThreads);
+            streamingPME.setLatticeVectors(20, 22, 25, 70, 85, 100,
+                                           helpme::PMEInstance<double>::LatticeType::XAligned);
+            REQUIRE_THROWS(streamingPME.probePotentialGridRec(points[0], 1, 0, atomPotential[0]));
+            streamingPME.computePotentialGridRec(0, charges, coords);
+            // Stream the points through in two uneven chunks.
+            helpme::Matrix<double> pointPotential(nAtoms * nImages, 10);
+            size_t firstChunk = 200;
+            streamingPME.probePotentialGridRec(points[0], firstChunk, 2, pointPotential[0]);
+            streamingPME.probePotentialGridRec(points[firstChunk], points.nRows() - firstChunk, 2,
+                                               pointPotential[firstChunk]);
+            for (int image = 0; image < nImages; ++image) {
+                for (int atom = 0; atom < nAtoms; ++atom) {
+                    int point = (image * nAtoms + atom) * 7 % (nAtoms * nImages);
+                    for (int component = 0; component < 10; ++component)
+                        REQUIRE(pointPotential(point, component) ==
+                                Approx(atomPotential(atom, component)).margin(TOL));
+                }
+            }
+        }
+    }
 }
@@ -0,0 +1,49 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+TEST_CASE("check that spatially sorting the atoms reproduces the unsorted results.") {
+    constexpr double TOL = 1e-8;
+    int nAtoms = 400;
+    std::mt19937 generator(4321);
+    std::uniform_real_distribution<double> position(0, 25);
+    std::uniform_real_distribution<double> displacement(-0.2, 0.2);
+    std::uniform_real_distribution<double> charge(-1, 1);
+    helpme::Matrix<double> coords(nAtoms, 3);
+    helpme::Matrix<double> charges(nAtoms, 1);
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        charges(atom, 0) = charge(generator);
+    }
+
+    helpme::PMEInstance<double> unsortedPME, sortedPME;
+    for (auto pme : {&unsortedPME, &sortedPME}) {
+        pme->setup(1, 0.3, 5, 32, 30, 28, 332.0716, 2);
+        pme->setLatticeVectors(25, 25, 25, 90, 90, 90, helpme::PMEInstance<double>::LatticeType::XAligned);
+    }
+    sortedPME.setSpatialSorting(true);
+
+    // Run a few steps with small displacements, to exercise both the sorting and the reuse of the previous ordering.
+    for (int step = 0; step < 4; ++step) {
+        helpme::Matrix<double> unsortedForces(nAtoms, 3), sortedForces(nAtoms, 3);
+        helpme::Matrix<double> unsortedVirial(1, 6), sortedVirial(1, 6);
+        double unsortedEnergy = unsortedPME.computeEFVRec(0, charges, coords, unsortedForces, unsortedVirial);
+        double sortedEnergy = sortedPME.computeEFVRec(0, charges, coords, sortedForces, sortedVirial);
+        REQUIRE(unsortedEnergy == Approx(sortedEnergy).margin(TOL));
+        REQUIRE(unsortedForces.almostEquals(sortedForces, TOL));
+        REQUIRE(unsortedVirial.almostEquals(sortedVirial, TOL));
+        for (int atom = 0; atom < nAtoms; ++atom)
+            for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) += displacement(generator);
+    }
+}
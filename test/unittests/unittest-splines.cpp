@@ -81,3 +81,54 @@ TEST_CASE("make sure B-Splines and their derivatives are created correctly.") {
         REQUIRE(refMod8.cast<float>().almostEquals(helpme::Matrix<float>(spline.invSplineModuli(8).data(), 8, 1), TOL));
     }
 }
+
+TEST_CASE("make sure blocks of B-Splines match the individually computed splines.") {
+    constexpr double TOL = 1e-14;
+    std::vector<double> values{0.0, 0.13, 0.5, 0.66, 0.999};
+    for (int order : {4, 5, 6, 8}) {
+        for (int deriv = 0; deriv <= order - 2; ++deriv) {
+            helpme::BSplineBlock<double> block;
+            block.update(values.data(), values.size(), order, deriv);
+            REQUIRE(block.nPoints() == static_cast<int>(values.size()));
+            for (size_t point = 0; point < values.size(); ++point) {
+                auto spline = helpme::BSpline<double>(0, values[point], order, deriv);
+                for (int level = 0; level <= deriv; ++level)
+                    for (int component = 0; component < order; ++component)
+                        REQUIRE(block(level, component)[point] == Approx(spline[level][component]).margin(TOL));
+            }
+        }
+    }
+}
+
+TEST_CASE("make sure B-Splines computed in place and viewed match the owning B-Splines.") {
+    constexpr int order = 6;
+    constexpr int deriv = 2;
+    auto spline = helpme::BSpline<double>(3, 0.42, order, deriv);
+    std::vector<double> storage((deriv + 1) * order, 0);
+    helpme::BSpline<double>::computeInPlace(storage.data(), 0.42, order, deriv);
+    helpme::BSplineView<double> view(3, storage.data(), order);
+    helpme::BSplineView<double> convertedView = spline;
+    REQUIRE(view.startingGridPoint() == 3);
+    REQUIRE(convertedView.startingGridPoint() == 3);
+    for (int level = 0; level <= deriv; ++level) {
+        for (int component = 0; component < order; ++component) {
+            REQUIRE(view[level][component] == spline[level][component]);
+            REQUIRE(convertedView[level][component] == spline[level][component]);
+        }
+    }
+}
+
+TEST_CASE("make sure fixed size B-Splines match the heap allocated B-Splines.") {
+    for (int order : {4, 5, 6, 8}) {
+        for (int deriv = 0; deriv <= order - 2; ++deriv) {
+            auto spline = helpme::BSpline<double>(2, 0.37, order, deriv);
+            auto fixedSpline = helpme::FixedBSpline<double, 8, 6>(2, 0.37, order, deriv);
+            REQUIRE(fixedSpline.startingGridPoint() == 2);
+            for (int level = 0; level <= deriv; ++level)
+                for (int component = 0; component < order; ++component)
+                    REQUIRE(fixedSpline[level][component] == spline[level][component]);
+        }
+    }
+    REQUIRE_THROWS(helpme::FixedBSpline<double, 8, 6>(0, 0.5, 10, 2));
+    REQUIRE_THROWS(helpme::FixedBSpline<double, 8, 6>(0, 0.5, 6, 5));
+}
@@ -0,0 +1,98 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <random>
+
+#include "helpme.h"
+
+namespace {
+// Make a box of randomly placed atoms, with parameters of the requested angular momentum.
+template <typename Real>
+std::tuple<helpme::Matrix<Real>, helpme::Matrix<Real>> makeSystem(int nAtoms, int parameterAngMom, Real boxLength) {
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<Real> position(-0.5 * boxLength, 1.5 * boxLength);
+    std::uniform_real_distribution<Real> parameter(-1, 1);
+    helpme::Matrix<Real> coords(nAtoms, 3);
+    helpme::Matrix<Real> parameters(nAtoms, helpme::nCartesian(parameterAngMom));
+    for (int atom = 0; atom < nAtoms; ++atom) {
+        for (int xyz = 0; xyz < 3; ++xyz) coords(atom, xyz) = position(generator);
+        for (size_t component = 0; component < parameters.nCols(); ++component)
+            parameters(atom, component) = parameter(generator);
+    }
+    return std::make_tuple(std::move(coords), std::move(parameters));
+}
+
+template <typename Real>
+std::tuple<Real, helpme::Matrix<Real>, helpme::Matrix<Real>> runEFV(int rPower, int splineOrder, int gridDim,
+                                                                    int nThreads, int parameterAngMom,
+                                                                    const helpme::Matrix<Real> &coords,
+                                                                    const helpme::Matrix<Real> &parameters) {
+    helpme::Matrix<Real> forces(coords.nRows(), 3);
+    helpme::Matrix<Real> virial(1, 6);
+    helpme::PMEInstance<Real> pme;
+    pme.setup(rPower, 0.3, splineOrder, gridDim, gridDim + 2, gridDim + 4, 332.0716, nThreads);
+    pme.setLatticeVectors(21, 22, 23, 85, 90, 95, helpme::PMEInstance<Real>::LatticeType::XAligned);
+    Real energy = pme.computeEFVRec(parameterAngMom, parameters, coords, forces, virial);
+    return std::make_tuple(energy, std::move(forces), std::move(virial));
+}
+}  // namespace
+
+TEST_CASE("check that multithreaded runs reproduce the serial results.") {
+    constexpr double TOL = 1e-8;
+    SECTION("Coulomb charges") {
+        auto system = makeSystem<double>(500, 0, 22);
+        const auto &coords = std::get<0>(system);
+        const auto &charges = std::get<1>(system);
+        for (int splineOrder : {4, 5, 6}) {
+            auto serial = runEFV<double>(1, splineOrder, 30, 1, 0, coords, charges);
+            for (int nThreads : {2, 3, 4}) {
+                auto threaded = runEFV<double>(1, splineOrder, 30, nThreads, 0, coords, charges);
+                REQUIRE(std::get<0>(serial) == Approx(std::get<0>(threaded)).margin(TOL));
+                REQUIRE(std::get<1>(serial).almostEquals(std::get<1>(threaded), TOL));
+                REQUIRE(std::get<2>(serial).almostEquals(std::get<2>(threaded), TOL));
+            }
+        }
+    }
+    SECTION("Dispersion coefficients on a grid too small to be split") {
+        auto system = makeSystem<double>(200, 0, 22);
+        const auto &coords = std::get<0>(system);
+        const auto &c6 = std::get<1>(system);
+        auto serial = runEFV<double>(6, 6, 8, 1, 0, coords, c6);
+        auto threaded = runEFV<double>(6, 6, 8, 4, 0, coords, c6);
+        REQUIRE(std::get<0>(serial) == Approx(std::get<0>(threaded)).margin(TOL));
+        REQUIRE(std::get<1>(serial).almostEquals(std::get<1>(threaded), TOL));
+        REQUIRE(std::get<2>(serial).almostEquals(std::get<2>(threaded), TOL));
+    }
+    SECTION("Quadrupoles") {
+        auto system = makeSystem<double>(300, 2, 22);
+        const auto &coords = std::get<0>(system);
+        const auto &multipoles = std::get<1>(system);
+        auto serial = runEFV<double>(1, 6, 24, 1, 2, coords, multipoles);
+        auto threaded = runEFV<double>(1, 6, 24, 4, 2, coords, multipoles);
+        REQUIRE(std::get<0>(serial) == Approx(std::get<0>(threaded)).margin(TOL));
+        REQUIRE(std::get<1>(serial).almostEquals(std::get<1>(threaded), TOL));
+        REQUIRE(std::get<2>(serial).almostEquals(std::get<2>(threaded), TOL));
+    }
+}
+
+TEST_CASE("check that an insufficient spline order throws, rather than aborting, in threaded runs.") {
+    auto system = makeSystem<double>(50, 2, 22);
+    const auto &coords = std::get<0>(system);
+    const auto &multipoles = std::get<1>(system);
+    for (int nThreads : {1, 4}) {
+        helpme::Matrix<double> forces(coords.nRows(), 3);
+        helpme::PMEInstance<double> pme;
+        pme.setup(1, 0.3, 4, 24, 24, 24, 332.0716, nThreads);
+        pme.setLatticeVectors(21, 22, 23, 85, 90, 95, helpme::PMEInstance<double>::LatticeType::XAligned);
+        REQUIRE_THROWS_WITH(pme.computeEFRec(2, multipoles, coords, forces),
+                            Catch::Contains("Set the spline order to at least 5"));
+    }
+}
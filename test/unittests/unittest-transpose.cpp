@@ -0,0 +1,59 @@
+// BEGINLICENSE
+//
+// This file is part of helPME, which is distributed under the BSD 3-clause license,
+// as described in the LICENSE file in the top level directory of this project.
+//
+// Author: Andrew C. Simmonett
+//
+// ENDLICENSE
+
+#include "catch.hpp"
+
+#include <complex>
+#include <vector>
+
+#include "transpose.h"
+
+namespace {
+// Transposes a batch of padded matrices using the tiled kernel, and compares with a direct element by element copy.
+template <typename T>
+void checkTranspose(size_t nMatrices, size_t nRows, size_t nCols, int nThreads) {
+    // Pad the rows and matrices, so that the strides are exercised as well as the shapes.
+    size_t inRowStride = nCols + 3, inMatrixStride = nRows * inRowStride + 5;
+    size_t outRowStride = nRows + 2, outMatrixStride = nCols * outRowStride + 1;
+    std::vector<T> in(nMatrices * inMatrixStride);
+    for (size_t n = 0; n < in.size(); ++n) in[n] = static_cast<T>(n % 1013) + T(0.5);
+    std::vector<T> expected(nMatrices * outMatrixStride, T(-1)), found(nMatrices * outMatrixStride, T(-1));
+    for (size_t matrix = 0; matrix < nMatrices; ++matrix)
+        for (size_t row = 0; row < nRows; ++row)
+            for (size_t col = 0; col < nCols; ++col)
+                expected[matrix * outMatrixStride + col * outRowStride + row] =
+                    in[matrix * inMatrixStride + row * inRowStride + col];
+    helpme::transposeMatrices(in.data(), inMatrixStride, inRowStride, found.data(), outMatrixStride, outRowStride,
+                              nMatrices, nRows, nCols, nThreads);
+    // The padding in the output must be left untouched.
+    REQUIRE(expected == found);
+}
+}  // namespace
+
+TEST_CASE("check the tiled transpose kernels against a direct transpose.") {
+    SECTION("real data") {
+        for (int nThreads : {1, 3}) {
+            checkTranspose<double>(1, 1, 1, nThreads);
+            checkTranspose<double>(1, 70, 33, nThreads);
+            checkTranspose<double>(4, 32, 32, nThreads);
+            checkTranspose<float>(3, 65, 129, nThreads);
+        }
+    }
+    SECTION("complex data") {
+        for (int nThreads : {1, 3}) {
+            checkTranspose<std::complex<double>>(1, 17, 40, nThreads);
+            checkTranspose<std::complex<double>>(5, 16, 3, nThreads);
+            checkTranspose<std::complex<float>>(2, 100, 31, nThreads);
+        }
+    }
+    SECTION("empty matrices") {
+        checkTranspose<double>(2, 0, 7, 2);
+        checkTranspose<double>(0, 5, 7, 2);
+    }
+}